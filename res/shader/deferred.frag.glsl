@@ -0,0 +1,76 @@
+#version 410 core
+
+in vec2 frag_texture_coordinate;
+
+out vec4 frag_color;
+
+uniform vec3 view_position;
+uniform mat4 inverse_view_projection;
+
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_material;
+uniform sampler2D gbuffer_depth;
+
+#include "include/pbr.glsl"
+#include "include/light_cluster.glsl"
+#include "include/shadow.glsl"
+
+void main() {
+    // The G-buffer is only filled up to the render size, so it's read by pixel rather than by texture coordinate
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+    // Nothing was drawn here, leave the clear color
+    if (depth == 1.0) {
+        discard;
+    }
+    // Keep the scene depth so that anything drawn after the lighting pass is still hidden behind it
+    gl_FragDepth = depth;
+
+    vec4 clip_position = vec4((frag_texture_coordinate * 2.0) - 1.0, (depth * 2.0) - 1.0, 1.0);
+    vec4 world_position = inverse_view_projection * clip_position;
+    vec3 frag_position = world_position.xyz / world_position.w;
+
+    vec3 view_direction = normalize(view_position - frag_position);
+    vec3 normal = texelFetch(gbuffer_normal, pixel, 0).xyz;
+    vec3 albedo = texelFetch(gbuffer_albedo, pixel, 0).rgb;
+    vec2 metallic_roughness = texelFetch(gbuffer_material, pixel, 0).rg;
+    float metallic = metallic_roughness.r;
+    float roughness = metallic_roughness.g;
+
+    vec3 base_reflectivity = mix(vec3(0.04), albedo, metallic);
+    vec3 light_out = vec3(0.0);
+    uvec2 cluster_range = texelFetch(light_clusters, int(light_cluster_index(gl_FragCoord.xy, depth))).xy;
+    for (uint i = 0u; i < cluster_range.y; i++) {
+        int light_index = int(texelFetch(light_indices, int(cluster_range.x + i)).r);
+        vec4 light_sphere = texelFetch(light_data, light_index * 2);
+        vec4 light_color = texelFetch(light_data, (light_index * 2) + 1);
+
+        // Calculate per-light radiance
+        vec3 light_direction = normalize(light_sphere.xyz - frag_position);
+        vec3 halfway = normalize(view_direction + light_direction);
+        float light_distance = length(light_sphere.xyz - frag_position);
+        // Fade out to zero at the light radius, past which the light isn't in any cluster
+        float falloff = clamp(1.0 - pow(light_distance / light_sphere.w, 4.0), 0.0, 1.0);
+        float attenuation = (falloff * falloff) / (light_distance * light_distance);
+        vec3 radiance = light_color.rgb * attenuation * light_shadow(light_sphere, light_color.w, frag_position, normal);
+
+        // Cook-Torrance BRDF
+        float NDF = distribution_ggx(normal, halfway, roughness);
+        float G = geometry_smith(normal, view_direction, light_direction, roughness);
+        vec3 light_reflected = fresnel_schlick(clamp(dot(halfway, view_direction), 0.0, 1.0), base_reflectivity);
+        vec3 light_refracted = (vec3(1.0) - light_reflected) * (1.0 - metallic);
+
+        vec3 numerator = NDF * G * light_reflected;
+        float denominator = 4.0 * max(dot(normal, view_direction), 0.0) * max(dot(normal, light_direction), 0.0) + 0.0001;
+        vec3 specular = numerator / denominator;
+
+        float n_dot_l = max(dot(normal, light_direction), 0.0);
+        light_out += (light_refracted * albedo / PI + specular) * radiance * n_dot_l;
+    }
+
+    vec3 ambient = vec3(0.03) * albedo;
+    vec3 color = ambient + light_out;
+
+    frag_color = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 410 core
+
+in vec3 frag_position;
+in vec3 frag_normal;
+in vec2 frag_texture_coordinate;
+
+uniform vec3 view_position;
+
+// Depth only, with the same back face test as the lit shaders so that walls seen from behind don't hide anything
+void main() {
+    if (dot(normalize(frag_normal), normalize(view_position - frag_position)) < 0) {
+        discard;
+    }
+}
\ No newline at end of file
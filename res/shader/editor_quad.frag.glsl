@@ -22,10 +22,6 @@ void main() {
 
     vec3 ambient = vec3(1.0) * albedo;
     vec3 color = ambient; 
-    // HDR tonemapping
-    color = color / (color + vec3(1.0));
-    // gamma correct
-    color = pow(color, vec3(1.0 / 2.2));
 
     frag_color = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -3,16 +3,34 @@
 layout (location = 0) in vec3 vertex_position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture_coordinate;
+#ifdef INDIRECT
+// Index of the draw in draw_models, stepped from the base instance of its indirect command
+layout (location = 3) in uint draw_index;
+#endif
 
 out vec3 frag_position;
 out vec3 frag_normal;
 out vec2 frag_texture_coordinate;
 
+// The depth prepass and the scene pass must land on exactly the same depth
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
+#ifdef INDIRECT
+// Four texels per draw, one per column of its model matrix
+uniform samplerBuffer draw_models;
+#else
 uniform mat4 model;
+#endif
 
 void main() {
+#ifdef INDIRECT
+    int model_texel = int(draw_index) * 4;
+    mat4 model = mat4(texelFetch(draw_models, model_texel), texelFetch(draw_models, model_texel + 1),
+                      texelFetch(draw_models, model_texel + 2), texelFetch(draw_models, model_texel + 3));
+#endif
+
     vec4 total_position = vec4(vertex_position, 1.0);
     gl_Position = projection * view * model * total_position;
 
@@ -0,0 +1,27 @@
+#version 410 core
+
+in vec3 frag_position;
+in vec3 frag_normal;
+in vec2 frag_texture_coordinate;
+
+layout (location = 0) out vec4 gbuffer_albedo;
+layout (location = 1) out vec4 gbuffer_normal;
+layout (location = 2) out vec4 gbuffer_material;
+
+uniform vec3 view_position;
+
+uniform sampler2D material_albedo;
+
+void main() {
+    vec3 view_direction = normalize(view_position - frag_position);
+    vec3 normal = normalize(frag_normal);
+    if (dot(normal, view_direction) < 0) {
+        discard;
+    }
+
+    // Albedo is stored in linear space, lighting happens in deferred.frag.glsl
+    gbuffer_albedo = vec4(pow(texture(material_albedo, frag_texture_coordinate).rgb, vec3(2.2)), 1.0);
+    gbuffer_normal = vec4(normal, 0.0);
+    // Metallic / Roughness
+    gbuffer_material = vec4(0.0, 0.5, 0.0, 0.0);
+}
\ No newline at end of file
@@ -8,20 +8,13 @@ out vec4 frag_color;
 
 uniform vec3 view_position;
 
-uniform vec3 light_positions[4];
-uniform vec3 light_colors[4];
-uniform int light_count;
-
 uniform sampler2DArray material_albedo;
-// uniform sampler2DArray material_normal;
-
-const float PI = 3.14159265359;
+#ifdef NORMAL_MAP
+uniform sampler2DArray material_normal;
+#endif
 
-float distribution_ggx(vec3 normal, vec3 halfway, float roughness);
-float geometry_schlick_ggx(float n_dot_v, float roughness);
-float geometry_smith(vec3 normal, vec3 view_direction, vec3 light_direction, float roughness);
-vec3 fresnel_schlick(float cos_theta, vec3 base_reflectivity);
-vec3 fresnel_schlick_roughness(float cos_theta, vec3 base_reflectivity, float roughness);
+#include "include/pbr.glsl"
+#include "include/light_cluster.glsl"
 
 void main() {  
     vec3 view_direction = normalize(view_position - frag_position);
@@ -35,8 +28,8 @@ void main() {
     float metallic = 0.0;
     float roughness = 0.5;
 
+#ifdef NORMAL_MAP
     // Normal
-    /*
     vec3 tangent_normal = texture(material_normal, frag_texture_coordinate).xyz * 2.0 - 1.0;
     vec3 q1 = dFdx(frag_position);
     vec3 q2 = dFdy(frag_position);
@@ -45,17 +38,24 @@ void main() {
     vec3 tangent = normalize(q1 * st2.t - q2 * st1.t);
     vec3 bitangent = -normalize(cross(normal, tangent));
     normal = normalize(mat3(tangent, bitangent, normal) * tangent_normal);
-    */
+#endif
 
     vec3 base_reflectivity = mix(vec3(0.04), albedo, metallic);
     vec3 light_out = vec3(0.0);
-    for (int light_index = 0; light_index < light_count; light_index++) {
+    uvec2 cluster_range = texelFetch(light_clusters, int(light_cluster_index(gl_FragCoord.xy, gl_FragCoord.z))).xy;
+    for (uint i = 0u; i < cluster_range.y; i++) {
+        int light_index = int(texelFetch(light_indices, int(cluster_range.x + i)).r);
+        vec4 light_sphere = texelFetch(light_data, light_index * 2);
+        vec3 light_color = texelFetch(light_data, (light_index * 2) + 1).rgb;
+
         // Calculate per-light radiance
-        vec3 light_direction = normalize(light_positions[light_index] - frag_position);
+        vec3 light_direction = normalize(light_sphere.xyz - frag_position);
         vec3 halfway = normalize(view_direction + light_direction);
-        float light_distance = length(light_positions[light_index] - frag_position);
-        float attenuation = 1.0 / (light_distance * light_distance);
-        vec3 radiance = light_colors[light_index] * attenuation;
+        float light_distance = length(light_sphere.xyz - frag_position);
+        // Fade out to zero at the light radius, past which the light isn't in any cluster
+        float falloff = clamp(1.0 - pow(light_distance / light_sphere.w, 4.0), 0.0, 1.0);
+        float attenuation = (falloff * falloff) / (light_distance * light_distance);
+        vec3 radiance = light_color * attenuation;
 
         // Cook-Torrance BRDF
         float NDF = distribution_ggx(normal, halfway, roughness);
@@ -76,47 +76,6 @@ void main() {
 
     vec3 ambient = vec3(0.03) * albedo;
     vec3 color = ambient + light_out;
-    // HDR tonemapping
-    color = color / (color + vec3(1.0));
-    // gamma correct
-    color = pow(color, vec3(1.0 / 2.2));
 
     frag_color = vec4(color, 1.0);
-}
-
-float distribution_ggx(vec3 normal, vec3 halfway, float roughness) {
-	float a = roughness * roughness;
-	float a_squared = a * a;
-	float n_dot_h = max(dot(normal, halfway), 0.0);
-	float n_dot_h_squared = n_dot_h * n_dot_h;
-
-	float denominator = (n_dot_h_squared * (a_squared - 1.0) + 1.0);
-	denominator = PI * denominator * denominator;
-
-	return a_squared / denominator;
-}
-
-float geometry_schlick_ggx(float n_dot_v, float roughness) {
-	float r = roughness + 1.0;
-	float k = (r * r) / 8.0;
-
-	float denominator = n_dot_v * (1.0 - k) + k;
-	return n_dot_v / denominator;
-}
-
-float geometry_smith(vec3 normal, vec3 view_direction, vec3 light_direction, float roughness) {
-	float n_dot_v = max(dot(normal, view_direction), 0.0);
-	float n_dot_l = max(dot(normal, light_direction), 0.0);
-	float ggx2 = geometry_schlick_ggx(n_dot_v, roughness);
-	float ggx1 = geometry_schlick_ggx(n_dot_l, roughness);
-
-	return ggx1 * ggx2;
-}
-
-vec3 fresnel_schlick(float cos_theta, vec3 base_reflectivity) {
-	return base_reflectivity + (1.0 - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
-}
-
-vec3 fresnel_schlick_roughness(float cos_theta, vec3 base_reflectivity, float roughness) {
-	return base_reflectivity + (max(vec3(1.0 - roughness), base_reflectivity) - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
 }
\ No newline at end of file
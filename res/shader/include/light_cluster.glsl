@@ -0,0 +1,22 @@
+// Keep in sync with light_cluster.h
+const uint CLUSTER_X = 16u;
+const uint CLUSTER_Y = 9u;
+const uint CLUSTER_Z = 24u;
+
+// Size of the area the scene is rendered into, which is smaller than the screen under dynamic resolution
+uniform vec2 render_size;
+uniform float cluster_near;
+uniform float cluster_far;
+// Two texels per light: position and radius, then color
+uniform samplerBuffer light_data;
+// Offset into light_indices and light count of each cluster
+uniform usamplerBuffer light_clusters;
+uniform usamplerBuffer light_indices;
+
+uint light_cluster_index(vec2 frag_coord, float frag_depth) {
+    float ndc_depth = (frag_depth * 2.0) - 1.0;
+    float depth = (2.0 * cluster_near * cluster_far) / (cluster_far + cluster_near - (ndc_depth * (cluster_far - cluster_near)));
+    uint slice = min(uint(max(log(depth / cluster_near) * float(CLUSTER_Z) / log(cluster_far / cluster_near), 0.0)), CLUSTER_Z - 1u);
+    uvec2 tile = min(uvec2(frag_coord / render_size * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1u, CLUSTER_Y - 1u));
+    return (((slice * CLUSTER_Y) + tile.y) * CLUSTER_X) + tile.x;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+// Cook-Torrance BRDF terms shared by the lit shaders
+const float PI = 3.14159265359;
+
+float distribution_ggx(vec3 normal, vec3 halfway, float roughness) {
+    float a = roughness * roughness;
+    float a_squared = a * a;
+    float n_dot_h = max(dot(normal, halfway), 0.0);
+    float n_dot_h_squared = n_dot_h * n_dot_h;
+
+    float denominator = (n_dot_h_squared * (a_squared - 1.0) + 1.0);
+    denominator = PI * denominator * denominator;
+
+    return a_squared / denominator;
+}
+
+float geometry_schlick_ggx(float n_dot_v, float roughness) {
+    float r = roughness + 1.0;
+    float k = (r * r) / 8.0;
+
+    float denominator = n_dot_v * (1.0 - k) + k;
+    return n_dot_v / denominator;
+}
+
+float geometry_smith(vec3 normal, vec3 view_direction, vec3 light_direction, float roughness) {
+    float n_dot_v = max(dot(normal, view_direction), 0.0);
+    float n_dot_l = max(dot(normal, light_direction), 0.0);
+    float ggx2 = geometry_schlick_ggx(n_dot_v, roughness);
+    float ggx1 = geometry_schlick_ggx(n_dot_l, roughness);
+
+    return ggx1 * ggx2;
+}
+
+vec3 fresnel_schlick(float cos_theta, vec3 base_reflectivity) {
+    return base_reflectivity + (1.0 - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
+}
+
+vec3 fresnel_schlick_roughness(float cos_theta, vec3 base_reflectivity, float roughness) {
+    return base_reflectivity + (max(vec3(1.0 - roughness), base_reflectivity) - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
+}
\ No newline at end of file
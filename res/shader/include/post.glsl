@@ -0,0 +1,23 @@
+// Set by post.cpp for every pass. A pass draws into the bottom left output_size pixels of its target, and input i was
+// drawn into the bottom left input_scale[i] part of its texture. Keep in sync with post.cpp
+const int POST_MAX_INPUTS = 3;
+
+uniform sampler2D input_textures[POST_MAX_INPUTS];
+uniform vec2 input_scale[POST_MAX_INPUTS];
+uniform vec2 input_texel[POST_MAX_INPUTS];
+uniform vec2 output_size;
+
+// Texture coordinate of this pixel's center in an input
+vec2 post_input_coordinate(int input_index) {
+    return (gl_FragCoord.xy / output_size) * input_scale[input_index];
+}
+
+// Samples an input, keeping the bilinear taps inside the part of it that was drawn this frame
+vec4 post_sample(int input_index, vec2 texture_coordinate) {
+    vec2 half_texel = input_texel[input_index] * 0.5;
+    return texture(input_textures[input_index], clamp(texture_coordinate, half_texel, input_scale[input_index] - half_texel));
+}
+
+float post_luma(vec3 color) {
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+// One cube map per shadowed light, storing the distance to the light divided by its radius
+uniform samplerCubeArrayShadow shadow_maps;
+
+// Shadow lookups are moved off the surface along its normal so that it doesn't shadow itself
+const float SHADOW_NORMAL_OFFSET = 0.03;
+
+// The light color's w is the light's layer in shadow_maps, or negative if the light has no shadow
+float light_shadow(vec4 light_sphere, float shadow_layer, vec3 position, vec3 normal) {
+    if (shadow_layer < 0.0) {
+        return 1.0;
+    }
+    vec3 light_to_position = position + (normal * SHADOW_NORMAL_OFFSET) - light_sphere.xyz;
+    return texture(shadow_maps, vec4(light_to_position, shadow_layer), length(light_to_position) / light_sphere.w);
+}
\ No newline at end of file
@@ -3,5 +3,6 @@
 out vec4 frag_color;
 
 void main() {
-    frag_color = vec4(1.0);
+    // Bright enough to come out white after tonemapping, and to bloom
+    frag_color = vec4(vec3(16.0), 1.0);
 }
\ No newline at end of file
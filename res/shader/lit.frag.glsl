@@ -0,0 +1,66 @@
+#version 410 core
+
+in vec3 frag_position;
+in vec3 frag_normal;
+in vec2 frag_texture_coordinate;
+
+out vec4 frag_color;
+
+uniform vec3 view_position;
+
+uniform sampler2D material_albedo;
+
+#include "include/pbr.glsl"
+#include "include/light_cluster.glsl"
+#include "include/shadow.glsl"
+
+void main() {
+    vec3 view_direction = normalize(view_position - frag_position);
+    vec3 normal = normalize(frag_normal);
+    if (dot(normal, view_direction) < 0) {
+        discard;
+    }
+
+    // Albedo
+    vec3 albedo = pow(texture(material_albedo, frag_texture_coordinate).rgb, vec3(2.2));
+
+    // Metallic / Roughness
+    float metallic = 0.0;
+    float roughness = 0.5;
+
+    vec3 base_reflectivity = mix(vec3(0.04), albedo, metallic);
+    vec3 light_out = vec3(0.0);
+    uvec2 cluster_range = texelFetch(light_clusters, int(light_cluster_index(gl_FragCoord.xy, gl_FragCoord.z))).xy;
+    for (uint i = 0u; i < cluster_range.y; i++) {
+        int light_index = int(texelFetch(light_indices, int(cluster_range.x + i)).r);
+        vec4 light_sphere = texelFetch(light_data, light_index * 2);
+        vec4 light_color = texelFetch(light_data, (light_index * 2) + 1);
+
+        // Calculate per-light radiance
+        vec3 light_direction = normalize(light_sphere.xyz - frag_position);
+        vec3 halfway = normalize(view_direction + light_direction);
+        float light_distance = length(light_sphere.xyz - frag_position);
+        // Fade out to zero at the light radius, past which the light isn't in any cluster
+        float falloff = clamp(1.0 - pow(light_distance / light_sphere.w, 4.0), 0.0, 1.0);
+        float attenuation = (falloff * falloff) / (light_distance * light_distance);
+        vec3 radiance = light_color.rgb * attenuation * light_shadow(light_sphere, light_color.w, frag_position, normal);
+
+        // Cook-Torrance BRDF
+        float NDF = distribution_ggx(normal, halfway, roughness);
+        float G = geometry_smith(normal, view_direction, light_direction, roughness);
+        vec3 light_reflected = fresnel_schlick(clamp(dot(halfway, view_direction), 0.0, 1.0), base_reflectivity);
+        vec3 light_refracted = (vec3(1.0) - light_reflected) * (1.0 - metallic);
+
+        vec3 numerator = NDF * G * light_reflected;
+        float denominator = 4.0 * max(dot(normal, view_direction), 0.0) * max(dot(normal, light_direction), 0.0) + 0.0001;
+        vec3 specular = numerator / denominator;
+
+        float n_dot_l = max(dot(normal, light_direction), 0.0);
+        light_out += (light_refracted * albedo / PI + specular) * radiance * n_dot_l;
+    }
+
+    vec3 ambient = vec3(0.03) * albedo;
+    vec3 color = ambient + light_out;
+
+    frag_color = vec4(color, 1.0);
+}
\ No newline at end of file
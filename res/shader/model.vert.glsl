@@ -3,8 +3,10 @@
 layout (location = 0) in vec3 vertex_position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture_coordinate;
+#ifdef SKINNED
 layout (location = 3) in ivec4 bone_ids;
 layout (location = 4) in vec4 bone_weights;
+#endif
 
 out vec3 frag_position;
 out vec3 frag_normal;
@@ -14,25 +16,31 @@ uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
+#ifdef SKINNED
 const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
 uniform mat4 bone_matrix[MAX_BONES];
+#endif
 
 void main() {
+#ifdef SKINNED
     vec4 total_position = vec4(0.0);
-    if (bone_ids[0] == -1) {
-        total_position = vec4(vertex_position, 1.0);
-    } else {
-        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
-            if (bone_ids[i] > MAX_BONES - 1) {
-                total_position = vec4(vertex_position, 1.0);
-                break;
-            }
-
-            vec4 local_position = bone_matrix[bone_ids[i]] * vec4(vertex_position, 1.0);
-            total_position += local_position * bone_weights[i];
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        // Unused influences
+        if (bone_ids[i] < 0) {
+            continue;
         }
+        if (bone_ids[i] > MAX_BONES - 1) {
+            total_position = vec4(vertex_position, 1.0);
+            break;
+        }
+
+        vec4 local_position = bone_matrix[bone_ids[i]] * vec4(vertex_position, 1.0);
+        total_position += local_position * bone_weights[i];
     }
+#else
+    vec4 total_position = vec4(vertex_position, 1.0);
+#endif
 
     gl_Position = projection * view * model * total_position;
 
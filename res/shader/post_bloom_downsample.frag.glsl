@@ -0,0 +1,31 @@
+#version 410 core
+
+out vec4 frag_color;
+
+#include "include/post.glsl"
+
+#ifdef PREFILTER
+uniform float threshold;
+#endif
+
+void main() {
+    // Four bilinear taps around the pixel average a 4x4 block of the input, which is twice the size of the output
+    vec2 texture_coordinate = post_input_coordinate(0);
+    vec2 texel = input_texel[0];
+    vec3 color = post_sample(0, texture_coordinate + vec2(-texel.x, -texel.y)).rgb;
+    color += post_sample(0, texture_coordinate + vec2(texel.x, -texel.y)).rgb;
+    color += post_sample(0, texture_coordinate + vec2(-texel.x, texel.y)).rgb;
+    color += post_sample(0, texture_coordinate + texel).rgb;
+    color *= 0.25;
+
+#ifdef PREFILTER
+    // Soft knee around the threshold, so that bloom fades in as things get brighter instead of popping in
+    float brightness = max(color.r, max(color.g, color.b));
+    float knee = threshold * 0.5;
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = (soft * soft) / ((4.0 * knee) + 0.0001);
+    color *= max(soft, brightness - threshold) / max(brightness, 0.0001);
+#endif
+
+    frag_color = vec4(color, 1.0);
+}
\ No newline at end of file
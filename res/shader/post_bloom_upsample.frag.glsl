@@ -0,0 +1,22 @@
+#version 410 core
+
+out vec4 frag_color;
+
+#include "include/post.glsl"
+
+void main() {
+    // 3x3 tent filter over the smaller level, added onto the level above
+    vec2 texture_coordinate = post_input_coordinate(0);
+    vec2 texel = input_texel[0];
+    vec3 color = post_sample(0, texture_coordinate).rgb * 4.0;
+    color += post_sample(0, texture_coordinate + vec2(-texel.x, 0.0)).rgb * 2.0;
+    color += post_sample(0, texture_coordinate + vec2(texel.x, 0.0)).rgb * 2.0;
+    color += post_sample(0, texture_coordinate + vec2(0.0, -texel.y)).rgb * 2.0;
+    color += post_sample(0, texture_coordinate + vec2(0.0, texel.y)).rgb * 2.0;
+    color += post_sample(0, texture_coordinate + vec2(-texel.x, -texel.y)).rgb;
+    color += post_sample(0, texture_coordinate + vec2(texel.x, -texel.y)).rgb;
+    color += post_sample(0, texture_coordinate + vec2(-texel.x, texel.y)).rgb;
+    color += post_sample(0, texture_coordinate + texel).rgb;
+
+    frag_color = vec4(color / 16.0, 1.0);
+}
\ No newline at end of file
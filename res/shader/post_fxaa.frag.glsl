@@ -0,0 +1,42 @@
+#version 410 core
+
+out vec4 frag_color;
+
+#include "include/post.glsl"
+
+const float FXAA_SPAN_MAX = 8.0;
+const float FXAA_REDUCE_MUL = 1.0 / 8.0;
+const float FXAA_REDUCE_MIN = 1.0 / 128.0;
+// Contrast below which a pixel isn't treated as an edge, absolute and relative to the brightest neighbour
+const float FXAA_EDGE_THRESHOLD_MIN = 1.0 / 32.0;
+const float FXAA_EDGE_THRESHOLD = 1.0 / 8.0;
+
+void main() {
+    vec2 texture_coordinate = post_input_coordinate(0);
+    vec2 texel = input_texel[0];
+    vec4 center = post_sample(0, texture_coordinate);
+    float luma_nw = post_sample(0, texture_coordinate + vec2(-texel.x, -texel.y)).a;
+    float luma_ne = post_sample(0, texture_coordinate + vec2(texel.x, -texel.y)).a;
+    float luma_sw = post_sample(0, texture_coordinate + vec2(-texel.x, texel.y)).a;
+    float luma_se = post_sample(0, texture_coordinate + texel).a;
+    float luma_min = min(center.a, min(min(luma_nw, luma_ne), min(luma_sw, luma_se)));
+    float luma_max = max(center.a, max(max(luma_nw, luma_ne), max(luma_sw, luma_se)));
+    if (luma_max - luma_min < max(FXAA_EDGE_THRESHOLD_MIN, luma_max * FXAA_EDGE_THRESHOLD)) {
+        frag_color = vec4(center.rgb, 1.0);
+        return;
+    }
+
+    // Blur along the edge, which runs across the luma gradient
+    vec2 direction = vec2(-((luma_nw + luma_ne) - (luma_sw + luma_se)), (luma_nw + luma_sw) - (luma_ne + luma_se));
+    float direction_reduce = max((luma_nw + luma_ne + luma_sw + luma_se) * 0.25 * FXAA_REDUCE_MUL, FXAA_REDUCE_MIN);
+    float inverse_direction_min = 1.0 / (min(abs(direction.x), abs(direction.y)) + direction_reduce);
+    direction = clamp(direction * inverse_direction_min, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texel;
+
+    vec3 near_average = 0.5 * (post_sample(0, texture_coordinate + (direction * ((1.0 / 3.0) - 0.5))).rgb +
+                               post_sample(0, texture_coordinate + (direction * ((2.0 / 3.0) - 0.5))).rgb);
+    vec3 far_average = (near_average * 0.5) + (0.25 * (post_sample(0, texture_coordinate - (direction * 0.5)).rgb +
+                                                       post_sample(0, texture_coordinate + (direction * 0.5)).rgb));
+    // The wider blur went past the edge if it left the range of the neighbourhood
+    float luma_far = post_luma(far_average);
+    frag_color = vec4(luma_far < luma_min || luma_far > luma_max ? near_average : far_average, 1.0);
+}
\ No newline at end of file
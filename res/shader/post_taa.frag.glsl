@@ -0,0 +1,43 @@
+#version 410 core
+
+out vec4 frag_color;
+
+#include "include/post.glsl"
+
+// Previous view projection times the inverse of the current one, both without jitter
+uniform mat4 reprojection;
+// This frame's projection jitter in NDC
+uniform vec2 jitter;
+uniform float history_weight;
+
+void main() {
+    // Inputs: this frame's tonemapped image, last frame's output and the scene depth
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 pixel_max = ivec2(output_size) - ivec2(1);
+    vec3 current = texelFetch(input_textures[0], pixel, 0).rgb;
+
+    // Where this pixel's surface was on screen last frame
+    float depth = texelFetch(input_textures[2], pixel, 0).r;
+    vec2 ndc = (((gl_FragCoord.xy / output_size) * 2.0) - 1.0) - jitter;
+    vec4 previous_position = reprojection * vec4(ndc, (depth * 2.0) - 1.0, 1.0);
+    vec2 previous_coordinate = ((previous_position.xy / previous_position.w) * 0.5) + 0.5;
+    bool is_off_screen = any(lessThan(previous_coordinate, vec2(0.0))) || any(greaterThan(previous_coordinate, vec2(1.0)));
+    if (history_weight == 0.0 || is_off_screen) {
+        frag_color = vec4(current, 1.0);
+        return;
+    }
+
+    // History is clamped to the colors around the pixel this frame, which throws out most of what moved or was uncovered
+    vec3 neighbour_min = current;
+    vec3 neighbour_max = current;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 neighbour = texelFetch(input_textures[0], clamp(pixel + ivec2(x, y), ivec2(0), pixel_max), 0).rgb;
+            neighbour_min = min(neighbour_min, neighbour);
+            neighbour_max = max(neighbour_max, neighbour);
+        }
+    }
+    vec3 history = clamp(post_sample(1, previous_coordinate * input_scale[1]).rgb, neighbour_min, neighbour_max);
+
+    frag_color = vec4(mix(current, history, history_weight), 1.0);
+}
\ No newline at end of file
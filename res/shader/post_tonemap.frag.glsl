@@ -0,0 +1,24 @@
+#version 410 core
+
+out vec4 frag_color;
+
+#include "include/post.glsl"
+
+#ifdef BLOOM
+uniform float bloom_intensity;
+#endif
+
+void main() {
+    vec3 color = texelFetch(input_textures[0], ivec2(gl_FragCoord.xy), 0).rgb;
+#ifdef BLOOM
+    color += post_sample(1, post_input_coordinate(1)).rgb * bloom_intensity;
+#endif
+
+    // HDR tonemapping
+    color = color / (color + vec3(1.0));
+    // gamma correct
+    color = pow(color, vec3(1.0 / 2.2));
+
+    // FXAA finds edges from the luma in alpha
+    frag_color = vec4(color, post_luma(color));
+}
\ No newline at end of file
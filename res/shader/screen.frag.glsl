@@ -5,7 +5,28 @@ in vec2 frag_texture_coordinate;
 out vec4 frag_color;
 
 uniform sampler2D screen_texture;
+uniform vec2 screen_size;
+// Fraction of the texture the scene was rendered into
+uniform vec2 texture_scale;
+uniform float sharpness;
 
 void main() {
-    frag_color = texture(screen_texture, frag_texture_coordinate);
+    vec2 texel = 1.0 / screen_size;
+    // Keep the bilinear taps inside the rendered area, past it is whatever an earlier, larger frame left there
+    vec2 texture_coordinate = min(frag_texture_coordinate * texture_scale, texture_scale - (texel * 0.5));
+    vec3 center = texture(screen_texture, texture_coordinate).rgb;
+    if (sharpness == 0.0) {
+        frag_color = vec4(center, 1.0);
+        return;
+    }
+
+    // Unsharp mask against the four neighbours, clamped to their range so that edges don't ring
+    vec3 left = texture(screen_texture, max(texture_coordinate - vec2(texel.x, 0.0), texel * 0.5)).rgb;
+    vec3 right = texture(screen_texture, min(texture_coordinate + vec2(texel.x, 0.0), texture_scale - (texel * 0.5))).rgb;
+    vec3 down = texture(screen_texture, max(texture_coordinate - vec2(0.0, texel.y), texel * 0.5)).rgb;
+    vec3 up = texture(screen_texture, min(texture_coordinate + vec2(0.0, texel.y), texture_scale - (texel * 0.5))).rgb;
+    vec3 neighbour_min = min(min(left, right), min(down, up));
+    vec3 neighbour_max = max(max(left, right), max(down, up));
+    vec3 sharpened = center + ((center * 4.0) - (left + right + down + up)) * sharpness;
+    frag_color = vec4(clamp(sharpened, min(neighbour_min, center), max(neighbour_max, center)), 1.0);
 }
\ No newline at end of file
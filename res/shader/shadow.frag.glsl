@@ -0,0 +1,11 @@
+#version 410 core
+
+in vec3 frag_position;
+
+uniform vec3 light_position;
+uniform float light_radius;
+
+void main() {
+    // Store the distance to the light rather than the projected depth so that all six faces can be compared against the same value
+    gl_FragDepth = length(frag_position - light_position) / light_radius;
+}
\ No newline at end of file
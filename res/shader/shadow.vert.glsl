@@ -0,0 +1,14 @@
+#version 410 core
+
+layout (location = 0) in vec3 vertex_position;
+
+out vec3 frag_position;
+
+uniform mat4 view_projection;
+uniform mat4 model;
+
+void main() {
+    vec4 world_position = model * vec4(vertex_position, 1.0);
+    frag_position = world_position.xyz;
+    gl_Position = view_projection * world_position;
+}
\ No newline at end of file
@@ -1,12 +1,13 @@
 #version 410 core
 
 in vec2 frag_texture_coordinate;
+in vec4 frag_text_color;
 
 out vec4 frag_color;
 
+// Coverage of each glyph in the red channel
 uniform sampler2D atlas_texture;
-uniform vec3 text_color;
 
 void main() {
-    frag_color = vec4(text_color, texture(atlas_texture, frag_texture_coordinate).r);
+    frag_color = vec4(frag_text_color.rgb, frag_text_color.a * texture(atlas_texture, frag_texture_coordinate).r);
 }
\ No newline at end of file
@@ -1,22 +1,19 @@
 #version 410 core
 
+// In screen pixels, with the origin at the top left
 layout (location = 0) in vec2 vertex_position;
+layout (location = 1) in vec2 texture_coordinate;
+layout (location = 2) in vec4 color;
 
 uniform vec2 screen_size;
-uniform sampler2D atlas_texture;
-
-uniform vec2 render_position;
-uniform vec2 glyph_size;
-uniform vec2 glyph_offset;
 
 out vec2 frag_texture_coordinate;
+out vec4 frag_text_color;
 
 void main() {
-    vec2 position = render_position + vec2(vertex_position.x * glyph_size.x, vertex_position.y * glyph_size.y);
-    position = vec2(position.x / (screen_size.x / 2.0), -position.y / (screen_size.y / 2.0)) - vec2(1.0, -1.0); 
+    vec2 position = vec2(vertex_position.x / (screen_size.x / 2.0), -vertex_position.y / (screen_size.y / 2.0)) - vec2(1.0, -1.0);
     gl_Position = vec4(position.x, position.y, 0.0, 1.0);
 
-    vec2 texture_size = vec2(textureSize(atlas_texture, 0));
-    frag_texture_coordinate = glyph_offset + vec2(vertex_position.x * glyph_size.x, vertex_position.y * glyph_size.y);
-    frag_texture_coordinate = vec2(frag_texture_coordinate.x / texture_size.x, frag_texture_coordinate.y / texture_size.y);
+    frag_texture_coordinate = texture_coordinate;
+    frag_text_color = color;
 }
\ No newline at end of file
@@ -3,13 +3,35 @@
 #include "resource.h"
 #include "logger.h"
 #include "input.h"
+#include "job.h"
+#include "file_watch.h"
+#include "vfs.h"
+#include "memory.h"
+#include "replay.h"
 #include "renderer/renderer.h"
+#include "renderer/profiler.h"
+#include "renderer/shader.h"
+#include "renderer/texture.h"
+#include "renderer/capture.h"
+#include "renderer/dynamic_resolution.h"
 #include <SDL2/SDL.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 static const uint64_t FRAME_TIME = (uint64_t)(1000.0 / 60.0);
 static const int APP_STATE_NONE = -1;
+// Caps how many fixed steps run in one frame so a long stall doesn't snowball into more work
+static const uint32_t FIXED_UPDATE_MAX_STEPS = 5;
+static const int OVERLAY_MARGIN = 8;
+// Frame compared against the golden image when PORTAL_GOLDEN_FRAME isn't set
+static const uint32_t GOLDEN_FRAME = 120;
+// Grows by itself if a frame needs more
+static const size_t FRAME_ARENA_CAPACITY = 4 * 1024 * 1024;
 
 struct Application {
     SDL_Window* window;
@@ -19,12 +41,151 @@ struct Application {
 
     int state_id;
     std::unordered_map<int, AppState> states;
+
+    std::vector<FileWatchChange> reload_changes;
+
+    // Counter value when application_create() started, to report how long it took to get to the first frame
+    uint64_t startup_start;
+
+    // Set for golden image runs
+    const char* golden_path;
+    uint32_t golden_frame;
+    int exit_code;
 };
 
 static bool initialized = false;
 static Application app;
 std::string resource_base_path;
 
+static double application_get_elapsed_ms(uint64_t start) {
+    return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Every device event goes through here, live or played back, so that a replay drives input exactly the way the
+// recording did. Event times are relative to run_start_time
+static void application_process_input(const ReplayEvent& event, uint64_t run_start_time) {
+    if (replay_is_recording()) {
+        replay_record_event(event);
+    }
+    uint64_t time = run_start_time + event.time;
+    switch (event.type) {
+        case REPLAY_EVENT_KEY:
+            input_process_key((SDL_Scancode)event.code, event.is_pressed, time);
+            break;
+        case REPLAY_EVENT_MOUSE_BUTTON:
+            input_process_mouse_button((uint8_t)event.code, event.is_pressed, time);
+            break;
+        case REPLAY_EVENT_MOUSE_MOTION:
+            input_process_mouse_motion(event.mouse_position, event.mouse_relative_position, time);
+            break;
+        case REPLAY_EVENT_MOUSE_WHEEL:
+            input_process_mouse_wheel_motion(event.mouse_wheel_motion, time);
+            break;
+    }
+}
+
+static void application_process_sdl_event(const SDL_Event& event, uint64_t run_start_time) {
+    // Events queued before the run started count as happening at its start
+    uint32_t time = (uint32_t)(std::max((uint64_t)event.common.timestamp, run_start_time) - run_start_time);
+    switch (event.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            if (!event.key.repeat) {
+                application_process_input((ReplayEvent) {
+                    .type = REPLAY_EVENT_KEY,
+                    .time = time,
+                    .code = (uint16_t)event.key.keysym.scancode,
+                    .is_pressed = event.type == SDL_KEYDOWN
+                }, run_start_time);
+            }
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            application_process_input((ReplayEvent) {
+                .type = REPLAY_EVENT_MOUSE_BUTTON,
+                .time = time,
+                .code = event.button.button,
+                .is_pressed = event.type == SDL_MOUSEBUTTONDOWN
+            }, run_start_time);
+            break;
+        case SDL_MOUSEMOTION:
+            application_process_input((ReplayEvent) {
+                .type = REPLAY_EVENT_MOUSE_MOTION,
+                .time = time,
+                .mouse_position = ivec2(event.motion.x, event.motion.y),
+                .mouse_relative_position = ivec2(event.motion.xrel, event.motion.yrel)
+            }, run_start_time);
+            break;
+        case SDL_MOUSEWHEEL:
+            application_process_input((ReplayEvent) {
+                .type = REPLAY_EVENT_MOUSE_WHEEL,
+                .time = time,
+                .mouse_wheel_motion = event.wheel.y
+            }, run_start_time);
+            break;
+    }
+}
+
+static bool application_has_extension(const std::string& path, const char* extension) {
+    size_t extension_length = strlen(extension);
+    return path.size() >= extension_length && path.compare(path.size() - extension_length, extension_length, extension) == 0;
+}
+
+// Runs on the file watcher's thread. Images are decoded here so that the main thread only has to upload them
+static void* application_prepare_reload(const std::string& path) {
+    if (!application_has_extension(path, ".png") && !application_has_extension(path, ".jpg")) {
+        return NULL;
+    }
+    TextureImage* image = new TextureImage;
+    if (!texture_decode(image, path.c_str())) {
+        delete image;
+        return NULL;
+    }
+    return image;
+}
+
+// Swaps in the shaders and textures that changed on disk. Done at the start of a frame so that a frame never
+// mixes old and new versions
+static void application_hot_reload() {
+    file_watch_poll(&app.reload_changes);
+    for (const FileWatchChange& change : app.reload_changes) {
+        uint64_t reload_start = SDL_GetPerformanceCounter();
+        uint32_t reload_count = 0;
+        if (change.prepared != NULL) {
+            TextureImage* image = (TextureImage*)change.prepared;
+            reload_count = texture_reload(change.path.c_str(), image) ? 1 : 0;
+            texture_free_image(image);
+            delete image;
+        } else if (application_has_extension(change.path, ".glsl")) {
+            reload_count = shader_reload(change.path.c_str());
+        }
+        if (reload_count != 0) {
+            double reload_time = (double)(SDL_GetPerformanceCounter() - reload_start) / (double)SDL_GetPerformanceFrequency();
+            log_info("Reloaded %s, %u resources updated in %.1fms.", change.path.c_str(), reload_count, reload_time * 1000.0);
+        }
+    }
+}
+
+// Starts the golden image comparison on its frame, then keeps the application running until the result is in
+static bool application_update_golden(uint32_t frame) {
+    if (frame == app.golden_frame) {
+        capture_compare_golden(app.golden_path);
+    }
+    CaptureGoldenResult result = capture_get_golden_result();
+    if (result == CAPTURE_GOLDEN_PASSED || result == CAPTURE_GOLDEN_FAILED) {
+        app.exit_code = result == CAPTURE_GOLDEN_PASSED ? 0 : 1;
+        return false;
+    }
+    return true;
+}
+
+// FPS and the profiler's numbers, drawn over the frame while the profiler is on. All text goes out in one draw call
+static void application_render_overlay() {
+    char overlay[2304];
+    snprintf(overlay, sizeof(overlay), "%-20s %6u\n%s", "fps", app.fps, profiler_get_overlay());
+    renderer_render_text(overlay, ivec2(OVERLAY_MARGIN, OVERLAY_MARGIN), vec3(1.0f, 1.0f, 1.0f));
+}
+
 bool application_create(AppConfig config) {
     if (initialized) {
         log_error("application_create() called more than once.");
@@ -32,9 +193,12 @@ bool application_create(AppConfig config) {
     }
 
     logger_init();
+    app.startup_start = SDL_GetPerformanceCounter();
+    memory_init(FRAME_ARENA_CAPACITY);
 
     // Get info out of config
     resource_base_path = std::string(config.resource_path);
+    vfs_init(config.resource_path);
 
     // Initialize other fields
     app.state_id = APP_STATE_NONE;
@@ -54,7 +218,49 @@ bool application_create(AppConfig config) {
 
     // Initialize subsystems
     input_init();
-    if (!renderer_init(app.window, config.screen_size, config.window_size)) { return false; }
+    if (!job_system_init(0)) { return false; }
+    if (!renderer_init(app.window, config.screen_size, config.window_size, config.anti_aliasing)) { return false; }
+    texture_set_budget(config.texture_budget);
+    // Hot reloading is a nice to have, so the game runs fine without it. Files in a pak never change
+    if (vfs_is_pak_mounted()) {
+        log_info("Hot reloading is off while reading from a pak.");
+    } else {
+        file_watch_init(resource_base_path.c_str(), application_prepare_reload);
+    }
+
+    // Golden image runs play a set number of frames, compare the last one against a golden image and quit with the
+    // result as the exit code. For the same pixels on every machine, run them on a software driver, for instance
+    // with LIBGL_ALWAYS_SOFTWARE=1, and with SDL_VIDEODRIVER=offscreen to go without a window
+    app.golden_path = getenv("PORTAL_GOLDEN");
+    const char* golden_frame = getenv("PORTAL_GOLDEN_FRAME");
+    app.golden_frame = golden_frame != NULL ? (uint32_t)atoi(golden_frame) : GOLDEN_FRAME;
+    app.exit_code = 0;
+    if (app.golden_path != NULL) {
+        dynamic_resolution_set_enabled(false);
+        log_info("Comparing frame %u against golden image %s.", app.golden_frame, app.golden_path);
+    }
+
+    // PORTAL_RECORD records every frame's input and delta time to a file, which PORTAL_REPLAY plays back as fast as
+    // it can, writing per frame timings to PORTAL_REPLAY_TIMINGS or next to the replay. Like golden runs, replays
+    // can go without a window with SDL_VIDEODRIVER=offscreen
+    const char* record_path = getenv("PORTAL_RECORD");
+    const char* replay_path = getenv("PORTAL_REPLAY");
+    uint32_t seed = REPLAY_DEFAULT_SEED;
+    if (replay_path != NULL) {
+        const char* timing_path = getenv("PORTAL_REPLAY_TIMINGS");
+        std::string default_timing_path = std::string(replay_path) + ".csv";
+        if (!replay_begin_playback(replay_path, timing_path != NULL ? timing_path : default_timing_path.c_str())) {
+            return false;
+        }
+        seed = replay_get_seed();
+        dynamic_resolution_set_enabled(false);
+        SDL_GL_SetSwapInterval(0);
+    } else if (record_path != NULL) {
+        if (!replay_begin_recording(record_path, seed)) {
+            return false;
+        }
+    }
+    srand(seed);
 
     log_info("%s initialized.", config.name);
 
@@ -96,28 +302,46 @@ void application_set_state(int state_id, void* switch_params) {
     app.states[app.state_id].on_switch(switch_params);
 }
 
-void application_run(int initial_state_id) {
+int application_run(int initial_state_id) {
     if (app.states.find(initial_state_id) == app.states.end()) {
         log_error("Cannot run application. The initial state id %i does not exist.", initial_state_id);
-        return;
+        return 1;
     }
 
     app.state_id = initial_state_id;
     bool is_running = true;
     uint64_t last_time = SDL_GetTicks();
+    // Input times are kept relative to this in replays
+    uint64_t run_start_time = last_time;
+    uint64_t last_input_time = last_time;
+    input_restart_steps(run_start_time);
     uint64_t last_second = last_time;
     uint32_t frames = 0;
+    uint32_t frame_index = 0;
     float delta = 0.0f;
+    float fixed_accumulator = 0.0f;
 
     while (is_running) {
         // Timekeep
         uint64_t current_time = SDL_GetTicks();
-        while (current_time - last_time < FRAME_TIME) {
+        while (!replay_is_playing() && current_time - last_time < FRAME_TIME) {
             current_time = SDL_GetTicks();
         }
+        uint64_t frame_start = SDL_GetPerformanceCounter();
 
         delta = (float)(current_time - last_time) / 1000.0f;
         last_time = current_time;
+        // Golden runs step the same amount every frame, however long the software driver takes to render it
+        if (app.golden_path != NULL) {
+            delta = APPLICATION_FIXED_DELTA;
+        }
+        // Replays step by the recorded delta times instead, and end when the recording does
+        uint32_t replay_input_time = 0;
+        const ReplayEvent* replay_events = NULL;
+        uint32_t replay_event_count = 0;
+        if (replay_is_playing() && !replay_play_frame(&delta, &replay_input_time, &replay_events, &replay_event_count)) {
+            break;
+        }
 
         if (current_time - last_second >= 1000) {
             app.fps = frames;
@@ -126,47 +350,113 @@ void application_run(int initial_state_id) {
         }
 
         frames++;
-
-        // Input
+        profiler_begin_frame();
+        memory_begin_frame();
+        MemoryStats memory_stats = memory_get_stats();
+        profiler_count("heap allocs", memory_stats.heap_allocation_count);
+        profiler_count("frame arena KB", (double)memory_stats.frame_bytes / 1024.0);
+        application_hot_reload();
+
+        // Input. Events carry the time SDL received them, so the fixed steps can tell when in the frame they happened
         input_update();
+        uint64_t input_time = SDL_GetTicks();
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    is_running = false;
-                    break;
-                case SDL_KEYDOWN:
-                    input_process_key(event.key.keysym.sym, true);
-                    break;
-                case SDL_KEYUP:
-                    input_process_key(event.key.keysym.sym, false);
-                    break;
-                case SDL_MOUSEBUTTONDOWN:
-                    input_process_mouse_button(event.button.button, true);
-                    break;
-                case SDL_MOUSEBUTTONUP:
-                    input_process_mouse_button(event.button.button, false);
-                    break;
-                case SDL_MOUSEMOTION:
-                    input_process_mouse_motion(ivec2(event.motion.x, event.motion.y), ivec2(event.motion.xrel, event.motion.yrel));
-                    break;
-                case SDL_MOUSEWHEEL:
-                    input_process_mouse_wheel_motion(event.wheel.y);
-                    break;
+            if (event.type == SDL_QUIT) {
+                is_running = false;
+            } else if (!replay_is_playing()) {
+                application_process_sdl_event(event, run_start_time);
+            }
+        }
+        if (replay_is_playing()) {
+            input_time = run_start_time + replay_input_time;
+            for (uint32_t i = 0; i < replay_event_count; i++) {
+                application_process_input(replay_events[i], run_start_time);
             }
+        } else if (replay_is_recording()) {
+            replay_record_frame(delta, (uint32_t)(input_time - run_start_time));
         }
 
         // Update
+        uint64_t update_start = SDL_GetPerformanceCounter();
+        profiler_begin("update");
         app.states[app.state_id].update(delta);
-        
+        profiler_end();
+        double update_time = application_get_elapsed_ms(update_start);
+
+        // The steps of a frame split the time since the last frame's input between them, and each step sees the
+        // input events from its part of it
+        uint64_t fixed_update_start = SDL_GetPerformanceCounter();
+        uint32_t step_count = 0;
+        if (app.states[app.state_id].fixed_update != NULL) {
+            profiler_begin("fixed update");
+            fixed_accumulator = fminf(fixed_accumulator + delta, APPLICATION_FIXED_DELTA * FIXED_UPDATE_MAX_STEPS);
+            for (float accumulator = fixed_accumulator; accumulator >= APPLICATION_FIXED_DELTA; accumulator -= APPLICATION_FIXED_DELTA) {
+                step_count++;
+            }
+            for (uint32_t step = 0; step < step_count; step++) {
+                input_begin_fixed_step(last_input_time + (((input_time - last_input_time) * (step + 1)) / step_count));
+                app.states[app.state_id].fixed_update(APPLICATION_FIXED_DELTA);
+                fixed_accumulator -= APPLICATION_FIXED_DELTA;
+            }
+            input_end_fixed_steps();
+            profiler_end();
+        } else {
+            input_flush_events(input_time);
+        }
+        last_input_time = input_time;
+        double fixed_update_time = application_get_elapsed_ms(fixed_update_start);
+
         // Render
+        uint64_t render_start = SDL_GetPerformanceCounter();
+        profiler_begin("render");
         renderer_prepare_frame();
         app.states[app.state_id].render();
+        if (profiler_is_enabled()) {
+            application_render_overlay();
+        }
+        profiler_end();
+        double render_time = application_get_elapsed_ms(render_start);
+        uint64_t present_start = SDL_GetPerformanceCounter();
         renderer_present_frame();
+        double present_time = application_get_elapsed_ms(present_start);
+        // Up to the buffer swap, the display adds its own scanout delay on top. Frames without input count from
+        // when input was polled, the least any input waited. Played back input never waited on anything
+        if (!replay_is_playing()) {
+            uint64_t oldest_input_time = input_get_oldest_frame_event_time();
+            profiler_count("input latency ms", (double)(SDL_GetTicks() - (oldest_input_time != 0 ? oldest_input_time : input_time)));
+        }
+        profiler_end_frame();
+        // Compare runs with and without the pak by setting PORTAL_LOOSE_FILES
+        if (frame_index == 0) {
+            double startup_time = (double)(SDL_GetPerformanceCounter() - app.startup_start) / (double)SDL_GetPerformanceFrequency();
+            log_info("Started up in %.1f ms reading %s.", startup_time * 1000.0, vfs_is_pak_mounted() ? "from a pak" : "loose files");
+        }
+
+        if (app.golden_path != NULL) {
+            is_running = application_update_golden(frame_index) && is_running;
+        }
+        if (replay_is_playing()) {
+            replay_record_timing((ReplayFrameTiming) {
+                .delta = delta * 1000.0,
+                .update = update_time,
+                .fixed_update = fixed_update_time,
+                .fixed_step_count = step_count,
+                .render = render_time,
+                .present = present_time,
+                .frame = application_get_elapsed_ms(frame_start)
+            });
+        }
+        frame_index++;
     }
+    replay_end();
 
     // Quit subsystems
+    file_watch_quit();
     renderer_quit();
+    job_system_quit();
+    vfs_quit();
+    memory_quit();
 
     SDL_DestroyWindow(app.window);
 
@@ -174,6 +464,7 @@ void application_run(int initial_state_id) {
 
     log_info("Application quit gracefully.");
     logger_quit();
+    return app.exit_code;
 }
 
 uint32_t application_get_fps() {
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "math/vector2.h"
+#include "renderer/post.h"
+#include <cstddef>
 #include <cstdint>
 
+static const float APPLICATION_FIXED_DELTA = 1.0f / 60.0f;
+
 struct AppConfig {
     const char* name;
     ivec2 screen_size;
     ivec2 window_size;
+    PostAntiAliasing anti_aliasing;
+    // Bytes of textures kept in VRAM before the least recently used ones are evicted, 0 for no limit
+    size_t texture_budget;
 
     const char* resource_path;
 
@@ -20,6 +27,8 @@ struct AppState {
     void (*on_switch)(void* switch_params);
     void (*update)(float delta);
     void (*render)();
+    // Optional, called at a fixed rate of APPLICATION_FIXED_DELTA after update
+    void (*fixed_update)(float delta);
 };
 
 enum AppMouseMode {
@@ -30,7 +39,8 @@ enum AppMouseMode {
 bool application_create(AppConfig config);
 bool application_register_state(int state_id, AppState app_state);
 void application_set_state(int state_id, void* switch_params);
-void application_run(int initial_state_id);
+// Returns the exit code
+int application_run(int initial_state_id);
 uint32_t application_get_fps();
 
 AppMouseMode application_get_mouse_mode();
@@ -0,0 +1,345 @@
+#include "ecs.h"
+
+#include "logger.h"
+#include "job.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t ECS_INDEX_MASK = ECS_MAX_ENTITIES - 1;
+static const uint32_t ECS_GENERATION_MASK = (1 << (32 - ECS_INDEX_BITS)) - 1;
+static const uint32_t ECS_NO_ARCHETYPE = UINT32_MAX;
+static const uint32_t ECS_CHUNKS_PER_POOL_CHUNK = 16;
+
+struct EcsParallelJob {
+    const EcsChunkView* views;
+    EcsChunkFunction function;
+    void* data;
+};
+
+static EcsComponent ecs_first_component(EcsMask mask) {
+    return (EcsComponent)__builtin_ctzll(mask);
+}
+
+void ecs_world_init(EcsWorld* world) {
+    memset(world->component_sizes, 0, sizeof(world->component_sizes));
+    memset(world->component_alignments, 0, sizeof(world->component_alignments));
+    world->registered_mask = 0;
+    world->archetypes.clear();
+    world->archetype_indices.clear();
+    // Slot 0 is never used, so that 0 is never a valid handle
+    world->records.clear();
+    world->records.push_back((EcsEntityRecord) { .generation = 1, .archetype = ECS_NO_ARCHETYPE });
+    world->free_indices.clear();
+    world->entity_count = 0;
+    memory_pool_init(&world->chunk_pool, ECS_CHUNK_SIZE, ECS_CHUNKS_PER_POOL_CHUNK);
+}
+
+void ecs_world_free(EcsWorld* world) {
+    memory_pool_free_all(&world->chunk_pool);
+    world->archetypes.clear();
+    world->archetype_indices.clear();
+    world->records.clear();
+    world->free_indices.clear();
+    world->entity_count = 0;
+}
+
+void ecs_register_component(EcsWorld* world, EcsComponent component, size_t size, size_t alignment) {
+    if (component >= ECS_MAX_COMPONENTS) {
+        log_error("Could not register component %u, the limit is %u.", component, ECS_MAX_COMPONENTS);
+        return;
+    }
+    world->component_sizes[component] = size;
+    world->component_alignments[component] = std::max(alignment, (size_t)1);
+    world->registered_mask |= ecs_mask(component);
+}
+
+// Lays out a chunk for the mask: the entity handles, then each component's array at its alignment. Room for the
+// worst case padding is set aside first, so the arrays always fit
+static uint32_t ecs_get_archetype(EcsWorld* world, EcsMask mask) {
+    auto it = world->archetype_indices.find(mask);
+    if (it != world->archetype_indices.end()) {
+        return it->second;
+    }
+
+    size_t entity_size = sizeof(Entity);
+    size_t padding = 0;
+    for (EcsMask bits = mask; bits != 0; bits &= bits - 1) {
+        EcsComponent component = ecs_first_component(bits);
+        entity_size += world->component_sizes[component];
+        padding += world->component_alignments[component] - 1;
+    }
+    if (padding + entity_size > ECS_CHUNK_SIZE) {
+        log_error("Components of mask %llx do not fit in a chunk of %zu bytes.", (unsigned long long)mask, ECS_CHUNK_SIZE);
+        return ECS_NO_ARCHETYPE;
+    }
+
+    EcsArchetype archetype;
+    archetype.mask = mask;
+    archetype.capacity = (uint32_t)((ECS_CHUNK_SIZE - padding) / entity_size);
+    archetype.entity_count = 0;
+    memset(archetype.offsets, 0, sizeof(archetype.offsets));
+    size_t offset = archetype.capacity * sizeof(Entity);
+    for (EcsMask bits = mask; bits != 0; bits &= bits - 1) {
+        EcsComponent component = ecs_first_component(bits);
+        size_t alignment = world->component_alignments[component];
+        offset = (offset + alignment - 1) & ~(alignment - 1);
+        archetype.offsets[component] = (uint32_t)offset;
+        offset += archetype.capacity * world->component_sizes[component];
+    }
+
+    uint32_t index = (uint32_t)world->archetypes.size();
+    world->archetypes.push_back(archetype);
+    world->archetype_indices[mask] = index;
+    return index;
+}
+
+static bool ecs_push_row(EcsWorld* world, uint32_t archetype_index, Entity entity, EcsEntityRecord* record) {
+    EcsArchetype& archetype = world->archetypes[archetype_index];
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        uint8_t* data = (uint8_t*)memory_pool_alloc(&world->chunk_pool);
+        if (data == NULL) {
+            return false;
+        }
+        archetype.chunks.push_back((EcsChunk) { .data = data, .count = 0 });
+    }
+
+    EcsChunk& chunk = archetype.chunks.back();
+    uint32_t row = chunk.count;
+    ((Entity*)chunk.data)[row] = entity;
+    for (EcsMask bits = archetype.mask; bits != 0; bits &= bits - 1) {
+        EcsComponent component = ecs_first_component(bits);
+        size_t size = world->component_sizes[component];
+        memset(chunk.data + archetype.offsets[component] + (row * size), 0, size);
+    }
+    chunk.count++;
+    archetype.entity_count++;
+
+    record->archetype = archetype_index;
+    record->chunk = (uint32_t)archetype.chunks.size() - 1;
+    record->row = row;
+    return true;
+}
+
+// The archetype's last entity is moved into the hole, which keeps the chunks packed
+static void ecs_remove_row(EcsWorld* world, uint32_t archetype_index, uint32_t chunk_index, uint32_t row) {
+    EcsArchetype& archetype = world->archetypes[archetype_index];
+    EcsChunk& chunk = archetype.chunks[chunk_index];
+    EcsChunk& last_chunk = archetype.chunks.back();
+    uint32_t last_row = last_chunk.count - 1;
+    if (&chunk != &last_chunk || row != last_row) {
+        Entity moved_entity = ((Entity*)last_chunk.data)[last_row];
+        ((Entity*)chunk.data)[row] = moved_entity;
+        for (EcsMask bits = archetype.mask; bits != 0; bits &= bits - 1) {
+            EcsComponent component = ecs_first_component(bits);
+            size_t size = world->component_sizes[component];
+            memcpy(chunk.data + archetype.offsets[component] + (row * size), last_chunk.data + archetype.offsets[component] + (last_row * size), size);
+        }
+        EcsEntityRecord& moved_record = world->records[moved_entity & ECS_INDEX_MASK];
+        moved_record.chunk = chunk_index;
+        moved_record.row = row;
+    }
+
+    last_chunk.count--;
+    archetype.entity_count--;
+    if (last_chunk.count == 0) {
+        memory_pool_free(&world->chunk_pool, last_chunk.data);
+        archetype.chunks.pop_back();
+    }
+}
+
+static const EcsEntityRecord* ecs_get_record(const EcsWorld& world, Entity entity) {
+    uint32_t index = entity & ECS_INDEX_MASK;
+    if (index == 0 || index >= world.records.size()) {
+        return NULL;
+    }
+    const EcsEntityRecord& record = world.records[index];
+    if (record.generation != entity >> ECS_INDEX_BITS || record.archetype == ECS_NO_ARCHETYPE) {
+        return NULL;
+    }
+    return &record;
+}
+
+Entity ecs_create(EcsWorld* world, EcsMask mask) {
+    if ((mask & ~world->registered_mask) != 0) {
+        log_error("Could not create entity, mask %llx has unregistered components.", (unsigned long long)mask);
+        return 0;
+    }
+    uint32_t archetype_index = ecs_get_archetype(world, mask);
+    if (archetype_index == ECS_NO_ARCHETYPE) {
+        return 0;
+    }
+
+    uint32_t index;
+    if (!world->free_indices.empty()) {
+        index = world->free_indices.back();
+        world->free_indices.pop_back();
+    } else {
+        index = (uint32_t)world->records.size();
+        if (index == ECS_MAX_ENTITIES) {
+            log_error("Out of entities, the limit is %u.", ECS_MAX_ENTITIES - 1);
+            return 0;
+        }
+        world->records.push_back((EcsEntityRecord) { .generation = 1, .archetype = ECS_NO_ARCHETYPE });
+    }
+
+    EcsEntityRecord& record = world->records[index];
+    Entity entity = (record.generation << ECS_INDEX_BITS) | index;
+    if (!ecs_push_row(world, archetype_index, entity, &record)) {
+        world->free_indices.push_back(index);
+        return 0;
+    }
+    world->entity_count++;
+    return entity;
+}
+
+void ecs_destroy(EcsWorld* world, Entity entity) {
+    const EcsEntityRecord* found_record = ecs_get_record(*world, entity);
+    if (found_record == NULL) {
+        return;
+    }
+    uint32_t index = entity & ECS_INDEX_MASK;
+    EcsEntityRecord& record = world->records[index];
+    ecs_remove_row(world, record.archetype, record.chunk, record.row);
+    record.archetype = ECS_NO_ARCHETYPE;
+    record.generation = std::max((record.generation + 1) & ECS_GENERATION_MASK, 1u);
+    world->free_indices.push_back(index);
+    world->entity_count--;
+}
+
+bool ecs_is_alive(const EcsWorld& world, Entity entity) {
+    return ecs_get_record(world, entity) != NULL;
+}
+
+void ecs_set_components(EcsWorld* world, Entity entity, EcsMask mask) {
+    const EcsEntityRecord* found_record = ecs_get_record(*world, entity);
+    if (found_record == NULL) {
+        return;
+    }
+    if ((mask & ~world->registered_mask) != 0) {
+        log_error("Could not set components, mask %llx has unregistered components.", (unsigned long long)mask);
+        return;
+    }
+    EcsEntityRecord& record = world->records[entity & ECS_INDEX_MASK];
+    uint32_t old_archetype_index = record.archetype;
+    if (world->archetypes[old_archetype_index].mask == mask) {
+        return;
+    }
+    // Looked up before taking references, since adding an archetype can move the others
+    uint32_t new_archetype_index = ecs_get_archetype(world, mask);
+    if (new_archetype_index == ECS_NO_ARCHETYPE) {
+        return;
+    }
+
+    EcsEntityRecord old_record = record;
+    if (!ecs_push_row(world, new_archetype_index, entity, &record)) {
+        return;
+    }
+    const EcsArchetype& old_archetype = world->archetypes[old_archetype_index];
+    const EcsArchetype& new_archetype = world->archetypes[new_archetype_index];
+    uint8_t* old_data = old_archetype.chunks[old_record.chunk].data;
+    uint8_t* new_data = new_archetype.chunks[record.chunk].data;
+    for (EcsMask bits = old_archetype.mask & mask; bits != 0; bits &= bits - 1) {
+        EcsComponent component = ecs_first_component(bits);
+        size_t size = world->component_sizes[component];
+        memcpy(new_data + new_archetype.offsets[component] + (record.row * size), old_data + old_archetype.offsets[component] + (old_record.row * size), size);
+    }
+    ecs_remove_row(world, old_archetype_index, old_record.chunk, old_record.row);
+}
+
+void ecs_add_components(EcsWorld* world, Entity entity, EcsMask mask) {
+    const EcsEntityRecord* record = ecs_get_record(*world, entity);
+    if (record != NULL) {
+        ecs_set_components(world, entity, world->archetypes[record->archetype].mask | mask);
+    }
+}
+
+void ecs_remove_components(EcsWorld* world, Entity entity, EcsMask mask) {
+    const EcsEntityRecord* record = ecs_get_record(*world, entity);
+    if (record != NULL) {
+        ecs_set_components(world, entity, world->archetypes[record->archetype].mask & ~mask);
+    }
+}
+
+bool ecs_has_components(const EcsWorld& world, Entity entity, EcsMask mask) {
+    const EcsEntityRecord* record = ecs_get_record(world, entity);
+    return record != NULL && (world.archetypes[record->archetype].mask & mask) == mask;
+}
+
+void* ecs_get_component(const EcsWorld& world, Entity entity, EcsComponent component) {
+    const EcsEntityRecord* record = ecs_get_record(world, entity);
+    if (record == NULL || component >= ECS_MAX_COMPONENTS) {
+        return NULL;
+    }
+    const EcsArchetype& archetype = world.archetypes[record->archetype];
+    if ((archetype.mask & ecs_mask(component)) == 0) {
+        return NULL;
+    }
+    return archetype.chunks[record->chunk].data + archetype.offsets[component] + (record->row * world.component_sizes[component]);
+}
+
+EcsQuery ecs_query(const EcsWorld& world, EcsMask mask) {
+    return (EcsQuery) {
+        .world = &world,
+        .mask = mask,
+        .archetype_index = 0,
+        .chunk_index = 0
+    };
+}
+
+bool ecs_query_next(EcsQuery* query, EcsChunkView* view) {
+    while (query->archetype_index < query->world->archetypes.size()) {
+        const EcsArchetype& archetype = query->world->archetypes[query->archetype_index];
+        if ((archetype.mask & query->mask) == query->mask && query->chunk_index < archetype.chunks.size()) {
+            const EcsChunk& chunk = archetype.chunks[query->chunk_index];
+            query->chunk_index++;
+            *view = (EcsChunkView) {
+                .archetype = &archetype,
+                .data = chunk.data,
+                .count = chunk.count
+            };
+            return true;
+        }
+        query->archetype_index++;
+        query->chunk_index = 0;
+    }
+    return false;
+}
+
+void ecs_for_each_chunk(const EcsWorld& world, EcsMask mask, EcsChunkFunction function, void* data) {
+    EcsQuery query = ecs_query(world, mask);
+    EcsChunkView view;
+    while (ecs_query_next(&query, &view)) {
+        function(data, view, 0);
+    }
+}
+
+static void ecs_process_chunks(void* data, uint32_t begin, uint32_t end, uint32_t thread_index) {
+    const EcsParallelJob* job = (const EcsParallelJob*)data;
+    for (uint32_t index = begin; index < end; index++) {
+        job->function(job->data, job->views[index], thread_index);
+    }
+}
+
+void ecs_parallel_for_each_chunk(const EcsWorld& world, EcsMask mask, EcsChunkFunction function, void* data) {
+    uint32_t chunk_count = 0;
+    for (const EcsArchetype& archetype : world.archetypes) {
+        if ((archetype.mask & mask) == mask) {
+            chunk_count += (uint32_t)archetype.chunks.size();
+        }
+    }
+    if (chunk_count == 0) {
+        return;
+    }
+
+    EcsChunkView* views = memory_frame_alloc_array<EcsChunkView>(chunk_count);
+    EcsQuery query = ecs_query(world, mask);
+    for (uint32_t index = 0; index < chunk_count; index++) {
+        ecs_query_next(&query, &views[index]);
+    }
+    EcsParallelJob job = (EcsParallelJob) {
+        .views = views,
+        .function = function,
+        .data = data
+    };
+    job_parallel_for(chunk_count, 1, ecs_process_chunks, &job);
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Handle to an entity. Like texture handles, the low bits index the entity's slot and the high bits hold the
+// generation the slot had when the handle was made, so a handle to a destroyed entity is caught. 0 is never valid
+typedef uint32_t Entity;
+// Components are small integers picked by the game, registered once with their size before any entity uses them
+typedef uint32_t EcsComponent;
+typedef uint64_t EcsMask;
+
+static const uint32_t ECS_INDEX_BITS = 20;
+static const uint32_t ECS_MAX_ENTITIES = 1 << ECS_INDEX_BITS;
+static const uint32_t ECS_MAX_COMPONENTS = 64;
+static const size_t ECS_CHUNK_SIZE = 16 * 1024;
+
+inline EcsMask ecs_mask(EcsComponent component) {
+    return (EcsMask)1 << component;
+}
+
+struct EcsChunk {
+    uint8_t* data;
+    uint32_t count;
+};
+
+// Every entity with exactly the same set of components. Their components are stored SoA in fixed size chunks,
+// one tightly packed array per component, and entities are swapped in from the end when one leaves, so every
+// chunk but the last is full and there are no holes to skip
+struct EcsArchetype {
+    EcsMask mask;
+    uint32_t capacity;
+    uint32_t entity_count;
+    // Byte offset of each component's array in a chunk. The entity handles come first, at offset 0
+    uint32_t offsets[ECS_MAX_COMPONENTS];
+    std::vector<EcsChunk> chunks;
+};
+
+struct EcsEntityRecord {
+    uint32_t generation;
+    // UINT32_MAX while the slot is free
+    uint32_t archetype;
+    uint32_t chunk;
+    uint32_t row;
+};
+
+struct EcsWorld {
+    size_t component_sizes[ECS_MAX_COMPONENTS];
+    size_t component_alignments[ECS_MAX_COMPONENTS];
+    EcsMask registered_mask;
+
+    std::vector<EcsArchetype> archetypes;
+    std::unordered_map<EcsMask, uint32_t> archetype_indices;
+    std::vector<EcsEntityRecord> records;
+    std::vector<uint32_t> free_indices;
+    uint32_t entity_count;
+    MemoryPool chunk_pool;
+};
+
+// One chunk of a query's results. Only valid until entities are next created, destroyed or change components
+struct EcsChunkView {
+    const EcsArchetype* archetype;
+    uint8_t* data;
+    uint32_t count;
+};
+
+struct EcsQuery {
+    const EcsWorld* world;
+    EcsMask mask;
+    uint32_t archetype_index;
+    uint32_t chunk_index;
+};
+
+// Processes one chunk. thread_index is the job system's, for picking per-thread scratch data
+typedef void (*EcsChunkFunction)(void* data, const EcsChunkView& view, uint32_t thread_index);
+
+void ecs_world_init(EcsWorld* world);
+void ecs_world_free(EcsWorld* world);
+void ecs_register_component(EcsWorld* world, EcsComponent component, size_t size, size_t alignment);
+
+// New components are zeroed
+Entity ecs_create(EcsWorld* world, EcsMask mask);
+void ecs_destroy(EcsWorld* world, Entity entity);
+bool ecs_is_alive(const EcsWorld& world, Entity entity);
+// Moves the entity to the archetype for the new mask, keeping the components it had and zeroing new ones
+void ecs_set_components(EcsWorld* world, Entity entity, EcsMask mask);
+void ecs_add_components(EcsWorld* world, Entity entity, EcsMask mask);
+void ecs_remove_components(EcsWorld* world, Entity entity, EcsMask mask);
+bool ecs_has_components(const EcsWorld& world, Entity entity, EcsMask mask);
+// NULL if the entity is stale or doesn't have the component. Only valid until the entity next moves
+void* ecs_get_component(const EcsWorld& world, Entity entity, EcsComponent component);
+
+// Every chunk holding entities with at least the components in mask, in the order the entities were made as long
+// as none were destroyed
+EcsQuery ecs_query(const EcsWorld& world, EcsMask mask);
+bool ecs_query_next(EcsQuery* query, EcsChunkView* view);
+void ecs_for_each_chunk(const EcsWorld& world, EcsMask mask, EcsChunkFunction function, void* data);
+// Chunks are handed to the job system one at a time. The function may write the components it was asked for,
+// but nothing may create, destroy or move entities until this returns. Needs frame memory
+void ecs_parallel_for_each_chunk(const EcsWorld& world, EcsMask mask, EcsChunkFunction function, void* data);
+
+template <typename T>
+T* ecs_get(const EcsWorld& world, Entity entity, EcsComponent component) {
+    return (T*)ecs_get_component(world, entity, component);
+}
+
+inline const Entity* ecs_view_get_entities(const EcsChunkView& view) {
+    return (const Entity*)view.data;
+}
+
+// The component's array in the chunk, view.count long. The view's query must have asked for the component
+template <typename T>
+T* ecs_view_get(const EcsChunkView& view, EcsComponent component) {
+    return (T*)(view.data + view.archetype->offsets[component]);
+}
\ No newline at end of file
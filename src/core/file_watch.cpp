@@ -0,0 +1,166 @@
+#include "file_watch.h"
+
+#include "logger.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+struct FileWatch {
+    std::string directory;
+    FileWatchPrepare prepare;
+    std::thread thread;
+    std::atomic<bool> is_running;
+
+    std::mutex mutex;
+    std::vector<FileWatchChange> changes;
+
+    int inotify;
+    // Watch descriptor to its directory, relative to the watched directory and ending in a slash unless it's the root
+    std::unordered_map<int, std::string> watch_directories;
+};
+
+static FileWatch file_watch;
+
+#ifdef __linux__
+
+// How often the thread checks whether it should quit while nothing is changing
+static const int FILE_WATCH_POLL_TIMEOUT = 100;
+// Editors often save in several writes, so a batch of changes is only picked up once the files were left alone this long
+static const int FILE_WATCH_SETTLE_TIMEOUT = 30;
+
+static const uint32_t FILE_WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+static void file_watch_add_directory(const std::string& relative_directory) {
+    std::string full_directory = file_watch.directory + relative_directory;
+    int watch = inotify_add_watch(file_watch.inotify, full_directory.c_str(), FILE_WATCH_EVENTS);
+    if (watch < 0) {
+        log_warn("Could not watch directory %s", full_directory.c_str());
+        return;
+    }
+    file_watch.watch_directories[watch] = relative_directory;
+
+    DIR* dir = opendir(full_directory.c_str());
+    if (dir == NULL) {
+        return;
+    }
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (entry->d_type == DT_DIR && name != "." && name != "..") {
+            file_watch_add_directory(relative_directory + name + "/");
+        }
+    }
+    closedir(dir);
+}
+
+// Reads every event that is ready, adding new directories to the watch and collecting the changed files
+static void file_watch_read_events(std::vector<std::string>* paths) {
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length = read(file_watch.inotify, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < length;) {
+        const inotify_event* event = (const inotify_event*)(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        auto it = file_watch.watch_directories.find(event->wd);
+        if (it == file_watch.watch_directories.end() || event->len == 0) {
+            continue;
+        }
+        std::string path = it->second + event->name;
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                file_watch_add_directory(path + "/");
+            }
+            continue;
+        }
+        // A created file is reported once it's closed
+        if (event->mask & IN_CREATE) {
+            continue;
+        }
+
+        bool is_duplicate = false;
+        for (const std::string& existing_path : *paths) {
+            is_duplicate = is_duplicate || existing_path == path;
+        }
+        if (!is_duplicate) {
+            paths->push_back(path);
+        }
+    }
+}
+
+static void file_watch_thread_main() {
+    pollfd poll_fd = (pollfd) {
+        .fd = file_watch.inotify,
+        .events = POLLIN,
+        .revents = 0
+    };
+    std::vector<std::string> paths;
+    while (file_watch.is_running.load()) {
+        if (poll(&poll_fd, 1, FILE_WATCH_POLL_TIMEOUT) <= 0) {
+            continue;
+        }
+        do {
+            file_watch_read_events(&paths);
+        } while (poll(&poll_fd, 1, FILE_WATCH_SETTLE_TIMEOUT) > 0);
+
+        for (const std::string& path : paths) {
+            FileWatchChange change = (FileWatchChange) {
+                .path = path,
+                .prepared = file_watch.prepare != NULL ? file_watch.prepare(path) : NULL
+            };
+            std::lock_guard<std::mutex> lock(file_watch.mutex);
+            file_watch.changes.push_back(change);
+        }
+        paths.clear();
+    }
+}
+
+bool file_watch_init(const char* directory, FileWatchPrepare prepare) {
+    file_watch.directory = std::string(directory);
+    file_watch.prepare = prepare;
+    file_watch.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (file_watch.inotify < 0) {
+        log_warn("Could not start watching %s, inotify is not available.", directory);
+        return false;
+    }
+    file_watch_add_directory("");
+
+    file_watch.is_running = true;
+    file_watch.thread = std::thread(file_watch_thread_main);
+    log_info("Watching %s for changes.", directory);
+    return true;
+}
+
+void file_watch_quit() {
+    if (!file_watch.thread.joinable()) {
+        return;
+    }
+    file_watch.is_running = false;
+    file_watch.thread.join();
+    close(file_watch.inotify);
+    file_watch.watch_directories.clear();
+}
+
+#else
+
+bool file_watch_init(const char* directory, FileWatchPrepare prepare) {
+    log_info("File watching is only supported on Linux, %s will not be watched.", directory);
+    return false;
+}
+
+void file_watch_quit() {
+}
+
+#endif
+
+void file_watch_poll(std::vector<FileWatchChange>* changes) {
+    changes->clear();
+    std::lock_guard<std::mutex> lock(file_watch.mutex);
+    changes->swap(file_watch.changes);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Runs on the watcher thread for each changed file, so slow work like decoding can happen off the main thread.
+// Whatever it returns is handed back with the change
+typedef void* (*FileWatchPrepare)(const std::string& path);
+
+struct FileWatchChange {
+    // Relative to the watched directory
+    std::string path;
+    void* prepared;
+};
+
+// Watches a directory tree for files that are written or moved into it, on a background thread. Backed by
+// inotify, so on other platforms init fails and changes are never reported
+bool file_watch_init(const char* directory, FileWatchPrepare prepare);
+void file_watch_quit();
+// Takes the changes found since the last poll. Files written several times in a row are only reported once
+void file_watch_poll(std::vector<FileWatchChange>* changes);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+static const uint64_t HASH_FNV1A_BASIS = 14695981039346656037ull;
+static const uint64_t HASH_FNV1A_PRIME = 1099511628211ull;
+
+// 64 bit FNV-1a. Start from HASH_FNV1A_BASIS, and pass the result back in to keep hashing where the last call left off
+inline uint64_t hash_fnv1a(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * HASH_FNV1A_PRIME;
+    }
+    return hash;
+}
\ No newline at end of file
@@ -1,68 +1,345 @@
 #include "input.h"
 
 #include "logger.h"
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+
+// Marks keys and mouse buttons without an action
+static const uint8_t INPUT_UNBOUND = INPUT_COUNT;
+
+struct InputKeyBinding {
+    Input input;
+    SDL_Scancode scancode;
+};
+
+struct InputMouseBinding {
+    Input input;
+    uint8_t button;
+};
+
+static const InputKeyBinding INPUT_DEFAULT_KEY_BINDINGS[] = {
+    { INPUT_FORWARD, SDL_SCANCODE_W },
+    { INPUT_RIGHT, SDL_SCANCODE_D },
+    { INPUT_BACK, SDL_SCANCODE_S },
+    { INPUT_LEFT, SDL_SCANCODE_A },
+    { INPUT_JUMP, SDL_SCANCODE_SPACE },
+    { INPUT_CROUCH, SDL_SCANCODE_LCTRL },
+    { INPUT_ESCAPE, SDL_SCANCODE_ESCAPE },
+    { INPUT_TILDE, SDL_SCANCODE_GRAVE },
+    { INPUT_GIZMO_TRANSLATE, SDL_SCANCODE_T },
+    { INPUT_GIZMO_ROTATE, SDL_SCANCODE_R },
+    { INPUT_TOGGLE_LIGHTING, SDL_SCANCODE_F2 },
+    { INPUT_TOGGLE_PROFILER, SDL_SCANCODE_F3 },
+    { INPUT_TOGGLE_OCCLUSION, SDL_SCANCODE_F4 },
+    { INPUT_TOGGLE_CPU_OCCLUSION, SDL_SCANCODE_F5 },
+    { INPUT_TOGGLE_DYNAMIC_RESOLUTION, SDL_SCANCODE_F6 },
+    { INPUT_CYCLE_ANTI_ALIASING, SDL_SCANCODE_F7 },
+    { INPUT_TOGGLE_BLOOM, SDL_SCANCODE_F8 },
+    { INPUT_SCREENSHOT, SDL_SCANCODE_F9 },
+    { INPUT_TOGGLE_FRAME_DUMP, SDL_SCANCODE_F10 }
+};
+
+static const InputMouseBinding INPUT_DEFAULT_MOUSE_BINDINGS[] = {
+    { INPUT_PORTAL_LEFT, SDL_BUTTON_LEFT },
+    { INPUT_PORTAL_RIGHT, SDL_BUTTON_RIGHT }
+};
 
 struct InputState {
     ivec2 mouse_position;
     ivec2 mouse_relative_position;
     int mouse_wheel_motion;
 
+    // Flat tables indexed by scancode and button, holding the bound action or INPUT_UNBOUND
+    uint8_t key_actions[SDL_NUM_SCANCODES];
+    uint8_t mouse_button_actions[INPUT_MOUSE_BUTTON_COUNT];
+    bool is_key_down[SDL_NUM_SCANCODES];
+    bool is_mouse_button_down[INPUT_MOUSE_BUTTON_COUNT];
+    // How many of an action's keys and buttons are down
+    uint8_t held_counts[INPUT_COUNT];
+    bool is_capturing_binding;
+    Input capture_input;
+
+    // The frame's view of the actions
     bool current[INPUT_COUNT];
-    bool previous[INPUT_COUNT];
+    bool pressed[INPUT_COUNT];
+    bool released[INPUT_COUNT];
+    uint64_t oldest_frame_event_time;
+
+    // Events not yet replayed by a fixed step, oldest first
+    InputEvent events[INPUT_MAX_EVENTS];
+    uint32_t event_count;
+
+    // The current fixed step's view of the actions
+    bool is_in_fixed_step;
+    uint64_t step_start_time;
+    bool step_current[INPUT_COUNT];
+    bool step_pressed[INPUT_COUNT];
+    bool step_released[INPUT_COUNT];
+    float step_held_fractions[INPUT_COUNT];
 };
 
 static InputState input_state;
 
+static void input_advance_step(uint64_t step_end_time) {
+    uint64_t step_start_time = input_state.step_start_time;
+    step_end_time = std::max(step_end_time, step_start_time);
+
+    uint64_t held_since[INPUT_COUNT];
+    uint64_t held_time[INPUT_COUNT];
+    for (uint32_t input = 0; input < INPUT_COUNT; input++) {
+        held_since[input] = step_start_time;
+        held_time[input] = 0;
+        input_state.step_pressed[input] = false;
+        input_state.step_released[input] = false;
+    }
+
+    uint32_t consumed_count = 0;
+    while (consumed_count < input_state.event_count && input_state.events[consumed_count].time <= step_end_time) {
+        const InputEvent& event = input_state.events[consumed_count];
+        consumed_count++;
+        if (event.type != INPUT_EVENT_ACTION) {
+            continue;
+        }
+        // Events left over from before the step count as happening at its start
+        uint64_t time = std::max(event.time, step_start_time);
+        if (event.is_pressed && !input_state.step_current[event.action]) {
+            input_state.step_current[event.action] = true;
+            input_state.step_pressed[event.action] = true;
+            held_since[event.action] = time;
+        } else if (!event.is_pressed && input_state.step_current[event.action]) {
+            input_state.step_current[event.action] = false;
+            input_state.step_released[event.action] = true;
+            held_time[event.action] += time - held_since[event.action];
+        }
+    }
+    input_state.event_count -= consumed_count;
+    memmove(input_state.events, input_state.events + consumed_count, input_state.event_count * sizeof(InputEvent));
+
+    uint64_t step_time = step_end_time - step_start_time;
+    for (uint32_t input = 0; input < INPUT_COUNT; input++) {
+        if (input_state.step_current[input]) {
+            held_time[input] += step_end_time - held_since[input];
+        }
+        if (step_time == 0) {
+            input_state.step_held_fractions[input] = input_state.step_current[input] ? 1.0f : 0.0f;
+        } else {
+            input_state.step_held_fractions[input] = (float)held_time[input] / (float)step_time;
+        }
+    }
+    input_state.step_start_time = step_end_time;
+}
+
+static void input_push_event(const InputEvent& event) {
+    if (input_state.oldest_frame_event_time == 0) {
+        input_state.oldest_frame_event_time = event.time;
+    }
+    // Only happens if nothing consumes the events for a long time, so the oldest ones are replayed right away
+    if (input_state.event_count == INPUT_MAX_EVENTS) {
+        log_warn("Input event queue is full, replaying the oldest events early.");
+        input_advance_step(input_state.events[INPUT_MAX_EVENTS / 2].time);
+    }
+    input_state.events[input_state.event_count++] = event;
+}
+
+static void input_change_action(Input input, bool pressed, uint64_t time) {
+    if (pressed) {
+        input_state.held_counts[input]++;
+        if (input_state.held_counts[input] != 1) {
+            return;
+        }
+        input_state.current[input] = true;
+        input_state.pressed[input] = true;
+    } else {
+        if (input_state.held_counts[input] == 0) {
+            return;
+        }
+        input_state.held_counts[input]--;
+        if (input_state.held_counts[input] != 0) {
+            return;
+        }
+        input_state.current[input] = false;
+        input_state.released[input] = true;
+    }
+
+    input_push_event((InputEvent) {
+        .time = time,
+        .type = INPUT_EVENT_ACTION,
+        .action = input,
+        .is_pressed = pressed
+    });
+}
+
+// Keys held while the bindings change would be released into whatever they're bound to now, so every action is
+// let go and the keys count as up until they're pressed again
+static void input_release_all(uint64_t time) {
+    for (uint32_t input = 0; input < INPUT_COUNT; input++) {
+        input_state.held_counts[input] = std::min(input_state.held_counts[input], (uint8_t)1);
+        input_change_action((Input)input, false, time);
+    }
+    memset(input_state.is_key_down, 0, sizeof(input_state.is_key_down));
+    memset(input_state.is_mouse_button_down, 0, sizeof(input_state.is_mouse_button_down));
+}
+
 void input_init() {
-    memset(&input_state, 0, sizeof(InputState));
+    input_state = (InputState) {};
+    input_state.step_start_time = SDL_GetTicks();
+    input_reset_bindings(input_state.step_start_time);
     log_info("Input subsystem initialized.");
 }
 
 void input_update() {
     input_state.mouse_relative_position = ivec2(0, 0);
     input_state.mouse_wheel_motion = 0;
+    input_state.oldest_frame_event_time = 0;
 
-    memcpy(&input_state.previous, &input_state.current, sizeof(bool) * INPUT_COUNT);
+    memset(input_state.pressed, 0, sizeof(input_state.pressed));
+    memset(input_state.released, 0, sizeof(input_state.released));
 }
 
-void input_process_key(SDL_Keycode key, bool pressed) {
-    auto it = input_key_to_input_map.find(key);
-    if (it == input_key_to_input_map.end()) {
+void input_process_key(SDL_Scancode scancode, bool pressed, uint64_t time) {
+    // Key repeats come in as more presses of a key that's already down
+    if (scancode >= SDL_NUM_SCANCODES || input_state.is_key_down[scancode] == pressed) {
         return;
     }
-    Input input = it->second;
-    input_state.current[input] = pressed;
+    input_state.is_key_down[scancode] = pressed;
+
+    if (pressed && input_state.is_capturing_binding) {
+        input_state.is_capturing_binding = false;
+        input_clear_bindings(input_state.capture_input, time);
+        input_bind_key(input_state.capture_input, scancode, time);
+        log_info("Bound key %s to action %u.", SDL_GetScancodeName(scancode), (uint32_t)input_state.capture_input);
+        return;
+    }
+
+    uint8_t input = input_state.key_actions[scancode];
+    if (input != INPUT_UNBOUND) {
+        input_change_action((Input)input, pressed, time);
+    }
 }
 
-void input_process_mouse_button(uint8_t button, bool pressed) {
-    auto it = input_mouse_button_to_input_map.find(button);
-    if (it == input_mouse_button_to_input_map.end()) {
+void input_process_mouse_button(uint8_t button, bool pressed, uint64_t time) {
+    if (button >= INPUT_MOUSE_BUTTON_COUNT || input_state.is_mouse_button_down[button] == pressed) {
         return;
     }
-    Input input = it->second;
-    input_state.current[input] = pressed;
+    input_state.is_mouse_button_down[button] = pressed;
+
+    if (pressed && input_state.is_capturing_binding) {
+        input_state.is_capturing_binding = false;
+        input_clear_bindings(input_state.capture_input, time);
+        input_bind_mouse_button(input_state.capture_input, button, time);
+        log_info("Bound mouse button %u to action %u.", (uint32_t)button, (uint32_t)input_state.capture_input);
+        return;
+    }
+
+    uint8_t input = input_state.mouse_button_actions[button];
+    if (input != INPUT_UNBOUND) {
+        input_change_action((Input)input, pressed, time);
+    }
 }
 
-void input_process_mouse_motion(ivec2 mouse_position, ivec2 mouse_relative_position) {
+void input_process_mouse_motion(ivec2 mouse_position, ivec2 mouse_relative_position, uint64_t time) {
     input_state.mouse_position = mouse_position;
-    input_state.mouse_relative_position = mouse_relative_position;
+    input_state.mouse_relative_position = input_state.mouse_relative_position + mouse_relative_position;
+    input_push_event((InputEvent) {
+        .time = time,
+        .type = INPUT_EVENT_MOUSE_MOTION,
+        .mouse_position = mouse_position,
+        .mouse_relative_position = mouse_relative_position
+    });
+}
+
+void input_process_mouse_wheel_motion(int motion, uint64_t time) {
+    input_state.mouse_wheel_motion += motion;
+    input_push_event((InputEvent) {
+        .time = time,
+        .type = INPUT_EVENT_MOUSE_WHEEL,
+        .mouse_wheel_motion = motion
+    });
+}
+
+void input_bind_key(Input input, SDL_Scancode scancode, uint64_t time) {
+    if (scancode >= SDL_NUM_SCANCODES) {
+        return;
+    }
+    input_release_all(time);
+    input_state.key_actions[scancode] = (uint8_t)input;
+}
+
+void input_bind_mouse_button(Input input, uint8_t button, uint64_t time) {
+    if (button >= INPUT_MOUSE_BUTTON_COUNT) {
+        return;
+    }
+    input_release_all(time);
+    input_state.mouse_button_actions[button] = (uint8_t)input;
+}
+
+void input_clear_bindings(Input input, uint64_t time) {
+    input_release_all(time);
+    for (uint32_t scancode = 0; scancode < SDL_NUM_SCANCODES; scancode++) {
+        if (input_state.key_actions[scancode] == input) {
+            input_state.key_actions[scancode] = INPUT_UNBOUND;
+        }
+    }
+    for (uint32_t button = 0; button < INPUT_MOUSE_BUTTON_COUNT; button++) {
+        if (input_state.mouse_button_actions[button] == input) {
+            input_state.mouse_button_actions[button] = INPUT_UNBOUND;
+        }
+    }
+}
+
+void input_reset_bindings(uint64_t time) {
+    input_release_all(time);
+    memset(input_state.key_actions, INPUT_UNBOUND, sizeof(input_state.key_actions));
+    memset(input_state.mouse_button_actions, INPUT_UNBOUND, sizeof(input_state.mouse_button_actions));
+    for (const InputKeyBinding& binding : INPUT_DEFAULT_KEY_BINDINGS) {
+        input_state.key_actions[binding.scancode] = (uint8_t)binding.input;
+    }
+    for (const InputMouseBinding& binding : INPUT_DEFAULT_MOUSE_BINDINGS) {
+        input_state.mouse_button_actions[binding.button] = (uint8_t)binding.input;
+    }
+}
+
+void input_capture_binding(Input input) {
+    input_state.is_capturing_binding = true;
+    input_state.capture_input = input;
+    log_info("Press a key or mouse button for action %u.", (uint32_t)input);
+}
+
+void input_begin_fixed_step(uint64_t step_end_time) {
+    input_advance_step(step_end_time);
+    input_state.is_in_fixed_step = true;
 }
 
-void input_process_mouse_wheel_motion(int motion) {
-    input_state.mouse_wheel_motion = motion;
+void input_end_fixed_steps() {
+    input_state.is_in_fixed_step = false;
+}
+
+void input_flush_events(uint64_t time) {
+    input_advance_step(time);
+}
+
+void input_restart_steps(uint64_t time) {
+    input_state.step_start_time = time;
 }
 
 bool input_is_action_pressed(Input input) {
-    return input_state.current[input];
+    return input_state.is_in_fixed_step ? input_state.step_current[input] : input_state.current[input];
 }
 
 bool input_is_action_just_pressed(Input input) {
-    return input_state.current[input] && !input_state.previous[input];
+    return input_state.is_in_fixed_step ? input_state.step_pressed[input] : input_state.pressed[input];
 }
 
 bool input_is_action_just_released(Input input) {
-    return !input_state.current[input] && input_state.previous[input];
+    return input_state.is_in_fixed_step ? input_state.step_released[input] : input_state.released[input];
+}
+
+float input_get_action_held_fraction(Input input) {
+    if (input_state.is_in_fixed_step) {
+        return input_state.step_held_fractions[input];
+    }
+    return input_state.current[input] ? 1.0f : 0.0f;
 }
 
 ivec2 input_get_mouse_position() {
@@ -75,4 +352,8 @@ ivec2 input_get_mouse_relative_position() {
 
 int input_get_mouse_wheel_motion() {
     return input_state.mouse_wheel_motion;
+}
+
+uint64_t input_get_oldest_frame_event_time() {
+    return input_state.oldest_frame_event_time;
 }
\ No newline at end of file
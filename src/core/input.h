@@ -2,7 +2,7 @@
 
 #include "math/math.h"
 #include <SDL2/SDL.h>
-#include <unordered_map>
+#include <cstdint>
 
 enum Input {
     INPUT_FORWARD,
@@ -15,37 +15,80 @@ enum Input {
     INPUT_PORTAL_RIGHT,
     INPUT_ESCAPE,
     INPUT_TILDE,
+    INPUT_GIZMO_TRANSLATE,
+    INPUT_GIZMO_ROTATE,
+    INPUT_TOGGLE_LIGHTING,
+    INPUT_TOGGLE_PROFILER,
+    INPUT_TOGGLE_OCCLUSION,
+    INPUT_TOGGLE_CPU_OCCLUSION,
+    INPUT_TOGGLE_DYNAMIC_RESOLUTION,
+    INPUT_CYCLE_ANTI_ALIASING,
+    INPUT_TOGGLE_BLOOM,
+    INPUT_SCREENSHOT,
+    INPUT_TOGGLE_FRAME_DUMP,
     INPUT_COUNT
 };
 
-static const std::unordered_map<SDL_Keycode, Input> input_key_to_input_map {
-    { SDLK_w, INPUT_FORWARD },
-    { SDLK_d, INPUT_RIGHT },
-    { SDLK_s, INPUT_BACK },
-    { SDLK_a, INPUT_LEFT },
-    { SDLK_SPACE, INPUT_JUMP },
-    { SDLK_LCTRL, INPUT_CROUCH },
-    { SDLK_ESCAPE, INPUT_ESCAPE },
-    { SDLK_BACKQUOTE, INPUT_TILDE }
+static const uint32_t INPUT_MOUSE_BUTTON_COUNT = 8;
+static const uint32_t INPUT_MAX_EVENTS = 256;
+
+enum InputEventType {
+    INPUT_EVENT_ACTION,
+    INPUT_EVENT_MOUSE_MOTION,
+    INPUT_EVENT_MOUSE_WHEEL
 };
 
-static const std::unordered_map<uint8_t, Input> input_mouse_button_to_input_map {
-    { SDL_BUTTON_LEFT, INPUT_PORTAL_LEFT },
-    { SDL_BUTTON_RIGHT, INPUT_PORTAL_RIGHT },
+// Times are SDL ticks in milliseconds, the same clock as SDL's event timestamps
+struct InputEvent {
+    uint64_t time;
+    InputEventType type;
+    Input action;
+    bool is_pressed;
+    ivec2 mouse_position;
+    ivec2 mouse_relative_position;
+    int mouse_wheel_motion;
 };
 
 void input_init();
+// Starts a new frame of input, before the frame's events are processed
 void input_update();
 
-void input_process_key(SDL_Keycode key, bool pressed);
-void input_process_mouse_button(uint8_t button, bool pressed);
-void input_process_mouse_motion(ivec2 mouse_position, ivec2 mouse_relative_position);
-void input_process_mouse_wheel_motion(int motion);
+// Keys are bound by scancode, so the bindings stay in the same place whatever the keyboard layout
+void input_process_key(SDL_Scancode scancode, bool pressed, uint64_t time);
+void input_process_mouse_button(uint8_t button, bool pressed, uint64_t time);
+// Motion from every event of a frame adds up
+void input_process_mouse_motion(ivec2 mouse_position, ivec2 mouse_relative_position, uint64_t time);
+void input_process_mouse_wheel_motion(int motion, uint64_t time);
+
+// Runtime rebinding. A key or mouse button drives one action, an action can have any number of them.
+// Rebinding releases every held action at time, which must be on the same clock as the events, so that replays
+// see the releases where they happened
+void input_bind_key(Input input, SDL_Scancode scancode, uint64_t time);
+void input_bind_mouse_button(Input input, uint8_t button, uint64_t time);
+void input_clear_bindings(Input input, uint64_t time);
+void input_reset_bindings(uint64_t time);
+// The next key or mouse button pressed replaces the bindings of input
+void input_capture_binding(Input input);
+
+// Between input_begin_fixed_step() and input_end_fixed_steps() the action queries below answer for the step instead
+// of the frame. Each step replays the queued events up to its end time, so a press lands in the step it happened
+// in, and a tap shorter than a step still counts as just pressed
+void input_begin_fixed_step(uint64_t step_end_time);
+void input_end_fixed_steps();
+// Consumes the queued events up to time without simulating anything, for states without fixed steps
+void input_flush_events(uint64_t time);
+// Starts the next fixed step's window at time, so that a run's first step doesn't span everything since startup
+void input_restart_steps(uint64_t time);
 
 bool input_is_action_pressed(Input input);
 bool input_is_action_just_pressed(Input input);
 bool input_is_action_just_released(Input input);
+// How much of the current fixed step the action was held for, from 0 to 1. Outside of fixed steps it's 0 or 1
+float input_get_action_held_fraction(Input input);
 
 ivec2 input_get_mouse_position();
 ivec2 input_get_mouse_relative_position();
-int input_get_mouse_wheel_motion();
\ No newline at end of file
+int input_get_mouse_wheel_motion();
+
+// Time of the oldest event processed this frame, or 0 if there were none
+uint64_t input_get_oldest_frame_event_time();
\ No newline at end of file
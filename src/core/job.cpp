@@ -0,0 +1,154 @@
+#include "job.h"
+
+#include "logger.h"
+#include "memory.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct JobSystem {
+    std::vector<std::thread> workers;
+    // Pool allocated, since batches are queued every frame
+    std::deque<JobBatch*, PoolAllocator<JobBatch*>> queue;
+    std::mutex mutex;
+    std::condition_variable wake_condition;
+    std::condition_variable done_condition;
+    bool is_quitting;
+};
+
+static JobSystem job_system;
+static thread_local uint32_t job_thread_index = 0;
+
+static void job_run_range(JobBatch* batch, uint32_t range) {
+    uint32_t begin = range * batch->grain_size;
+    uint32_t end = begin + batch->grain_size;
+    if (end > batch->count) {
+        end = batch->count;
+    }
+    batch->function(batch->data, begin, end, job_thread_index);
+
+    if (batch->completed_ranges.fetch_add(1) + 1 == batch->range_count) {
+        std::lock_guard<std::mutex> lock(job_system.mutex);
+        job_system.done_condition.notify_all();
+    }
+}
+
+static void job_worker_main(uint32_t thread_index) {
+    job_thread_index = thread_index;
+
+    while (true) {
+        JobBatch* batch;
+        {
+            std::unique_lock<std::mutex> lock(job_system.mutex);
+            job_system.wake_condition.wait(lock, [] { return job_system.is_quitting || !job_system.queue.empty(); });
+            if (job_system.is_quitting) {
+                return;
+            }
+
+            batch = job_system.queue.front();
+            // Marked under the lock so that job_wait() can't release the batch while we still hold it
+            batch->active_workers.fetch_add(1);
+        }
+
+        uint32_t range = batch->next_range.fetch_add(1);
+        while (range < batch->range_count) {
+            job_run_range(batch, range);
+            range = batch->next_range.fetch_add(1);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(job_system.mutex);
+            if (!job_system.queue.empty() && job_system.queue.front() == batch) {
+                job_system.queue.pop_front();
+            }
+            batch->active_workers.fetch_sub(1);
+            job_system.done_condition.notify_all();
+        }
+    }
+}
+
+bool job_system_init(uint32_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+
+    job_system.is_quitting = false;
+    for (uint32_t thread_index = 1; thread_index < thread_count; thread_index++) {
+        job_system.workers.push_back(std::thread(job_worker_main, thread_index));
+    }
+
+    log_info("Job subsystem initialized with %u threads.", thread_count);
+    return true;
+}
+
+void job_system_quit() {
+    {
+        std::lock_guard<std::mutex> lock(job_system.mutex);
+        job_system.is_quitting = true;
+    }
+    job_system.wake_condition.notify_all();
+
+    for (std::thread& worker : job_system.workers) {
+        worker.join();
+    }
+    job_system.workers.clear();
+    job_system.queue.clear();
+}
+
+uint32_t job_system_get_thread_count() {
+    return (uint32_t)job_system.workers.size() + 1;
+}
+
+void job_submit(JobBatch* batch, uint32_t count, uint32_t grain_size, JobFunction function, void* data) {
+    if (grain_size == 0) {
+        grain_size = 1;
+    }
+
+    batch->function = function;
+    batch->data = data;
+    batch->count = count;
+    batch->grain_size = grain_size;
+    batch->range_count = (count + grain_size - 1) / grain_size;
+    batch->next_range = 0;
+    batch->completed_ranges = 0;
+    batch->active_workers = 0;
+
+    if (batch->range_count <= 1 || job_system.workers.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job_system.mutex);
+        job_system.queue.push_back(batch);
+    }
+    job_system.wake_condition.notify_all();
+}
+
+void job_wait(JobBatch* batch) {
+    uint32_t range = batch->next_range.fetch_add(1);
+    while (range < batch->range_count) {
+        job_run_range(batch, range);
+        range = batch->next_range.fetch_add(1);
+    }
+
+    std::unique_lock<std::mutex> lock(job_system.mutex);
+    job_system.done_condition.wait(lock, [batch] { return batch->completed_ranges.load() == batch->range_count; });
+    for (auto it = job_system.queue.begin(); it != job_system.queue.end(); it++) {
+        if (*it == batch) {
+            job_system.queue.erase(it);
+            break;
+        }
+    }
+    job_system.done_condition.wait(lock, [batch] { return batch->active_workers.load() == 0; });
+}
+
+void job_parallel_for(uint32_t count, uint32_t grain_size, JobFunction function, void* data) {
+    JobBatch batch;
+    job_submit(&batch, count, grain_size, function, data);
+    job_wait(&batch);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Processes the items in [begin, end). thread_index is 0 for the thread that submitted the work
+// and 1 to job_system_get_thread_count() - 1 for the workers, so it can be used to pick per-thread scratch data
+typedef void (*JobFunction)(void* data, uint32_t begin, uint32_t end, uint32_t thread_index);
+
+struct JobBatch {
+    JobFunction function;
+    void* data;
+    uint32_t count;
+    uint32_t grain_size;
+    uint32_t range_count;
+    std::atomic<uint32_t> next_range;
+    std::atomic<uint32_t> completed_ranges;
+    std::atomic<uint32_t> active_workers;
+};
+
+// A thread_count of 0 uses one thread per hardware core, including the calling thread
+bool job_system_init(uint32_t thread_count);
+void job_system_quit();
+uint32_t job_system_get_thread_count();
+
+// Splits count items into ranges of grain_size and queues them for the workers.
+// The batch must stay alive until job_wait() returns for it
+void job_submit(JobBatch* batch, uint32_t count, uint32_t grain_size, JobFunction function, void* data);
+// Helps process the batch on the calling thread, then blocks until every range of it has finished
+void job_wait(JobBatch* batch);
+void job_parallel_for(uint32_t count, uint32_t grain_size, JobFunction function, void* data);
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "platform.h"
 #include "math/math.h"
+#include <algorithm>
 #include <cstdarg>
 #include <cstring>
 #include <cstdint>
@@ -119,6 +120,51 @@ void log_out(LogLevel level, const char* message, ...) {
                 }
                 break;
             }
+            // Anything else is a standard conversion with flags, width, precision or a length, which sprintf handles
+            default: {
+                const char* conversion = message + strspn(message, "-+ #0123456789.hlzjt");
+                if (*conversion == '\0') {
+                    break;
+                }
+                char format[32];
+                size_t format_length = std::min((size_t)(conversion - message) + 2, sizeof(format) - 1);
+                memcpy(format, message - 1, format_length);
+                format[format_length] = '\0';
+                bool is_long_long = strstr(format, "ll") != NULL;
+                bool is_size = strchr(format, 'z') != NULL;
+                switch (*conversion) {
+                    case 'd':
+                    case 'i':
+                    case 'u':
+                    case 'x':
+                    case 'X': {
+                        if (is_long_long) {
+                            out_ptr += sprintf(out_ptr, format, va_arg(arg_ptr, long long));
+                        } else if (is_size) {
+                            out_ptr += sprintf(out_ptr, format, va_arg(arg_ptr, size_t));
+                        } else {
+                            out_ptr += sprintf(out_ptr, format, va_arg(arg_ptr, int));
+                        }
+                        break;
+                    }
+                    case 'f':
+                    case 'e':
+                    case 'g': {
+                        out_ptr += sprintf(out_ptr, format, va_arg(arg_ptr, double));
+                        break;
+                    }
+                    case 's': {
+                        out_ptr += sprintf(out_ptr, format, va_arg(arg_ptr, char*));
+                        break;
+                    }
+                    case '%': {
+                        *out_ptr++ = '%';
+                        break;
+                    }
+                }
+                message = conversion;
+                break;
+            }
             /*
             case 'q': {
                 quat* q = va_arg(arg_ptr, quat*);
@@ -0,0 +1,254 @@
+#include "memory.h"
+
+#include "logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+static const size_t MEMORY_SIZE_CLASS_MIN = 16;
+static const uint32_t MEMORY_SIZE_CLASS_COUNT = 9;
+static const size_t MEMORY_SIZE_CLASS_CHUNK_SIZE = 64 * 1024;
+static const uint32_t MEMORY_FRAME_ARENA_COUNT = 2;
+
+struct MemoryState {
+    MemoryArena frame_arenas[MEMORY_FRAME_ARENA_COUNT];
+    uint32_t frame_arena_index;
+    uint32_t heap_allocation_mark;
+    MemoryStats stats;
+};
+
+static MemoryState state;
+// Counted by the heap functions below, which operator new can call before main(), so it can't live in the state
+static std::atomic<uint32_t> memory_heap_allocation_count(0);
+
+void* memory_heap_alloc(size_t size) {
+    memory_heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+void* memory_heap_realloc(void* block, size_t size) {
+    memory_heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return realloc(block, size);
+}
+
+void memory_heap_free(void* block) {
+    free(block);
+}
+
+void* operator new(size_t size) {
+    void* block = memory_heap_alloc(size == 0 ? 1 : size);
+    if (block == NULL) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    memory_heap_free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    memory_heap_free(block);
+}
+
+void memory_arena_init(MemoryArena* arena, size_t capacity) {
+    arena->base = capacity == 0 ? NULL : (uint8_t*)memory_heap_alloc(capacity);
+    arena->capacity = arena->base == NULL ? 0 : capacity;
+    arena->offset = 0;
+    arena->allocation_count = 0;
+    arena->overflow.clear();
+}
+
+void memory_arena_free(MemoryArena* arena) {
+    memory_arena_reset(arena);
+    memory_heap_free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+}
+
+void* memory_arena_alloc(MemoryArena* arena, size_t size, size_t alignment) {
+    arena->allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+    // The offset always moves, even when the allocation doesn't fit, so that it ends up at what the frame needed
+    uintptr_t base = (uintptr_t)arena->base;
+    size_t offset = arena->offset.load(std::memory_order_relaxed);
+    size_t start;
+    do {
+        start = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+    } while (!arena->offset.compare_exchange_weak(offset, start + size, std::memory_order_relaxed));
+    if (start + size <= arena->capacity) {
+        return arena->base + start;
+    }
+
+    void* block = memory_heap_alloc(size + alignment);
+    if (block == NULL) {
+        log_error("Out of memory allocating %zu bytes of frame memory.", size);
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(arena->overflow_mutex);
+    arena->overflow.push_back(block);
+    return (void*)(((uintptr_t)block + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+void memory_arena_reset(MemoryArena* arena) {
+    for (void* block : arena->overflow) {
+        memory_heap_free(block);
+    }
+    arena->overflow.clear();
+
+    size_t used = arena->offset.load();
+    if (used > arena->capacity) {
+        size_t capacity = used + (used / 2);
+        log_info("Arena of %zu KB ran out with %zu KB allocated, growing it to %zu KB.", arena->capacity / 1024, used / 1024, capacity / 1024);
+        memory_heap_free(arena->base);
+        memory_arena_init(arena, capacity);
+    }
+    arena->offset = 0;
+    arena->allocation_count = 0;
+}
+
+size_t memory_arena_get_used(const MemoryArena& arena) {
+    return arena.offset.load();
+}
+
+void memory_pool_init(MemoryPool* pool, size_t block_size, uint32_t blocks_per_chunk) {
+    // Free blocks hold the free list pointer, and every block keeps the alignment malloc gave the chunk
+    size_t aligned_size = (block_size + MEMORY_DEFAULT_ALIGNMENT - 1) & ~(MEMORY_DEFAULT_ALIGNMENT - 1);
+    pool->block_size = std::max(aligned_size, sizeof(void*));
+    pool->blocks_per_chunk = std::max(blocks_per_chunk, 1u);
+    pool->free_list = NULL;
+    pool->chunks.clear();
+    pool->used_count = 0;
+}
+
+void memory_pool_free_all(MemoryPool* pool) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    for (void* chunk : pool->chunks) {
+        memory_heap_free(chunk);
+    }
+    pool->chunks.clear();
+    pool->free_list = NULL;
+    pool->used_count = 0;
+}
+
+void* memory_pool_alloc(MemoryPool* pool) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (pool->free_list == NULL) {
+        uint8_t* chunk = (uint8_t*)memory_heap_alloc(pool->block_size * pool->blocks_per_chunk);
+        if (chunk == NULL) {
+            log_error("Out of memory allocating a pool chunk of %zu bytes.", pool->block_size * pool->blocks_per_chunk);
+            return NULL;
+        }
+        pool->chunks.push_back(chunk);
+        // Pushed in reverse so that the chunk is handed out front to back
+        for (uint32_t index = pool->blocks_per_chunk; index-- > 0;) {
+            void* block = chunk + (index * pool->block_size);
+            *(void**)block = pool->free_list;
+            pool->free_list = block;
+        }
+    }
+
+    void* block = pool->free_list;
+    pool->free_list = *(void**)block;
+    pool->used_count++;
+    return block;
+}
+
+void memory_pool_free(MemoryPool* pool, void* block) {
+    if (block == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    *(void**)block = pool->free_list;
+    pool->free_list = block;
+    pool->used_count--;
+}
+
+static bool memory_init_size_classes(MemoryPool* size_classes) {
+    for (uint32_t index = 0; index < MEMORY_SIZE_CLASS_COUNT; index++) {
+        size_t block_size = MEMORY_SIZE_CLASS_MIN << index;
+        memory_pool_init(&size_classes[index], block_size, (uint32_t)(MEMORY_SIZE_CLASS_CHUNK_SIZE / block_size));
+    }
+    return true;
+}
+
+// Function local so that containers in other files' statics can use the pools before main()
+static MemoryPool* memory_get_size_classes() {
+    static MemoryPool size_classes[MEMORY_SIZE_CLASS_COUNT];
+    static bool is_initialized = memory_init_size_classes(size_classes);
+    (void)is_initialized;
+    return size_classes;
+}
+
+static uint32_t memory_get_size_class(size_t size) {
+    uint32_t index = 0;
+    while ((MEMORY_SIZE_CLASS_MIN << index) < size) {
+        index++;
+    }
+    return index;
+}
+
+void* memory_size_class_alloc(size_t size) {
+    if (size > MEMORY_SIZE_CLASS_MAX) {
+        return ::operator new(size);
+    }
+    return memory_pool_alloc(&memory_get_size_classes()[memory_get_size_class(size)]);
+}
+
+void memory_size_class_free(void* block, size_t size) {
+    if (size > MEMORY_SIZE_CLASS_MAX) {
+        ::operator delete(block);
+        return;
+    }
+    memory_pool_free(&memory_get_size_classes()[memory_get_size_class(size)], block);
+}
+
+void memory_init(size_t frame_arena_capacity) {
+    for (uint32_t index = 0; index < MEMORY_FRAME_ARENA_COUNT; index++) {
+        memory_arena_free(&state.frame_arenas[index]);
+        memory_arena_init(&state.frame_arenas[index], frame_arena_capacity);
+    }
+    state.frame_arena_index = 0;
+    state.heap_allocation_mark = memory_heap_allocation_count.load();
+    state.stats = (MemoryStats) {};
+    log_info("Memory subsystem initialized with %zu KB frame arenas.", frame_arena_capacity / 1024);
+}
+
+void memory_quit() {
+    for (uint32_t index = 0; index < MEMORY_FRAME_ARENA_COUNT; index++) {
+        memory_arena_free(&state.frame_arenas[index]);
+    }
+}
+
+void memory_begin_frame() {
+    const MemoryArena& finished_arena = state.frame_arenas[state.frame_arena_index];
+    uint32_t heap_allocation_count = memory_heap_allocation_count.load();
+    state.stats.heap_allocation_count = heap_allocation_count - state.heap_allocation_mark;
+    state.heap_allocation_mark = heap_allocation_count;
+    state.stats.frame_allocation_count = finished_arena.allocation_count.load();
+    state.stats.frame_bytes = memory_arena_get_used(finished_arena);
+    state.stats.frame_peak_bytes = std::max(state.stats.frame_peak_bytes, state.stats.frame_bytes);
+
+    // The other arena held the frame before last, which nothing may use anymore
+    state.frame_arena_index = (state.frame_arena_index + 1) % MEMORY_FRAME_ARENA_COUNT;
+    memory_arena_reset(&state.frame_arenas[state.frame_arena_index]);
+}
+
+void* memory_frame_alloc(size_t size, size_t alignment) {
+    return memory_arena_alloc(&state.frame_arenas[state.frame_arena_index], size, alignment);
+}
+
+uint32_t memory_get_heap_allocation_total() {
+    return memory_heap_allocation_count.load(std::memory_order_relaxed);
+}
+
+MemoryStats memory_get_stats() {
+    MemoryStats stats = state.stats;
+    stats.pool_bytes = 0;
+    MemoryPool* size_classes = memory_get_size_classes();
+    for (uint32_t index = 0; index < MEMORY_SIZE_CLASS_COUNT; index++) {
+        std::lock_guard<std::mutex> lock(size_classes[index].mutex);
+        stats.pool_bytes += size_classes[index].chunks.size() * size_classes[index].block_size * size_classes[index].blocks_per_chunk;
+    }
+    return stats;
+}
\ No newline at end of file
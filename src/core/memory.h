@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+static const size_t MEMORY_DEFAULT_ALIGNMENT = 16;
+static const size_t MEMORY_SIZE_CLASS_MAX = 4096;
+
+// Bump allocator that is freed all at once. Allocating is a single atomic add, so any thread can use it.
+// Allocations that don't fit fall back to the heap and are freed on reset, which also grows the arena to the
+// most it was asked for, so an arena sized too small stops touching the heap after one frame
+struct MemoryArena {
+    uint8_t* base;
+    size_t capacity;
+    std::atomic<size_t> offset;
+    std::atomic<uint32_t> allocation_count;
+
+    std::mutex overflow_mutex;
+    std::vector<void*> overflow;
+};
+
+void memory_arena_init(MemoryArena* arena, size_t capacity);
+void memory_arena_free(MemoryArena* arena);
+void* memory_arena_alloc(MemoryArena* arena, size_t size, size_t alignment = MEMORY_DEFAULT_ALIGNMENT);
+void memory_arena_reset(MemoryArena* arena);
+// Includes what went to the heap, so it can be more than the capacity
+size_t memory_arena_get_used(const MemoryArena& arena);
+
+// Fixed size blocks for objects that come and go one at a time. Freed blocks go on a free list threaded through
+// the blocks themselves, and chunks are only given back by memory_pool_free_all()
+struct MemoryPool {
+    size_t block_size;
+    uint32_t blocks_per_chunk;
+    void* free_list;
+    std::vector<void*> chunks;
+    uint32_t used_count;
+    std::mutex mutex;
+};
+
+void memory_pool_init(MemoryPool* pool, size_t block_size, uint32_t blocks_per_chunk);
+void memory_pool_free_all(MemoryPool* pool);
+void* memory_pool_alloc(MemoryPool* pool);
+void memory_pool_free(MemoryPool* pool, void* block);
+
+struct MemoryStats {
+    // Of the last whole frame
+    uint32_t heap_allocation_count;
+    uint32_t frame_allocation_count;
+    size_t frame_bytes;
+    // Highest frame_bytes since startup
+    size_t frame_peak_bytes;
+    size_t pool_bytes;
+};
+
+// Frame memory comes from two arenas that take turns, so it stays valid until the end of the frame after the one
+// it was allocated in. That leaves time for work handed to the job system or the GPU to finish with it
+void memory_init(size_t frame_arena_capacity);
+void memory_quit();
+// Called once at the start of every frame, before anything allocates frame memory
+void memory_begin_frame();
+void* memory_frame_alloc(size_t size, size_t alignment = MEMORY_DEFAULT_ALIGNMENT);
+// Blocks of any size up to MEMORY_SIZE_CLASS_MAX from a pool per power of two, larger ones from the heap
+void* memory_size_class_alloc(size_t size);
+void memory_size_class_free(void* block, size_t size);
+MemoryStats memory_get_stats();
+// Every heap allocation since startup, for measuring a stretch of code rather than a whole frame
+uint32_t memory_get_heap_allocation_total();
+
+// malloc, realloc and free, counted as heap allocations just like operator new. Code that goes to the heap
+// without new uses these, so that the count covers everything
+void* memory_heap_alloc(size_t size);
+void* memory_heap_realloc(void* block, size_t size);
+void memory_heap_free(void* block);
+
+template <typename T>
+T* memory_frame_alloc_array(size_t count) {
+    return (T*)memory_frame_alloc(count * sizeof(T), alignof(T) > MEMORY_DEFAULT_ALIGNMENT ? alignof(T) : MEMORY_DEFAULT_ALIGNMENT);
+}
+
+// STL allocators. Containers using FrameAllocator must not outlive the frame after the one they were filled in
+template <typename T>
+struct FrameAllocator {
+    typedef T value_type;
+
+    FrameAllocator() = default;
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return memory_frame_alloc_array<T>(count);
+    }
+    void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) { return false; }
+
+// Recycles the blocks of node based containers like std::deque and std::list instead of going to the heap
+template <typename T>
+struct PoolAllocator {
+    typedef T value_type;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return (T*)memory_size_class_alloc(count * sizeof(T));
+    }
+    void deallocate(T* block, size_t count) {
+        memory_size_class_free(block, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
\ No newline at end of file
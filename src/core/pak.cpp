@@ -0,0 +1,152 @@
+#include "pak.h"
+
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+static const size_t PAK_MIN_MATCH = 4;
+// The format requires the last 5 bytes to be literals and no match to start in the last 12
+static const size_t PAK_LAST_LITERALS = 5;
+static const size_t PAK_MATCH_START_LIMIT = 12;
+static const size_t PAK_MAX_OFFSET = 65535;
+static const uint32_t PAK_HASH_BITS = 12;
+
+uint64_t pak_hash_path(const char* path, size_t length) {
+    return hash_fnv1a(HASH_FNV1A_BASIS, path, length);
+}
+
+uint32_t pak_get_bucket(uint64_t hash, uint32_t bucket_bits) {
+    return (uint32_t)(hash >> (64 - bucket_bits));
+}
+
+size_t pak_get_compress_bound(size_t size) {
+    return size + (size / 255) + 16;
+}
+
+static uint32_t pak_read_u32(const uint8_t* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// Lengths that don't fit in their 4 bits of the token carry on in bytes of 255 until the last one
+static uint8_t* pak_write_length(uint8_t* output, size_t length) {
+    while (length >= 255) {
+        *output++ = 255;
+        length -= 255;
+    }
+    *output++ = (uint8_t)length;
+    return output;
+}
+
+static bool pak_read_length(const uint8_t** input, const uint8_t* input_end, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*input == input_end) {
+            return false;
+        }
+        byte = *(*input)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static uint8_t* pak_write_sequence(uint8_t* output, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length) {
+    uint8_t* token = output++;
+    *token = (uint8_t)(std::min(literal_length, (size_t)15) << 4);
+    if (literal_length >= 15) {
+        output = pak_write_length(output, literal_length - 15);
+    }
+    memcpy(output, literals, literal_length);
+    output += literal_length;
+    if (match_length == 0) {
+        return output;
+    }
+
+    *output++ = (uint8_t)(offset & 0xff);
+    *output++ = (uint8_t)(offset >> 8);
+    size_t match_code = match_length - PAK_MIN_MATCH;
+    *token |= (uint8_t)std::min(match_code, (size_t)15);
+    if (match_code >= 15) {
+        output = pak_write_length(output, match_code - 15);
+    }
+    return output;
+}
+
+// Greedy matching against the last position each 4 byte sequence was seen at. Packing runs offline, so this only
+// needs to be simple and good enough for text like shaders
+size_t pak_compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity) {
+    if (capacity < pak_get_compress_bound(size)) {
+        return 0;
+    }
+
+    std::vector<uint32_t> positions(1 << PAK_HASH_BITS, UINT32_MAX);
+    uint8_t* output = destination;
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + PAK_MATCH_START_LIMIT <= size) {
+        uint32_t sequence = pak_read_u32(source + position);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - PAK_HASH_BITS);
+        uint32_t candidate = positions[hash];
+        positions[hash] = (uint32_t)position;
+        if (candidate == UINT32_MAX || position - candidate > PAK_MAX_OFFSET || pak_read_u32(source + candidate) != sequence) {
+            position++;
+            continue;
+        }
+
+        size_t match_length = PAK_MIN_MATCH;
+        while (position + match_length < size - PAK_LAST_LITERALS && source[candidate + match_length] == source[position + match_length]) {
+            match_length++;
+        }
+        output = pak_write_sequence(output, source + anchor, position - anchor, position - candidate, match_length);
+        position += match_length;
+        anchor = position;
+    }
+    output = pak_write_sequence(output, source + anchor, size - anchor, 0, 0);
+    return output - destination;
+}
+
+bool pak_decompress(const uint8_t* source, size_t source_size, uint8_t* destination, size_t destination_size) {
+    const uint8_t* input = source;
+    const uint8_t* input_end = source + source_size;
+    uint8_t* output = destination;
+    uint8_t* output_end = destination + destination_size;
+    while (input < input_end) {
+        uint8_t token = *input++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !pak_read_length(&input, input_end, &literal_length)) {
+            return false;
+        }
+        if (literal_length > (size_t)(input_end - input) || literal_length > (size_t)(output_end - output)) {
+            return false;
+        }
+        memcpy(output, input, literal_length);
+        input += literal_length;
+        output += literal_length;
+        // The last sequence is only literals
+        if (input == input_end) {
+            break;
+        }
+
+        if (input_end - input < 2) {
+            return false;
+        }
+        size_t offset = input[0] | (input[1] << 8);
+        input += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && !pak_read_length(&input, input_end, &match_length)) {
+            return false;
+        }
+        match_length += PAK_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(output - destination) || match_length > (size_t)(output_end - output)) {
+            return false;
+        }
+        // Byte by byte, since the match may overlap what it's writing
+        const uint8_t* match = output - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            *output++ = *match++;
+        }
+    }
+    return output == output_end;
+}
\ No newline at end of file
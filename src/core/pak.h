@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A pak is a header, the bucket table, the entries sorted by path hash, the path strings and then the file data,
+// every file starting on a PAK_ALIGNMENT boundary. Bucket i holds the entries whose hash starts with the bits of i,
+// and since the entries are sorted by hash, those are entries buckets[i] up to buckets[i + 1]
+static const char PAK_MAGIC[4] = { 'P', 'A', 'K', '1' };
+static const uint32_t PAK_VERSION = 1;
+static const uint32_t PAK_ALIGNMENT = 64;
+// Stored files only get compressed when it saves at least this fraction of their size
+static const float PAK_MIN_COMPRESSION_SAVING = 0.1f;
+
+enum PakEntryFlag {
+    PAK_ENTRY_COMPRESSED = 1
+};
+
+struct PakHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t bucket_bits;
+    uint64_t buckets_offset;
+    uint64_t entries_offset;
+    uint64_t names_offset;
+    uint64_t file_size;
+};
+
+struct PakEntry {
+    uint64_t hash;
+    uint64_t offset;
+    // Size of the file itself and of what's stored in the pak, which differ for compressed files
+    uint64_t size;
+    uint64_t stored_size;
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t flags;
+    uint32_t padding;
+};
+
+// Paths are relative to the resource directory with forward slashes, the way the game asks for them
+uint64_t pak_hash_path(const char* path, size_t length);
+uint32_t pak_get_bucket(uint64_t hash, uint32_t bucket_bits);
+
+// LZ4 block format, so packs can also be made with other LZ4 tools. Compressing returns 0 when the output doesn't
+// fit in capacity, which pak_get_compress_bound() always does
+size_t pak_get_compress_bound(size_t size);
+size_t pak_compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity);
+// Fails on malformed data or when it doesn't decompress to exactly destination_size bytes
+bool pak_decompress(const uint8_t* source, size_t source_size, uint8_t* destination, size_t destination_size);
\ No newline at end of file
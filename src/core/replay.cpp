@@ -0,0 +1,251 @@
+#include "replay.h"
+
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char REPLAY_MAGIC[4] = { 'P', 'R', 'P', 'L' };
+static const uint32_t REPLAY_VERSION = 1;
+
+struct ReplayHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;
+    uint32_t frame_count;
+};
+
+// Frames are a float delta, a uint32 input time and a uint16 event count, followed by the events. Events are a
+// uint8 type and a uint32 time, followed by only the fields their type uses
+struct ReplayState {
+    FILE* file;
+    FILE* timing_file;
+    bool is_recording;
+    bool is_playing;
+    ReplayHeader header;
+
+    // Recording
+    std::vector<uint8_t> frame_buffer;
+    std::vector<ReplayEvent> frame_events;
+
+    // Playback
+    std::vector<uint8_t> data;
+    size_t cursor;
+    uint32_t frame_index;
+    std::vector<double> frame_times;
+};
+
+static ReplayState state;
+
+template <typename T>
+static void replay_write(std::vector<uint8_t>& buffer, T value) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(T));
+    memcpy(&buffer[offset], &value, sizeof(T));
+}
+
+template <typename T>
+static bool replay_read(T* value) {
+    if (state.cursor + sizeof(T) > state.data.size()) {
+        return false;
+    }
+    memcpy(value, &state.data[state.cursor], sizeof(T));
+    state.cursor += sizeof(T);
+    return true;
+}
+
+bool replay_begin_recording(const char* path, uint32_t seed) {
+    state.file = fopen(path, "wb");
+    if (state.file == NULL) {
+        log_error("Error opening replay %s for writing.", path);
+        return false;
+    }
+
+    memcpy(state.header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    state.header.version = REPLAY_VERSION;
+    state.header.seed = seed;
+    state.header.frame_count = 0;
+    // Written again with the frame count once recording ends
+    fwrite(&state.header, sizeof(ReplayHeader), 1, state.file);
+
+    state.frame_buffer.clear();
+    state.frame_events.clear();
+    state.is_recording = true;
+    log_info("Recording replay to %s.", path);
+    return true;
+}
+
+bool replay_begin_playback(const char* path, const char* timing_path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        log_error("Error opening replay %s.", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    state.data.resize(size > 0 ? (size_t)size : 0);
+    size_t read_size = fread(state.data.data(), 1, state.data.size(), file);
+    fclose(file);
+
+    state.cursor = 0;
+    if (read_size != state.data.size() || !replay_read(&state.header) || memcmp(state.header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0) {
+        log_error("Replay %s is not a replay file.", path);
+        return false;
+    }
+    if (state.header.version != REPLAY_VERSION) {
+        log_error("Replay %s has version %u, expected %u.", path, state.header.version, REPLAY_VERSION);
+        return false;
+    }
+
+    state.timing_file = fopen(timing_path, "w");
+    if (state.timing_file == NULL) {
+        log_error("Error opening replay timings %s for writing.", timing_path);
+        return false;
+    }
+    fprintf(state.timing_file, "frame,delta_ms,update_ms,fixed_update_ms,fixed_steps,render_ms,present_ms,frame_ms\n");
+
+    state.frame_index = 0;
+    state.frame_events.clear();
+    state.frame_times.clear();
+    state.frame_times.reserve(state.header.frame_count);
+    state.is_playing = true;
+    log_info("Playing back replay %s, %u frames, writing timings to %s.", path, state.header.frame_count, timing_path);
+    return true;
+}
+
+void replay_end() {
+    if (state.is_recording) {
+        fseek(state.file, 0, SEEK_SET);
+        fwrite(&state.header, sizeof(ReplayHeader), 1, state.file);
+        fclose(state.file);
+        state.file = NULL;
+        state.is_recording = false;
+        log_info("Recorded %u replay frames.", state.header.frame_count);
+    }
+
+    if (state.is_playing) {
+        fclose(state.timing_file);
+        state.timing_file = NULL;
+        state.is_playing = false;
+        state.data.clear();
+        if (!state.frame_times.empty()) {
+            double total = 0.0;
+            for (double frame_time : state.frame_times) {
+                total += frame_time;
+            }
+            std::sort(state.frame_times.begin(), state.frame_times.end());
+            size_t p99_index = std::min(state.frame_times.size() - 1, (state.frame_times.size() * 99) / 100);
+            log_info("Played back %u frames in %.1f ms, average %.3f ms, median %.3f ms, p99 %.3f ms.",
+                     state.frame_index, total, total / state.frame_times.size(),
+                     state.frame_times[state.frame_times.size() / 2], state.frame_times[p99_index]);
+        }
+    }
+}
+
+bool replay_is_recording() {
+    return state.is_recording;
+}
+
+bool replay_is_playing() {
+    return state.is_playing;
+}
+
+uint32_t replay_get_seed() {
+    return state.header.seed;
+}
+
+void replay_record_event(const ReplayEvent& event) {
+    state.frame_events.push_back(event);
+}
+
+void replay_record_frame(float delta, uint32_t input_time) {
+    std::vector<uint8_t>& buffer = state.frame_buffer;
+    buffer.clear();
+    replay_write(buffer, delta);
+    replay_write(buffer, input_time);
+    replay_write(buffer, (uint16_t)state.frame_events.size());
+    for (const ReplayEvent& event : state.frame_events) {
+        replay_write(buffer, (uint8_t)event.type);
+        replay_write(buffer, event.time);
+        switch (event.type) {
+            case REPLAY_EVENT_KEY:
+            case REPLAY_EVENT_MOUSE_BUTTON:
+                replay_write(buffer, event.code);
+                replay_write(buffer, (uint8_t)event.is_pressed);
+                break;
+            case REPLAY_EVENT_MOUSE_MOTION:
+                replay_write(buffer, (int16_t)event.mouse_position.x);
+                replay_write(buffer, (int16_t)event.mouse_position.y);
+                replay_write(buffer, (int16_t)event.mouse_relative_position.x);
+                replay_write(buffer, (int16_t)event.mouse_relative_position.y);
+                break;
+            case REPLAY_EVENT_MOUSE_WHEEL:
+                replay_write(buffer, (int16_t)event.mouse_wheel_motion);
+                break;
+        }
+    }
+    fwrite(buffer.data(), 1, buffer.size(), state.file);
+    state.frame_events.clear();
+    state.header.frame_count++;
+}
+
+bool replay_play_frame(float* delta, uint32_t* input_time, const ReplayEvent** events, uint32_t* event_count) {
+    uint16_t count;
+    if (state.frame_index == state.header.frame_count || !replay_read(delta) || !replay_read(input_time) || !replay_read(&count)) {
+        return false;
+    }
+
+    state.frame_events.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        ReplayEvent event;
+        uint8_t type;
+        if (!replay_read(&type) || !replay_read(&event.time)) {
+            return false;
+        }
+        event.type = (ReplayEventType)type;
+        bool is_complete = true;
+        switch (event.type) {
+            case REPLAY_EVENT_KEY:
+            case REPLAY_EVENT_MOUSE_BUTTON: {
+                uint8_t is_pressed;
+                is_complete = replay_read(&event.code) && replay_read(&is_pressed);
+                event.is_pressed = is_pressed != 0;
+                break;
+            }
+            case REPLAY_EVENT_MOUSE_MOTION: {
+                int16_t values[4];
+                is_complete = replay_read(&values);
+                event.mouse_position = ivec2(values[0], values[1]);
+                event.mouse_relative_position = ivec2(values[2], values[3]);
+                break;
+            }
+            case REPLAY_EVENT_MOUSE_WHEEL: {
+                int16_t motion;
+                is_complete = replay_read(&motion);
+                event.mouse_wheel_motion = motion;
+                break;
+            }
+            default:
+                is_complete = false;
+                break;
+        }
+        if (!is_complete) {
+            log_error("Replay frame %u is truncated.", state.frame_index);
+            return false;
+        }
+        state.frame_events.push_back(event);
+    }
+
+    state.frame_index++;
+    *events = state.frame_events.data();
+    *event_count = (uint32_t)state.frame_events.size();
+    return true;
+}
+
+void replay_record_timing(const ReplayFrameTiming& timing) {
+    fprintf(state.timing_file, "%u,%.4f,%.4f,%.4f,%u,%.4f,%.4f,%.4f\n", state.frame_index - 1, timing.delta, timing.update,
+            timing.fixed_update, timing.fixed_step_count, timing.render, timing.present, timing.frame);
+    state.frame_times.push_back(timing.frame);
+}
\ No newline at end of file
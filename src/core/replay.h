@@ -0,0 +1,57 @@
+#pragma once
+
+#include "math/math.h"
+#include <cstdint>
+
+// Seeds the C RNG for recordings, and is stored in them so playback seeds it the same way
+static const uint32_t REPLAY_DEFAULT_SEED = 0x504f5254;
+
+enum ReplayEventType {
+    REPLAY_EVENT_KEY,
+    REPLAY_EVENT_MOUSE_BUTTON,
+    REPLAY_EVENT_MOUSE_MOTION,
+    REPLAY_EVENT_MOUSE_WHEEL
+};
+
+// A device event as it went into the input subsystem. Times are milliseconds since application_run() started.
+// The code is the scancode of key events and the button of mouse button events
+struct ReplayEvent {
+    ReplayEventType type;
+    uint32_t time;
+    uint16_t code;
+    bool is_pressed;
+    ivec2 mouse_position;
+    ivec2 mouse_relative_position;
+    int mouse_wheel_motion;
+};
+
+// CPU times of one played back frame, in milliseconds
+struct ReplayFrameTiming {
+    double delta;
+    double update;
+    double fixed_update;
+    uint32_t fixed_step_count;
+    double render;
+    double present;
+    double frame;
+};
+
+// Records every frame's delta time, input time and device events to a compact binary file. Feeding them back
+// through the same input path with the same deltas takes the game down the same path through the level, so
+// timings from different builds can be compared frame for frame
+bool replay_begin_recording(const char* path, uint32_t seed);
+// Reads the whole replay up front so playback never waits on the disk. Per frame timings go to timing_path as CSV
+bool replay_begin_playback(const char* path, const char* timing_path);
+// Finishes the recording or playback, logging a summary of the played back frame times
+void replay_end();
+bool replay_is_recording();
+bool replay_is_playing();
+uint32_t replay_get_seed();
+
+void replay_record_event(const ReplayEvent& event);
+// Writes out the frame with the events recorded since the last one
+void replay_record_frame(float delta, uint32_t input_time);
+
+// Returns false once every frame has been played. The events stay valid until the next call
+bool replay_play_frame(float* delta, uint32_t* input_time, const ReplayEvent** events, uint32_t* event_count);
+void replay_record_timing(const ReplayFrameTiming& timing);
\ No newline at end of file
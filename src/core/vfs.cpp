@@ -0,0 +1,230 @@
+#include "vfs.h"
+
+#include "logger.h"
+#include "memory.h"
+#include "pak.h"
+#include "platform.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef PLATFORM_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct VfsState {
+    std::string resource_path;
+    std::string pak_path;
+
+    // The whole pak stays mapped while it's mounted
+    void* pak_mapping;
+    size_t pak_size;
+    const PakHeader* header;
+    const uint32_t* buckets;
+    const PakEntry* entries;
+    const char* names;
+};
+
+static VfsState state;
+
+// Maps a whole file read only. Empty files can't be mapped, they come back as a NULL mapping of size 0
+static bool vfs_map_file(const char* path, void** mapping, size_t* size) {
+    *mapping = NULL;
+    *size = 0;
+#ifdef PLATFORM_WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    *size = (size_t)file_size.QuadPart;
+    if (*size == 0) {
+        CloseHandle(file);
+        return true;
+    }
+    // The view keeps the file open by itself, so the handles can go right away
+    HANDLE file_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (file_mapping == NULL) {
+        return false;
+    }
+    *mapping = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(file_mapping);
+    return *mapping != NULL;
+#else
+    int file = open(path, O_RDONLY);
+    if (file == -1) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0) {
+        close(file);
+        return false;
+    }
+    *size = (size_t)file_stat.st_size;
+    if (*size == 0) {
+        close(file);
+        return true;
+    }
+    void* data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    *mapping = data;
+    return true;
+#endif
+}
+
+static void vfs_unmap_file(void* mapping, size_t size) {
+    if (mapping == NULL) {
+        return;
+    }
+#ifdef PLATFORM_WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
+
+static bool vfs_is_range_in_pak(uint64_t offset, uint64_t size) {
+    return offset <= state.pak_size && size <= state.pak_size - offset;
+}
+
+static bool vfs_mount_pak() {
+    if (!vfs_map_file(state.pak_path.c_str(), &state.pak_mapping, &state.pak_size)) {
+        return false;
+    }
+
+    const uint8_t* pak = (const uint8_t*)state.pak_mapping;
+    state.header = (const PakHeader*)pak;
+    const PakHeader& header = *state.header;
+    bool is_valid = state.pak_size >= sizeof(PakHeader) &&
+                    memcmp(header.magic, PAK_MAGIC, sizeof(PAK_MAGIC)) == 0 &&
+                    header.version == PAK_VERSION &&
+                    header.file_size == state.pak_size &&
+                    header.bucket_bits >= 1 && header.bucket_bits <= 31 &&
+                    vfs_is_range_in_pak(header.buckets_offset, ((1ull << header.bucket_bits) + 1) * sizeof(uint32_t)) &&
+                    vfs_is_range_in_pak(header.entries_offset, (uint64_t)header.entry_count * sizeof(PakEntry)) &&
+                    header.names_offset <= state.pak_size;
+    if (!is_valid) {
+        log_error("Pak %s is not a version %u pak, reading loose files instead.", state.pak_path.c_str(), PAK_VERSION);
+        vfs_unmap_file(state.pak_mapping, state.pak_size);
+        state.pak_mapping = NULL;
+        return false;
+    }
+    state.buckets = (const uint32_t*)(pak + header.buckets_offset);
+    state.entries = (const PakEntry*)(pak + header.entries_offset);
+    state.names = (const char*)(pak + header.names_offset);
+    return true;
+}
+
+void vfs_init(const char* resource_path) {
+    state.resource_path = std::string(resource_path);
+    state.pak_path = state.resource_path;
+    while (!state.pak_path.empty() && state.pak_path.back() == '/') {
+        state.pak_path.pop_back();
+    }
+    state.pak_path += ".pak";
+    state.pak_mapping = NULL;
+
+    if (getenv("PORTAL_LOOSE_FILES") != NULL) {
+        log_info("PORTAL_LOOSE_FILES is set, reading loose files from %s.", resource_path);
+        return;
+    }
+    if (!vfs_mount_pak()) {
+        log_info("Reading loose files from %s.", resource_path);
+        return;
+    }
+    log_info("Mounted %s with %u files.", state.pak_path.c_str(), state.header->entry_count);
+}
+
+void vfs_quit() {
+    vfs_unmap_file(state.pak_mapping, state.pak_size);
+    state.pak_mapping = NULL;
+}
+
+bool vfs_is_pak_mounted() {
+    return state.pak_mapping != NULL;
+}
+
+static const PakEntry* vfs_find_entry(const char* path) {
+    size_t length = strlen(path);
+    uint64_t hash = pak_hash_path(path, length);
+    uint32_t bucket = pak_get_bucket(hash, state.header->bucket_bits);
+    for (uint32_t index = state.buckets[bucket]; index < state.buckets[bucket + 1] && index < state.header->entry_count; index++) {
+        const PakEntry& entry = state.entries[index];
+        if (entry.hash == hash && entry.name_length == length && memcmp(state.names + entry.name_offset, path, length) == 0) {
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+static bool vfs_open_entry(VfsFile* file, const char* path) {
+    const PakEntry* entry = vfs_find_entry(path);
+    if (entry == NULL) {
+        log_error("Could not find %s in %s", path, state.pak_path.c_str());
+        return false;
+    }
+    if (!vfs_is_range_in_pak(entry->offset, entry->stored_size)) {
+        log_error("Entry %s runs past the end of %s", path, state.pak_path.c_str());
+        return false;
+    }
+
+    const uint8_t* stored = (const uint8_t*)state.pak_mapping + entry->offset;
+    if (!(entry->flags & PAK_ENTRY_COMPRESSED)) {
+        file->data = stored;
+        file->size = entry->size;
+        return true;
+    }
+    file->buffer = (uint8_t*)memory_heap_alloc(entry->size == 0 ? 1 : entry->size);
+    if (!pak_decompress(stored, entry->stored_size, file->buffer, entry->size)) {
+        log_error("Entry %s of %s is corrupt.", path, state.pak_path.c_str());
+        memory_heap_free(file->buffer);
+        file->buffer = NULL;
+        return false;
+    }
+    file->data = file->buffer;
+    file->size = entry->size;
+    return true;
+}
+
+bool vfs_open(VfsFile* file, const char* path) {
+    file->data = NULL;
+    file->size = 0;
+    file->mapping = NULL;
+    file->mapping_size = 0;
+    file->buffer = NULL;
+
+    if (vfs_is_pak_mounted()) {
+        return vfs_open_entry(file, path);
+    }
+
+    std::string full_path = state.resource_path + std::string(path);
+    if (!vfs_map_file(full_path.c_str(), &file->mapping, &file->mapping_size)) {
+        log_error("Could not open file %s", full_path.c_str());
+        return false;
+    }
+    file->data = (const uint8_t*)file->mapping;
+    file->size = file->mapping_size;
+    return true;
+}
+
+void vfs_close(VfsFile* file) {
+    vfs_unmap_file(file->mapping, file->mapping_size);
+    memory_heap_free(file->buffer);
+    file->data = NULL;
+    file->size = 0;
+    file->mapping = NULL;
+    file->buffer = NULL;
+}
\ No newline at end of file
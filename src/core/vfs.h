@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A read only view of a resource. Files stored uncompressed in the pak, and loose files, are views straight into
+// memory mapped files, so nothing is copied until the caller decodes them
+struct VfsFile {
+    const uint8_t* data;
+    size_t size;
+
+    // What closing has to give back: the mapping of a loose file, or the buffer of a decompressed pak entry
+    void* mapping;
+    size_t mapping_size;
+    uint8_t* buffer;
+};
+
+// Mounts the pak next to the resource directory, "../res/" is read from "../res.pak", if there is one and
+// PORTAL_LOOSE_FILES isn't set. Otherwise files are read from the resource directory
+void vfs_init(const char* resource_path);
+void vfs_quit();
+bool vfs_is_pak_mounted();
+// Paths are relative to the resource directory. Loose files can be opened from any thread
+bool vfs_open(VfsFile* file, const char* path);
+void vfs_close(VfsFile* file);
\ No newline at end of file
@@ -13,6 +13,8 @@ int main() {
         .name = "PORTAL",
         .screen_size = ivec2(1280, 720),
         .window_size = ivec2(1280, 720),
+        .anti_aliasing = POST_ANTI_ALIASING_FXAA,
+        .texture_budget = 256 * 1024 * 1024,
         
         .resource_path = "../res/",
     };
@@ -24,7 +26,5 @@ int main() {
         application_register_state(state_id, app_states.at((State)state_id));
     }
 
-    application_run(STATE_LEVEL);
-
-    return 0;
+    return application_run(STATE_LEVEL);
 }
\ No newline at end of file
@@ -145,6 +145,24 @@ struct quat {
         return result;
     }
 
+    // Expects the upper 3x3 of the matrix to be a rotation
+    inline static quat from_mat4(const mat4& m) {
+        float trace = m[0][0] + m[1][1] + m[2][2];
+        if (trace > 0.0f) {
+            float s = 0.5f / sqrtf(trace + 1.0f);
+            return quat((m[1][2] - m[2][1]) * s, (m[2][0] - m[0][2]) * s, (m[0][1] - m[1][0]) * s, 0.25f / s);
+        } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+            float s = 2.0f * sqrtf(1.0f + m[0][0] - m[1][1] - m[2][2]);
+            return quat(0.25f * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+        } else if (m[1][1] > m[2][2]) {
+            float s = 2.0f * sqrtf(1.0f + m[1][1] - m[0][0] - m[2][2]);
+            return quat((m[1][0] + m[0][1]) / s, 0.25f * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+        } else {
+            float s = 2.0f * sqrtf(1.0f + m[2][2] - m[0][0] - m[1][1]);
+            return quat((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25f * s, (m[0][1] - m[1][0]) / s);
+        }
+    }
+
     inline static quat from_axis_angle(vec3 axis, float angle, bool normalize) {
         const float half_angle = 0.5f * angle;
         float sin_half_angle = sin(half_angle);
@@ -0,0 +1,210 @@
+#include "bvh.h"
+
+static const uint32_t BVH_LEAF_SIZE = 4;
+static const uint32_t BVH_BIN_COUNT = 12;
+
+struct BvhBuildState {
+    Bvh* bvh;
+    const AABB* primitive_bounds;
+    std::vector<vec3> centroids;
+};
+
+static float vec3_axis(const vec3& v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static void bvh_update_bounds(BvhBuildState& build, uint32_t node_index) {
+    BvhNode& node = build.bvh->nodes[node_index];
+    node.bounds = AABB::empty();
+    for (uint32_t i = 0; i < node.count; i++) {
+        node.bounds.expand(build.primitive_bounds[build.bvh->indices[node.left_or_first + i]]);
+    }
+}
+
+// Finds the cheapest split plane using the surface area heuristic evaluated over a fixed number of bins per axis
+static float bvh_find_split(BvhBuildState& build, const BvhNode& node, int* best_axis, float* best_position) {
+    float best_cost = INFINITY;
+
+    AABB centroid_bounds = AABB::empty();
+    for (uint32_t i = 0; i < node.count; i++) {
+        centroid_bounds.expand(build.centroids[build.bvh->indices[node.left_or_first + i]]);
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        float axis_min = vec3_axis(centroid_bounds.min, axis);
+        float axis_max = vec3_axis(centroid_bounds.max, axis);
+        if (axis_min == axis_max) {
+            continue;
+        }
+
+        AABB bin_bounds[BVH_BIN_COUNT];
+        uint32_t bin_counts[BVH_BIN_COUNT];
+        for (uint32_t bin = 0; bin < BVH_BIN_COUNT; bin++) {
+            bin_bounds[bin] = AABB::empty();
+            bin_counts[bin] = 0;
+        }
+
+        float scale = BVH_BIN_COUNT / (axis_max - axis_min);
+        for (uint32_t i = 0; i < node.count; i++) {
+            uint32_t primitive = build.bvh->indices[node.left_or_first + i];
+            uint32_t bin = (uint32_t)((vec3_axis(build.centroids[primitive], axis) - axis_min) * scale);
+            if (bin > BVH_BIN_COUNT - 1) {
+                bin = BVH_BIN_COUNT - 1;
+            }
+            bin_counts[bin]++;
+            bin_bounds[bin].expand(build.primitive_bounds[primitive]);
+        }
+
+        // Sweep from both sides to get the area and count to the left and right of each plane
+        float left_area[BVH_BIN_COUNT - 1];
+        float right_area[BVH_BIN_COUNT - 1];
+        uint32_t left_count[BVH_BIN_COUNT - 1];
+        uint32_t right_count[BVH_BIN_COUNT - 1];
+        AABB left_box = AABB::empty();
+        AABB right_box = AABB::empty();
+        uint32_t left_sum = 0;
+        uint32_t right_sum = 0;
+        for (uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++) {
+            left_sum += bin_counts[i];
+            left_count[i] = left_sum;
+            left_box.expand(bin_bounds[i]);
+            left_area[i] = left_sum == 0 ? 0.0f : left_box.surface_area();
+
+            right_sum += bin_counts[BVH_BIN_COUNT - 1 - i];
+            right_count[BVH_BIN_COUNT - 2 - i] = right_sum;
+            right_box.expand(bin_bounds[BVH_BIN_COUNT - 1 - i]);
+            right_area[BVH_BIN_COUNT - 2 - i] = right_sum == 0 ? 0.0f : right_box.surface_area();
+        }
+
+        float bin_width = (axis_max - axis_min) / BVH_BIN_COUNT;
+        for (uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++) {
+            float cost = (left_count[i] * left_area[i]) + (right_count[i] * right_area[i]);
+            if (cost < best_cost) {
+                best_cost = cost;
+                *best_axis = axis;
+                *best_position = axis_min + (bin_width * (i + 1));
+            }
+        }
+    }
+
+    return best_cost;
+}
+
+static void bvh_subdivide(BvhBuildState& build, uint32_t node_index, uint32_t depth) {
+    BvhNode node = build.bvh->nodes[node_index];
+    if (node.count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH) {
+        return;
+    }
+
+    int axis = 0;
+    float split_position = 0.0f;
+    float split_cost = bvh_find_split(build, node, &axis, &split_position);
+    float leaf_cost = node.count * node.bounds.surface_area();
+    if (split_cost >= leaf_cost) {
+        return;
+    }
+
+    // Partition the primitives in place around the split plane
+    int64_t i = node.left_or_first;
+    int64_t j = i + node.count - 1;
+    while (i <= j) {
+        if (vec3_axis(build.centroids[build.bvh->indices[i]], axis) < split_position) {
+            i++;
+        } else {
+            std::swap(build.bvh->indices[i], build.bvh->indices[j]);
+            j--;
+        }
+    }
+
+    uint32_t left_count = (uint32_t)(i - node.left_or_first);
+    if (left_count == 0 || left_count == node.count) {
+        return;
+    }
+
+    uint32_t left_index = (uint32_t)build.bvh->nodes.size();
+    build.bvh->nodes.push_back((BvhNode) {
+        .bounds = AABB::empty(),
+        .left_or_first = node.left_or_first,
+        .count = left_count
+    });
+    build.bvh->nodes.push_back((BvhNode) {
+        .bounds = AABB::empty(),
+        .left_or_first = (uint32_t)i,
+        .count = node.count - left_count
+    });
+    build.bvh->nodes[node_index].left_or_first = left_index;
+    build.bvh->nodes[node_index].count = 0;
+
+    bvh_update_bounds(build, left_index);
+    bvh_update_bounds(build, left_index + 1);
+    bvh_subdivide(build, left_index, depth + 1);
+    bvh_subdivide(build, left_index + 1, depth + 1);
+}
+
+void bvh_build(Bvh* bvh, const AABB* primitive_bounds, uint32_t primitive_count) {
+    bvh->nodes.clear();
+    bvh->indices.resize(primitive_count);
+    if (primitive_count == 0) {
+        return;
+    }
+
+    BvhBuildState build;
+    build.bvh = bvh;
+    build.primitive_bounds = primitive_bounds;
+    build.centroids.resize(primitive_count);
+    for (uint32_t i = 0; i < primitive_count; i++) {
+        bvh->indices[i] = i;
+        build.centroids[i] = primitive_bounds[i].center();
+    }
+
+    bvh->nodes.reserve((primitive_count * 2) - 1);
+    bvh->nodes.push_back((BvhNode) {
+        .bounds = AABB::empty(),
+        .left_or_first = 0,
+        .count = primitive_count
+    });
+    bvh_update_bounds(build, 0);
+    bvh_subdivide(build, 0, 0);
+}
+
+void bvh_refit(Bvh* bvh, const AABB* primitive_bounds) {
+    // Children are always stored after their parent, so walking backwards visits them first
+    for (uint32_t node_index = (uint32_t)bvh->nodes.size(); node_index-- != 0;) {
+        BvhNode& node = bvh->nodes[node_index];
+        node.bounds = AABB::empty();
+        if (node.count != 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                node.bounds.expand(primitive_bounds[bvh->indices[node.left_or_first + i]]);
+            }
+        } else {
+            node.bounds.expand(bvh->nodes[node.left_or_first].bounds);
+            node.bounds.expand(bvh->nodes[node.left_or_first + 1].bounds);
+        }
+    }
+}
+
+void bvh_query_aabb(const Bvh& bvh, const AABB& query, std::vector<uint32_t>& results) {
+    if (bvh.nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size != 0) {
+        const BvhNode& node = bvh.nodes[stack[--stack_size]];
+        if (!node.bounds.intersects(query)) {
+            continue;
+        }
+
+        if (node.count != 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                results.push_back(bvh.indices[node.left_or_first + i]);
+            }
+        } else {
+            stack[stack_size++] = node.left_or_first;
+            stack[stack_size++] = node.left_or_first + 1;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "math/math.h"
+#include <cstdint>
+#include <vector>
+
+static const uint32_t BVH_MAX_DEPTH = 48;
+// Depth first traversal pushes at most one extra node per level
+static const uint32_t BVH_STACK_SIZE = BVH_MAX_DEPTH + 2;
+
+struct AABB {
+    vec3 min;
+    vec3 max;
+
+    inline static AABB empty() {
+        return (AABB) {
+            .min = vec3(INFINITY),
+            .max = vec3(-INFINITY)
+        };
+    }
+
+    inline void expand(const vec3& point) {
+        min = vec3(fminf(min.x, point.x), fminf(min.y, point.y), fminf(min.z, point.z));
+        max = vec3(fmaxf(max.x, point.x), fmaxf(max.y, point.y), fmaxf(max.z, point.z));
+    }
+
+    // Unions component-wise so that expanding by an empty box leaves this one unchanged
+    inline void expand(const AABB& other) {
+        min = vec3(fminf(min.x, other.min.x), fminf(min.y, other.min.y), fminf(min.z, other.min.z));
+        max = vec3(fmaxf(max.x, other.max.x), fmaxf(max.y, other.max.y), fmaxf(max.z, other.max.z));
+    }
+
+    inline AABB grown(float amount) const {
+        return (AABB) {
+            .min = min - vec3(amount),
+            .max = max + vec3(amount)
+        };
+    }
+
+    inline vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+
+    inline float surface_area() const {
+        vec3 size = max - min;
+        return 2.0f * ((size.x * size.y) + (size.y * size.z) + (size.z * size.x));
+    }
+
+    inline bool intersects(const AABB& other) const {
+        return min.x <= other.max.x && max.x >= other.min.x &&
+               min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+};
+
+// Flattened bounding volume hierarchy over static level geometry
+// Interior nodes have a count of 0 and store the index of their left child, the right child immediately follows it
+// Leaf nodes store the offset of their first primitive in the indices array
+struct BvhNode {
+    AABB bounds;
+    uint32_t left_or_first;
+    uint32_t count;
+};
+
+struct Bvh {
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> indices;
+};
+
+void bvh_build(Bvh* bvh, const AABB* primitive_bounds, uint32_t primitive_count);
+// Recomputes node bounds bottom up after primitives moved, keeping the tree layout. Much cheaper than a rebuild,
+// but the tree gets less efficient the further primitives move from where they were when it was built
+void bvh_refit(Bvh* bvh, const AABB* primitive_bounds);
+void bvh_query_aabb(const Bvh& bvh, const AABB& query, std::vector<uint32_t>& results);
\ No newline at end of file
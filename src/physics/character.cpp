@@ -0,0 +1,253 @@
+#include "character.h"
+
+static const float CHARACTER_SKIN = 0.01f;
+static const float CHARACTER_WALKABLE_SLOPE = 0.7f;
+static const uint32_t CHARACTER_MAX_SLIDES = 4;
+static const uint32_t CHARACTER_MAX_ADVANCE_ITERATIONS = 32;
+
+struct CharacterSweep {
+    const Character* character;
+    const CollisionWorld* world;
+    const Portal* portals;
+    uint32_t portal_count;
+};
+
+struct CharacterHit {
+    float time;
+    // Direction from the contact point to the capsule
+    vec3 normal;
+    // Normal of the face that was hit, facing the capsule. Used to decide what counts as ground
+    // so that standing on the rounded edge of a ledge still counts as standing on the ledge
+    vec3 surface_normal;
+};
+
+struct CharacterSlide {
+    vec3 position;
+    vec3 normals[CHARACTER_MAX_SLIDES];
+    uint32_t normal_count;
+    bool hit_ground;
+};
+
+static bool character_is_portal_pair_open(const Portal* portals, uint32_t portal_count, uint32_t portal_index) {
+    uint32_t linked_index = portal_index ^ 1;
+    return linked_index < portal_count && portals[portal_index].is_open && portals[linked_index].is_open;
+}
+
+static void character_segment(const Character& character, vec3 position, vec3* segment_start, vec3* segment_end) {
+    float half_segment = fmaxf((character.height * 0.5f) - character.radius, 0.0f);
+    *segment_start = position + (VEC3_UP * half_segment);
+    *segment_end = position + (VEC3_DOWN * half_segment);
+}
+
+static AABB character_bounds(const Character& character, vec3 position) {
+    vec3 segment_start;
+    vec3 segment_end;
+    character_segment(character, position, &segment_start, &segment_end);
+
+    AABB result = AABB::empty();
+    result.expand(segment_start);
+    result.expand(segment_end);
+    return result.grown(character.radius + CHARACTER_SKIN);
+}
+
+// The wall a portal sits on should not block the character while it is lined up with the portal opening
+static bool character_is_face_ignored(const CharacterSweep& sweep, uint32_t face_index, vec3 position) {
+    for (uint32_t portal_index = 0; portal_index < sweep.portal_count; portal_index++) {
+        const Portal& portal = sweep.portals[portal_index];
+        if (portal.wall_index != face_index || !character_is_portal_pair_open(sweep.portals, sweep.portal_count, portal_index)) {
+            continue;
+        }
+        if (portal_contains_point(portal, position, 0.0f)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Finds the time of impact of the capsule moving along displacement using conservative advancement.
+// Each step moves the capsule forward by the distance to the face divided by the displacement length,
+// which can never overshoot, so thin walls cannot be tunneled through regardless of speed
+static bool character_sweep(const CharacterSweep& sweep, vec3 start, vec3 displacement, CharacterHit* hit) {
+    static thread_local std::vector<uint32_t> candidates;
+
+    const Character& character = *sweep.character;
+    float displacement_length = displacement.length();
+    float contact_distance = character.radius + CHARACTER_SKIN;
+
+    AABB query = character_bounds(character, start);
+    query.expand(character_bounds(character, start + displacement));
+    candidates.clear();
+    collision_world_query_aabb(*sweep.world, query, candidates);
+
+    bool found = false;
+    hit->time = 1.0f;
+    for (uint32_t face_index : candidates) {
+        if (character_is_face_ignored(sweep, face_index, start)) {
+            continue;
+        }
+
+        const CollisionFace& face = sweep.world->faces[face_index];
+        float t = 0.0f;
+        for (uint32_t iteration = 0; iteration < CHARACTER_MAX_ADVANCE_ITERATIONS; iteration++) {
+            vec3 position = start + (displacement * t);
+            vec3 segment_start;
+            vec3 segment_end;
+            character_segment(character, position, &segment_start, &segment_end);
+
+            vec3 segment_point;
+            vec3 face_point;
+            float distance = collision_segment_face_distance(segment_start, segment_end, face, &segment_point, &face_point);
+            if (distance <= contact_distance) {
+                vec3 surface_normal = vec3::dot(position - face.center, face.normal) >= 0.0f ? face.normal : face.normal * -1.0f;
+                vec3 normal = distance > MATH_FLOAT_EPSILON ? (segment_point - face_point) / distance : surface_normal;
+
+                // Touching a face we are moving away from is not a hit
+                if (vec3::dot(displacement, normal) < 0.0f && t < hit->time) {
+                    hit->time = t;
+                    hit->normal = normal;
+                    hit->surface_normal = surface_normal;
+                    found = true;
+                }
+                break;
+            }
+
+            if (displacement_length <= MATH_FLOAT_EPSILON) {
+                break;
+            }
+            t += (distance - character.radius - (CHARACTER_SKIN * 0.5f)) / displacement_length;
+            if (t >= hit->time) {
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+static bool character_is_walkable(const CharacterHit& hit) {
+    return vec3::dot(hit.surface_normal, VEC3_UP) >= CHARACTER_WALKABLE_SLOPE;
+}
+
+// When walking on the ground, walls and ledge edges are treated as vertical so they can't push the character up or down
+static CharacterSlide character_slide(const CharacterSweep& sweep, vec3 position, vec3 displacement, bool is_grounded) {
+    CharacterSlide slide;
+    slide.position = position;
+    slide.normal_count = 0;
+    slide.hit_ground = false;
+
+    for (uint32_t i = 0; i < CHARACTER_MAX_SLIDES; i++) {
+        if (displacement.length() <= MATH_FLOAT_EPSILON) {
+            break;
+        }
+
+        CharacterHit hit;
+        if (!character_sweep(sweep, slide.position, displacement, &hit)) {
+            slide.position += displacement;
+            break;
+        }
+
+        slide.position += displacement * hit.time;
+        if (character_is_walkable(hit)) {
+            slide.hit_ground = true;
+        } else if (is_grounded) {
+            vec3 flattened = hit.normal - (VEC3_UP * vec3::dot(hit.normal, VEC3_UP));
+            if (flattened.length() > MATH_FLOAT_EPSILON) {
+                hit.normal = flattened.normalized();
+            }
+        }
+        slide.normals[slide.normal_count++] = hit.normal;
+
+        // Remove the part of the remaining motion that goes into the surface
+        displacement = displacement * (1.0f - hit.time);
+        displacement -= hit.normal * vec3::dot(displacement, hit.normal);
+    }
+
+    return slide;
+}
+
+static vec3 character_horizontal(vec3 v) {
+    return v - (VEC3_UP * vec3::dot(v, VEC3_UP));
+}
+
+Character character_create(vec3 position, float radius, float height, float step_height) {
+    return (Character) {
+        .position = position,
+        .velocity = vec3(0.0f),
+        .radius = radius,
+        .height = height,
+        .step_height = step_height,
+        .is_grounded = false
+    };
+}
+
+int character_move(Character* character, const CollisionWorld& world, const Portal* portals, uint32_t portal_count, float delta, mat4* teleport_matrix) {
+    CharacterSweep sweep = (CharacterSweep) {
+        .character = character,
+        .world = &world,
+        .portals = portals,
+        .portal_count = portal_count
+    };
+
+    vec3 start_position = character->position;
+    vec3 displacement = character->velocity * delta;
+    CharacterSlide result = character_slide(sweep, start_position, displacement, character->is_grounded);
+
+    // Step up: lift the capsule, move across, then put it back down. Keep whichever attempt got further horizontally
+    vec3 horizontal_displacement = character_horizontal(displacement);
+    if (character->is_grounded && result.normal_count != 0 && horizontal_displacement.length() > MATH_FLOAT_EPSILON) {
+        CharacterHit hit;
+        vec3 lift = VEC3_UP * character->step_height;
+        vec3 lifted_position = start_position + (character_sweep(sweep, start_position, lift, &hit) ? lift * hit.time : lift);
+        CharacterSlide step = character_slide(sweep, lifted_position, horizontal_displacement, false);
+
+        vec3 drop = VEC3_DOWN * (character->step_height + CHARACTER_SKIN);
+        if (character_sweep(sweep, step.position, drop, &hit) && character_is_walkable(hit)) {
+            step.position += drop * hit.time;
+            step.hit_ground = true;
+
+            float regular_distance = character_horizontal(result.position - start_position).length();
+            float step_distance = character_horizontal(step.position - start_position).length();
+            if (step_distance > regular_distance + CHARACTER_SKIN) {
+                result = step;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < result.normal_count; i++) {
+        float into_surface = vec3::dot(character->velocity, result.normals[i]);
+        if (into_surface < 0.0f) {
+            character->velocity -= result.normals[i] * into_surface;
+        }
+    }
+
+    // Probe for ground below. While grounded, probe far enough to stay glued to the floor going down steps
+    bool is_grounded = result.hit_ground;
+    if (vec3::dot(character->velocity, VEC3_UP) <= 0.0f) {
+        float probe_distance = character->is_grounded ? character->step_height : CHARACTER_SKIN * 2.0f;
+        CharacterHit hit;
+        if (character_sweep(sweep, result.position, VEC3_DOWN * probe_distance, &hit) && character_is_walkable(hit)) {
+            result.position += VEC3_DOWN * (probe_distance * hit.time);
+            is_grounded = true;
+        }
+    }
+    character->is_grounded = is_grounded;
+    character->position = result.position;
+
+    // Portal traversal
+    for (uint32_t portal_index = 0; portal_index < portal_count; portal_index++) {
+        float t;
+        if (!character_is_portal_pair_open(portals, portal_count, portal_index) ||
+            !portal_segment_crossing(portals[portal_index], start_position, character->position, &t)) {
+            continue;
+        }
+
+        *teleport_matrix = portal_pair_matrix(portals[portal_index], portals[portal_index ^ 1]);
+        character->position = teleport_matrix->transform_point(character->position);
+        character->velocity = teleport_matrix->transform_direction(character->velocity);
+        character->is_grounded = false;
+        return (int)portal_index;
+    }
+
+    return -1;
+}
\ No newline at end of file
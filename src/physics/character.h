@@ -0,0 +1,23 @@
+#pragma once
+
+#include "math/math.h"
+#include "collision.h"
+#include "portal.h"
+
+// Capsule shaped character controller. The capsule stands upright along VEC3_UP and is centered on position
+struct Character {
+    vec3 position;
+    vec3 velocity;
+    float radius;
+    float height;
+    float step_height;
+    bool is_grounded;
+};
+
+Character character_create(vec3 position, float radius, float height, float step_height);
+
+// Moves the character by its velocity over delta seconds, sliding along walls and stepping up onto ledges.
+// Portals come in pairs, portal i is linked to portal i ^ 1. If the character passes through a portal,
+// it is moved to the linked portal, teleport_matrix is set to the transform it went through and the index
+// of the entry portal is returned. Otherwise returns -1
+int character_move(Character* character, const CollisionWorld& world, const Portal* portals, uint32_t portal_count, float delta, mat4* teleport_matrix);
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "collision.h"
+
+#include "core/memory.h"
+
+CollisionFace collision_face_from_transform(const Transform& transform, bool portalable) {
+    mat4 rotation = transform.rotation.to_mat4();
+
+    CollisionFace face;
+    face.center = transform.origin;
+    face.axis_u = rotation.transform_direction(vec3(1.0f, 0.0f, 0.0f)).normalized();
+    face.axis_v = rotation.transform_direction(vec3(0.0f, 1.0f, 0.0f)).normalized();
+    face.normal = rotation.transform_direction(vec3(0.0f, 0.0f, 1.0f)).normalized();
+    face.extent_u = fabs(transform.scale.x);
+    face.extent_v = fabs(transform.scale.y);
+    face.portalable = portalable;
+
+    return face;
+}
+
+AABB collision_face_aabb(const CollisionFace& face) {
+    vec3 u = face.axis_u * face.extent_u;
+    vec3 v = face.axis_v * face.extent_v;
+
+    AABB result = AABB::empty();
+    result.expand(face.center + u + v);
+    result.expand(face.center + u - v);
+    result.expand(face.center - u + v);
+    result.expand(face.center - u - v);
+
+    return result;
+}
+
+vec3 collision_face_closest_point(const CollisionFace& face, vec3 point) {
+    vec3 offset = point - face.center;
+    float u = clampf(vec3::dot(offset, face.axis_u), -face.extent_u, face.extent_u);
+    float v = clampf(vec3::dot(offset, face.axis_v), -face.extent_v, face.extent_v);
+
+    return face.center + (face.axis_u * u) + (face.axis_v * v);
+}
+
+vec3 collision_segment_closest_point(vec3 segment_start, vec3 segment_end, vec3 point) {
+    vec3 segment = segment_end - segment_start;
+    float length_squared = vec3::dot(segment, segment);
+    if (length_squared <= MATH_FLOAT_EPSILON) {
+        return segment_start;
+    }
+
+    float t = clampf(vec3::dot(point - segment_start, segment) / length_squared, 0.0f, 1.0f);
+    return segment_start + (segment * t);
+}
+
+// Closest points between two segments, see Real-Time Collision Detection 5.1.9
+static float collision_segment_segment_distance(vec3 p1, vec3 q1, vec3 p2, vec3 q2, vec3* c1, vec3* c2) {
+    vec3 d1 = q1 - p1;
+    vec3 d2 = q2 - p2;
+    vec3 r = p1 - p2;
+    float a = vec3::dot(d1, d1);
+    float e = vec3::dot(d2, d2);
+    float f = vec3::dot(d2, r);
+    float s;
+    float t;
+
+    if (a <= MATH_FLOAT_EPSILON && e <= MATH_FLOAT_EPSILON) {
+        s = 0.0f;
+        t = 0.0f;
+    } else if (a <= MATH_FLOAT_EPSILON) {
+        s = 0.0f;
+        t = clampf(f / e, 0.0f, 1.0f);
+    } else {
+        float c = vec3::dot(d1, r);
+        if (e <= MATH_FLOAT_EPSILON) {
+            t = 0.0f;
+            s = clampf(-c / a, 0.0f, 1.0f);
+        } else {
+            float b = vec3::dot(d1, d2);
+            float denominator = (a * e) - (b * b);
+            s = denominator != 0.0f ? clampf(((b * f) - (c * e)) / denominator, 0.0f, 1.0f) : 0.0f;
+            t = ((b * s) + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = clampf(-c / a, 0.0f, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = clampf((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+
+    *c1 = p1 + (d1 * s);
+    *c2 = p2 + (d2 * t);
+    return (*c1 - *c2).length();
+}
+
+float collision_segment_face_distance(vec3 segment_start, vec3 segment_end, const CollisionFace& face, vec3* segment_point, vec3* face_point) {
+    // If the segment pierces the rectangle the distance is zero
+    float start_distance = vec3::dot(segment_start - face.center, face.normal);
+    float end_distance = vec3::dot(segment_end - face.center, face.normal);
+    if (start_distance * end_distance <= 0.0f && start_distance != end_distance) {
+        float t = start_distance / (start_distance - end_distance);
+        vec3 point = segment_start + ((segment_end - segment_start) * t);
+        vec3 offset = point - face.center;
+        if (fabs(vec3::dot(offset, face.axis_u)) <= face.extent_u && fabs(vec3::dot(offset, face.axis_v)) <= face.extent_v) {
+            *segment_point = point;
+            *face_point = point;
+            return 0.0f;
+        }
+    }
+
+    // Otherwise the closest pair is either an endpoint against the rectangle or the segment against one of its edges
+    float best_distance = INFINITY;
+    vec3 endpoints[2] = { segment_start, segment_end };
+    for (int i = 0; i < 2; i++) {
+        vec3 closest = collision_face_closest_point(face, endpoints[i]);
+        float distance = (endpoints[i] - closest).length();
+        if (distance < best_distance) {
+            best_distance = distance;
+            *segment_point = endpoints[i];
+            *face_point = closest;
+        }
+    }
+
+    vec3 u = face.axis_u * face.extent_u;
+    vec3 v = face.axis_v * face.extent_v;
+    vec3 corners[4] = { face.center - u - v, face.center + u - v, face.center + u + v, face.center - u + v };
+    for (int i = 0; i < 4; i++) {
+        vec3 on_segment;
+        vec3 on_edge;
+        float distance = collision_segment_segment_distance(segment_start, segment_end, corners[i], corners[(i + 1) % 4], &on_segment, &on_edge);
+        if (distance < best_distance) {
+            best_distance = distance;
+            *segment_point = on_segment;
+            *face_point = on_edge;
+        }
+    }
+
+    return best_distance;
+}
+
+void collision_world_build(CollisionWorld* world) {
+    std::vector<AABB> face_bounds;
+    face_bounds.reserve(world->faces.size());
+    for (const CollisionFace& face : world->faces) {
+        face_bounds.push_back(collision_face_aabb(face));
+    }
+
+    bvh_build(&world->bvh, face_bounds.data(), (uint32_t)face_bounds.size());
+}
+
+void collision_world_refit(CollisionWorld* world) {
+    AABB* face_bounds = memory_frame_alloc_array<AABB>(world->faces.size());
+    for (size_t face_index = 0; face_index < world->faces.size(); face_index++) {
+        face_bounds[face_index] = collision_face_aabb(world->faces[face_index]);
+    }
+
+    bvh_refit(&world->bvh, face_bounds);
+}
+
+void collision_world_query_aabb(const CollisionWorld& world, const AABB& query, std::vector<uint32_t>& results) {
+    bvh_query_aabb(world.bvh, query, results);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "math/math.h"
+#include "bvh.h"
+#include <vector>
+
+// A rectangular face of level geometry. Walls are unit quads in their local XY plane,
+// so a face is stored as its center, two unit axes, the half extent along each axis and its normal
+struct CollisionFace {
+    vec3 center;
+    vec3 axis_u;
+    vec3 axis_v;
+    vec3 normal;
+    float extent_u;
+    float extent_v;
+    bool portalable;
+};
+
+struct CollisionWorld {
+    std::vector<CollisionFace> faces;
+    Bvh bvh;
+};
+
+CollisionFace collision_face_from_transform(const Transform& transform, bool portalable);
+AABB collision_face_aabb(const CollisionFace& face);
+vec3 collision_face_closest_point(const CollisionFace& face, vec3 point);
+float collision_segment_face_distance(vec3 segment_start, vec3 segment_end, const CollisionFace& face, vec3* segment_point, vec3* face_point);
+vec3 collision_segment_closest_point(vec3 segment_start, vec3 segment_end, vec3 point);
+
+void collision_world_build(CollisionWorld* world);
+// Updates the BVH after faces moved. Faces can't be added or removed without a full rebuild
+void collision_world_refit(CollisionWorld* world);
+void collision_world_query_aabb(const CollisionWorld& world, const AABB& query, std::vector<uint32_t>& results);
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "hash_grid.h"
+
+#include "core/memory.h"
+#include <algorithm>
+
+static int32_t hash_grid_cell(float value, float cell_size) {
+    return (int32_t)floorf(value / cell_size);
+}
+
+static uint32_t hash_grid_hash(int32_t x, int32_t y, int32_t z, uint32_t table_mask) {
+    uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+    return hash & table_mask;
+}
+
+void hash_grid_build(HashGrid* grid, const AABB* bounds, uint32_t count, float cell_size) {
+    grid->cell_size = cell_size;
+    grid->bounds.assign(bounds, bounds + count);
+    grid->entries.clear();
+
+    // Insert the proxy into every cell its bounds touch
+    for (uint32_t proxy = 0; proxy < count; proxy++) {
+        int32_t min_x = hash_grid_cell(bounds[proxy].min.x, cell_size);
+        int32_t min_y = hash_grid_cell(bounds[proxy].min.y, cell_size);
+        int32_t min_z = hash_grid_cell(bounds[proxy].min.z, cell_size);
+        int32_t max_x = hash_grid_cell(bounds[proxy].max.x, cell_size);
+        int32_t max_y = hash_grid_cell(bounds[proxy].max.y, cell_size);
+        int32_t max_z = hash_grid_cell(bounds[proxy].max.z, cell_size);
+        for (int32_t z = min_z; z <= max_z; z++) {
+            for (int32_t y = min_y; y <= max_y; y++) {
+                for (int32_t x = min_x; x <= max_x; x++) {
+                    grid->entries.push_back((HashGridEntry) {
+                        .cell_x = x,
+                        .cell_y = y,
+                        .cell_z = z,
+                        .proxy = proxy
+                    });
+                }
+            }
+        }
+    }
+
+    uint32_t table_size = 64;
+    while (table_size < grid->entries.size() * 2) {
+        table_size *= 2;
+    }
+    uint32_t table_mask = table_size - 1;
+
+    // Counting sort the entries by bucket
+    grid->bucket_starts.assign(table_size + 1, 0);
+    for (const HashGridEntry& entry : grid->entries) {
+        grid->bucket_starts[hash_grid_hash(entry.cell_x, entry.cell_y, entry.cell_z, table_mask) + 1]++;
+    }
+    for (uint32_t bucket = 0; bucket < table_size; bucket++) {
+        grid->bucket_starts[bucket + 1] += grid->bucket_starts[bucket];
+    }
+
+    HashGridEntry* sorted = memory_frame_alloc_array<HashGridEntry>(grid->entries.size());
+    uint32_t* bucket_offsets = memory_frame_alloc_array<uint32_t>(table_size);
+    std::copy(grid->bucket_starts.begin(), grid->bucket_starts.end() - 1, bucket_offsets);
+    for (const HashGridEntry& entry : grid->entries) {
+        sorted[bucket_offsets[hash_grid_hash(entry.cell_x, entry.cell_y, entry.cell_z, table_mask)]++] = entry;
+    }
+    std::copy(sorted, sorted + grid->entries.size(), grid->entries.begin());
+
+    if (grid->query_marks.size() < count) {
+        grid->query_marks.assign(count, 0);
+        grid->query_stamp = 0;
+    }
+}
+
+void hash_grid_find_pairs(const HashGrid& grid, std::vector<HashGridPair>& pairs) {
+    size_t first_pair = pairs.size();
+    uint32_t table_size = (uint32_t)grid.bucket_starts.size() - 1;
+
+    for (uint32_t bucket = 0; bucket < table_size; bucket++) {
+        for (uint32_t i = grid.bucket_starts[bucket]; i < grid.bucket_starts[bucket + 1]; i++) {
+            const HashGridEntry& entry_a = grid.entries[i];
+            for (uint32_t j = i + 1; j < grid.bucket_starts[bucket + 1]; j++) {
+                const HashGridEntry& entry_b = grid.entries[j];
+                // Different cells can share a bucket
+                if (entry_a.cell_x != entry_b.cell_x || entry_a.cell_y != entry_b.cell_y || entry_a.cell_z != entry_b.cell_z) {
+                    continue;
+                }
+
+                const AABB& a = grid.bounds[entry_a.proxy];
+                const AABB& b = grid.bounds[entry_b.proxy];
+                if (!a.intersects(b)) {
+                    continue;
+                }
+
+                // Two proxies can share several cells, only report the pair from the cell holding the minimum corner of their overlap
+                if (hash_grid_cell(fmaxf(a.min.x, b.min.x), grid.cell_size) != entry_a.cell_x ||
+                    hash_grid_cell(fmaxf(a.min.y, b.min.y), grid.cell_size) != entry_a.cell_y ||
+                    hash_grid_cell(fmaxf(a.min.z, b.min.z), grid.cell_size) != entry_a.cell_z) {
+                    continue;
+                }
+
+                uint32_t proxy_a = entry_a.proxy < entry_b.proxy ? entry_a.proxy : entry_b.proxy;
+                uint32_t proxy_b = entry_a.proxy < entry_b.proxy ? entry_b.proxy : entry_a.proxy;
+                pairs.push_back((HashGridPair) {
+                    .a = proxy_a,
+                    .b = proxy_b
+                });
+            }
+        }
+    }
+
+    std::sort(pairs.begin() + first_pair, pairs.end(), [](const HashGridPair& a, const HashGridPair& b) {
+        return a.a != b.a ? a.a < b.a : a.b < b.b;
+    });
+}
+
+void hash_grid_query(HashGrid* grid, const AABB& query, std::vector<uint32_t>& results) {
+    if (grid->entries.empty()) {
+        return;
+    }
+
+    uint32_t table_mask = (uint32_t)grid->bucket_starts.size() - 2;
+    grid->query_stamp++;
+    if (grid->query_stamp == 0) {
+        std::fill(grid->query_marks.begin(), grid->query_marks.end(), 0);
+        grid->query_stamp = 1;
+    }
+
+    int32_t min_x = hash_grid_cell(query.min.x, grid->cell_size);
+    int32_t min_y = hash_grid_cell(query.min.y, grid->cell_size);
+    int32_t min_z = hash_grid_cell(query.min.z, grid->cell_size);
+    int32_t max_x = hash_grid_cell(query.max.x, grid->cell_size);
+    int32_t max_y = hash_grid_cell(query.max.y, grid->cell_size);
+    int32_t max_z = hash_grid_cell(query.max.z, grid->cell_size);
+    for (int32_t z = min_z; z <= max_z; z++) {
+        for (int32_t y = min_y; y <= max_y; y++) {
+            for (int32_t x = min_x; x <= max_x; x++) {
+                uint32_t bucket = hash_grid_hash(x, y, z, table_mask);
+                for (uint32_t i = grid->bucket_starts[bucket]; i < grid->bucket_starts[bucket + 1]; i++) {
+                    const HashGridEntry& entry = grid->entries[i];
+                    if (entry.cell_x != x || entry.cell_y != y || entry.cell_z != z || grid->query_marks[entry.proxy] == grid->query_stamp) {
+                        continue;
+                    }
+                    grid->query_marks[entry.proxy] = grid->query_stamp;
+                    if (grid->bounds[entry.proxy].intersects(query)) {
+                        results.push_back(entry.proxy);
+                    }
+                }
+            }
+        }
+    }
+}
\ No newline at end of file
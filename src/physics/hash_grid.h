@@ -0,0 +1,33 @@
+#pragma once
+
+#include "bvh.h"
+#include <cstdint>
+#include <vector>
+
+// Uniform grid broadphase for moving objects. Cells are hashed into a fixed size table,
+// so the grid is unbounded and its memory only depends on how many proxies are inserted
+struct HashGridEntry {
+    int32_t cell_x;
+    int32_t cell_y;
+    int32_t cell_z;
+    uint32_t proxy;
+};
+
+struct HashGridPair {
+    uint32_t a;
+    uint32_t b;
+};
+
+struct HashGrid {
+    float cell_size;
+    std::vector<uint32_t> bucket_starts;
+    std::vector<HashGridEntry> entries;
+    std::vector<AABB> bounds;
+    std::vector<uint32_t> query_marks;
+    uint32_t query_stamp;
+};
+
+void hash_grid_build(HashGrid* grid, const AABB* bounds, uint32_t count, float cell_size);
+// Reports each overlapping pair once, with a < b, ordered by a then b
+void hash_grid_find_pairs(const HashGrid& grid, std::vector<HashGridPair>& pairs);
+void hash_grid_query(HashGrid* grid, const AABB& query, std::vector<uint32_t>& results);
\ No newline at end of file
@@ -0,0 +1,1092 @@
+#include "physics.h"
+
+#include "core/job.h"
+#include "core/memory.h"
+#include <algorithm>
+
+static const float PHYSICS_AABB_MARGIN = 0.05f;
+static const float PHYSICS_CONTACT_MARGIN = 0.02f;
+static const float PHYSICS_CONTACT_HERTZ = 30.0f;
+static const float PHYSICS_CONTACT_DAMPING_RATIO = 10.0f;
+static const float PHYSICS_MAX_PUSHOUT_SPEED = 3.0f;
+static const float PHYSICS_FRICTION = 0.6f;
+static const float PHYSICS_LINEAR_DAMPING = 0.01f;
+static const float PHYSICS_ANGULAR_DAMPING = 0.05f;
+static const float PHYSICS_SLEEP_LINEAR_SPEED = 0.08f;
+static const float PHYSICS_SLEEP_ANGULAR_SPEED = 0.08f;
+static const float PHYSICS_SLEEP_TIME = 0.5f;
+static const float PHYSICS_CLIP_TOLERANCE = 0.0001f;
+static const float PHYSICS_WARM_START_DISTANCE = 0.05f;
+static const uint32_t PHYSICS_MAX_PAIR_CONTACTS = 4;
+static const uint32_t PHYSICS_MAX_STATIC_CONTACTS = 16;
+static const uint32_t PHYSICS_NARROWPHASE_GRAIN = 64;
+
+struct BoxShape {
+    vec3 center;
+    vec3 axes[3];
+    float half_extents[3];
+};
+
+static BoxShape physics_box_shape(const RigidBody& body) {
+    mat4 rotation = body.orientation.to_mat4();
+
+    BoxShape box;
+    box.center = body.position;
+    for (int axis = 0; axis < 3; axis++) {
+        box.axes[axis] = vec3(rotation[axis].x, rotation[axis].y, rotation[axis].z);
+    }
+    box.half_extents[0] = body.half_extents.x;
+    box.half_extents[1] = body.half_extents.y;
+    box.half_extents[2] = body.half_extents.z;
+
+    return box;
+}
+
+static void physics_box_vertices(const BoxShape& box, vec3 vertices[8]) {
+    for (int i = 0; i < 8; i++) {
+        vertices[i] = box.center +
+                      (box.axes[0] * ((i & 1) ? box.half_extents[0] : -box.half_extents[0])) +
+                      (box.axes[1] * ((i & 2) ? box.half_extents[1] : -box.half_extents[1])) +
+                      (box.axes[2] * ((i & 4) ? box.half_extents[2] : -box.half_extents[2]));
+    }
+}
+
+static float physics_box_projected_radius(const BoxShape& box, vec3 axis) {
+    return (box.half_extents[0] * fabs(vec3::dot(box.axes[0], axis))) +
+           (box.half_extents[1] * fabs(vec3::dot(box.axes[1], axis))) +
+           (box.half_extents[2] * fabs(vec3::dot(box.axes[2], axis)));
+}
+
+static vec3 physics_box_extent(const BoxShape& box) {
+    return vec3(physics_box_projected_radius(box, vec3(1.0f, 0.0f, 0.0f)),
+                physics_box_projected_radius(box, vec3(0.0f, 1.0f, 0.0f)),
+                physics_box_projected_radius(box, vec3(0.0f, 0.0f, 1.0f)));
+}
+
+// Bounds of the box swept along its velocity for the step, so fast bodies find their pairs before they meet
+static AABB physics_box_bounds(const BoxShape& box, vec3 velocity, float delta) {
+    vec3 extent = physics_box_extent(box);
+    AABB bounds = (AABB) {
+        .min = box.center - extent,
+        .max = box.center + extent
+    };
+    bounds.expand(bounds.min + (velocity * delta));
+    bounds.expand(bounds.max + (velocity * delta));
+
+    return bounds.grown(PHYSICS_AABB_MARGIN);
+}
+
+static BoxShape physics_ghost_shape(const PhysicsWorld* world, const PhysicsGhost& ghost) {
+    RigidBody body = world->bodies[ghost.body];
+    body.position = ghost.position;
+    body.orientation = ghost.orientation;
+    return physics_box_shape(body);
+}
+
+static uint32_t physics_clip_polygon(const vec3* input, uint32_t input_count, vec3 plane_normal, float plane_offset, vec3* output) {
+    uint32_t output_count = 0;
+    for (uint32_t i = 0; i < input_count; i++) {
+        vec3 current = input[i];
+        vec3 next = input[(i + 1) % input_count];
+        float current_distance = vec3::dot(current, plane_normal) - plane_offset;
+        float next_distance = vec3::dot(next, plane_normal) - plane_offset;
+
+        // Points within the tolerance count as on the plane, so edges lying along it don't produce duplicates
+        if (current_distance <= PHYSICS_CLIP_TOLERANCE) {
+            output[output_count++] = current;
+        }
+        if ((current_distance < -PHYSICS_CLIP_TOLERANCE && next_distance > PHYSICS_CLIP_TOLERANCE) ||
+            (current_distance > PHYSICS_CLIP_TOLERANCE && next_distance < -PHYSICS_CLIP_TOLERANCE)) {
+            float t = current_distance / (current_distance - next_distance);
+            output[output_count++] = current + ((next - current) * t);
+        }
+    }
+
+    return output_count;
+}
+
+// Reduces a contact patch to the deepest point, the point farthest from it, and the two points spanning
+// the most area on either side of the line between them. Fewer redundant contacts converge faster
+static uint32_t physics_reduce_contacts(PhysicsContact* contacts, uint32_t count, vec3 normal) {
+    if (count <= PHYSICS_MAX_PAIR_CONTACTS) {
+        return count;
+    }
+
+    uint32_t selected[4] = { 0, 0, 0, 0 };
+    for (uint32_t i = 1; i < count; i++) {
+        if (contacts[i].depth > contacts[selected[0]].depth) {
+            selected[0] = i;
+        }
+    }
+    float best_distance = -1.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        float distance = (contacts[i].point - contacts[selected[0]].point).length();
+        if (distance > best_distance) {
+            best_distance = distance;
+            selected[1] = i;
+        }
+    }
+    vec3 edge = contacts[selected[1]].point - contacts[selected[0]].point;
+    float max_area = 0.0f;
+    float min_area = 0.0f;
+    selected[2] = selected[0];
+    selected[3] = selected[1];
+    for (uint32_t i = 0; i < count; i++) {
+        float area = vec3::dot(vec3::cross(edge, contacts[i].point - contacts[selected[0]].point), normal);
+        if (area > max_area) {
+            max_area = area;
+            selected[2] = i;
+        }
+        if (area < min_area) {
+            min_area = area;
+            selected[3] = i;
+        }
+    }
+
+    PhysicsContact reduced[4];
+    uint32_t reduced_count = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        bool is_duplicate = false;
+        for (uint32_t j = 0; j < i; j++) {
+            is_duplicate = is_duplicate || selected[i] == selected[j];
+        }
+        if (!is_duplicate) {
+            reduced[reduced_count++] = contacts[selected[i]];
+        }
+    }
+    for (uint32_t i = 0; i < reduced_count; i++) {
+        contacts[i] = reduced[i];
+    }
+
+    return reduced_count;
+}
+
+// Separating axis test over the face and edge axes of both boxes. The face axis of least penetration picks
+// the reference face, and the most anti-parallel face of the other box is clipped against its side planes
+static uint32_t physics_collide_boxes(const BoxShape& a, const BoxShape& b, uint32_t index_a, uint32_t index_b, PhysicsContact* out) {
+    vec3 offset = b.center - a.center;
+    float best_overlap[2] = { INFINITY, INFINITY };
+    uint32_t best_axis[2] = { 0, 0 };
+
+    for (uint32_t i = 0; i < 6; i++) {
+        vec3 axis = i < 3 ? a.axes[i] : b.axes[i - 3];
+        float overlap = physics_box_projected_radius(a, axis) + physics_box_projected_radius(b, axis) - fabs(vec3::dot(offset, axis));
+        if (overlap < 0.0f) {
+            return 0;
+        }
+        if (overlap < best_overlap[i / 3]) {
+            best_overlap[i / 3] = overlap;
+            best_axis[i / 3] = i % 3;
+        }
+    }
+
+    for (uint32_t i = 0; i < 3; i++) {
+        for (uint32_t j = 0; j < 3; j++) {
+            vec3 axis = vec3::cross(a.axes[i], b.axes[j]);
+            float axis_length = axis.length();
+            if (axis_length < 0.0001f) {
+                continue;
+            }
+            axis = axis / axis_length;
+            float overlap = physics_box_projected_radius(a, axis) + physics_box_projected_radius(b, axis) - fabs(vec3::dot(offset, axis));
+            if (overlap < 0.0f) {
+                return 0;
+            }
+        }
+    }
+
+    // Prefer faces of a unless b is clearly better, so the reference face doesn't flip between steps
+    bool is_reference_b = best_overlap[1] < (0.95f * best_overlap[0]) - 0.001f;
+    const BoxShape& reference = is_reference_b ? b : a;
+    const BoxShape& incident = is_reference_b ? a : b;
+    uint32_t reference_axis = best_axis[is_reference_b ? 1 : 0];
+
+    // Reference face normal, facing the incident box
+    vec3 reference_normal = reference.axes[reference_axis];
+    if (vec3::dot(incident.center - reference.center, reference_normal) < 0.0f) {
+        reference_normal = reference_normal * -1.0f;
+    }
+
+    uint32_t incident_axis = 0;
+    float incident_alignment = 0.0f;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        float alignment = fabs(vec3::dot(incident.axes[axis], reference_normal));
+        if (alignment > incident_alignment) {
+            incident_alignment = alignment;
+            incident_axis = axis;
+        }
+    }
+    vec3 incident_normal = incident.axes[incident_axis];
+    if (vec3::dot(incident_normal, reference_normal) > 0.0f) {
+        incident_normal = incident_normal * -1.0f;
+    }
+
+    vec3 incident_u = incident.axes[(incident_axis + 1) % 3] * incident.half_extents[(incident_axis + 1) % 3];
+    vec3 incident_v = incident.axes[(incident_axis + 2) % 3] * incident.half_extents[(incident_axis + 2) % 3];
+    vec3 incident_center = incident.center + (incident_normal * incident.half_extents[incident_axis]);
+    vec3 polygon[8] = {
+        incident_center - incident_u - incident_v,
+        incident_center + incident_u - incident_v,
+        incident_center + incident_u + incident_v,
+        incident_center - incident_u + incident_v
+    };
+    uint32_t polygon_count = 4;
+
+    for (uint32_t side = 1; side < 3 && polygon_count != 0; side++) {
+        uint32_t side_axis = (reference_axis + side) % 3;
+        vec3 side_normal = reference.axes[side_axis];
+        float center_distance = vec3::dot(reference.center, side_normal);
+
+        vec3 clipped[8];
+        polygon_count = physics_clip_polygon(polygon, polygon_count, side_normal, center_distance + reference.half_extents[side_axis], clipped);
+        polygon_count = physics_clip_polygon(clipped, polygon_count, side_normal * -1.0f, -center_distance + reference.half_extents[side_axis], polygon);
+    }
+
+    // The contact normal always pushes a out of b
+    vec3 normal = is_reference_b ? reference_normal : reference_normal * -1.0f;
+    float reference_offset = vec3::dot(reference.center, reference_normal) + reference.half_extents[reference_axis];
+    uint32_t feature = (((is_reference_b ? 3 : 0) + reference_axis) * 3) + incident_axis;
+
+    PhysicsContact candidates[8];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < polygon_count; i++) {
+        float separation = vec3::dot(polygon[i], reference_normal) - reference_offset;
+        if (separation > PHYSICS_CONTACT_MARGIN) {
+            continue;
+        }
+
+        candidates[count].feature = feature;
+        candidates[count].point = polygon[i] - (reference_normal * (separation * 0.5f));
+        candidates[count].depth = -separation;
+        count++;
+    }
+
+    count = physics_reduce_contacts(candidates, count, normal);
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = candidates[i];
+        out[i].body_a = index_a;
+        out[i].body_b = index_b;
+        out[i].portal_b = PHYSICS_NO_PORTAL;
+        out[i].normal = normal;
+    }
+
+    return count;
+}
+
+static uint32_t physics_collide_box_face(const BoxShape& box, const CollisionFace& face, uint32_t body_index, uint32_t face_index, PhysicsContact* out, uint32_t max_count) {
+    // Faces are one sided, boxes behind them are ignored
+    if (vec3::dot(box.center - face.center, face.normal) < 0.0f) {
+        return 0;
+    }
+
+    float max_depth = 2.0f * fmaxf(box.half_extents[0], fmaxf(box.half_extents[1], box.half_extents[2]));
+    vec3 vertices[8];
+    physics_box_vertices(box, vertices);
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 8 && count < max_count; i++) {
+        vec3 offset = vertices[i] - face.center;
+        float distance = vec3::dot(offset, face.normal);
+        if (distance > PHYSICS_CONTACT_MARGIN || distance < -max_depth) {
+            continue;
+        }
+        if (fabs(vec3::dot(offset, face.axis_u)) > face.extent_u || fabs(vec3::dot(offset, face.axis_v)) > face.extent_v) {
+            continue;
+        }
+
+        out[count].body_a = body_index;
+        out[count].body_b = PHYSICS_STATIC_BODY;
+        out[count].portal_b = PHYSICS_NO_PORTAL;
+        out[count].feature = (face_index * 8) + i;
+        out[count].point = vertices[i];
+        out[count].normal = face.normal;
+        out[count].depth = -distance;
+        count++;
+    }
+
+    return count;
+}
+
+static bool physics_contact_key_less(const PhysicsContact& a, const PhysicsContact& b) {
+    if (a.body_a != b.body_a) {
+        return a.body_a < b.body_a;
+    }
+    if (a.body_b != b.body_b) {
+        return a.body_b < b.body_b;
+    }
+    return a.feature < b.feature;
+}
+
+// Clipped box contacts don't have stable vertex ids, so contacts with the same bodies and reference
+// face are matched with the closest contact point of the previous step instead
+static const PhysicsContact* physics_find_previous_contact(const std::vector<PhysicsContact>& previous_contacts, const PhysicsContact& contact) {
+    auto range = std::equal_range(previous_contacts.begin(), previous_contacts.end(), contact, physics_contact_key_less);
+    const PhysicsContact* result = NULL;
+    float best_distance = PHYSICS_WARM_START_DISTANCE;
+    for (auto it = range.first; it != range.second; it++) {
+        float distance = (it->point - contact.point).length();
+        if (distance < best_distance) {
+            best_distance = distance;
+            result = &(*it);
+        }
+    }
+
+    return result;
+}
+
+static uint32_t physics_find_island(std::vector<uint32_t>& parents, uint32_t index) {
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+static bool physics_is_portal_pair_open(const Portal* portals, uint32_t portal_count, uint32_t portal_index) {
+    uint32_t linked_index = portal_index ^ 1;
+    return linked_index < portal_count && portals[portal_index].is_open && portals[linked_index].is_open;
+}
+
+static float physics_portal_distance(const Portal& portal, vec3 point) {
+    return vec3::dot(point - portal.face.center, portal.face.normal);
+}
+
+// The wall around an open portal doesn't block anything lined up with the opening
+static bool physics_is_in_portal_opening(const PhysicsWorld* world, uint32_t face_index, vec3 point) {
+    if (face_index + 1 >= world->wall_portal_starts.size()) {
+        return false;
+    }
+    for (uint32_t i = world->wall_portal_starts[face_index]; i < world->wall_portal_starts[face_index + 1]; i++) {
+        if (portal_contains_point(world->portals[world->wall_portals[i]], point, 0.0f)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The part of a body that has gone into a portal only collides through its ghost on the other side
+static bool physics_is_behind_entered_portal(const PhysicsWorld* world, uint32_t body_index, vec3 point) {
+    auto it = std::lower_bound(world->ghosts.begin(), world->ghosts.end(), body_index, [](const PhysicsGhost& ghost, uint32_t body) {
+        return ghost.body < body;
+    });
+    for (; it != world->ghosts.end() && it->body == body_index; it++) {
+        if (physics_portal_distance(world->portals[it->portal], point) < 0.0f) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Ghosts pass the portal they come out of as exit_portal, since they only exist in front of it
+static uint32_t physics_collide_level(const PhysicsWorld* world, const BoxShape& box, const AABB& bounds, uint32_t body_index, uint32_t exit_portal, PhysicsContact* out) {
+    static thread_local std::vector<uint32_t> candidates;
+    candidates.clear();
+    collision_world_query_aabb(*world->level, bounds, candidates);
+
+    uint32_t count = 0;
+    for (uint32_t face_index : candidates) {
+        PhysicsContact face_contacts[8];
+        uint32_t face_count = physics_collide_box_face(box, world->level->faces[face_index], body_index, face_index, face_contacts, 8);
+        for (uint32_t i = 0; i < face_count && count < PHYSICS_MAX_STATIC_CONTACTS; i++) {
+            vec3 point = face_contacts[i].point;
+            bool is_hidden = exit_portal == PHYSICS_NO_PORTAL
+                                ? physics_is_behind_entered_portal(world, body_index, point)
+                                : physics_portal_distance(world->portals[exit_portal], point) < 0.0f;
+            if (is_hidden || physics_is_in_portal_opening(world, face_index, point)) {
+                continue;
+            }
+            out[count++] = face_contacts[i];
+        }
+    }
+
+    return count;
+}
+
+// Moves contacts found around a ghost back through the portal into the space of the body the ghost belongs to
+static void physics_return_ghost_contacts(const PhysicsWorld* world, const PhysicsGhost& ghost, PhysicsContact* contacts, uint32_t count, bool is_other_body_dynamic) {
+    uint32_t exit_portal = ghost.portal ^ 1;
+    const mat4& matrix = world->portal_matrices[exit_portal];
+    for (uint32_t i = 0; i < count; i++) {
+        contacts[i].point = matrix.transform_point(contacts[i].point);
+        contacts[i].normal = matrix.transform_direction(contacts[i].normal);
+        contacts[i].feature += (exit_portal + 1) << 24;
+        contacts[i].portal_b = is_other_body_dynamic ? exit_portal : PHYSICS_NO_PORTAL;
+    }
+}
+
+// Contact slots hold the level contacts of every body and then every ghost, followed by the body pairs and the ghost pairs
+static uint32_t physics_contact_slot_start(const PhysicsWorld* world, uint32_t item) {
+    uint32_t static_item_count = (uint32_t)(world->bodies.size() + world->ghosts.size());
+    if (item < static_item_count) {
+        return item * PHYSICS_MAX_STATIC_CONTACTS;
+    }
+    return (static_item_count * PHYSICS_MAX_STATIC_CONTACTS) + ((item - static_item_count) * PHYSICS_MAX_PAIR_CONTACTS);
+}
+
+static void physics_narrowphase_job(void* data, uint32_t begin, uint32_t end, uint32_t thread_index) {
+    PhysicsWorld* world = (PhysicsWorld*)data;
+    uint32_t body_count = (uint32_t)world->bodies.size();
+    uint32_t ghost_count = (uint32_t)world->ghosts.size();
+    uint32_t pair_count = (uint32_t)world->pairs.size();
+
+    // Contacts with the level come first so the solver propagates support up from the ground
+    for (uint32_t i = begin; i < end; i++) {
+        world->contact_slot_counts[i] = 0;
+        PhysicsContact* out = &world->contact_slots[physics_contact_slot_start(world, i)];
+        uint32_t count = 0;
+
+        if (i < body_count) {
+            if (world->bodies[i].is_sleeping || world->level == NULL) {
+                continue;
+            }
+            count = physics_collide_level(world, physics_box_shape(world->bodies[i]), world->body_bounds[i], i, PHYSICS_NO_PORTAL, out);
+        } else if (i < body_count + ghost_count) {
+            const PhysicsGhost& ghost = world->ghosts[i - body_count];
+            if (world->bodies[ghost.body].is_sleeping || world->level == NULL) {
+                continue;
+            }
+            count = physics_collide_level(world, physics_ghost_shape(world, ghost), ghost.bounds, ghost.body, ghost.portal ^ 1, out);
+            physics_return_ghost_contacts(world, ghost, out, count, false);
+        } else if (i < body_count + ghost_count + pair_count) {
+            const HashGridPair& pair = world->pairs[i - body_count - ghost_count];
+            if (world->bodies[pair.a].is_sleeping && world->bodies[pair.b].is_sleeping) {
+                continue;
+            }
+            uint32_t pair_contact_count = physics_collide_boxes(physics_box_shape(world->bodies[pair.a]), physics_box_shape(world->bodies[pair.b]), pair.a, pair.b, out);
+            for (uint32_t j = 0; j < pair_contact_count; j++) {
+                if (!physics_is_behind_entered_portal(world, pair.a, out[j].point) && !physics_is_behind_entered_portal(world, pair.b, out[j].point)) {
+                    out[count++] = out[j];
+                }
+            }
+        } else {
+            const HashGridPair& pair = world->ghost_pairs[i - body_count - ghost_count - pair_count];
+            const PhysicsGhost& ghost = world->ghosts[pair.a];
+            if (world->bodies[ghost.body].is_sleeping && world->bodies[pair.b].is_sleeping) {
+                continue;
+            }
+            const Portal& exit_portal = world->portals[ghost.portal ^ 1];
+            uint32_t pair_contact_count = physics_collide_boxes(physics_ghost_shape(world, ghost), physics_box_shape(world->bodies[pair.b]), ghost.body, pair.b, out);
+            for (uint32_t j = 0; j < pair_contact_count; j++) {
+                if (physics_portal_distance(exit_portal, out[j].point) >= 0.0f && !physics_is_behind_entered_portal(world, pair.b, out[j].point)) {
+                    out[count++] = out[j];
+                }
+            }
+            physics_return_ghost_contacts(world, ghost, out, count, true);
+        }
+
+        world->contact_slot_counts[i] = count;
+    }
+}
+
+// Applies an impulse along one of the contact directions. The angular parts are the inverse inertia times the
+// offset crossed with the direction, computed once per step so the solver loop doesn't touch the inertia tensors
+// Static bodies are left alone, since islands solved in parallel can share one
+static void physics_apply_impulse(PhysicsWorld* world, const PhysicsContact& contact, vec3 direction, const PhysicsContactAxis& axis, float impulse) {
+    RigidBody& a = world->bodies[contact.body_a];
+    if (a.inverse_mass != 0.0f) {
+        a.linear_velocity += direction * (impulse * a.inverse_mass);
+        a.angular_velocity += axis.angular_a * impulse;
+    }
+
+    if (contact.body_b != PHYSICS_STATIC_BODY && world->bodies[contact.body_b].inverse_mass != 0.0f) {
+        RigidBody& b = world->bodies[contact.body_b];
+        b.linear_velocity -= axis.linear_b * (impulse * b.inverse_mass);
+        b.angular_velocity -= axis.angular_b * impulse;
+    }
+}
+
+static float physics_relative_speed(const PhysicsWorld* world, const PhysicsContact& contact, vec3 direction, const PhysicsContactAxis& axis) {
+    const RigidBody& a = world->bodies[contact.body_a];
+    float speed = vec3::dot(a.linear_velocity, direction) + vec3::dot(a.angular_velocity, axis.jacobian_a);
+
+    if (contact.body_b != PHYSICS_STATIC_BODY) {
+        const RigidBody& b = world->bodies[contact.body_b];
+        speed -= vec3::dot(b.linear_velocity, axis.linear_b) + vec3::dot(b.angular_velocity, axis.jacobian_b);
+    }
+
+    return speed;
+}
+
+static vec3 physics_rotate(quat rotation, vec3 v) {
+    vec3 axis = vec3(rotation.x, rotation.y, rotation.z);
+    vec3 t = vec3::cross(axis, v) * 2.0f;
+    return v + (t * rotation.w) + vec3::cross(axis, t);
+}
+
+// Takes a direction from contact space into the space of body b
+static vec3 physics_to_body_b(const PhysicsWorld* world, const PhysicsContact& contact, vec3 direction) {
+    if (contact.portal_b == PHYSICS_NO_PORTAL) {
+        return direction;
+    }
+    return physics_rotate(world->portal_rotations[contact.portal_b].conjugate(), direction);
+}
+
+static PhysicsContactAxis physics_contact_axis(const PhysicsWorld* world, const PhysicsContact& contact, vec3 direction) {
+    PhysicsContactAxis axis;
+    axis.jacobian_a = vec3::cross(contact.offset_a, direction);
+    axis.angular_a = world->inverse_inertia_world[contact.body_a].transform_direction(axis.jacobian_a);
+    float inverse_mass = world->bodies[contact.body_a].inverse_mass + vec3::dot(axis.jacobian_a, axis.angular_a);
+
+    if (contact.body_b != PHYSICS_STATIC_BODY) {
+        axis.linear_b = physics_to_body_b(world, contact, direction);
+        axis.jacobian_b = vec3::cross(contact.offset_b, axis.linear_b);
+        axis.angular_b = world->inverse_inertia_world[contact.body_b].transform_direction(axis.jacobian_b);
+        inverse_mass += world->bodies[contact.body_b].inverse_mass + vec3::dot(axis.jacobian_b, axis.angular_b);
+    } else {
+        axis.linear_b = vec3(0.0f);
+        axis.jacobian_b = vec3(0.0f);
+        axis.angular_b = vec3(0.0f);
+    }
+    axis.mass = inverse_mass > 0.0f ? 1.0f / inverse_mass : 0.0f;
+
+    return axis;
+}
+
+static quat physics_integrate_rotation(quat rotation, vec3 angular_velocity, float delta) {
+    quat spin = quat(angular_velocity.x, angular_velocity.y, angular_velocity.z, 0.0f) * rotation;
+    return quat(rotation.x + (spin.x * 0.5f * delta),
+                rotation.y + (spin.y * 0.5f * delta),
+                rotation.z + (spin.z * 0.5f * delta),
+                rotation.w + (spin.w * 0.5f * delta)).normalized();
+}
+
+// Separation of the contact after the bodies have moved during the substeps, without running collision again
+static float physics_current_separation(const PhysicsWorld* world, const PhysicsContact& contact) {
+    vec3 motion_a = world->delta_positions[contact.body_a] + physics_rotate(world->delta_rotations[contact.body_a], contact.offset_a) - contact.offset_a;
+    float separation = vec3::dot(motion_a, contact.normal) - contact.depth;
+    if (contact.body_b != PHYSICS_STATIC_BODY) {
+        vec3 motion_b = world->delta_positions[contact.body_b] + physics_rotate(world->delta_rotations[contact.body_b], contact.offset_b) - contact.offset_b;
+        separation -= vec3::dot(motion_b, contact.normal_axis.linear_b);
+    }
+
+    return separation;
+}
+
+static void physics_solve_contacts(PhysicsWorld* world, const PhysicsIsland& island, float substep_delta, bool use_bias) {
+    const uint32_t* island_contacts = world->island_contacts.data() + island.contact_start;
+
+    // Contact softness, see Erin Catto's Solver2D soft step
+    float omega = 2.0f * MATH_PI * PHYSICS_CONTACT_HERTZ;
+    float a1 = (2.0f * PHYSICS_CONTACT_DAMPING_RATIO) + (substep_delta * omega);
+    float a2 = substep_delta * omega * a1;
+    float a3 = 1.0f / (1.0f + a2);
+    float bias_rate = omega / a1;
+
+    for (uint32_t i = 0; i < island.contact_count; i++) {
+        PhysicsContact& contact = world->contacts[island_contacts[i]];
+
+        // Non penetration. Separated contacts let the bodies close the gap, penetrating ones are pushed apart softly
+        float separation = physics_current_separation(world, contact);
+        float bias = 0.0f;
+        float mass_scale = 1.0f;
+        float impulse_scale = 0.0f;
+        if (separation > 0.0f) {
+            bias = separation / substep_delta;
+        } else if (use_bias) {
+            bias = fmaxf(bias_rate * separation, -PHYSICS_MAX_PUSHOUT_SPEED);
+            mass_scale = a2 * a3;
+            impulse_scale = a3;
+        }
+
+        float speed = physics_relative_speed(world, contact, contact.normal, contact.normal_axis);
+        float impulse = (-contact.normal_axis.mass * mass_scale * (speed + bias)) - (impulse_scale * contact.normal_impulse);
+        float previous = contact.normal_impulse;
+        contact.normal_impulse = fmaxf(previous + impulse, 0.0f);
+        physics_apply_impulse(world, contact, contact.normal, contact.normal_axis, contact.normal_impulse - previous);
+
+        // Friction, clamped to the friction cone of the current normal impulse
+        float max_friction = PHYSICS_FRICTION * contact.normal_impulse;
+        impulse = -physics_relative_speed(world, contact, contact.tangent_1, contact.tangent_axis_1) * contact.tangent_axis_1.mass;
+        previous = contact.tangent_impulse_1;
+        contact.tangent_impulse_1 = clampf(previous + impulse, -max_friction, max_friction);
+        physics_apply_impulse(world, contact, contact.tangent_1, contact.tangent_axis_1, contact.tangent_impulse_1 - previous);
+
+        impulse = -physics_relative_speed(world, contact, contact.tangent_2, contact.tangent_axis_2) * contact.tangent_axis_2.mass;
+        previous = contact.tangent_impulse_2;
+        contact.tangent_impulse_2 = clampf(previous + impulse, -max_friction, max_friction);
+        physics_apply_impulse(world, contact, contact.tangent_2, contact.tangent_axis_2, contact.tangent_impulse_2 - previous);
+    }
+}
+
+// Solves an island with substepping: each substep integrates gravity, solves the contacts with a soft
+// position bias, moves the bodies and then relaxes the contacts again without bias to remove the energy
+// the bias added. Contacts are generated once per step and their separation is updated from the body motion
+static void physics_solve_island(PhysicsWorld* world, const PhysicsIsland& island, float delta) {
+    const uint32_t* island_contacts = world->island_contacts.data() + island.contact_start;
+    const uint32_t* island_bodies = world->island_bodies.data() + island.body_start;
+    float substep_delta = delta / (float)world->substep_count;
+
+    for (uint32_t i = 0; i < island.body_count; i++) {
+        world->delta_positions[island_bodies[i]] = vec3(0.0f);
+        world->delta_rotations[island_bodies[i]] = quat();
+    }
+
+    for (uint32_t i = 0; i < island.contact_count; i++) {
+        PhysicsContact& contact = world->contacts[island_contacts[i]];
+        contact.offset_a = contact.point - world->bodies[contact.body_a].position;
+        contact.offset_b = vec3(0.0f);
+        if (contact.body_b != PHYSICS_STATIC_BODY) {
+            // Offsets of body b are kept in its own space, which is only different when it is seen through a portal
+            vec3 position_b = world->bodies[contact.body_b].position;
+            if (contact.portal_b != PHYSICS_NO_PORTAL) {
+                position_b = world->portal_matrices[contact.portal_b].transform_point(position_b);
+            }
+            contact.offset_b = physics_to_body_b(world, contact, contact.point - position_b);
+        }
+
+        vec3 reference = fabs(contact.normal.x) > 0.57f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f);
+        contact.tangent_1 = vec3::cross(contact.normal, reference).normalized();
+        contact.tangent_2 = vec3::cross(contact.normal, contact.tangent_1);
+
+        contact.normal_axis = physics_contact_axis(world, contact, contact.normal);
+        contact.tangent_axis_1 = physics_contact_axis(world, contact, contact.tangent_1);
+        contact.tangent_axis_2 = physics_contact_axis(world, contact, contact.tangent_2);
+    }
+
+    for (uint32_t substep = 0; substep < world->substep_count; substep++) {
+        for (uint32_t i = 0; i < island.body_count; i++) {
+            RigidBody& body = world->bodies[island_bodies[i]];
+            if (body.inverse_mass != 0.0f) {
+                body.linear_velocity += world->gravity * substep_delta;
+            }
+        }
+
+        // Warm start with the impulses of the previous substep, or of the previous step for the first one
+        for (uint32_t i = 0; i < island.contact_count; i++) {
+            const PhysicsContact& contact = world->contacts[island_contacts[i]];
+            physics_apply_impulse(world, contact, contact.normal, contact.normal_axis, contact.normal_impulse);
+            physics_apply_impulse(world, contact, contact.tangent_1, contact.tangent_axis_1, contact.tangent_impulse_1);
+            physics_apply_impulse(world, contact, contact.tangent_2, contact.tangent_axis_2, contact.tangent_impulse_2);
+        }
+
+        physics_solve_contacts(world, island, substep_delta, true);
+
+        for (uint32_t i = 0; i < island.body_count; i++) {
+            uint32_t body_index = island_bodies[i];
+            RigidBody& body = world->bodies[body_index];
+            if (body.inverse_mass == 0.0f) {
+                continue;
+            }
+
+            body.linear_velocity *= 1.0f / (1.0f + (substep_delta * PHYSICS_LINEAR_DAMPING));
+            body.angular_velocity *= 1.0f / (1.0f + (substep_delta * PHYSICS_ANGULAR_DAMPING));
+            body.position += body.linear_velocity * substep_delta;
+            body.orientation = physics_integrate_rotation(body.orientation, body.angular_velocity, substep_delta);
+            world->delta_positions[body_index] += body.linear_velocity * substep_delta;
+            world->delta_rotations[body_index] = physics_integrate_rotation(world->delta_rotations[body_index], body.angular_velocity, substep_delta);
+        }
+
+        physics_solve_contacts(world, island, substep_delta, false);
+    }
+
+    // Sleeping
+    float min_sleep_timer = INFINITY;
+    for (uint32_t i = 0; i < island.body_count; i++) {
+        RigidBody& body = world->bodies[island_bodies[i]];
+        if (body.inverse_mass == 0.0f) {
+            continue;
+        }
+
+        if (body.linear_velocity.length() < PHYSICS_SLEEP_LINEAR_SPEED && body.angular_velocity.length() < PHYSICS_SLEEP_ANGULAR_SPEED) {
+            body.sleep_timer += delta;
+        } else {
+            body.sleep_timer = 0.0f;
+        }
+        min_sleep_timer = fminf(min_sleep_timer, body.sleep_timer);
+    }
+
+    // The island only goes to sleep once every body in it has been resting for a while
+    if (min_sleep_timer >= PHYSICS_SLEEP_TIME) {
+        for (uint32_t i = 0; i < island.body_count; i++) {
+            RigidBody& body = world->bodies[island_bodies[i]];
+            body.is_sleeping = true;
+            body.linear_velocity = vec3(0.0f);
+            body.angular_velocity = vec3(0.0f);
+        }
+    }
+}
+
+// Either body of a contact can be static, but at least one of them is awake, and that one decides the island
+static uint32_t physics_contact_island_body(const PhysicsWorld* world, const PhysicsContact& contact) {
+    return world->bodies[contact.body_a].inverse_mass != 0.0f ? contact.body_a : contact.body_b;
+}
+
+struct PhysicsSolveJob {
+    PhysicsWorld* world;
+    float delta;
+};
+
+static void physics_solve_job(void* data, uint32_t begin, uint32_t end, uint32_t thread_index) {
+    PhysicsSolveJob* job = (PhysicsSolveJob*)data;
+    for (uint32_t i = begin; i < end; i++) {
+        physics_solve_island(job->world, job->world->islands[i], job->delta);
+    }
+}
+
+void physics_world_init(PhysicsWorld* world, const CollisionWorld* level) {
+    world->bodies.clear();
+    world->level = level;
+    world->gravity = VEC3_DOWN * 9.8f;
+    world->substep_count = 4;
+    world->portals = NULL;
+    world->portal_count = 0;
+    world->portal_matrices.clear();
+    world->portal_rotations.clear();
+    world->open_portals.clear();
+    world->wall_portal_starts.clear();
+    world->wall_portals.clear();
+    world->stats = (PhysicsStats) {};
+    world->ghosts.clear();
+    world->previous_contacts.clear();
+}
+
+uint32_t physics_add_box(PhysicsWorld* world, vec3 position, quat orientation, vec3 half_extents, float mass) {
+    RigidBody body;
+    body.position = position;
+    body.orientation = orientation;
+    body.linear_velocity = vec3(0.0f);
+    body.angular_velocity = vec3(0.0f);
+    body.half_extents = half_extents;
+    body.inverse_mass = mass > 0.0f ? 1.0f / mass : 0.0f;
+    if (mass > 0.0f) {
+        vec3 squared = vec3(half_extents.x * half_extents.x, half_extents.y * half_extents.y, half_extents.z * half_extents.z);
+        body.inverse_inertia = vec3(3.0f / (mass * (squared.y + squared.z)),
+                                    3.0f / (mass * (squared.x + squared.z)),
+                                    3.0f / (mass * (squared.x + squared.y)));
+    } else {
+        body.inverse_inertia = vec3(0.0f);
+    }
+    body.sleep_timer = 0.0f;
+    // Static bodies never move, so they stay asleep and are never part of an island
+    body.is_sleeping = mass <= 0.0f;
+
+    world->bodies.push_back(body);
+    return (uint32_t)world->bodies.size() - 1;
+}
+
+void physics_wake_body(PhysicsWorld* world, uint32_t body_index) {
+    if (world->bodies[body_index].inverse_mass == 0.0f) {
+        return;
+    }
+    world->bodies[body_index].is_sleeping = false;
+    world->bodies[body_index].sleep_timer = 0.0f;
+}
+
+void physics_set_portals(PhysicsWorld* world, const Portal* portals, uint32_t portal_count) {
+    // Anything that was going through a portal may now be up against a closed wall, or the other way around
+    for (const PhysicsGhost& ghost : world->ghosts) {
+        physics_wake_body(world, ghost.body);
+    }
+    world->ghosts.clear();
+
+    world->portals = portals;
+    world->portal_count = portal_count;
+    world->portal_matrices.resize(portal_count);
+    world->portal_rotations.resize(portal_count);
+    world->open_portals.clear();
+    for (uint32_t portal_index = 0; portal_index < portal_count; portal_index++) {
+        if (!physics_is_portal_pair_open(portals, portal_count, portal_index)) {
+            world->portal_matrices[portal_index] = mat4(1.0f);
+            world->portal_rotations[portal_index] = quat();
+            continue;
+        }
+
+        world->portal_matrices[portal_index] = portal_pair_matrix(portals[portal_index], portals[portal_index ^ 1]);
+        world->portal_rotations[portal_index] = quat::from_mat4(world->portal_matrices[portal_index]).normalized();
+        world->open_portals.push_back(portal_index);
+    }
+
+    uint32_t face_count = world->level != NULL ? (uint32_t)world->level->faces.size() : 0;
+    world->wall_portal_starts.assign(face_count + 1, 0);
+    world->wall_portals.resize(world->open_portals.size());
+    for (uint32_t portal_index : world->open_portals) {
+        world->wall_portal_starts[portals[portal_index].wall_index + 1]++;
+    }
+    for (uint32_t face_index = 0; face_index < face_count; face_index++) {
+        world->wall_portal_starts[face_index + 1] += world->wall_portal_starts[face_index];
+    }
+    uint32_t* wall_cursors = memory_frame_alloc_array<uint32_t>(face_count);
+    std::copy(world->wall_portal_starts.begin(), world->wall_portal_starts.end() - 1, wall_cursors);
+    for (uint32_t portal_index : world->open_portals) {
+        world->wall_portals[wall_cursors[portals[portal_index].wall_index]++] = portal_index;
+    }
+
+    for (uint32_t portal_index : world->open_portals) {
+        AABB portal_bounds = collision_face_aabb(portals[portal_index].face).grown(PHYSICS_AABB_MARGIN);
+        for (uint32_t body_index = 0; body_index < world->bodies.size(); body_index++) {
+            if (physics_box_bounds(physics_box_shape(world->bodies[body_index]), vec3(0.0f), 0.0f).intersects(portal_bounds)) {
+                physics_wake_body(world, body_index);
+            }
+        }
+    }
+}
+
+static void physics_teleport_body(PhysicsWorld* world, uint32_t body_index, uint32_t portal_index) {
+    const mat4& matrix = world->portal_matrices[portal_index];
+    RigidBody& body = world->bodies[body_index];
+    body.position = matrix.transform_point(body.position);
+    body.orientation = (world->portal_rotations[portal_index] * body.orientation).normalized();
+    body.linear_velocity = matrix.transform_direction(body.linear_velocity);
+    body.angular_velocity = matrix.transform_direction(body.angular_velocity);
+}
+
+void physics_step(PhysicsWorld* world, float delta) {
+    uint32_t body_count = (uint32_t)world->bodies.size();
+    world->stats = (PhysicsStats) {};
+    world->stats.body_count = body_count;
+    if (body_count == 0) {
+        return;
+    }
+
+    // Broadphase. Open portals go into the grid as extra proxies after the bodies, so the same pass finds the bodies near them
+    float cell_size = 0.0f;
+    uint32_t open_portal_count = (uint32_t)world->open_portals.size();
+    world->body_bounds.resize(body_count + open_portal_count);
+    for (uint32_t i = 0; i < body_count; i++) {
+        const RigidBody& body = world->bodies[i];
+        BoxShape box = physics_box_shape(body);
+        vec3 extent = physics_box_extent(box);
+        world->body_bounds[i] = physics_box_bounds(box, body.linear_velocity, delta);
+        cell_size = fmaxf(cell_size, 2.0f * fmaxf(extent.x, fmaxf(extent.y, extent.z)));
+    }
+    for (uint32_t i = 0; i < open_portal_count; i++) {
+        world->body_bounds[body_count + i] = collision_face_aabb(world->portals[world->open_portals[i]].face).grown(PHYSICS_AABB_MARGIN);
+    }
+    hash_grid_build(&world->grid, world->body_bounds.data(), body_count + open_portal_count, cell_size + (2.0f * PHYSICS_AABB_MARGIN));
+    world->proxy_pairs.clear();
+    hash_grid_find_pairs(world->grid, world->proxy_pairs);
+    world->pairs.clear();
+    world->portal_overlaps.clear();
+    for (const HashGridPair& pair : world->proxy_pairs) {
+        if (pair.b < body_count) {
+            world->pairs.push_back(pair);
+        } else if (pair.a < body_count) {
+            world->portal_overlaps.push_back((PhysicsPortalOverlap) {
+                .body = pair.a,
+                .portal = world->open_portals[pair.b - body_count]
+            });
+        }
+    }
+    uint32_t pair_count = (uint32_t)world->pairs.size();
+
+    // Bodies straddling a portal get a ghost on the other side. The ghost collides with whatever is over there,
+    // and its contacts are brought back through the portal and applied to the real body
+    world->ghosts.clear();
+    for (const PhysicsPortalOverlap& overlap : world->portal_overlaps) {
+        const RigidBody& body = world->bodies[overlap.body];
+        const Portal& portal = world->portals[overlap.portal];
+        BoxShape box = physics_box_shape(body);
+        float distance = physics_portal_distance(portal, body.position);
+        if (body.inverse_mass == 0.0f || fabs(distance) >= physics_box_projected_radius(box, portal.face.normal) || !portal_contains_point(portal, body.position, 0.0f)) {
+            continue;
+        }
+
+        const mat4& matrix = world->portal_matrices[overlap.portal];
+        PhysicsGhost ghost;
+        ghost.body = overlap.body;
+        ghost.portal = overlap.portal;
+        ghost.position = matrix.transform_point(body.position);
+        ghost.orientation = (world->portal_rotations[overlap.portal] * body.orientation).normalized();
+        ghost.bounds = physics_box_bounds(physics_ghost_shape(world, ghost), matrix.transform_direction(body.linear_velocity), delta);
+        world->ghosts.push_back(ghost);
+    }
+    uint32_t ghost_count = (uint32_t)world->ghosts.size();
+
+    world->ghost_pairs.clear();
+    for (uint32_t i = 0; i < ghost_count; i++) {
+        world->ghost_candidates.clear();
+        hash_grid_query(&world->grid, world->ghosts[i].bounds, world->ghost_candidates);
+        std::sort(world->ghost_candidates.begin(), world->ghost_candidates.end());
+        for (uint32_t candidate : world->ghost_candidates) {
+            if (candidate < body_count && candidate != world->ghosts[i].body) {
+                world->ghost_pairs.push_back((HashGridPair) {
+                    .a = i,
+                    .b = candidate
+                });
+            }
+        }
+    }
+    uint32_t ghost_pair_count = (uint32_t)world->ghost_pairs.size();
+
+    // Islands are found from overlapping bounds rather than contacts, so that waking spreads through
+    // an island before contacts are generated and a body woken this step still collides with the level
+    world->island_parents.resize(body_count);
+    for (uint32_t i = 0; i < body_count; i++) {
+        world->island_parents[i] = i;
+    }
+    for (uint32_t i = 0; i < pair_count + ghost_pair_count; i++) {
+        HashGridPair pair = i < pair_count ? world->pairs[i] : (HashGridPair) {
+            .a = world->ghosts[world->ghost_pairs[i - pair_count].a].body,
+            .b = world->ghost_pairs[i - pair_count].b
+        };
+        if (world->bodies[pair.a].inverse_mass == 0.0f || world->bodies[pair.b].inverse_mass == 0.0f) {
+            continue;
+        }
+        uint32_t root_a = physics_find_island(world->island_parents, pair.a);
+        uint32_t root_b = physics_find_island(world->island_parents, pair.b);
+        if (root_a != root_b) {
+            world->island_parents[root_a > root_b ? root_a : root_b] = root_a > root_b ? root_b : root_a;
+        }
+    }
+    world->island_awake.assign(body_count, 0);
+    for (uint32_t i = 0; i < body_count; i++) {
+        if (!world->bodies[i].is_sleeping) {
+            world->island_awake[physics_find_island(world->island_parents, i)] = 1;
+        }
+    }
+
+    world->inverse_inertia_world.resize(body_count);
+    world->delta_positions.resize(body_count);
+    world->delta_rotations.resize(body_count);
+    for (uint32_t i = 0; i < body_count; i++) {
+        RigidBody& body = world->bodies[i];
+        if (body.is_sleeping && world->island_awake[physics_find_island(world->island_parents, i)]) {
+            physics_wake_body(world, i);
+        }
+        // Static bodies are in contacts with awake bodies without being solved themselves, so they need these too
+        if (body.inverse_mass == 0.0f) {
+            world->delta_positions[i] = vec3(0.0f);
+            world->delta_rotations[i] = quat();
+        } else if (body.is_sleeping) {
+            continue;
+        }
+
+        mat4 rotation = body.orientation.to_mat4();
+        mat4 rotation_transposed(1.0f);
+        for (uint32_t column = 0; column < 3; column++) {
+            for (uint32_t row = 0; row < 3; row++) {
+                rotation_transposed[column][row] = rotation[row][column];
+            }
+        }
+        world->inverse_inertia_world[i] = rotation * mat4::scale(body.inverse_inertia) * rotation_transposed;
+    }
+
+    // Narrowphase. Every body, ghost and pair writes to its own fixed slots so the result does not depend on thread timing
+    uint32_t item_count = body_count + ghost_count + pair_count + ghost_pair_count;
+    uint32_t slot_count = physics_contact_slot_start(world, item_count);
+    if (world->contact_slots.size() < slot_count) {
+        world->contact_slots.resize(slot_count);
+    }
+    world->contact_slot_counts.resize(item_count);
+    job_parallel_for(item_count, PHYSICS_NARROWPHASE_GRAIN, physics_narrowphase_job, world);
+
+    world->contacts.clear();
+    for (uint32_t i = 0; i < item_count; i++) {
+        uint32_t slot_start = physics_contact_slot_start(world, i);
+        for (uint32_t j = 0; j < world->contact_slot_counts[i]; j++) {
+            PhysicsContact contact = world->contact_slots[slot_start + j];
+
+            // Warm start from the matching contact of the previous step
+            contact.normal_impulse = 0.0f;
+            contact.tangent_impulse_1 = 0.0f;
+            contact.tangent_impulse_2 = 0.0f;
+            const PhysicsContact* previous = physics_find_previous_contact(world->previous_contacts, contact);
+            if (previous != NULL) {
+                contact.normal_impulse = previous->normal_impulse;
+                contact.tangent_impulse_1 = previous->tangent_impulse_1;
+                contact.tangent_impulse_2 = previous->tangent_impulse_2;
+            }
+
+            world->contacts.push_back(contact);
+        }
+    }
+    uint32_t contact_count = (uint32_t)world->contacts.size();
+
+    // Group bodies and contacts by island
+    world->islands.clear();
+    std::vector<uint32_t>& island_index = world->island_indices;
+    island_index.assign(body_count, UINT32_MAX);
+    for (uint32_t i = 0; i < body_count; i++) {
+        uint32_t root = physics_find_island(world->island_parents, i);
+        if (world->bodies[i].is_sleeping) {
+            continue;
+        }
+        if (island_index[root] == UINT32_MAX) {
+            island_index[root] = (uint32_t)world->islands.size();
+            world->islands.push_back((PhysicsIsland) {});
+        }
+        world->islands[island_index[root]].body_count++;
+    }
+    for (uint32_t i = 0; i < contact_count; i++) {
+        world->islands[island_index[physics_find_island(world->island_parents, physics_contact_island_body(world, world->contacts[i]))]].contact_count++;
+    }
+
+    uint32_t body_offset = 0;
+    uint32_t contact_offset = 0;
+    for (PhysicsIsland& island : world->islands) {
+        island.body_start = body_offset;
+        island.contact_start = contact_offset;
+        body_offset += island.body_count;
+        contact_offset += island.contact_count;
+        island.body_count = 0;
+        island.contact_count = 0;
+    }
+    world->island_bodies.resize(body_offset);
+    world->island_contacts.resize(contact_offset);
+    for (uint32_t i = 0; i < body_count; i++) {
+        if (world->bodies[i].is_sleeping) {
+            continue;
+        }
+        PhysicsIsland& island = world->islands[island_index[physics_find_island(world->island_parents, i)]];
+        world->island_bodies[island.body_start + island.body_count++] = i;
+    }
+    for (uint32_t i = 0; i < contact_count; i++) {
+        PhysicsIsland& island = world->islands[island_index[physics_find_island(world->island_parents, physics_contact_island_body(world, world->contacts[i]))]];
+        world->island_contacts[island.contact_start + island.contact_count++] = i;
+    }
+
+    // Solve the biggest islands first so the workers finish at about the same time
+    std::sort(world->islands.begin(), world->islands.end(), [](const PhysicsIsland& a, const PhysicsIsland& b) {
+        return a.contact_count != b.contact_count ? a.contact_count > b.contact_count : a.body_start < b.body_start;
+    });
+    world->start_positions.resize(body_count);
+    for (uint32_t i = 0; i < body_count; i++) {
+        world->start_positions[i] = world->bodies[i].position;
+    }
+    PhysicsSolveJob solve_job = (PhysicsSolveJob) {
+        .world = world,
+        .delta = delta
+    };
+    job_parallel_for((uint32_t)world->islands.size(), 1, physics_solve_job, &solve_job);
+
+    // Bodies whose center went in through a portal come out of the linked one. Their ghosts are now on the side they came from
+    for (const PhysicsPortalOverlap& overlap : world->portal_overlaps) {
+        float t;
+        if (world->bodies[overlap.body].is_sleeping ||
+            !portal_segment_crossing(world->portals[overlap.portal], world->start_positions[overlap.body], world->bodies[overlap.body].position, &t)) {
+            continue;
+        }
+
+        physics_teleport_body(world, overlap.body, overlap.portal);
+        world->start_positions[overlap.body] = world->bodies[overlap.body].position;
+        for (PhysicsGhost& ghost : world->ghosts) {
+            if (ghost.body == overlap.body && ghost.portal == overlap.portal) {
+                ghost.portal = overlap.portal ^ 1;
+            }
+        }
+    }
+    for (PhysicsGhost& ghost : world->ghosts) {
+        const RigidBody& body = world->bodies[ghost.body];
+        ghost.position = world->portal_matrices[ghost.portal].transform_point(body.position);
+        ghost.orientation = (world->portal_rotations[ghost.portal] * body.orientation).normalized();
+    }
+
+    world->previous_contacts = world->contacts;
+    std::sort(world->previous_contacts.begin(), world->previous_contacts.end(), physics_contact_key_less);
+
+    // Stats
+    world->stats.pair_count = pair_count + ghost_pair_count;
+    world->stats.ghost_count = ghost_count;
+    world->stats.contact_count = contact_count;
+    world->stats.awake_island_count = (uint32_t)world->islands.size();
+    for (uint32_t i = 0; i < body_count; i++) {
+        if (world->island_parents[i] == i && world->bodies[i].inverse_mass != 0.0f) {
+            world->stats.island_count++;
+        }
+        if (!world->bodies[i].is_sleeping) {
+            world->stats.awake_body_count++;
+        }
+    }
+}
\ No newline at end of file
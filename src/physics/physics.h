@@ -0,0 +1,144 @@
+#pragma once
+
+#include "math/math.h"
+#include "collision.h"
+#include "hash_grid.h"
+#include "portal.h"
+#include <cstdint>
+#include <vector>
+
+static const uint32_t PHYSICS_STATIC_BODY = UINT32_MAX;
+static const uint32_t PHYSICS_NO_PORTAL = UINT32_MAX;
+
+struct RigidBody {
+    vec3 position;
+    quat orientation;
+    vec3 linear_velocity;
+    vec3 angular_velocity;
+
+    vec3 half_extents;
+    float inverse_mass;
+    vec3 inverse_inertia;
+
+    float sleep_timer;
+    bool is_sleeping;
+};
+
+// Jacobian of one contact direction and the effective mass along it. The parts for body b are in body b's own
+// space, which is different from the contact space when body b is seen through a portal
+struct PhysicsContactAxis {
+    vec3 linear_b;
+    vec3 jacobian_a;
+    vec3 jacobian_b;
+    vec3 angular_a;
+    vec3 angular_b;
+    float mass;
+};
+
+// Contacts always push body_a out of body_b along normal. body_b is PHYSICS_STATIC_BODY for contacts with level geometry.
+// Contacts are in body_a's space. If portal_b is set, body_b is on the other side of that portal and is seen through it
+struct PhysicsContact {
+    uint32_t body_a;
+    uint32_t body_b;
+    uint32_t portal_b;
+    uint32_t feature;
+    vec3 point;
+    vec3 normal;
+    float depth;
+
+    // Solver data
+    vec3 offset_a;
+    vec3 offset_b;
+    vec3 tangent_1;
+    vec3 tangent_2;
+    PhysicsContactAxis normal_axis;
+    PhysicsContactAxis tangent_axis_1;
+    PhysicsContactAxis tangent_axis_2;
+    float normal_impulse;
+    float tangent_impulse_1;
+    float tangent_impulse_2;
+};
+
+// A copy of a body that is partway into a portal, placed where that part comes out of the linked portal
+struct PhysicsGhost {
+    uint32_t body;
+    uint32_t portal;
+    vec3 position;
+    quat orientation;
+    AABB bounds;
+};
+
+struct PhysicsPortalOverlap {
+    uint32_t body;
+    uint32_t portal;
+};
+
+struct PhysicsIsland {
+    uint32_t body_start;
+    uint32_t body_count;
+    uint32_t contact_start;
+    uint32_t contact_count;
+};
+
+struct PhysicsStats {
+    uint32_t body_count;
+    uint32_t awake_body_count;
+    uint32_t pair_count;
+    uint32_t contact_count;
+    uint32_t island_count;
+    uint32_t awake_island_count;
+    uint32_t ghost_count;
+};
+
+struct PhysicsWorld {
+    std::vector<RigidBody> bodies;
+    const CollisionWorld* level;
+    vec3 gravity;
+    uint32_t substep_count;
+
+    // Portals are owned by the caller. Pair transforms are cached by physics_set_portals()
+    const Portal* portals;
+    uint32_t portal_count;
+    std::vector<mat4> portal_matrices;
+    std::vector<quat> portal_rotations;
+    std::vector<uint32_t> open_portals;
+    // Open portals on each level face, indexed by wall_portal_starts[face]..wall_portal_starts[face + 1]
+    std::vector<uint32_t> wall_portal_starts;
+    std::vector<uint32_t> wall_portals;
+
+    PhysicsStats stats;
+    // Bodies going through a portal this step, in body order. Rendered on the far side of the portal too
+    std::vector<PhysicsGhost> ghosts;
+
+    // Per step scratch data, kept around to avoid reallocating every step
+    HashGrid grid;
+    std::vector<AABB> body_bounds;
+    std::vector<HashGridPair> pairs;
+    std::vector<HashGridPair> proxy_pairs;
+    std::vector<PhysicsPortalOverlap> portal_overlaps;
+    std::vector<HashGridPair> ghost_pairs;
+    std::vector<uint32_t> ghost_candidates;
+    std::vector<vec3> start_positions;
+    std::vector<mat4> inverse_inertia_world;
+    std::vector<vec3> delta_positions;
+    std::vector<quat> delta_rotations;
+    std::vector<uint32_t> island_parents;
+    std::vector<uint8_t> island_awake;
+    std::vector<uint32_t> island_indices;
+    std::vector<PhysicsContact> contact_slots;
+    std::vector<uint32_t> contact_slot_counts;
+    std::vector<PhysicsContact> contacts;
+    std::vector<PhysicsContact> previous_contacts;
+    std::vector<uint32_t> island_bodies;
+    std::vector<uint32_t> island_contacts;
+    std::vector<PhysicsIsland> islands;
+};
+
+void physics_world_init(PhysicsWorld* world, const CollisionWorld* level);
+// A mass of 0 makes a static box, which other bodies collide with but which never moves
+uint32_t physics_add_box(PhysicsWorld* world, vec3 position, quat orientation, vec3 half_extents, float mass);
+void physics_wake_body(PhysicsWorld* world, uint32_t body_index);
+// Must be called again whenever a portal opens, closes or moves. Bodies near the changed portals are woken up
+void physics_set_portals(PhysicsWorld* world, const Portal* portals, uint32_t portal_count);
+// Advances the simulation by one fixed step. Islands of touching bodies are solved in parallel on the job system
+void physics_step(PhysicsWorld* world, float delta);
\ No newline at end of file
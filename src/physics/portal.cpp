@@ -0,0 +1,89 @@
+#include "portal.h"
+
+mat4 portal_frame(const Portal& portal) {
+    mat4 result(1.0f);
+    result[0] = vec4(portal.face.axis_u.x, portal.face.axis_u.y, portal.face.axis_u.z, 0.0f);
+    result[1] = vec4(portal.face.axis_v.x, portal.face.axis_v.y, portal.face.axis_v.z, 0.0f);
+    result[2] = vec4(portal.face.normal.x, portal.face.normal.y, portal.face.normal.z, 0.0f);
+    result[3] = vec4(portal.face.center.x, portal.face.center.y, portal.face.center.z, 1.0f);
+
+    return result;
+}
+
+// Maps world space in front of the from portal into world space behind the to portal.
+// Going in the front of one portal means coming out the front of the other, so the
+// local frame is turned half way around its vertical axis in between
+mat4 portal_pair_matrix(const Portal& from, const Portal& to) {
+    mat4 half_turn = mat4::scale(vec3(-1.0f, 1.0f, -1.0f));
+    return portal_frame(to) * half_turn * portal_frame(from).inverse();
+}
+
+bool portal_contains_point(const Portal& portal, vec3 point, float margin) {
+    vec3 offset = point - portal.face.center;
+    return fabs(vec3::dot(offset, portal.face.axis_u)) <= portal.face.extent_u + margin &&
+           fabs(vec3::dot(offset, portal.face.axis_v)) <= portal.face.extent_v + margin;
+}
+
+bool portal_segment_crossing(const Portal& portal, vec3 segment_start, vec3 segment_end, float* t) {
+    float start_distance = vec3::dot(segment_start - portal.face.center, portal.face.normal);
+    float end_distance = vec3::dot(segment_end - portal.face.center, portal.face.normal);
+
+    // Only crossing from the front to the back counts
+    if (start_distance < 0.0f || end_distance >= 0.0f) {
+        return false;
+    }
+
+    float crossing_t = start_distance / (start_distance - end_distance);
+    vec3 crossing_point = segment_start + ((segment_end - segment_start) * crossing_t);
+    if (!portal_contains_point(portal, crossing_point, 0.0f)) {
+        return false;
+    }
+
+    *t = crossing_t;
+    return true;
+}
+
+bool portal_place(Portal* portal, const CollisionWorld& world, uint32_t face_index, vec3 point, vec3 up, float half_width, float half_height) {
+    const CollisionFace& face = world.faces[face_index];
+    vec3 axis_v = up - (face.normal * vec3::dot(up, face.normal));
+    if (axis_v.length() <= MATH_FLOAT_EPSILON) {
+        return false;
+    }
+    axis_v = axis_v.normalized();
+    vec3 axis_u = vec3::cross(axis_v, face.normal);
+
+    // How far the portal reaches along each axis of the face, which may be rotated relative to the portal
+    float reach_u = (half_width * fabs(vec3::dot(axis_u, face.axis_u))) + (half_height * fabs(vec3::dot(axis_v, face.axis_u)));
+    float reach_v = (half_width * fabs(vec3::dot(axis_u, face.axis_v))) + (half_height * fabs(vec3::dot(axis_v, face.axis_v)));
+    if (reach_u > face.extent_u || reach_v > face.extent_v) {
+        return false;
+    }
+
+    vec3 offset = point - face.center;
+    float u = clampf(vec3::dot(offset, face.axis_u), reach_u - face.extent_u, face.extent_u - reach_u);
+    float v = clampf(vec3::dot(offset, face.axis_v), reach_v - face.extent_v, face.extent_v - reach_v);
+
+    portal->face = face;
+    portal->face.center = face.center + (face.axis_u * u) + (face.axis_v * v);
+    portal->face.axis_u = axis_u;
+    portal->face.axis_v = axis_v;
+    portal->face.extent_u = half_width;
+    portal->face.extent_v = half_height;
+    portal->wall_index = face_index;
+
+    return true;
+}
+
+bool portal_overlaps(const Portal& a, const Portal& b) {
+    vec3 offset = b.face.center - a.face.center;
+    vec3 axes[4] = { a.face.axis_u, a.face.axis_v, b.face.axis_u, b.face.axis_v };
+    for (int i = 0; i < 4; i++) {
+        float radius_a = (a.face.extent_u * fabs(vec3::dot(a.face.axis_u, axes[i]))) + (a.face.extent_v * fabs(vec3::dot(a.face.axis_v, axes[i])));
+        float radius_b = (b.face.extent_u * fabs(vec3::dot(b.face.axis_u, axes[i]))) + (b.face.extent_v * fabs(vec3::dot(b.face.axis_v, axes[i])));
+        if (fabs(vec3::dot(offset, axes[i])) >= radius_a + radius_b) {
+            return false;
+        }
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "math/math.h"
+#include "collision.h"
+
+// A portal is a rectangle placed on a wall, with its normal pointing out of the wall.
+// Things that enter through the front of a portal leave through the front of the portal it is linked to
+struct Portal {
+    CollisionFace face;
+    uint32_t wall_index;
+    bool is_open;
+};
+
+mat4 portal_frame(const Portal& portal);
+mat4 portal_pair_matrix(const Portal& from, const Portal& to);
+bool portal_contains_point(const Portal& portal, vec3 point, float margin);
+bool portal_segment_crossing(const Portal& portal, vec3 segment_start, vec3 segment_end, float* t);
+// Fits a portal onto a level face as close to point as it can go, with its top towards up projected onto the face.
+// Fails if the portal doesn't fit on the face or up is perpendicular to it. Leaves is_open alone
+bool portal_place(Portal* portal, const CollisionWorld& world, uint32_t face_index, vec3 point, vec3 up, float half_width, float half_height);
+// For portals on the same face
+bool portal_overlaps(const Portal& a, const Portal& b);
\ No newline at end of file
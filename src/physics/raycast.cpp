@@ -0,0 +1,328 @@
+#include "raycast.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #define RAYCAST_SIMD
+    #include <emmintrin.h>
+#endif
+
+static const uint32_t RAYCAST_LANE_WIDTH = 4;
+
+// Rays stored one component per array so four lanes can be loaded at once
+struct alignas(16) RaycastPacket {
+    float origin[3][RAYCAST_PACKET_SIZE];
+    float inverse_direction[3][RAYCAST_PACKET_SIZE];
+    float max_distance[RAYCAST_PACKET_SIZE];
+    uint32_t group_count;
+};
+
+struct RaycastStackEntry {
+    uint32_t node;
+    uint32_t mask;
+};
+
+static bool raycast_is_face_included(const CollisionFace& face, RaycastFilter filter) {
+    return filter == RAYCAST_FILTER_ALL || face.portalable;
+}
+
+static vec3 raycast_inverse_direction(vec3 direction) {
+    return vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+}
+
+static bool raycast_face(const CollisionFace& face, vec3 origin, vec3 direction, float max_distance, float* distance) {
+    float denominator = vec3::dot(direction, face.normal);
+    if (denominator >= 0.0f) {
+        return false;
+    }
+
+    float t = vec3::dot(face.center - origin, face.normal) / denominator;
+    if (t < 0.0f || t > max_distance) {
+        return false;
+    }
+
+    vec3 offset = origin + (direction * t) - face.center;
+    if (fabs(vec3::dot(offset, face.axis_u)) > face.extent_u || fabs(vec3::dot(offset, face.axis_v)) > face.extent_v) {
+        return false;
+    }
+
+    *distance = t;
+    return true;
+}
+
+// Plain comparisons instead of fminf() and fmaxf(), which handle NaN and end up as library calls in the inner loop
+static inline float raycast_min(float a, float b) {
+    return a < b ? a : b;
+}
+
+static inline float raycast_max(float a, float b) {
+    return a > b ? a : b;
+}
+
+// Slab test. Returns the distance at which the ray enters the box
+static bool raycast_box(const AABB& box, vec3 origin, vec3 inverse_direction, float max_distance, float* entry) {
+    float t1 = (box.min.x - origin.x) * inverse_direction.x;
+    float t2 = (box.max.x - origin.x) * inverse_direction.x;
+    float t_entry = raycast_min(t1, t2);
+    float t_exit = raycast_max(t1, t2);
+
+    t1 = (box.min.y - origin.y) * inverse_direction.y;
+    t2 = (box.max.y - origin.y) * inverse_direction.y;
+    t_entry = raycast_max(t_entry, raycast_min(t1, t2));
+    t_exit = raycast_min(t_exit, raycast_max(t1, t2));
+
+    t1 = (box.min.z - origin.z) * inverse_direction.z;
+    t2 = (box.max.z - origin.z) * inverse_direction.z;
+    t_entry = raycast_max(t_entry, raycast_min(t1, t2));
+    t_exit = raycast_min(t_exit, raycast_max(t1, t2));
+
+    *entry = raycast_max(t_entry, 0.0f);
+    return t_exit >= *entry && *entry <= max_distance;
+}
+
+static bool raycast_traverse(const CollisionWorld& world, const Ray& ray, RaycastFilter filter, bool is_any_hit, RaycastHit* hit) {
+    const Bvh& bvh = world.bvh;
+    vec3 inverse_direction = raycast_inverse_direction(ray.direction);
+    float best_distance = ray.max_distance;
+    bool found = false;
+
+    float root_entry;
+    if (bvh.nodes.empty() || !raycast_box(bvh.nodes[0].bounds, ray.origin, inverse_direction, best_distance, &root_entry)) {
+        return false;
+    }
+
+    uint32_t stack[BVH_STACK_SIZE];
+    float stack_entries[BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size] = 0;
+    stack_entries[stack_size] = root_entry;
+    stack_size++;
+
+    while (stack_size != 0) {
+        stack_size--;
+        // A closer hit may have been found since this node was pushed
+        if (stack_entries[stack_size] > best_distance) {
+            continue;
+        }
+        const BvhNode& node = bvh.nodes[stack[stack_size]];
+
+        if (node.count != 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                uint32_t face_index = bvh.indices[node.left_or_first + i];
+                const CollisionFace& face = world.faces[face_index];
+                float distance;
+                if (!raycast_is_face_included(face, filter) || !raycast_face(face, ray.origin, ray.direction, best_distance, &distance)) {
+                    continue;
+                }
+
+                found = true;
+                if (is_any_hit) {
+                    return true;
+                }
+                best_distance = distance;
+                hit->face_index = face_index;
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so that hits in it can cull the other one
+        float entries[2];
+        bool is_hit[2];
+        for (uint32_t child = 0; child < 2; child++) {
+            is_hit[child] = raycast_box(bvh.nodes[node.left_or_first + child].bounds, ray.origin, inverse_direction, best_distance, &entries[child]);
+        }
+        uint32_t near_child = entries[1] < entries[0] ? 1 : 0;
+        for (uint32_t i = 0; i < 2; i++) {
+            uint32_t child = i == 0 ? 1 - near_child : near_child;
+            if (is_hit[child]) {
+                stack[stack_size] = node.left_or_first + child;
+                stack_entries[stack_size] = entries[child];
+                stack_size++;
+            }
+        }
+    }
+
+    if (found && !is_any_hit) {
+        hit->distance = best_distance;
+        hit->point = ray.origin + (ray.direction * best_distance);
+        hit->normal = world.faces[hit->face_index].normal;
+    }
+
+    return found;
+}
+
+bool raycast_nearest(const CollisionWorld& world, const Ray& ray, RaycastFilter filter, RaycastHit* hit) {
+    return raycast_traverse(world, ray, filter, false, hit);
+}
+
+bool raycast_any(const CollisionWorld& world, const Ray& ray, RaycastFilter filter) {
+    return raycast_traverse(world, ray, filter, true, NULL);
+}
+
+static void raycast_packet_init(RaycastPacket* packet, const Ray* rays, uint32_t ray_count) {
+    packet->group_count = (ray_count + RAYCAST_LANE_WIDTH - 1) / RAYCAST_LANE_WIDTH;
+    for (uint32_t lane = 0; lane < RAYCAST_PACKET_SIZE; lane++) {
+        // Unused lanes get a negative length so they never hit anything
+        Ray ray = lane < ray_count ? rays[lane] : (Ray) {
+            .origin = vec3(0.0f),
+            .direction = vec3(1.0f, 0.0f, 0.0f),
+            .max_distance = -1.0f
+        };
+        vec3 inverse_direction = raycast_inverse_direction(ray.direction);
+
+        packet->origin[0][lane] = ray.origin.x;
+        packet->origin[1][lane] = ray.origin.y;
+        packet->origin[2][lane] = ray.origin.z;
+        packet->inverse_direction[0][lane] = inverse_direction.x;
+        packet->inverse_direction[1][lane] = inverse_direction.y;
+        packet->inverse_direction[2][lane] = inverse_direction.z;
+        packet->max_distance[lane] = ray.max_distance;
+    }
+}
+
+// Returns the mask of lanes that hit the box and the nearest distance at which any of them enter it
+static uint32_t raycast_packet_box(const RaycastPacket& packet, const AABB& box, float* nearest_entry) {
+    float box_min[3] = { box.min.x, box.min.y, box.min.z };
+    float box_max[3] = { box.max.x, box.max.y, box.max.z };
+    uint32_t mask = 0;
+
+#ifdef RAYCAST_SIMD
+    __m128 nearest = _mm_set1_ps(INFINITY);
+    for (uint32_t group = 0; group < packet.group_count; group++) {
+        uint32_t lane = group * RAYCAST_LANE_WIDTH;
+        __m128 t_entry = _mm_setzero_ps();
+        __m128 t_exit = _mm_load_ps(&packet.max_distance[lane]);
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            __m128 origin = _mm_load_ps(&packet.origin[axis][lane]);
+            __m128 inverse_direction = _mm_load_ps(&packet.inverse_direction[axis][lane]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_min[axis]), origin), inverse_direction);
+            __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_max[axis]), origin), inverse_direction);
+            t_entry = _mm_max_ps(t_entry, _mm_min_ps(t1, t2));
+            t_exit = _mm_min_ps(t_exit, _mm_max_ps(t1, t2));
+        }
+
+        __m128 is_hit = _mm_cmple_ps(t_entry, t_exit);
+        mask |= (uint32_t)_mm_movemask_ps(is_hit) << lane;
+        nearest = _mm_min_ps(nearest, _mm_or_ps(_mm_and_ps(is_hit, t_entry), _mm_andnot_ps(is_hit, _mm_set1_ps(INFINITY))));
+    }
+
+    alignas(16) float nearest_lanes[RAYCAST_LANE_WIDTH];
+    _mm_store_ps(nearest_lanes, nearest);
+    *nearest_entry = raycast_min(raycast_min(nearest_lanes[0], nearest_lanes[1]), raycast_min(nearest_lanes[2], nearest_lanes[3]));
+#else
+    *nearest_entry = INFINITY;
+    for (uint32_t lane = 0; lane < packet.group_count * RAYCAST_LANE_WIDTH; lane++) {
+        float t_entry = 0.0f;
+        float t_exit = packet.max_distance[lane];
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            float t1 = (box_min[axis] - packet.origin[axis][lane]) * packet.inverse_direction[axis][lane];
+            float t2 = (box_max[axis] - packet.origin[axis][lane]) * packet.inverse_direction[axis][lane];
+            t_entry = raycast_max(t_entry, raycast_min(t1, t2));
+            t_exit = raycast_min(t_exit, raycast_max(t1, t2));
+        }
+        if (t_entry <= t_exit) {
+            mask |= 1 << lane;
+            *nearest_entry = raycast_min(*nearest_entry, t_entry);
+        }
+    }
+#endif
+
+    return mask;
+}
+
+static uint32_t raycast_traverse_packet(const CollisionWorld& world, const Ray* rays, uint32_t ray_count, RaycastFilter filter, bool is_any_hit, RaycastHit* hits) {
+    const Bvh& bvh = world.bvh;
+    if (ray_count > RAYCAST_PACKET_SIZE) {
+        ray_count = RAYCAST_PACKET_SIZE;
+    }
+    if (bvh.nodes.empty() || ray_count == 0) {
+        return 0;
+    }
+
+    RaycastPacket packet;
+    raycast_packet_init(&packet, rays, ray_count);
+    uint32_t hit_mask = 0;
+
+    float root_entry;
+    RaycastStackEntry stack[BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = (RaycastStackEntry) {
+        .node = 0,
+        .mask = raycast_packet_box(packet, bvh.nodes[0].bounds, &root_entry)
+    };
+
+    while (stack_size != 0) {
+        RaycastStackEntry entry = stack[--stack_size];
+        // Rays that already found something are done for any hit queries
+        if (is_any_hit) {
+            entry.mask &= ~hit_mask;
+        }
+        if (entry.mask == 0) {
+            continue;
+        }
+        const BvhNode& node = bvh.nodes[entry.node];
+
+        if (node.count != 0) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                uint32_t face_index = bvh.indices[node.left_or_first + i];
+                const CollisionFace& face = world.faces[face_index];
+                if (!raycast_is_face_included(face, filter)) {
+                    continue;
+                }
+
+                for (uint32_t lane = 0; lane < ray_count; lane++) {
+                    float distance;
+                    if ((entry.mask & (1 << lane)) == 0 ||
+                        !raycast_face(face, rays[lane].origin, rays[lane].direction, packet.max_distance[lane], &distance)) {
+                        continue;
+                    }
+
+                    hit_mask |= 1 << lane;
+                    if (is_any_hit) {
+                        entry.mask &= ~(1 << lane);
+                        continue;
+                    }
+                    // Shortening the ray culls everything farther away than this hit
+                    packet.max_distance[lane] = distance;
+                    hits[lane].face_index = face_index;
+                }
+            }
+            continue;
+        }
+
+        float entries[2];
+        uint32_t masks[2];
+        for (uint32_t child = 0; child < 2; child++) {
+            masks[child] = raycast_packet_box(packet, bvh.nodes[node.left_or_first + child].bounds, &entries[child]) & entry.mask;
+        }
+        uint32_t near_child = entries[1] < entries[0] ? 1 : 0;
+        for (uint32_t i = 0; i < 2; i++) {
+            uint32_t child = i == 0 ? 1 - near_child : near_child;
+            if (masks[child] != 0) {
+                stack[stack_size++] = (RaycastStackEntry) {
+                    .node = node.left_or_first + child,
+                    .mask = masks[child]
+                };
+            }
+        }
+    }
+
+    if (!is_any_hit) {
+        for (uint32_t lane = 0; lane < ray_count; lane++) {
+            if ((hit_mask & (1 << lane)) == 0) {
+                continue;
+            }
+            hits[lane].distance = packet.max_distance[lane];
+            hits[lane].point = rays[lane].origin + (rays[lane].direction * packet.max_distance[lane]);
+            hits[lane].normal = world.faces[hits[lane].face_index].normal;
+        }
+    }
+
+    return hit_mask;
+}
+
+uint32_t raycast_nearest_packet(const CollisionWorld& world, const Ray* rays, uint32_t ray_count, RaycastFilter filter, RaycastHit* hits) {
+    return raycast_traverse_packet(world, rays, ray_count, filter, false, hits);
+}
+
+uint32_t raycast_any_packet(const CollisionWorld& world, const Ray* rays, uint32_t ray_count, RaycastFilter filter) {
+    return raycast_traverse_packet(world, rays, ray_count, filter, true, NULL);
+}
\ No newline at end of file
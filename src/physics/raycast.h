@@ -0,0 +1,35 @@
+#pragma once
+
+#include "math/math.h"
+#include "collision.h"
+#include <cstdint>
+
+static const uint32_t RAYCAST_PACKET_SIZE = 8;
+
+enum RaycastFilter {
+    RAYCAST_FILTER_ALL,
+    RAYCAST_FILTER_PORTALABLE
+};
+
+// Direction must be normalized, so distances along the ray are in world units
+struct Ray {
+    vec3 origin;
+    vec3 direction;
+    float max_distance;
+};
+
+struct RaycastHit {
+    uint32_t face_index;
+    float distance;
+    vec3 point;
+    vec3 normal;
+};
+
+// Faces are one sided, only rays coming from the front of a face hit it
+bool raycast_nearest(const CollisionWorld& world, const Ray& ray, RaycastFilter filter, RaycastHit* hit);
+bool raycast_any(const CollisionWorld& world, const Ray& ray, RaycastFilter filter);
+
+// Packets of up to RAYCAST_PACKET_SIZE rays walk the BVH together, testing each node against four rays at a time.
+// Works best for coherent rays such as line of sight checks from one place. Both return a mask of the rays that hit
+uint32_t raycast_nearest_packet(const CollisionWorld& world, const Ray* rays, uint32_t ray_count, RaycastFilter filter, RaycastHit* hits);
+uint32_t raycast_any_packet(const CollisionWorld& world, const Ray* rays, uint32_t ray_count, RaycastFilter filter);
\ No newline at end of file
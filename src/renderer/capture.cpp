@@ -0,0 +1,322 @@
+#include "capture.h"
+
+#include "core/logger.h"
+#include "profiler.h"
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t CAPTURE_BUFFER_COUNT = 3;
+static const GLuint64 CAPTURE_QUIT_TIMEOUT = 1000000000;
+// Channel difference out of 255 above which a pixel counts as changed. Leaves room for rounding differences
+static const int CAPTURE_GOLDEN_TOLERANCE = 8;
+// Share of changed pixels a frame may have and still match its golden image
+static const double CAPTURE_GOLDEN_MAX_CHANGED = 0.001;
+
+enum CaptureKind {
+    CAPTURE_KIND_SCREENSHOT,
+    CAPTURE_KIND_DUMP,
+    CAPTURE_KIND_GOLDEN
+};
+
+struct CaptureImage {
+    CaptureKind kind;
+    std::string path;
+    uint32_t width;
+    uint32_t height;
+    // RGBA with the bottom row first, as GL reads it
+    std::vector<uint8_t> pixels;
+};
+
+struct CaptureSlot {
+    uint32_t buffer;
+    size_t capacity;
+    // NULL while the slot is free
+    GLsync fence;
+    CaptureImage image;
+};
+
+struct CaptureState {
+    std::string directory;
+    uint32_t framebuffer;
+    CaptureSlot slots[CAPTURE_BUFFER_COUNT];
+
+    uint32_t frame;
+    bool is_screenshot_requested;
+    uint32_t dump_interval;
+    std::string golden_path;
+    bool is_golden_requested;
+    std::atomic<CaptureGoldenResult> golden_result;
+
+    // Encoding happens on its own thread rather than on the job system, so that it never holds up a frame's jobs
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<CaptureImage> queue;
+    bool is_running;
+};
+
+static CaptureState state;
+
+// Flips the image the right way up and drops alpha, which holds luma for FXAA rather than anything to save
+static std::vector<uint8_t> capture_get_rgb(const CaptureImage& image) {
+    std::vector<uint8_t> rgb(image.width * image.height * 3);
+    for (uint32_t y = 0; y < image.height; y++) {
+        const uint8_t* source = image.pixels.data() + ((image.height - 1 - y) * image.width * 4);
+        uint8_t* destination = rgb.data() + (y * image.width * 3);
+        for (uint32_t x = 0; x < image.width; x++) {
+            destination[(x * 3) + 0] = source[(x * 4) + 0];
+            destination[(x * 3) + 1] = source[(x * 4) + 1];
+            destination[(x * 3) + 2] = source[(x * 4) + 2];
+        }
+    }
+    return rgb;
+}
+
+static bool capture_write_png(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgb) {
+    if (!stbi_write_png(path.c_str(), width, height, 3, rgb.data(), width * 3)) {
+        log_error("Error writing capture %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static CaptureGoldenResult capture_compare_image(const CaptureImage& image, const std::vector<uint8_t>& rgb) {
+    int golden_width;
+    int golden_height;
+    int golden_components;
+    uint8_t* golden = stbi_load(image.path.c_str(), &golden_width, &golden_height, &golden_components, 3);
+    if (golden == NULL) {
+        if (!capture_write_png(image.path, image.width, image.height, rgb)) {
+            return CAPTURE_GOLDEN_FAILED;
+        }
+        log_info("No golden image at %s, saved this frame as the golden image.", image.path.c_str());
+        return CAPTURE_GOLDEN_PASSED;
+    }
+    if ((uint32_t)golden_width != image.width || (uint32_t)golden_height != image.height) {
+        log_error("Golden image %s is %ix%i but the frame is %ux%u.", image.path.c_str(), golden_width, golden_height, image.width, image.height);
+        stbi_image_free(golden);
+        return CAPTURE_GOLDEN_FAILED;
+    }
+
+    // Changed pixels are marked red over a dimmed copy of the frame
+    std::vector<uint8_t> diff(rgb.size());
+    uint32_t pixel_count = image.width * image.height;
+    uint32_t changed_count = 0;
+    int max_difference = 0;
+    for (uint32_t pixel = 0; pixel < pixel_count; pixel++) {
+        int difference = 0;
+        for (uint32_t channel = 0; channel < 3; channel++) {
+            difference = std::max(difference, abs((int)rgb[(pixel * 3) + channel] - (int)golden[(pixel * 3) + channel]));
+        }
+        max_difference = std::max(max_difference, difference);
+        bool is_changed = difference > CAPTURE_GOLDEN_TOLERANCE;
+        changed_count += is_changed ? 1 : 0;
+        for (uint32_t channel = 0; channel < 3; channel++) {
+            diff[(pixel * 3) + channel] = is_changed ? (channel == 0 ? 255 : 0) : rgb[(pixel * 3) + channel] / 4;
+        }
+    }
+    stbi_image_free(golden);
+
+    double changed_share = (double)changed_count / pixel_count;
+    bool is_match = changed_share <= CAPTURE_GOLDEN_MAX_CHANGED;
+    log_info("Golden image %s %s: %u of %u pixels changed, max channel difference %i.", image.path.c_str(),
+             is_match ? "matches" : "does not match", changed_count, pixel_count, max_difference);
+    if (changed_count != 0) {
+        std::string diff_path = image.path.substr(0, image.path.rfind('.')) + "_diff.png";
+        capture_write_png(diff_path, image.width, image.height, diff);
+    }
+    return is_match ? CAPTURE_GOLDEN_PASSED : CAPTURE_GOLDEN_FAILED;
+}
+
+static void capture_thread() {
+    while (true) {
+        CaptureImage image;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.condition.wait(lock, [] { return !state.queue.empty() || !state.is_running; });
+            if (state.queue.empty()) {
+                return;
+            }
+            image = std::move(state.queue.front());
+            state.queue.pop_front();
+        }
+
+        std::vector<uint8_t> rgb = capture_get_rgb(image);
+        if (image.kind == CAPTURE_KIND_GOLDEN) {
+            state.golden_result = capture_compare_image(image, rgb);
+        } else if (capture_write_png(image.path, image.width, image.height, rgb) && image.kind == CAPTURE_KIND_SCREENSHOT) {
+            log_info("Saved screenshot %s", image.path.c_str());
+        }
+    }
+}
+
+// Copies a finished readback out of its buffer and hands it to the worker, freeing the slot
+static void capture_finish_slot(CaptureSlot& slot) {
+    CaptureImage& image = slot.image;
+    size_t size = image.width * image.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const uint8_t* data = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data != NULL) {
+        image.pixels.assign(data, data + size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteSync(slot.fence);
+    slot.fence = NULL;
+
+    if (data == NULL) {
+        log_error("Error mapping capture buffer.");
+        if (image.kind == CAPTURE_KIND_GOLDEN) {
+            state.golden_result = CAPTURE_GOLDEN_FAILED;
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.queue.push_back(std::move(image));
+    }
+    state.condition.notify_one();
+}
+
+void capture_init(const char* directory) {
+    state.directory = directory;
+    std::error_code error;
+    std::filesystem::create_directories(state.directory, error);
+    if (error) {
+        log_warn("Could not create capture directory %s: %s", state.directory.c_str(), error.message().c_str());
+    }
+
+    glGenFramebuffers(1, &state.framebuffer);
+    for (CaptureSlot& slot : state.slots) {
+        glGenBuffers(1, &slot.buffer);
+        slot.capacity = 0;
+        slot.fence = NULL;
+    }
+    state.frame = 0;
+    state.is_screenshot_requested = false;
+    state.dump_interval = 0;
+    state.is_golden_requested = false;
+    state.golden_result = CAPTURE_GOLDEN_NONE;
+
+    state.is_running = true;
+    state.thread = std::thread(capture_thread);
+}
+
+void capture_quit() {
+    for (CaptureSlot& slot : state.slots) {
+        if (slot.fence == NULL) {
+            continue;
+        }
+        GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, CAPTURE_QUIT_TIMEOUT);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            capture_finish_slot(slot);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.is_running = false;
+    }
+    state.condition.notify_one();
+    state.thread.join();
+}
+
+void capture_screenshot() {
+    state.is_screenshot_requested = true;
+}
+
+void capture_set_dump_interval(uint32_t interval) {
+    state.dump_interval = interval;
+}
+
+uint32_t capture_get_dump_interval() {
+    return state.dump_interval;
+}
+
+void capture_compare_golden(const char* golden_path) {
+    state.golden_path = golden_path;
+    state.is_golden_requested = true;
+    state.golden_result = CAPTURE_GOLDEN_PENDING;
+}
+
+CaptureGoldenResult capture_get_golden_result() {
+    return state.golden_result;
+}
+
+void capture_frame(uint32_t texture, ivec2 size) {
+    // Never waits, readbacks that aren't done yet are checked again next frame
+    for (CaptureSlot& slot : state.slots) {
+        if (slot.fence == NULL) {
+            continue;
+        }
+        GLenum result = glClientWaitSync(slot.fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            capture_finish_slot(slot);
+        }
+    }
+
+    uint32_t frame = state.frame++;
+    CaptureKind kind;
+    char name[64];
+    if (state.is_golden_requested) {
+        kind = CAPTURE_KIND_GOLDEN;
+    } else if (state.is_screenshot_requested) {
+        kind = CAPTURE_KIND_SCREENSHOT;
+        snprintf(name, sizeof(name), "screenshot_%06u.png", frame);
+    } else if (state.dump_interval != 0 && frame % state.dump_interval == 0) {
+        kind = CAPTURE_KIND_DUMP;
+        snprintf(name, sizeof(name), "frame_%06u.png", frame);
+    } else {
+        return;
+    }
+
+    CaptureSlot* free_slot = NULL;
+    for (CaptureSlot& slot : state.slots) {
+        if (slot.fence == NULL) {
+            free_slot = &slot;
+            break;
+        }
+    }
+    // Requested captures try again next frame, dumped frames are just left out of the sequence
+    if (free_slot == NULL) {
+        profiler_count("capture skipped", 1.0);
+        return;
+    }
+    if (kind == CAPTURE_KIND_GOLDEN) {
+        state.is_golden_requested = false;
+    } else if (kind == CAPTURE_KIND_SCREENSHOT) {
+        state.is_screenshot_requested = false;
+    }
+
+    CaptureSlot& slot = *free_slot;
+    size_t buffer_size = size.x * size.y * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < buffer_size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, buffer_size, NULL, GL_STREAM_READ);
+        slot.capacity = buffer_size;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, state.framebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    // With a pack buffer bound this only queues the copy, the pointer is an offset into the buffer
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    slot.image.kind = kind;
+    slot.image.path = kind == CAPTURE_KIND_GOLDEN ? state.golden_path : state.directory + name;
+    slot.image.width = size.x;
+    slot.image.height = size.y;
+    profiler_count("captured frames", 1.0);
+}
\ No newline at end of file
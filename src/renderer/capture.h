@@ -0,0 +1,30 @@
+#pragma once
+
+#include "math/math.h"
+#include <cstdint>
+
+enum CaptureGoldenResult {
+    CAPTURE_GOLDEN_NONE,
+    CAPTURE_GOLDEN_PENDING,
+    CAPTURE_GOLDEN_PASSED,
+    CAPTURE_GOLDEN_FAILED
+};
+
+// Saves frames as PNGs without stalling the GPU. A captured frame is read into one of a ring of pixel pack buffers
+// and only mapped once its fence has signaled, usually a frame or two later, then encoded on a worker thread. When
+// every buffer is still in flight a dumped frame is skipped rather than waited on
+void capture_init(const char* directory);
+// Waits for the captures in flight and finishes writing them
+void capture_quit();
+// Saves the next frame
+void capture_screenshot();
+// Saves every nth frame as a numbered sequence, 0 stops
+void capture_set_dump_interval(uint32_t interval);
+uint32_t capture_get_dump_interval();
+// Compares the next frame against a golden image, writing an image of the differences next to it when they don't
+// match. A missing golden image is written from the frame instead. Meant for runs on a software GL driver, which
+// renders the same everywhere
+void capture_compare_golden(const char* golden_path);
+CaptureGoldenResult capture_get_golden_result();
+// Called once per frame with the finished image, which fills the bottom left size pixels of the texture
+void capture_frame(uint32_t texture, ivec2 size);
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "depth_raster.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #define DEPTH_RASTER_SIMD
+    #include <emmintrin.h>
+#endif
+
+static const uint32_t DEPTH_RASTER_LANE_WIDTH = 4;
+static const uint32_t DEPTH_RASTER_MAX_CLIPPED_VERTICES = 5;
+static const float DEPTH_RASTER_MIN_AREA = 1e-6f;
+// Relative amount a box's nearest depth is moved toward the camera before testing it. 1 / w interpolated across
+// an occluder can round to just in front of the occluder's own corners, and a wall would cull itself
+static const float DEPTH_RASTER_OCCLUSION_BIAS = 1e-4f;
+
+// Plain comparisons instead of fminf() and fmaxf(), which handle NaN and end up as library calls in the inner loop
+static inline float depth_raster_min(float a, float b) {
+    return a < b ? a : b;
+}
+
+static inline float depth_raster_max(float a, float b) {
+    return a > b ? a : b;
+}
+
+// Edge function a * x + b * y + c, positive on the inside of the edge
+struct DepthRasterEdge {
+    float a;
+    float b;
+    float c;
+};
+
+static DepthRasterEdge depth_raster_edge(vec3 from, vec3 to) {
+    DepthRasterEdge edge;
+    edge.a = from.y - to.y;
+    edge.b = to.x - from.x;
+    edge.c = -((edge.a * from.x) + (edge.b * from.y));
+    return edge;
+}
+
+// Draws a convex polygon in one go, so there are no cracks along the diagonals a triangle fan would have.
+// Vertices are in pixels with z holding 1 / w
+static void depth_raster_polygon(DepthRaster* raster, const vec3* vertices, uint32_t vertex_count, int row_begin, int row_end) {
+    // Twice the signed area. The depth plane comes from the largest triangle of the fan for precision
+    float area = 0.0f;
+    float plane_area = 0.0f;
+    uint32_t plane_vertex = 2;
+    for (uint32_t i = 2; i < vertex_count; i++) {
+        float triangle_area = ((vertices[i - 1].x - vertices[0].x) * (vertices[i].y - vertices[0].y)) - ((vertices[i - 1].y - vertices[0].y) * (vertices[i].x - vertices[0].x));
+        area += triangle_area;
+        if (fabsf(triangle_area) > fabsf(plane_area)) {
+            plane_area = triangle_area;
+            plane_vertex = i;
+        }
+    }
+    if (fabsf(area) < DEPTH_RASTER_MIN_AREA) {
+        return;
+    }
+    float winding = area > 0.0f ? 1.0f : -1.0f;
+
+    float min_x = vertices[0].x;
+    float max_x = vertices[0].x;
+    float min_y = vertices[0].y;
+    float max_y = vertices[0].y;
+    DepthRasterEdge edges[DEPTH_RASTER_MAX_CLIPPED_VERTICES];
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        min_x = depth_raster_min(min_x, vertices[i].x);
+        max_x = depth_raster_max(max_x, vertices[i].x);
+        min_y = depth_raster_min(min_y, vertices[i].y);
+        max_y = depth_raster_max(max_y, vertices[i].y);
+
+        DepthRasterEdge edge = depth_raster_edge(vertices[i], vertices[(i + 1) % vertex_count]);
+        edges[i] = (DepthRasterEdge) {
+            .a = edge.a * winding,
+            .b = edge.b * winding,
+            .c = edge.c * winding
+        };
+    }
+    int pixel_min_x = min_x < 0.0f ? 0 : (int)min_x;
+    int pixel_max_x = max_x > (float)(raster->width - 1) ? (int)raster->width - 1 : (int)max_x;
+    int pixel_min_y = min_y < (float)row_begin ? row_begin : (int)min_y;
+    int pixel_max_y = max_y > (float)(row_end - 1) ? row_end - 1 : (int)max_y;
+    if (pixel_min_x > pixel_max_x || pixel_min_y > pixel_max_y) {
+        return;
+    }
+
+    // Depth from the barycentric weights of the plane triangle, each weight being the opposite edge over the area
+    const vec3& v0 = vertices[0];
+    const vec3& v1 = vertices[plane_vertex - 1];
+    const vec3& v2 = vertices[plane_vertex];
+    DepthRasterEdge edge_0 = depth_raster_edge(v1, v2);
+    DepthRasterEdge edge_1 = depth_raster_edge(v2, v0);
+    DepthRasterEdge edge_2 = depth_raster_edge(v0, v1);
+    float inverse_area = 1.0f / plane_area;
+    DepthRasterEdge depth_plane;
+    depth_plane.a = ((edge_0.a * v0.z) + (edge_1.a * v1.z) + (edge_2.a * v2.z)) * inverse_area;
+    depth_plane.b = ((edge_0.b * v0.z) + (edge_1.b * v1.z) + (edge_2.b * v2.z)) * inverse_area;
+    depth_plane.c = ((edge_0.c * v0.z) + (edge_1.c * v1.z) + (edge_2.c * v2.z)) * inverse_area;
+
+    // Rows are padded to the lane width, so whole groups of four never run off the end of a row.
+    // Pixels of a group outside the polygon's bounds still fail the edge tests
+    int start_x = pixel_min_x & ~(int)(DEPTH_RASTER_LANE_WIDTH - 1);
+#ifdef DEPTH_RASTER_SIMD
+    __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 all_inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128 edge_steps[DEPTH_RASTER_MAX_CLIPPED_VERTICES];
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        edge_steps[i] = _mm_set1_ps(edges[i].a);
+    }
+    __m128 depth_step = _mm_set1_ps(depth_plane.a);
+#endif
+    for (int y = pixel_min_y; y <= pixel_max_y; y++) {
+        float pixel_y = (float)y + 0.5f;
+        float* row = raster->depth.data() + (y * raster->width);
+        float row_edges[DEPTH_RASTER_MAX_CLIPPED_VERTICES];
+        for (uint32_t i = 0; i < vertex_count; i++) {
+            row_edges[i] = (edges[i].b * pixel_y) + edges[i].c;
+        }
+        float row_depth = (depth_plane.b * pixel_y) + depth_plane.c;
+
+    #ifdef DEPTH_RASTER_SIMD
+        __m128 row_edge_values[DEPTH_RASTER_MAX_CLIPPED_VERTICES];
+        for (uint32_t i = 0; i < vertex_count; i++) {
+            row_edge_values[i] = _mm_set1_ps(row_edges[i]);
+        }
+        __m128 row_depth_value = _mm_set1_ps(row_depth);
+        for (int x = start_x; x <= pixel_max_x; x += DEPTH_RASTER_LANE_WIDTH) {
+            __m128 pixel_x = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+            __m128 inside = all_inside;
+            for (uint32_t i = 0; i < vertex_count; i++) {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(edge_steps[i], pixel_x), row_edge_values[i]);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+            }
+            __m128 depth = _mm_add_ps(_mm_mul_ps(depth_step, pixel_x), row_depth_value);
+            // Stored depth is never negative, so masked out lanes of 0 leave it unchanged
+            __m128 stored = _mm_loadu_ps(row + x);
+            _mm_storeu_ps(row + x, _mm_max_ps(stored, _mm_and_ps(inside, depth)));
+        }
+    #else
+        for (int x = start_x; x <= pixel_max_x; x++) {
+            float pixel_x = (float)x + 0.5f;
+            bool is_inside = true;
+            for (uint32_t i = 0; i < vertex_count; i++) {
+                is_inside = is_inside && (edges[i].a * pixel_x) + row_edges[i] >= 0.0f;
+            }
+            if (is_inside) {
+                row[x] = depth_raster_max(row[x], (depth_plane.a * pixel_x) + row_depth);
+            }
+        }
+    #endif
+    }
+}
+
+static void depth_raster_quad(DepthRaster* raster, const DepthRasterQuad& quad, int row_begin, int row_end) {
+    if (vec3::dot(quad.normal, raster->view_position - quad.corners[0]) <= 0.0f) {
+        return;
+    }
+
+    vec4 clip[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        clip[i] = raster->view_projection * vec4(quad.corners[i].x, quad.corners[i].y, quad.corners[i].z, 1.0f);
+    }
+
+    // Clip against the near plane, w = near_plane in clip space. Everything else is handled by the pixel bounds
+    vec4 clipped[DEPTH_RASTER_MAX_CLIPPED_VERTICES];
+    uint32_t clipped_count = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        const vec4& current = clip[i];
+        const vec4& next = clip[(i + 1) % 4];
+        bool is_current_inside = current.w >= raster->near_plane;
+        bool is_next_inside = next.w >= raster->near_plane;
+        if (is_current_inside) {
+            clipped[clipped_count++] = current;
+        }
+        if (is_current_inside != is_next_inside) {
+            float t = (raster->near_plane - current.w) / (next.w - current.w);
+            clipped[clipped_count++] = current + ((next - current) * t);
+        }
+    }
+    if (clipped_count < 3) {
+        return;
+    }
+
+    vec3 screen[DEPTH_RASTER_MAX_CLIPPED_VERTICES];
+    for (uint32_t i = 0; i < clipped_count; i++) {
+        float inverse_w = 1.0f / clipped[i].w;
+        screen[i] = vec3(((clipped[i].x * inverse_w * 0.5f) + 0.5f) * raster->width,
+                         ((clipped[i].y * inverse_w * 0.5f) + 0.5f) * raster->height,
+                         inverse_w);
+    }
+    depth_raster_polygon(raster, screen, clipped_count, row_begin, row_end);
+}
+
+void depth_raster_init(DepthRaster* raster, uint32_t width, uint32_t height, float near_plane) {
+    raster->width = (width + DEPTH_RASTER_LANE_WIDTH - 1) & ~(DEPTH_RASTER_LANE_WIDTH - 1);
+    raster->height = height;
+    raster->near_plane = near_plane;
+    raster->view_projection = mat4(1.0f);
+    raster->view_position = vec3(0.0f);
+
+    uint32_t offset = 0;
+    uint32_t level_width = raster->width;
+    uint32_t level_height = raster->height;
+    raster->level_count = 0;
+    while (raster->level_count < DEPTH_RASTER_MAX_LEVELS) {
+        raster->levels[raster->level_count++] = (DepthRasterLevel) {
+            .width = level_width,
+            .height = level_height,
+            .offset = offset
+        };
+        offset += level_width * level_height;
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+        level_width = (level_width + 1) / 2;
+        level_height = (level_height + 1) / 2;
+    }
+    raster->depth.assign(offset, 0.0f);
+}
+
+uint32_t depth_raster_get_band_count(const DepthRaster& raster) {
+    return (raster.height + DEPTH_RASTER_BAND_HEIGHT - 1) / DEPTH_RASTER_BAND_HEIGHT;
+}
+
+void depth_raster_set_camera(DepthRaster* raster, const mat4& view_projection, vec3 view_position) {
+    raster->view_projection = view_projection;
+    raster->view_position = view_position;
+}
+
+void depth_raster_render_band(DepthRaster* raster, const DepthRasterQuad* quads, uint32_t quad_count, uint32_t band) {
+    int row_begin = (int)(band * DEPTH_RASTER_BAND_HEIGHT);
+    int row_end = row_begin + (int)DEPTH_RASTER_BAND_HEIGHT;
+    row_end = row_end > (int)raster->height ? (int)raster->height : row_end;
+
+    std::fill(raster->depth.begin() + (row_begin * raster->width), raster->depth.begin() + (row_end * raster->width), 0.0f);
+    for (uint32_t quad_index = 0; quad_index < quad_count; quad_index++) {
+        depth_raster_quad(raster, quads[quad_index], row_begin, row_end);
+    }
+}
+
+void depth_raster_render(DepthRaster* raster, const DepthRasterQuad* quads, uint32_t quad_count) {
+    uint32_t band_count = depth_raster_get_band_count(*raster);
+    for (uint32_t band = 0; band < band_count; band++) {
+        depth_raster_render_band(raster, quads, quad_count, band);
+    }
+    depth_raster_build_hiz(raster);
+}
+
+void depth_raster_build_hiz(DepthRaster* raster) {
+    for (uint32_t level_index = 1; level_index < raster->level_count; level_index++) {
+        const DepthRasterLevel& source = raster->levels[level_index - 1];
+        const DepthRasterLevel& level = raster->levels[level_index];
+        const float* source_depth = raster->depth.data() + source.offset;
+        float* level_depth = raster->depth.data() + level.offset;
+        for (uint32_t y = 0; y < level.height; y++) {
+            uint32_t source_y_0 = y * 2;
+            uint32_t source_y_1 = source_y_0 + 1 < source.height ? source_y_0 + 1 : source_y_0;
+            for (uint32_t x = 0; x < level.width; x++) {
+                uint32_t source_x_0 = x * 2;
+                uint32_t source_x_1 = source_x_0 + 1 < source.width ? source_x_0 + 1 : source_x_0;
+                float furthest = depth_raster_min(
+                    depth_raster_min(source_depth[(source_y_0 * source.width) + source_x_0], source_depth[(source_y_0 * source.width) + source_x_1]),
+                    depth_raster_min(source_depth[(source_y_1 * source.width) + source_x_0], source_depth[(source_y_1 * source.width) + source_x_1]));
+                level_depth[(y * level.width) + x] = furthest;
+            }
+        }
+    }
+}
+
+bool depth_raster_is_occluded(const DepthRaster& raster, const AABB& bounds) {
+    float min_x = INFINITY;
+    float min_y = INFINITY;
+    float max_x = -INFINITY;
+    float max_y = -INFINITY;
+    float nearest = 0.0f;
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        vec3 point = vec3(corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y, corner & 4 ? bounds.max.z : bounds.min.z);
+        vec4 clip = raster.view_projection * vec4(point.x, point.y, point.z, 1.0f);
+        if (clip.w < raster.near_plane) {
+            return false;
+        }
+        float inverse_w = 1.0f / clip.w;
+        float screen_x = ((clip.x * inverse_w * 0.5f) + 0.5f) * raster.width;
+        float screen_y = ((clip.y * inverse_w * 0.5f) + 0.5f) * raster.height;
+        min_x = depth_raster_min(min_x, screen_x);
+        min_y = depth_raster_min(min_y, screen_y);
+        max_x = depth_raster_max(max_x, screen_x);
+        max_y = depth_raster_max(max_y, screen_y);
+        nearest = depth_raster_max(nearest, inverse_w);
+    }
+
+    int pixel_min_x = min_x < 0.0f ? 0 : (int)min_x;
+    int pixel_min_y = min_y < 0.0f ? 0 : (int)min_y;
+    int pixel_max_x = max_x > (float)(raster.width - 1) ? (int)raster.width - 1 : (int)max_x;
+    int pixel_max_y = max_y > (float)(raster.height - 1) ? (int)raster.height - 1 : (int)max_y;
+    if (pixel_min_x > pixel_max_x || pixel_min_y > pixel_max_y) {
+        return false;
+    }
+
+    // Go up the levels until the box covers at most 2x2 texels
+    uint32_t level_index = 0;
+    while (level_index + 1 < raster.level_count &&
+           (((pixel_max_x >> level_index) - (pixel_min_x >> level_index)) > 1 || ((pixel_max_y >> level_index) - (pixel_min_y >> level_index)) > 1)) {
+        level_index++;
+    }
+
+    nearest *= 1.0f + DEPTH_RASTER_OCCLUSION_BIAS;
+    const DepthRasterLevel& level = raster.levels[level_index];
+    const float* level_depth = raster.depth.data() + level.offset;
+    for (int y = pixel_min_y >> level_index; y <= pixel_max_y >> level_index; y++) {
+        for (int x = pixel_min_x >> level_index; x <= pixel_max_x >> level_index; x++) {
+            if (level_depth[(y * level.width) + x] <= nearest) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "math/math.h"
+#include "physics/bvh.h"
+#include <cstdint>
+#include <vector>
+
+static const uint32_t DEPTH_RASTER_MAX_LEVELS = 16;
+// Rows are rendered in bands that don't share any pixels, so that bands can be rendered on different threads
+static const uint32_t DEPTH_RASTER_BAND_HEIGHT = 16;
+
+// A one sided occluder, only drawn when the camera is on the side its normal points to
+struct DepthRasterQuad {
+    vec3 corners[4];
+    vec3 normal;
+};
+
+struct DepthRasterLevel {
+    uint32_t width;
+    uint32_t height;
+    uint32_t offset;
+};
+
+// Low resolution software depth buffer for occlusion culling without the GPU. Depth is stored as 1 / w, which is
+// linear in screen space, so larger values are closer and 0 is empty. Level 0 is the full resolution buffer
+// and every level above holds the furthest depth of the 2x2 texels below it
+struct DepthRaster {
+    uint32_t width;
+    uint32_t height;
+    mat4 view_projection;
+    vec3 view_position;
+    float near_plane;
+
+    std::vector<float> depth;
+    DepthRasterLevel levels[DEPTH_RASTER_MAX_LEVELS];
+    uint32_t level_count;
+};
+
+// The width is rounded up to a multiple of 4 so that rows can be processed four pixels at a time
+void depth_raster_init(DepthRaster* raster, uint32_t width, uint32_t height, float near_plane);
+uint32_t depth_raster_get_band_count(const DepthRaster& raster);
+void depth_raster_set_camera(DepthRaster* raster, const mat4& view_projection, vec3 view_position);
+// Clears one band and draws the quads into it. Call for every band, then build the HiZ
+void depth_raster_render_band(DepthRaster* raster, const DepthRasterQuad* quads, uint32_t quad_count, uint32_t band);
+void depth_raster_render(DepthRaster* raster, const DepthRasterQuad* quads, uint32_t quad_count);
+void depth_raster_build_hiz(DepthRaster* raster);
+// True if the box is behind the occluders everywhere it covers on screen. Boxes off screen or crossing the near
+// plane are never occluded, frustum culling is left to the caller
+bool depth_raster_is_occluded(const DepthRaster& raster, const AABB& bounds);
\ No newline at end of file
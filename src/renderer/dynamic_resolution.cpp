@@ -0,0 +1,149 @@
+#include "dynamic_resolution.h"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+// How many frames old the GPU times are when they get read
+static const uint32_t DYNAMIC_RESOLUTION_FRAME_LATENCY = 4;
+static const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+// Scales within this fraction of the wanted one are left alone, so the scale doesn't hunt around the target
+static const float DYNAMIC_RESOLUTION_TOLERANCE = 0.05f;
+// The most the scale moves per frame. Dropping fast catches a sudden expensive view, rising slowly avoids overshooting it
+static const float DYNAMIC_RESOLUTION_MAX_DECREASE = 0.1f;
+static const float DYNAMIC_RESOLUTION_MAX_INCREASE = 0.02f;
+// Weight of the newest frame in the smoothed frame cost
+static const double DYNAMIC_RESOLUTION_SMOOTHING = 0.2;
+// Render sizes are rounded to this many pixels, so that tiny scale changes don't change the size every frame
+static const int DYNAMIC_RESOLUTION_SIZE_STEP = 8;
+
+// A begin and end timestamp of one frame in flight, and the scale it was rendered at
+struct DynamicResolutionFrame {
+    uint32_t queries[2];
+    float scale;
+    bool is_pending;
+};
+
+struct DynamicResolutionState {
+    bool is_enabled;
+    ivec2 max_size;
+    double target_gpu_time;
+    // Smoothed GPU time of a frame as if it had been rendered at full size, 0 until the first measurement
+    double full_size_gpu_time;
+    float scale;
+    ivec2 size;
+
+    DynamicResolutionFrame frames[DYNAMIC_RESOLUTION_FRAME_LATENCY];
+    uint32_t frame_index;
+};
+
+static DynamicResolutionState state;
+
+static void dynamic_resolution_set_scale(float scale) {
+    state.scale = scale;
+    if (scale >= 1.0f) {
+        state.size = state.max_size;
+        return;
+    }
+
+    int width = (int)((state.max_size.x * scale) / DYNAMIC_RESOLUTION_SIZE_STEP + 0.5f) * DYNAMIC_RESOLUTION_SIZE_STEP;
+    width = std::min(std::max(width, DYNAMIC_RESOLUTION_SIZE_STEP), state.max_size.x);
+    // The height follows the rounded width so that the aspect ratio stays the same as the full size one
+    int height = std::min((int)((((int64_t)width * state.max_size.y) + (state.max_size.x / 2)) / state.max_size.x), state.max_size.y);
+    state.size = ivec2(width, std::max(height, 1));
+}
+
+// Folds in the GPU time of the frame that used this slot DYNAMIC_RESOLUTION_FRAME_LATENCY frames ago
+static void dynamic_resolution_read_frame(DynamicResolutionFrame& frame) {
+    if (!frame.is_pending) {
+        return;
+    }
+    frame.is_pending = false;
+
+    GLint is_available = 0;
+    glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+    if (!is_available) {
+        return;
+    }
+
+    GLuint64 begin;
+    GLuint64 end;
+    glGetQueryObjectui64v(frame.queries[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.queries[1], GL_QUERY_RESULT, &end);
+    // Most of the cost scales with the pixel count, so the time is scaled back up by the area the frame was rendered at.
+    // That way frames still in flight at an older scale don't push the scale any further than they should
+    double gpu_time = (double)(end - begin) / 1000000000.0;
+    double full_size_gpu_time = gpu_time / (frame.scale * frame.scale);
+    if (state.full_size_gpu_time == 0.0) {
+        state.full_size_gpu_time = full_size_gpu_time;
+    } else {
+        state.full_size_gpu_time += (full_size_gpu_time - state.full_size_gpu_time) * DYNAMIC_RESOLUTION_SMOOTHING;
+    }
+}
+
+static void dynamic_resolution_update_scale() {
+    if (!state.is_enabled || state.full_size_gpu_time == 0.0) {
+        return;
+    }
+
+    // The cost goes with the area, which goes with the square of the scale
+    float wanted_scale = (float)sqrt(state.target_gpu_time / state.full_size_gpu_time);
+    wanted_scale = std::min(std::max(wanted_scale, DYNAMIC_RESOLUTION_MIN_SCALE), 1.0f);
+    if (fabsf(wanted_scale - state.scale) <= state.scale * DYNAMIC_RESOLUTION_TOLERANCE && wanted_scale != 1.0f) {
+        return;
+    }
+
+    float scale = std::min(std::max(wanted_scale, state.scale * (1.0f - DYNAMIC_RESOLUTION_MAX_DECREASE)), state.scale * (1.0f + DYNAMIC_RESOLUTION_MAX_INCREASE));
+    dynamic_resolution_set_scale(std::min(std::max(scale, DYNAMIC_RESOLUTION_MIN_SCALE), 1.0f));
+}
+
+void dynamic_resolution_init(ivec2 max_size, double target_gpu_time) {
+    state.is_enabled = true;
+    state.max_size = max_size;
+    state.target_gpu_time = target_gpu_time;
+    state.full_size_gpu_time = 0.0;
+    dynamic_resolution_set_scale(1.0f);
+
+    for (uint32_t frame = 0; frame < DYNAMIC_RESOLUTION_FRAME_LATENCY; frame++) {
+        glGenQueries(2, state.frames[frame].queries);
+        state.frames[frame].scale = 1.0f;
+        state.frames[frame].is_pending = false;
+    }
+    state.frame_index = 0;
+}
+
+void dynamic_resolution_set_enabled(bool enabled) {
+    state.is_enabled = enabled;
+    if (!enabled) {
+        dynamic_resolution_set_scale(1.0f);
+    }
+}
+
+bool dynamic_resolution_is_enabled() {
+    return state.is_enabled;
+}
+
+void dynamic_resolution_begin_frame() {
+    // The next slot was last used DYNAMIC_RESOLUTION_FRAME_LATENCY frames ago, so its queries are very likely done
+    state.frame_index = (state.frame_index + 1) % DYNAMIC_RESOLUTION_FRAME_LATENCY;
+    DynamicResolutionFrame& frame = state.frames[state.frame_index];
+    dynamic_resolution_read_frame(frame);
+    dynamic_resolution_update_scale();
+
+    frame.scale = state.scale;
+    glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+}
+
+void dynamic_resolution_end_frame() {
+    DynamicResolutionFrame& frame = state.frames[state.frame_index];
+    glQueryCounter(frame.queries[1], GL_TIMESTAMP);
+    frame.is_pending = true;
+}
+
+ivec2 dynamic_resolution_get_size() {
+    return state.size;
+}
+
+float dynamic_resolution_get_scale() {
+    return state.scale;
+}
\ No newline at end of file
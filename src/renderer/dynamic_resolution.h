@@ -0,0 +1,16 @@
+#pragma once
+
+#include "math/math.h"
+
+// Picks the size the scene is rendered at so that the GPU keeps up with a target frame time, for instance when deep
+// portal recursion makes frames expensive. The GPU time of each frame is measured with timestamp queries that are
+// read back a few frames later, like the profiler's. Render targets keep their full size and the scene is rendered
+// into the bottom left corner of them, so changing the scale never reallocates anything
+void dynamic_resolution_init(ivec2 max_size, double target_gpu_time);
+void dynamic_resolution_set_enabled(bool enabled);
+bool dynamic_resolution_is_enabled();
+// Call around all of the GPU work of a frame. The render size may change in dynamic_resolution_begin_frame()
+void dynamic_resolution_begin_frame();
+void dynamic_resolution_end_frame();
+ivec2 dynamic_resolution_get_size();
+float dynamic_resolution_get_scale();
\ No newline at end of file
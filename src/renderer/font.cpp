@@ -0,0 +1,211 @@
+#include "font.h"
+
+#include "core/logger.h"
+#include "core/vfs.h"
+#include <glad/glad.h>
+#include <SDL2/SDL_ttf.h>
+#include <algorithm>
+#include <string>
+
+static const int FONT_ATLAS_WIDTH = 256;
+// Empty texels between glyphs so that filtering doesn't bleed a neighbour in
+static const int FONT_ATLAS_PADDING = 1;
+static const uint32_t FONT_FALLBACK_CHARACTER = '?';
+
+struct FontGlyphImage {
+    uint32_t character;
+    ivec2 size;
+    // Alpha only, size.x * size.y
+    std::vector<uint8_t> pixels;
+};
+
+// Renders the glyph and crops it to the pixels it covers, so that the atlas doesn't store the empty space around it
+static bool font_render_glyph(TTF_Font* ttf_font, uint32_t character, FontGlyphImage* image, FontGlyph* glyph) {
+    image->character = character;
+    image->size = ivec2(0, 0);
+    image->pixels.clear();
+    glyph->offset = ivec2(0, 0);
+    glyph->size = ivec2(0, 0);
+    int min_x, max_x, min_y, max_y;
+    if (TTF_GlyphMetrics(ttf_font, (Uint16)character, &min_x, &max_x, &min_y, &max_y, &glyph->advance) != 0) {
+        return false;
+    }
+
+    SDL_Surface* rendered = TTF_RenderGlyph_Blended(ttf_font, (Uint16)character, (SDL_Color) { 255, 255, 255, 255 });
+    if (rendered == NULL) {
+        // Whitespace renders nothing, which isn't an error
+        return true;
+    }
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(rendered);
+    if (surface == NULL) {
+        return false;
+    }
+
+    ivec2 covered_min = ivec2(surface->w, surface->h);
+    ivec2 covered_max = ivec2(-1, -1);
+    for (int y = 0; y < surface->h; y++) {
+        const uint8_t* row = (const uint8_t*)surface->pixels + (y * surface->pitch);
+        for (int x = 0; x < surface->w; x++) {
+            if (row[(x * 4) + 3] != 0) {
+                covered_min = ivec2(std::min(covered_min.x, x), std::min(covered_min.y, y));
+                covered_max = ivec2(std::max(covered_max.x, x), std::max(covered_max.y, y));
+            }
+        }
+    }
+    if (covered_max.x >= 0) {
+        image->size = ivec2(covered_max.x - covered_min.x + 1, covered_max.y - covered_min.y + 1);
+        image->pixels.resize(image->size.x * image->size.y);
+        for (int y = 0; y < image->size.y; y++) {
+            const uint8_t* row = (const uint8_t*)surface->pixels + ((covered_min.y + y) * surface->pitch);
+            for (int x = 0; x < image->size.x; x++) {
+                image->pixels[(y * image->size.x) + x] = row[((covered_min.x + x) * 4) + 3];
+            }
+        }
+        glyph->offset = covered_min;
+        glyph->size = image->size;
+    }
+    SDL_FreeSurface(surface);
+    return true;
+}
+
+bool font_load(Font* font, const char* path, int point_size) {
+    if (!TTF_WasInit() && TTF_Init() != 0) {
+        log_error("SDL_ttf failed to initialize: %s", TTF_GetError());
+        return false;
+    }
+    // The font reads from the file until it's closed, which happens once every glyph is rendered
+    VfsFile file;
+    if (!vfs_open(&file, path)) {
+        return false;
+    }
+    TTF_Font* ttf_font = TTF_OpenFontRW(SDL_RWFromConstMem(file.data, (int)file.size), 1, point_size);
+    if (ttf_font == NULL) {
+        log_error("Could not open font %s: %s", path, TTF_GetError());
+        vfs_close(&file);
+        return false;
+    }
+    font->line_height = TTF_FontLineSkip(ttf_font);
+
+    std::vector<FontGlyphImage> images(FONT_CHARACTER_COUNT);
+    for (uint32_t index = 0; index < FONT_CHARACTER_COUNT; index++) {
+        if (!font_render_glyph(ttf_font, FONT_FIRST_CHARACTER + index, &images[index], &font->glyphs[index])) {
+            log_error("Could not render glyph %u of font %s: %s", FONT_FIRST_CHARACTER + index, path, TTF_GetError());
+            TTF_CloseFont(ttf_font);
+            vfs_close(&file);
+            return false;
+        }
+    }
+    TTF_CloseFont(ttf_font);
+    vfs_close(&file);
+
+    // Shelf packing: tallest glyphs first, left to right in rows as tall as the first glyph of the row
+    std::vector<uint32_t> order(FONT_CHARACTER_COUNT);
+    for (uint32_t index = 0; index < FONT_CHARACTER_COUNT; index++) {
+        order[index] = index;
+    }
+    std::sort(order.begin(), order.end(), [&images](uint32_t a, uint32_t b) {
+        return images[a].size.y > images[b].size.y;
+    });
+    ivec2 pen = ivec2(FONT_ATLAS_PADDING, FONT_ATLAS_PADDING);
+    int row_height = 0;
+    for (uint32_t index : order) {
+        const FontGlyphImage& image = images[index];
+        if (image.size.x == 0) {
+            font->glyphs[index].atlas_position = ivec2(0, 0);
+            continue;
+        }
+        if (pen.x + image.size.x + FONT_ATLAS_PADDING > FONT_ATLAS_WIDTH) {
+            pen = ivec2(FONT_ATLAS_PADDING, pen.y + row_height + FONT_ATLAS_PADDING);
+            row_height = 0;
+        }
+        font->glyphs[index].atlas_position = pen;
+        pen.x += image.size.x + FONT_ATLAS_PADDING;
+        row_height = std::max(row_height, image.size.y);
+    }
+    int atlas_height = 1;
+    while (atlas_height < pen.y + row_height + FONT_ATLAS_PADDING) {
+        atlas_height *= 2;
+    }
+    font->atlas_size = ivec2(FONT_ATLAS_WIDTH, atlas_height);
+
+    std::vector<uint8_t> atlas_pixels(FONT_ATLAS_WIDTH * atlas_height, 0);
+    for (uint32_t index = 0; index < FONT_CHARACTER_COUNT; index++) {
+        const FontGlyphImage& image = images[index];
+        const FontGlyph& glyph = font->glyphs[index];
+        for (int y = 0; y < image.size.y; y++) {
+            std::copy(image.pixels.begin() + (y * image.size.x), image.pixels.begin() + ((y + 1) * image.size.x),
+                      atlas_pixels.begin() + ((glyph.atlas_position.y + y) * FONT_ATLAS_WIDTH) + glyph.atlas_position.x);
+        }
+    }
+
+    glGenTextures(1, &font->atlas);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, font->atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_ATLAS_WIDTH, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas_pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // Glyphs are laid out on whole pixels of the screen size, so when the window is the same size every pixel
+    // samples a texel center and filtering changes nothing. A scaled window resamples the text, and filtering
+    // keeps it smooth instead of blocky
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    log_info("Loaded font %s at %ipt into a %ix%i atlas.", path, point_size, FONT_ATLAS_WIDTH, atlas_height);
+    return true;
+}
+
+uint32_t font_pack_color(vec3 color) {
+    uint32_t r = (uint32_t)(std::min(std::max(color.x, 0.0f), 1.0f) * 255.0f);
+    uint32_t g = (uint32_t)(std::min(std::max(color.y, 0.0f), 1.0f) * 255.0f);
+    uint32_t b = (uint32_t)(std::min(std::max(color.z, 0.0f), 1.0f) * 255.0f);
+    return (255u << 24) | (b << 16) | (g << 8) | r;
+}
+
+uint32_t font_layout(const Font& font, const char* text, ivec2 position, uint32_t color, std::vector<TextVertex>* vertices) {
+    vec2 texel_size = vec2(1.0f / (float)font.atlas_size.x, 1.0f / (float)font.atlas_size.y);
+    ivec2 pen = position;
+    uint32_t glyph_count = 0;
+    for (const char* character = text; *character != '\0'; character++) {
+        if (*character == '\n') {
+            pen = ivec2(position.x, pen.y + font.line_height);
+            continue;
+        }
+        uint32_t index = (uint32_t)(uint8_t)*character - FONT_FIRST_CHARACTER;
+        if (index >= FONT_CHARACTER_COUNT) {
+            index = FONT_FALLBACK_CHARACTER - FONT_FIRST_CHARACTER;
+        }
+        const FontGlyph& glyph = font.glyphs[index];
+        if (glyph.size.x != 0) {
+            vec2 top_left = vec2((float)(pen.x + glyph.offset.x), (float)(pen.y + glyph.offset.y));
+            vec2 bottom_right = top_left + vec2((float)glyph.size.x, (float)glyph.size.y);
+            vec2 uv_top_left = vec2((float)glyph.atlas_position.x * texel_size.x, (float)glyph.atlas_position.y * texel_size.y);
+            vec2 uv_bottom_right = uv_top_left + vec2((float)glyph.size.x * texel_size.x, (float)glyph.size.y * texel_size.y);
+
+            TextVertex top_left_vertex = (TextVertex) { .position = top_left, .texture_coordinate = uv_top_left, .color = color };
+            TextVertex top_right_vertex = (TextVertex) {
+                .position = vec2(bottom_right.x, top_left.y),
+                .texture_coordinate = vec2(uv_bottom_right.x, uv_top_left.y),
+                .color = color
+            };
+            TextVertex bottom_left_vertex = (TextVertex) {
+                .position = vec2(top_left.x, bottom_right.y),
+                .texture_coordinate = vec2(uv_top_left.x, uv_bottom_right.y),
+                .color = color
+            };
+            TextVertex bottom_right_vertex = (TextVertex) { .position = bottom_right, .texture_coordinate = uv_bottom_right, .color = color };
+            vertices->push_back(top_left_vertex);
+            vertices->push_back(top_right_vertex);
+            vertices->push_back(bottom_left_vertex);
+            vertices->push_back(bottom_left_vertex);
+            vertices->push_back(top_right_vertex);
+            vertices->push_back(bottom_right_vertex);
+            glyph_count++;
+        }
+        pen.x += glyph.advance;
+    }
+    return glyph_count;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "math/math.h"
+#include <cstdint>
+#include <vector>
+
+// Printable ASCII. Anything else is drawn as a question mark
+static const uint32_t FONT_FIRST_CHARACTER = 32;
+static const uint32_t FONT_CHARACTER_COUNT = 95;
+
+struct FontGlyph {
+    // Pixel rectangle of the glyph in the atlas. Empty for glyphs like space that draw nothing
+    ivec2 atlas_position;
+    ivec2 size;
+    // From the pen position at the top of the line to the top left of the rectangle
+    ivec2 offset;
+    int advance;
+};
+
+// Every glyph of one font and size, rendered once and packed into a single texture so that any amount of text
+// can be drawn with that one texture bound
+struct Font {
+    uint32_t atlas;
+    ivec2 atlas_size;
+    int line_height;
+    FontGlyph glyphs[FONT_CHARACTER_COUNT];
+};
+
+// One vertex of a glyph quad, in screen pixels with the origin at the top left
+struct TextVertex {
+    vec2 position;
+    vec2 texture_coordinate;
+    // RGBA, one byte each
+    uint32_t color;
+};
+
+bool font_load(Font* font, const char* path, int point_size);
+uint32_t font_pack_color(vec3 color);
+// Appends six vertices for every glyph that draws something. Newlines start a new line at position.x.
+// Returns how many glyphs were added
+uint32_t font_layout(const Font& font, const char* text, ivec2 position, uint32_t color, std::vector<TextVertex>* vertices);
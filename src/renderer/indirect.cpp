@@ -0,0 +1,161 @@
+#include "indirect.h"
+
+#include "core/logger.h"
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <cstring>
+
+// Three slices, so the CPU can fill one while the GPU may still be reading the previous two
+static const uint32_t INDIRECT_FRAME_COUNT = 3;
+static const GLuint64 INDIRECT_FENCE_TIMEOUT = 1000000000;
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP IndirectMultiDrawArraysFunction)(GLenum mode, const void* indirect, GLsizei draw_count, GLsizei stride);
+typedef void (APIENTRYP IndirectBufferStorageFunction)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+struct IndirectState {
+    IndirectMultiDrawArraysFunction multi_draw_arrays_indirect;
+    IndirectBufferStorageFunction buffer_storage;
+
+    uint32_t max_draws;
+    uint32_t command_buffer;
+    uint32_t model_buffer;
+    uint32_t model_texture;
+    uint32_t draw_index_buffer;
+    IndirectDrawCommand* commands;
+    mat4* models;
+
+    GLsync fences[INDIRECT_FRAME_COUNT];
+    uint32_t frame_index;
+};
+
+static IndirectState state;
+
+static bool indirect_has_extension(const char* name) {
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; i++) {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* indirect_create_mapped_buffer(uint32_t* buffer, GLenum target, size_t size) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, buffer);
+    glBindBuffer(target, *buffer);
+    state.buffer_storage(target, size, NULL, flags);
+    void* data = glMapBufferRange(target, 0, size, flags);
+    glBindBuffer(target, 0);
+    return data;
+}
+
+bool indirect_init(uint32_t max_draws, uint32_t models_texture_unit) {
+    GLint major_version = 0;
+    GLint minor_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+    int version = (major_version * 10) + minor_version;
+
+    state.multi_draw_arrays_indirect = NULL;
+    state.buffer_storage = NULL;
+    // Commands find their draw's data through baseInstance, which a 4.1 context only honours with
+    // GL_ARB_base_instance, so multi-draw alone isn't enough
+    bool has_multi_draw_indirect = version >= 43 || indirect_has_extension("GL_ARB_multi_draw_indirect");
+    bool has_base_instance = version >= 42 || indirect_has_extension("GL_ARB_base_instance");
+    if (has_multi_draw_indirect && has_base_instance) {
+        state.multi_draw_arrays_indirect = (IndirectMultiDrawArraysFunction)SDL_GL_GetProcAddress("glMultiDrawArraysIndirect");
+    }
+    if (version >= 44 || indirect_has_extension("GL_ARB_buffer_storage")) {
+        state.buffer_storage = (IndirectBufferStorageFunction)SDL_GL_GetProcAddress("glBufferStorage");
+    }
+    if (state.multi_draw_arrays_indirect == NULL || state.buffer_storage == NULL) {
+        log_info("Multi-draw indirect is not supported by GL %i.%i, using regular draws.", major_version, minor_version);
+        return false;
+    }
+
+    state.max_draws = max_draws;
+    uint32_t total_draws = max_draws * INDIRECT_FRAME_COUNT;
+    state.commands = (IndirectDrawCommand*)indirect_create_mapped_buffer(&state.command_buffer, GL_DRAW_INDIRECT_BUFFER, total_draws * sizeof(IndirectDrawCommand));
+    state.models = (mat4*)indirect_create_mapped_buffer(&state.model_buffer, GL_TEXTURE_BUFFER, total_draws * sizeof(mat4));
+    if (state.commands == NULL || state.models == NULL) {
+        log_error("Error mapping indirect draw buffers.");
+        return false;
+    }
+
+    glGenTextures(1, &state.model_texture);
+    glActiveTexture(GL_TEXTURE0 + models_texture_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, state.model_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, state.model_buffer);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Instanced attributes step from the command's base instance, which is how the shader finds its draw's data
+    // without GL 4.6's gl_DrawID
+    uint32_t* draw_indices = new uint32_t[total_draws];
+    for (uint32_t i = 0; i < total_draws; i++) {
+        draw_indices[i] = i;
+    }
+    glGenBuffers(1, &state.draw_index_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, state.draw_index_buffer);
+    glBufferData(GL_ARRAY_BUFFER, total_draws * sizeof(uint32_t), draw_indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    delete [] draw_indices;
+
+    for (uint32_t i = 0; i < INDIRECT_FRAME_COUNT; i++) {
+        state.fences[i] = NULL;
+    }
+    state.frame_index = 0;
+
+    log_info("Multi-draw indirect enabled with GL %i.%i.", major_version, minor_version);
+    return true;
+}
+
+void indirect_setup_draw_index(uint32_t attribute) {
+    glBindBuffer(GL_ARRAY_BUFFER, state.draw_index_buffer);
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribIPointer(attribute, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+    glVertexAttribDivisor(attribute, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+IndirectFrame indirect_begin_frame() {
+    uint32_t region = state.frame_index;
+    state.frame_index = (state.frame_index + 1) % INDIRECT_FRAME_COUNT;
+
+    GLsync fence = state.fences[region];
+    if (fence != NULL) {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, INDIRECT_FENCE_TIMEOUT);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, INDIRECT_FENCE_TIMEOUT);
+        }
+        glDeleteSync(fence);
+        state.fences[region] = NULL;
+    }
+
+    uint32_t base_draw = region * state.max_draws;
+    return (IndirectFrame) {
+        .commands = state.commands + base_draw,
+        .models = state.models + base_draw,
+        .base_draw = base_draw,
+        .region = region
+    };
+}
+
+void indirect_draw(const IndirectFrame& frame, uint32_t first_command, uint32_t command_count) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, state.command_buffer);
+    size_t offset = (frame.base_draw + first_command) * sizeof(IndirectDrawCommand);
+    state.multi_draw_arrays_indirect(GL_TRIANGLES, (const void*)offset, command_count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void indirect_end_frame(const IndirectFrame& frame) {
+    state.fences[frame.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
\ No newline at end of file
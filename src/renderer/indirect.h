@@ -0,0 +1,33 @@
+#pragma once
+
+#include "math/matrix.h"
+#include <cstdint>
+
+// Matches the layout GL reads from the draw indirect buffer
+struct IndirectDrawCommand {
+    uint32_t vertex_count;
+    uint32_t instance_count;
+    uint32_t first_vertex;
+    uint32_t base_instance;
+};
+
+// A slice of the persistently mapped buffers that the CPU can fill for one submission. Commands and models are
+// written straight into GPU visible memory, so they can be filled from any thread. The draw_index vertex attribute
+// of a command's vertices is its base_instance, which must be base_draw plus the command's index in the slice
+struct IndirectFrame {
+    IndirectDrawCommand* commands;
+    mat4* models;
+    uint32_t base_draw;
+    uint32_t region;
+};
+
+// Loads the GL 4.3 multi-draw indirect and GL 4.4 buffer storage entry points, which the 4.1 loader doesn't have.
+// Returns false if the context can't do either, in which case nothing else here may be called
+bool indirect_init(uint32_t max_draws, uint32_t models_texture_unit);
+// Adds the per draw index as the given instanced attribute of the currently bound vertex array
+void indirect_setup_draw_index(uint32_t attribute);
+// Waits until the GPU is done with the oldest slice and hands it out again
+IndirectFrame indirect_begin_frame();
+// Draws command_count commands starting at first_command with the currently bound vertex array and shader
+void indirect_draw(const IndirectFrame& frame, uint32_t first_command, uint32_t command_count);
+void indirect_end_frame(const IndirectFrame& frame);
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "light_cluster.h"
+
+#include <algorithm>
+
+static inline float light_cluster_min(float a, float b) {
+    return a < b ? a : b;
+}
+
+static inline float light_cluster_max(float a, float b) {
+    return a > b ? a : b;
+}
+
+static uint32_t light_cluster_tile(float ndc, uint32_t tile_count) {
+    int tile = (int)floorf((ndc + 1.0f) * 0.5f * tile_count);
+    return (uint32_t)(tile < 0 ? 0 : (tile >= (int)tile_count ? (int)tile_count - 1 : tile));
+}
+
+// Projected range of the interval [low, high] seen anywhere between depths near_depth and far_depth.
+// Dividing by the depth moves values toward zero, so each end is extreme at one of the two depths
+static void light_cluster_project_range(float low, float high, float near_depth, float far_depth, float scale, float* ndc_low, float* ndc_high) {
+    *ndc_low = scale * (low >= 0.0f ? low / far_depth : low / near_depth);
+    *ndc_high = scale * (high >= 0.0f ? high / near_depth : high / far_depth);
+}
+
+void light_cluster_init(LightClusterGrid* grid, const mat4& projection, float near, float far) {
+    grid->projection_scale_x = projection[0][0];
+    grid->projection_scale_y = projection[1][1];
+    grid->near = near;
+    grid->far = far;
+    grid->slice_scale = LIGHT_CLUSTER_Z / logf(far / near);
+    for (uint32_t slice = 0; slice <= LIGHT_CLUSTER_Z; slice++) {
+        grid->slice_depths[slice] = near * powf(far / near, (float)slice / LIGHT_CLUSTER_Z);
+    }
+
+    grid->cluster_ranges.assign(LIGHT_CLUSTER_COUNT * 2, 0);
+    grid->light_indices.clear();
+}
+
+uint32_t light_cluster_slice(const LightClusterGrid& grid, float depth) {
+    if (depth <= grid.near) {
+        return 0;
+    }
+    uint32_t slice = (uint32_t)(logf(depth / grid.near) * grid.slice_scale);
+    return slice < LIGHT_CLUSTER_Z ? slice : LIGHT_CLUSTER_Z - 1;
+}
+
+void light_cluster_build(LightClusterGrid* grid, const mat4& view, const LightClusterSphere* spheres, uint32_t light_count) {
+    grid->pairs.clear();
+
+    for (uint32_t light = 0; light < light_count; light++) {
+        vec3 position = view.transform_point(vec3(spheres[light].x, spheres[light].y, spheres[light].z));
+        float radius = spheres[light].w;
+        float depth = -position.z;
+        if (depth + radius < grid->near || depth - radius > grid->far) {
+            continue;
+        }
+
+        float depth_min = light_cluster_max(depth - radius, grid->near);
+        float depth_max = light_cluster_min(depth + radius, grid->far);
+        uint32_t slice_end = light_cluster_slice(*grid, depth_max);
+        for (uint32_t slice = light_cluster_slice(*grid, depth_min); slice <= slice_end; slice++) {
+            float slice_near = light_cluster_max(grid->slice_depths[slice], depth_min);
+            float slice_far = light_cluster_min(grid->slice_depths[slice + 1], depth_max);
+
+            // Widest cross section of the sphere within this slice
+            float offset = depth < slice_near ? slice_near - depth : (depth > slice_far ? depth - slice_far : 0.0f);
+            float section_radius = sqrtf(light_cluster_max((radius * radius) - (offset * offset), 0.0f));
+
+            float x_low, x_high, y_low, y_high;
+            light_cluster_project_range(position.x - section_radius, position.x + section_radius, slice_near, slice_far, grid->projection_scale_x, &x_low, &x_high);
+            light_cluster_project_range(position.y - section_radius, position.y + section_radius, slice_near, slice_far, grid->projection_scale_y, &y_low, &y_high);
+            if (x_low > 1.0f || x_high < -1.0f || y_low > 1.0f || y_high < -1.0f) {
+                continue;
+            }
+
+            uint32_t x_end = light_cluster_tile(x_high, LIGHT_CLUSTER_X);
+            uint32_t y_end = light_cluster_tile(y_high, LIGHT_CLUSTER_Y);
+            for (uint32_t y = light_cluster_tile(y_low, LIGHT_CLUSTER_Y); y <= y_end; y++) {
+                for (uint32_t x = light_cluster_tile(x_low, LIGHT_CLUSTER_X); x <= x_end; x++) {
+                    grid->pairs.push_back((LightClusterPair) {
+                        .cluster = (((slice * LIGHT_CLUSTER_Y) + y) * LIGHT_CLUSTER_X) + x,
+                        .light = light
+                    });
+                }
+            }
+        }
+    }
+
+    // Counting sort of the pairs by cluster
+    std::fill(grid->cluster_ranges.begin(), grid->cluster_ranges.end(), 0);
+    for (const LightClusterPair& pair : grid->pairs) {
+        grid->cluster_ranges[(pair.cluster * 2) + 1]++;
+    }
+    uint32_t offset = 0;
+    for (uint32_t cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+        grid->cluster_ranges[cluster * 2] = offset;
+        offset += grid->cluster_ranges[(cluster * 2) + 1];
+        grid->cluster_ranges[(cluster * 2) + 1] = 0;
+    }
+
+    grid->light_indices.resize(grid->pairs.size());
+    for (const LightClusterPair& pair : grid->pairs) {
+        uint32_t& count = grid->cluster_ranges[(pair.cluster * 2) + 1];
+        grid->light_indices[grid->cluster_ranges[pair.cluster * 2] + count] = pair.light;
+        count++;
+    }
+}
\ No newline at end of file
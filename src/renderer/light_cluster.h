@@ -0,0 +1,41 @@
+#pragma once
+
+#include "math/math.h"
+#include <cstdint>
+#include <vector>
+
+// The view frustum is split into tiles on screen and exponentially spaced slices in depth.
+// Keep in sync with the cluster constants in the lit fragment shaders
+static const uint32_t LIGHT_CLUSTER_X = 16;
+static const uint32_t LIGHT_CLUSTER_Y = 9;
+static const uint32_t LIGHT_CLUSTER_Z = 24;
+static const uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+
+// Light bounds for binning, xyz is the world position and w is the radius past which the light has no effect
+typedef vec4 LightClusterSphere;
+
+struct LightClusterPair {
+    uint32_t cluster;
+    uint32_t light;
+};
+
+struct LightClusterGrid {
+    float projection_scale_x;
+    float projection_scale_y;
+    float near;
+    float far;
+    float slice_scale;
+    float slice_depths[LIGHT_CLUSTER_Z + 1];
+
+    // Two values per cluster: the offset into light_indices and the number of lights
+    std::vector<uint32_t> cluster_ranges;
+    std::vector<uint32_t> light_indices;
+
+    // Scratch data, kept around to avoid reallocating every build
+    std::vector<LightClusterPair> pairs;
+};
+
+void light_cluster_init(LightClusterGrid* grid, const mat4& projection, float near, float far);
+// Bins the lights into every cluster their sphere touches. Lights within a cluster stay in their original order
+void light_cluster_build(LightClusterGrid* grid, const mat4& view, const LightClusterSphere* spheres, uint32_t light_count);
+uint32_t light_cluster_slice(const LightClusterGrid& grid, float depth);
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "occlusion.h"
+
+#include <glad/glad.h>
+
+// Query boxes are pushed out a little so that a node's own geometry doesn't hide it
+static const float OCCLUSION_BOUNDS_MARGIN = 0.05f;
+// Boxes the camera is in or right next to would be clipped by the near plane, so they always count as visible
+static const float OCCLUSION_CAMERA_MARGIN = 0.2f;
+// Visible leaves only need checking now and then to find out they became hidden. They are staggered by node index
+static const uint32_t OCCLUSION_VISIBLE_QUERY_INTERVAL = 4;
+
+static bool occlusion_is_in_frustum(const AABB& bounds, const vec4* frustum_planes) {
+    for (uint32_t i = 0; i < 6; i++) {
+        const vec4& plane = frustum_planes[i];
+        vec3 corner = vec3(plane.x > 0.0f ? bounds.max.x : bounds.min.x,
+                           plane.y > 0.0f ? bounds.max.y : bounds.min.y,
+                           plane.z > 0.0f ? bounds.max.z : bounds.min.z);
+        if ((plane.x * corner.x) + (plane.y * corner.y) + (plane.z * corner.z) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool occlusion_contains(const AABB& outer, const AABB& inner) {
+    return inner.min.x >= outer.min.x && inner.min.y >= outer.min.y && inner.min.z >= outer.min.z &&
+           inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+static bool occlusion_contains_point(const AABB& bounds, vec3 point) {
+    return point.x >= bounds.min.x && point.y >= bounds.min.y && point.z >= bounds.min.z &&
+           point.x <= bounds.max.x && point.y <= bounds.max.y && point.z <= bounds.max.z;
+}
+
+void occlusion_init(OcclusionCuller* culler) {
+    culler->bvh = NULL;
+    culler->nodes.clear();
+    culler->query_nodes.clear();
+    culler->frame = 0;
+}
+
+void occlusion_set_bvh(OcclusionCuller* culler, const Bvh* bvh) {
+    uint32_t node_count = bvh == NULL ? 0 : (uint32_t)bvh->nodes.size();
+    if (culler->bvh == bvh && culler->nodes.size() == node_count) {
+        return;
+    }
+
+    for (const OcclusionNode& node : culler->nodes) {
+        glDeleteQueries(1, &node.query);
+    }
+    culler->bvh = bvh;
+    culler->nodes.resize(node_count);
+    culler->query_nodes.clear();
+    for (OcclusionNode& node : culler->nodes) {
+        glGenQueries(1, &node.query);
+        node.visited_frame = 0;
+        node.is_visible = true;
+        node.is_query_pending = false;
+    }
+}
+
+void occlusion_read_results(OcclusionCuller* culler) {
+    for (OcclusionNode& node : culler->nodes) {
+        if (!node.is_query_pending) {
+            continue;
+        }
+        GLuint is_available;
+        glGetQueryObjectuiv(node.query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+        if (!is_available) {
+            continue;
+        }
+        GLuint any_samples_passed;
+        glGetQueryObjectuiv(node.query, GL_QUERY_RESULT, &any_samples_passed);
+        node.is_visible = any_samples_passed != 0;
+        node.is_query_pending = false;
+    }
+
+    // Pull up. Children come after their parents, so walking backwards lets hidden nodes merge all the way up
+    for (uint32_t node_index = (uint32_t)culler->nodes.size(); node_index-- > 0;) {
+        const BvhNode& bvh_node = culler->bvh->nodes[node_index];
+        OcclusionNode& node = culler->nodes[node_index];
+        if (bvh_node.count != 0 || !node.is_visible) {
+            continue;
+        }
+        const OcclusionNode& left = culler->nodes[bvh_node.left_or_first];
+        const OcclusionNode& right = culler->nodes[bvh_node.left_or_first + 1];
+        bool are_children_current = left.visited_frame == node.visited_frame && right.visited_frame == node.visited_frame;
+        bool are_children_hidden = !left.is_visible && !left.is_query_pending && !right.is_visible && !right.is_query_pending;
+        if (are_children_current && are_children_hidden) {
+            node.is_visible = false;
+        }
+    }
+}
+
+void occlusion_update(OcclusionCuller* culler, const vec4* frustum_planes, vec3 view_position) {
+    culler->frame++;
+    culler->query_nodes.clear();
+    if (culler->nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size != 0) {
+        uint32_t node_index = stack[--stack_size];
+        const BvhNode& bvh_node = culler->bvh->nodes[node_index];
+        OcclusionNode& node = culler->nodes[node_index];
+        if (!occlusion_is_in_frustum(bvh_node.bounds, frustum_planes)) {
+            continue;
+        }
+
+        // Nodes that weren't reached last frame, because they were off screen or under a hidden node,
+        // have no result that still means anything, so they start out visible until queried
+        if (node.visited_frame + 1 < culler->frame && !node.is_query_pending) {
+            node.is_visible = true;
+        }
+        node.visited_frame = culler->frame;
+
+        bool is_leaf = bvh_node.count != 0;
+        if (occlusion_contains_point(bvh_node.bounds.grown(OCCLUSION_CAMERA_MARGIN), view_position)) {
+            node.is_visible = true;
+        } else if (!node.is_visible || (is_leaf && (culler->frame + node_index) % OCCLUSION_VISIBLE_QUERY_INTERVAL == 0)) {
+            if (!node.is_query_pending) {
+                culler->query_nodes.push_back(node_index);
+            }
+            if (!node.is_visible) {
+                continue;
+            }
+        }
+
+        if (!is_leaf) {
+            stack[stack_size++] = bvh_node.left_or_first + 1;
+            stack[stack_size++] = bvh_node.left_or_first;
+        }
+    }
+}
+
+void occlusion_issue_queries(OcclusionCuller* culler, OcclusionDrawBox draw_box) {
+    for (uint32_t node_index : culler->query_nodes) {
+        OcclusionNode& node = culler->nodes[node_index];
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, node.query);
+        draw_box(culler->bvh->nodes[node_index].bounds.grown(OCCLUSION_BOUNDS_MARGIN));
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        node.is_query_pending = true;
+    }
+}
+
+bool occlusion_is_hidden(const OcclusionCuller& culler, const AABB& bounds) {
+    if (culler.nodes.empty()) {
+        return false;
+    }
+
+    uint32_t node_index = 0;
+    while (true) {
+        const BvhNode& bvh_node = culler.bvh->nodes[node_index];
+        const OcclusionNode& node = culler.nodes[node_index];
+        if (node.visited_frame != culler.frame || !occlusion_contains(bvh_node.bounds.grown(OCCLUSION_BOUNDS_MARGIN), bounds)) {
+            return false;
+        }
+        if (!node.is_visible) {
+            return true;
+        }
+        if (bvh_node.count != 0) {
+            return false;
+        }
+
+        uint32_t left = bvh_node.left_or_first;
+        node_index = occlusion_contains(culler.bvh->nodes[left].bounds.grown(OCCLUSION_BOUNDS_MARGIN), bounds) ? left : left + 1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "math/math.h"
+#include "physics/bvh.h"
+#include <cstdint>
+#include <vector>
+
+struct OcclusionNode {
+    uint32_t query;
+    uint32_t visited_frame;
+    bool is_visible;
+    bool is_query_pending;
+};
+
+// Draws the box used for an occlusion query. It must not write color or depth
+typedef void (*OcclusionDrawBox)(const AABB& bounds);
+
+// Occlusion culling against the nodes of a BVH with hardware occlusion queries, in the style of coherent hierarchical
+// culling. Queries are only read once their results are available, usually a frame or two later, so nodes use
+// the last known result in the meantime. Visible nodes are descended into and their leaves queried. Hidden nodes
+// are queried as a whole, and a visible node whose children both turned out hidden is pulled up into one hidden node
+struct OcclusionCuller {
+    const Bvh* bvh;
+    std::vector<OcclusionNode> nodes;
+    std::vector<uint32_t> query_nodes;
+    uint32_t frame;
+};
+
+void occlusion_init(OcclusionCuller* culler);
+// The BVH must outlive the culler or be replaced before it is freed. Passing NULL turns culling off
+void occlusion_set_bvh(OcclusionCuller* culler, const Bvh* bvh);
+// Picks up the query results that have arrived, never waiting on the GPU
+void occlusion_read_results(OcclusionCuller* culler);
+// Walks the nodes inside the frustum and decides which ones need a query this frame
+void occlusion_update(OcclusionCuller* culler, const vec4* frustum_planes, vec3 view_position);
+// Issues the queries picked by occlusion_update() against the current depth buffer
+void occlusion_issue_queries(OcclusionCuller* culler, OcclusionDrawBox draw_box);
+// Whether bounds are inside a node that was hidden as of the last occlusion_update()
+bool occlusion_is_hidden(const OcclusionCuller& culler, const AABB& bounds);
\ No newline at end of file
@@ -0,0 +1,426 @@
+#include "post.h"
+
+#include "core/logger.h"
+#include "shader.h"
+#include "profiler.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdio>
+#include <initializer_list>
+
+static const uint32_t POST_MSAA_SAMPLES = 4;
+static const uint32_t POST_BLOOM_LEVELS = 5;
+// Only the part of the scene brighter than this blooms
+static const float POST_BLOOM_THRESHOLD = 1.0f;
+// The upsampled levels add up, so this is spread over all of them
+static const float POST_BLOOM_INTENSITY = 0.04f;
+// How much of the reprojected history TAA keeps every frame
+static const float POST_TAA_HISTORY_WEIGHT = 0.9f;
+static const uint32_t POST_TAA_JITTER_COUNT = 8;
+// Keep in sync with include/post.glsl
+static const uint32_t POST_MAX_INPUTS = 3;
+static const uint32_t POST_MAX_PASSES = 16;
+
+// Targets, in no particular order. The bloom levels follow each other, each half the size of the one before
+static const uint32_t POST_TARGET_SCENE = 0;
+static const uint32_t POST_TARGET_RESOLVED = 1;
+static const uint32_t POST_TARGET_BLOOM = 2;
+static const uint32_t POST_TARGET_TONEMAPPED = POST_TARGET_BLOOM + POST_BLOOM_LEVELS;
+static const uint32_t POST_TARGET_ANTI_ALIASED = POST_TARGET_TONEMAPPED + 1;
+static const uint32_t POST_TARGET_HISTORY = POST_TARGET_TONEMAPPED + 2;
+static const uint32_t POST_TARGET_PREVIOUS_HISTORY = POST_TARGET_TONEMAPPED + 3;
+static const uint32_t POST_TARGET_COUNT = POST_TARGET_TONEMAPPED + 4;
+// Not a target of its own but the depth attachment of the scene target, which passes can read as an input too
+static const uint32_t POST_INPUT_SCENE_DEPTH = POST_TARGET_COUNT;
+
+struct PostTarget {
+    uint32_t framebuffer;
+    uint32_t texture;
+    // Only the scene target has depth. It's a texture, unless multisampled
+    uint32_t depth;
+    ivec2 size;
+    GLenum format;
+    uint32_t samples;
+};
+
+struct PostPass {
+    // Profiler section. Consecutive passes with the same section are timed together
+    const char* section;
+    // 0 for the MSAA resolve, which is a blit rather than a draw
+    Shader shader;
+    uint32_t inputs[POST_MAX_INPUTS];
+    uint32_t input_count;
+    uint32_t output;
+    // Added onto what the output already holds instead of replacing it
+    bool is_additive;
+};
+
+struct PostState {
+    ivec2 screen_size;
+    uint32_t quad_vao;
+    PostAntiAliasing anti_aliasing;
+    bool is_bloom_enabled;
+
+    PostTarget targets[POST_TARGET_COUNT];
+    PostPass passes[POST_MAX_PASSES];
+    uint32_t pass_count;
+
+    Shader bloom_prefilter_shader;
+    Shader bloom_downsample_shader;
+    Shader bloom_upsample_shader;
+    Shader tonemap_shader;
+    Shader tonemap_bloom_shader;
+    Shader fxaa_shader;
+    Shader taa_shader;
+
+    uint32_t frame;
+    // TAA history is only used when it was rendered at the same size, otherwise it starts over from the current frame
+    mat4 previous_view_projection;
+    ivec2 history_size;
+    bool is_history_valid;
+};
+
+static PostState state;
+
+static uint32_t post_get_bytes_per_pixel(GLenum format) {
+    return format == GL_RGBA16F ? 8 : 4;
+}
+
+// The part of a target that the render size maps to, rounded up so that smaller bloom levels cover all of it
+static ivec2 post_get_target_rect(const PostTarget& target, ivec2 render_size) {
+    return ivec2(std::max(((render_size.x * target.size.x) + state.screen_size.x - 1) / state.screen_size.x, 1),
+                 std::max(((render_size.y * target.size.y) + state.screen_size.y - 1) / state.screen_size.y, 1));
+}
+
+static bool post_create_target(uint32_t index, GLenum format, ivec2 size, uint32_t samples, bool has_depth) {
+    PostTarget& target = state.targets[index];
+    target.size = size;
+    target.format = format;
+    target.samples = samples;
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glGenTextures(1, &target.texture);
+    if (samples > 1) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, format, size.x, size.y, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, target.texture, 0);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, size.x, size.y, 0, format == GL_R11F_G11F_B10F ? GL_RGB : GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    target.depth = 0;
+    if (has_depth && samples > 1) {
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, size.x, size.y);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    } else if (has_depth) {
+        glGenTextures(1, &target.depth);
+        glBindTexture(GL_TEXTURE_2D, target.depth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, size.x, size.y, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, target.depth, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    bool is_complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!is_complete) {
+        log_error("Post target %u framebuffer not complete!", index);
+        return false;
+    }
+    return true;
+}
+
+static void post_delete_targets() {
+    for (PostTarget& target : state.targets) {
+        if (target.framebuffer == 0) {
+            continue;
+        }
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteTextures(1, &target.texture);
+        if (target.depth != 0 && target.samples > 1) {
+            glDeleteRenderbuffers(1, &target.depth);
+        } else if (target.depth != 0) {
+            glDeleteTextures(1, &target.depth);
+        }
+        target = (PostTarget) {
+            .framebuffer = 0,
+            .texture = 0,
+            .depth = 0,
+            .size = ivec2(0, 0),
+            .format = GL_NONE,
+            .samples = 0
+        };
+    }
+}
+
+static void post_add_pass(const char* section, Shader shader, uint32_t output, std::initializer_list<uint32_t> inputs, bool is_additive = false) {
+    PostPass& pass = state.passes[state.pass_count++];
+    pass.section = section;
+    pass.shader = shader;
+    pass.input_count = 0;
+    for (uint32_t input : inputs) {
+        pass.inputs[pass.input_count++] = input;
+    }
+    pass.output = output;
+    pass.is_additive = is_additive;
+}
+
+// Creates the targets the settings need and lines up the passes between them
+static bool post_build() {
+    post_delete_targets();
+    state.pass_count = 0;
+    state.is_history_valid = false;
+
+    bool is_msaa = state.anti_aliasing == POST_ANTI_ALIASING_MSAA;
+    if (!post_create_target(POST_TARGET_SCENE, GL_RGBA16F, state.screen_size, is_msaa ? POST_MSAA_SAMPLES : 1, true) ||
+            !post_create_target(POST_TARGET_TONEMAPPED, GL_RGBA8, state.screen_size, 1, false)) {
+        return false;
+    }
+
+    uint32_t hdr_target = POST_TARGET_SCENE;
+    if (is_msaa) {
+        if (!post_create_target(POST_TARGET_RESOLVED, GL_RGBA16F, state.screen_size, 1, false)) {
+            return false;
+        }
+        post_add_pass("resolve", 0, POST_TARGET_RESOLVED, { POST_TARGET_SCENE });
+        hdr_target = POST_TARGET_RESOLVED;
+    }
+
+    if (state.is_bloom_enabled) {
+        for (uint32_t level = 0; level < POST_BLOOM_LEVELS; level++) {
+            ivec2 size = ivec2(std::max(state.screen_size.x >> (level + 1), 1), std::max(state.screen_size.y >> (level + 1), 1));
+            if (!post_create_target(POST_TARGET_BLOOM + level, GL_R11F_G11F_B10F, size, 1, false)) {
+                return false;
+            }
+        }
+        post_add_pass("bloom", state.bloom_prefilter_shader, POST_TARGET_BLOOM, { hdr_target });
+        for (uint32_t level = 1; level < POST_BLOOM_LEVELS; level++) {
+            post_add_pass("bloom", state.bloom_downsample_shader, POST_TARGET_BLOOM + level, { POST_TARGET_BLOOM + level - 1 });
+        }
+        for (uint32_t level = POST_BLOOM_LEVELS - 1; level > 0; level--) {
+            post_add_pass("bloom", state.bloom_upsample_shader, POST_TARGET_BLOOM + level - 1, { POST_TARGET_BLOOM + level }, true);
+        }
+        post_add_pass("tonemap", state.tonemap_bloom_shader, POST_TARGET_TONEMAPPED, { hdr_target, POST_TARGET_BLOOM });
+    } else {
+        post_add_pass("tonemap", state.tonemap_shader, POST_TARGET_TONEMAPPED, { hdr_target });
+    }
+
+    if (state.anti_aliasing == POST_ANTI_ALIASING_FXAA) {
+        if (!post_create_target(POST_TARGET_ANTI_ALIASED, GL_RGBA8, state.screen_size, 1, false)) {
+            return false;
+        }
+        post_add_pass("anti-aliasing", state.fxaa_shader, POST_TARGET_ANTI_ALIASED, { POST_TARGET_TONEMAPPED });
+    } else if (state.anti_aliasing == POST_ANTI_ALIASING_TAA) {
+        if (!post_create_target(POST_TARGET_HISTORY, GL_RGBA8, state.screen_size, 1, false) ||
+                !post_create_target(POST_TARGET_PREVIOUS_HISTORY, GL_RGBA8, state.screen_size, 1, false)) {
+            return false;
+        }
+        post_add_pass("anti-aliasing", state.taa_shader, POST_TARGET_HISTORY, { POST_TARGET_TONEMAPPED, POST_TARGET_PREVIOUS_HISTORY, POST_INPUT_SCENE_DEPTH });
+    }
+
+    // Memory of the targets, which is roughly what a frame has to move through them at full resolution
+    uint64_t target_bytes = 0;
+    for (const PostTarget& target : state.targets) {
+        if (target.framebuffer == 0) {
+            continue;
+        }
+        uint64_t pixel_count = (uint64_t)target.size.x * target.size.y * target.samples;
+        target_bytes += pixel_count * post_get_bytes_per_pixel(target.format);
+        if (target.depth != 0) {
+            target_bytes += pixel_count * 4;
+        }
+    }
+    log_info("Post chain with %s%s, %u passes, %.1f MB of targets.", post_get_anti_aliasing_name(state.anti_aliasing),
+             state.is_bloom_enabled ? " and bloom" : "", state.pass_count, target_bytes / 1000000.0);
+    return true;
+}
+
+bool post_init(ivec2 screen_size, uint32_t quad_vao, PostAntiAliasing anti_aliasing) {
+    state.screen_size = screen_size;
+    state.quad_vao = quad_vao;
+    state.anti_aliasing = anti_aliasing;
+    state.is_bloom_enabled = true;
+    state.frame = 0;
+    state.previous_view_projection = mat4(1.0f);
+    for (PostTarget& target : state.targets) {
+        target.framebuffer = 0;
+    }
+
+    if (!shader_load(&state.bloom_prefilter_shader, "shader/screen.vert.glsl", "shader/post_bloom_downsample.frag.glsl", "PREFILTER") ||
+            !shader_load(&state.bloom_downsample_shader, "shader/screen.vert.glsl", "shader/post_bloom_downsample.frag.glsl") ||
+            !shader_load(&state.bloom_upsample_shader, "shader/screen.vert.glsl", "shader/post_bloom_upsample.frag.glsl") ||
+            !shader_load(&state.tonemap_shader, "shader/screen.vert.glsl", "shader/post_tonemap.frag.glsl") ||
+            !shader_load(&state.tonemap_bloom_shader, "shader/screen.vert.glsl", "shader/post_tonemap.frag.glsl", "BLOOM") ||
+            !shader_load(&state.fxaa_shader, "shader/screen.vert.glsl", "shader/post_fxaa.frag.glsl") ||
+            !shader_load(&state.taa_shader, "shader/screen.vert.glsl", "shader/post_taa.frag.glsl")) {
+        return false;
+    }
+
+    return post_build();
+}
+
+void post_set_anti_aliasing(PostAntiAliasing anti_aliasing) {
+    state.anti_aliasing = anti_aliasing;
+    post_build();
+}
+
+PostAntiAliasing post_get_anti_aliasing() {
+    return state.anti_aliasing;
+}
+
+const char* post_get_anti_aliasing_name(PostAntiAliasing anti_aliasing) {
+    switch (anti_aliasing) {
+        case POST_ANTI_ALIASING_NONE:
+            return "no anti-aliasing";
+        case POST_ANTI_ALIASING_MSAA:
+            return "4x MSAA";
+        case POST_ANTI_ALIASING_FXAA:
+            return "FXAA";
+        case POST_ANTI_ALIASING_TAA:
+            return "TAA";
+        default:
+            return "unknown anti-aliasing";
+    }
+}
+
+void post_set_bloom(bool is_enabled) {
+    state.is_bloom_enabled = is_enabled;
+    post_build();
+}
+
+bool post_is_bloom_enabled() {
+    return state.is_bloom_enabled;
+}
+
+uint32_t post_get_scene_framebuffer() {
+    return state.targets[POST_TARGET_SCENE].framebuffer;
+}
+
+vec2 post_get_jitter(ivec2 render_size) {
+    if (state.anti_aliasing != POST_ANTI_ALIASING_TAA) {
+        return vec2(0.0f, 0.0f);
+    }
+
+    // Halton 2, 3 sequence, which covers the pixel evenly over a few frames
+    uint32_t bases[2] = { 2, 3 };
+    float offsets[2];
+    for (uint32_t axis = 0; axis < 2; axis++) {
+        float fraction = 1.0f;
+        float value = 0.0f;
+        for (uint32_t index = (state.frame % POST_TAA_JITTER_COUNT) + 1; index > 0; index /= bases[axis]) {
+            fraction /= bases[axis];
+            value += fraction * (index % bases[axis]);
+        }
+        offsets[axis] = value - 0.5f;
+    }
+    // A pixel is 2 / size wide in NDC
+    return vec2((offsets[0] * 2.0f) / render_size.x, (offsets[1] * 2.0f) / render_size.y);
+}
+
+uint32_t post_run(ivec2 render_size, const mat4& view_projection) {
+    bool is_history_valid = state.is_history_valid && state.history_size.x == render_size.x && state.history_size.y == render_size.y;
+    mat4 reprojection = state.previous_view_projection * view_projection.inverse();
+    vec2 jitter = post_get_jitter(render_size);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBindVertexArray(state.quad_vao);
+    const char* section = NULL;
+    uint64_t bytes = 0;
+    uint32_t output = POST_TARGET_SCENE;
+    for (uint32_t pass_index = 0; pass_index < state.pass_count; pass_index++) {
+        const PostPass& pass = state.passes[pass_index];
+        if (pass.section != section) {
+            if (section != NULL) {
+                profiler_end();
+            }
+            profiler_begin(pass.section);
+            section = pass.section;
+        }
+
+        const PostTarget& target = state.targets[pass.output];
+        ivec2 output_rect = post_get_target_rect(target, render_size);
+        uint64_t output_bytes = (uint64_t)output_rect.x * output_rect.y * post_get_bytes_per_pixel(target.format);
+        output = pass.output;
+        if (pass.shader == 0) {
+            const PostTarget& source = state.targets[pass.inputs[0]];
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, source.framebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebuffer);
+            glBlitFramebuffer(0, 0, output_rect.x, output_rect.y, 0, 0, output_rect.x, output_rect.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            bytes += (output_bytes * source.samples) + output_bytes;
+            continue;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        glViewport(0, 0, output_rect.x, output_rect.y);
+        glBlendFunc(GL_ONE, pass.is_additive ? GL_ONE : GL_ZERO);
+        shader_use(pass.shader);
+        shader_set_uniform_vec2(pass.shader, "output_size", vec2((float)output_rect.x, (float)output_rect.y));
+        for (uint32_t input_index = 0; input_index < pass.input_count; input_index++) {
+            const PostTarget& input = state.targets[pass.inputs[input_index] == POST_INPUT_SCENE_DEPTH ? POST_TARGET_SCENE : pass.inputs[input_index]];
+            bool is_depth = pass.inputs[input_index] == POST_INPUT_SCENE_DEPTH;
+            ivec2 input_rect = post_get_target_rect(input, render_size);
+            glActiveTexture(GL_TEXTURE0 + input_index);
+            glBindTexture(GL_TEXTURE_2D, is_depth ? input.depth : input.texture);
+
+            // Uniforms are set every time since the passes are few, and hot reloads reset them anyway
+            char name[32];
+            snprintf(name, sizeof(name), "input_textures[%u]", input_index);
+            shader_set_uniform_int(pass.shader, name, input_index);
+            snprintf(name, sizeof(name), "input_scale[%u]", input_index);
+            shader_set_uniform_vec2(pass.shader, name, vec2((float)input_rect.x / input.size.x, (float)input_rect.y / input.size.y));
+            snprintf(name, sizeof(name), "input_texel[%u]", input_index);
+            shader_set_uniform_vec2(pass.shader, name, vec2(1.0f / input.size.x, 1.0f / input.size.y));
+            bytes += (uint64_t)input_rect.x * input_rect.y * (is_depth ? 4 : post_get_bytes_per_pixel(input.format));
+        }
+        if (pass.shader == state.bloom_prefilter_shader) {
+            shader_set_uniform_float(pass.shader, "threshold", POST_BLOOM_THRESHOLD);
+        } else if (pass.shader == state.tonemap_bloom_shader) {
+            shader_set_uniform_float(pass.shader, "bloom_intensity", POST_BLOOM_INTENSITY);
+        } else if (pass.shader == state.taa_shader) {
+            shader_set_uniform_mat4(pass.shader, "reprojection", &reprojection);
+            shader_set_uniform_vec2(pass.shader, "jitter", jitter);
+            shader_set_uniform_float(pass.shader, "history_weight", is_history_valid ? POST_TAA_HISTORY_WEIGHT : 0.0f);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        bytes += pass.is_additive ? output_bytes * 2 : output_bytes;
+
+        for (uint32_t input_index = 0; input_index < pass.input_count; input_index++) {
+            glActiveTexture(GL_TEXTURE0 + input_index);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
+    if (section != NULL) {
+        profiler_end();
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(0);
+    glBlendFunc(GL_ONE, GL_ZERO);
+    glEnable(GL_DEPTH_TEST);
+    profiler_count("post MB", bytes / 1000000.0);
+
+    uint32_t output_texture = state.targets[output].texture;
+    if (state.anti_aliasing == POST_ANTI_ALIASING_TAA) {
+        std::swap(state.targets[POST_TARGET_HISTORY], state.targets[POST_TARGET_PREVIOUS_HISTORY]);
+        state.previous_view_projection = view_projection;
+        state.history_size = render_size;
+        state.is_history_valid = true;
+    }
+    state.frame++;
+    return output_texture;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "math/math.h"
+#include <cstdint>
+
+enum PostAntiAliasing {
+    POST_ANTI_ALIASING_NONE,
+    POST_ANTI_ALIASING_MSAA,
+    POST_ANTI_ALIASING_FXAA,
+    POST_ANTI_ALIASING_TAA,
+    POST_ANTI_ALIASING_COUNT
+};
+
+// The scene is rendered in linear HDR into an RGBA16F target and turned into the displayed image by a chain of full
+// screen passes: the MSAA resolve when multisampled, bloom, a single tonemap and gamma pass, then FXAA or TAA. Each pass
+// names the targets it reads and the one it writes, and the chain and its targets are rebuilt whenever the settings
+// change. Like the scene, every pass only covers the part of its target that the render size maps to
+bool post_init(ivec2 screen_size, uint32_t quad_vao, PostAntiAliasing anti_aliasing);
+void post_set_anti_aliasing(PostAntiAliasing anti_aliasing);
+PostAntiAliasing post_get_anti_aliasing();
+const char* post_get_anti_aliasing_name(PostAntiAliasing anti_aliasing);
+void post_set_bloom(bool is_enabled);
+bool post_is_bloom_enabled();
+// Where the scene is drawn, with a depth and stencil attachment. It changes when the settings do
+uint32_t post_get_scene_framebuffer();
+// Sub-pixel offset in NDC to add to this frame's projection, zero unless TAA is on
+vec2 post_get_jitter(ivec2 render_size);
+// Runs the chain over the scene and returns the texture holding the final, display ready image. The view projection
+// is this frame's unjittered one, which TAA needs to find where pixels were in the previous frame
+uint32_t post_run(ivec2 render_size, const mat4& view_projection);
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "profiler.h"
+
+#include "core/logger.h"
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <cstdio>
+#include <cstring>
+
+static const uint32_t PROFILER_MAX_SECTIONS = 16;
+static const uint32_t PROFILER_MAX_COUNTERS = 16;
+static const uint32_t PROFILER_MAX_DEPTH = 8;
+// How many frames old the GPU results are when they get read
+static const uint32_t PROFILER_FRAME_LATENCY = 4;
+static const double PROFILER_REPORT_INTERVAL = 1.0;
+
+struct ProfilerSection {
+    const char* name;
+    double cpu_total;
+    double gpu_total;
+    uint32_t cpu_samples;
+    uint32_t gpu_samples;
+};
+
+struct ProfilerCounter {
+    const char* name;
+    double total;
+};
+
+// Timestamp queries of one frame in flight, a begin and end query per section
+struct ProfilerFrame {
+    uint32_t queries[PROFILER_MAX_SECTIONS][2];
+    bool is_section_used[PROFILER_MAX_SECTIONS];
+};
+
+struct Profiler {
+    bool is_enabled;
+    double counter_frequency;
+
+    ProfilerSection sections[PROFILER_MAX_SECTIONS];
+    uint32_t section_count;
+    ProfilerCounter counters[PROFILER_MAX_COUNTERS];
+    uint32_t counter_count;
+
+    ProfilerFrame frames[PROFILER_FRAME_LATENCY];
+    uint32_t frame_index;
+
+    uint32_t stack[PROFILER_MAX_DEPTH];
+    uint64_t stack_start[PROFILER_MAX_DEPTH];
+    uint32_t stack_size;
+
+    uint64_t frame_start;
+    double frame_total;
+    uint32_t frame_count;
+    uint64_t report_start;
+    // The last report as a table, one line per section and counter
+    char overlay[2048];
+};
+
+static Profiler profiler;
+
+static double profiler_seconds_since(uint64_t start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / profiler.counter_frequency;
+}
+
+static uint32_t profiler_find_section(const char* name) {
+    for (uint32_t section = 0; section < profiler.section_count; section++) {
+        if (profiler.sections[section].name == name || strcmp(profiler.sections[section].name, name) == 0) {
+            return section;
+        }
+    }
+    if (profiler.section_count == PROFILER_MAX_SECTIONS) {
+        return PROFILER_MAX_SECTIONS;
+    }
+
+    profiler.sections[profiler.section_count] = (ProfilerSection) {
+        .name = name,
+        .cpu_total = 0.0,
+        .gpu_total = 0.0,
+        .cpu_samples = 0,
+        .gpu_samples = 0
+    };
+    return profiler.section_count++;
+}
+
+// Collects the GPU times of the frame that used this slot PROFILER_FRAME_LATENCY frames ago
+static void profiler_read_frame(ProfilerFrame& frame) {
+    for (uint32_t section = 0; section < PROFILER_MAX_SECTIONS; section++) {
+        if (!frame.is_section_used[section]) {
+            continue;
+        }
+        frame.is_section_used[section] = false;
+
+        GLint is_available = 0;
+        glGetQueryObjectiv(frame.queries[section][1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+        if (!is_available) {
+            continue;
+        }
+
+        GLuint64 begin;
+        GLuint64 end;
+        glGetQueryObjectui64v(frame.queries[section][0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[section][1], GL_QUERY_RESULT, &end);
+        profiler.sections[section].gpu_total += (double)(end - begin) / 1000000000.0;
+        profiler.sections[section].gpu_samples++;
+    }
+}
+
+static void profiler_report() {
+    char report[1024];
+    double frame_ms = (profiler.frame_total * 1000.0) / profiler.frame_count;
+    int length = snprintf(report, sizeof(report), "Frame %.2f ms", frame_ms);
+    int overlay_length = snprintf(profiler.overlay, sizeof(profiler.overlay), "%-20s %6.2f ms\n%-20s %6s %9s\n", "frame", frame_ms, "", "cpu", "gpu");
+    for (uint32_t index = 0; index < profiler.section_count; index++) {
+        ProfilerSection& section = profiler.sections[index];
+        double cpu_ms = section.cpu_samples == 0 ? 0.0 : (section.cpu_total * 1000.0) / section.cpu_samples;
+        double gpu_ms = section.gpu_samples == 0 ? 0.0 : (section.gpu_total * 1000.0) / section.gpu_samples;
+        if (length < (int)sizeof(report)) {
+            length += snprintf(report + length, sizeof(report) - length, " | %s cpu %.2f gpu %.2f", section.name, cpu_ms, gpu_ms);
+        }
+        if (overlay_length < (int)sizeof(profiler.overlay)) {
+            overlay_length += snprintf(profiler.overlay + overlay_length, sizeof(profiler.overlay) - overlay_length, "%-20s %6.2f ms %6.2f ms\n", section.name, cpu_ms, gpu_ms);
+        }
+
+        section.cpu_total = 0.0;
+        section.gpu_total = 0.0;
+        section.cpu_samples = 0;
+        section.gpu_samples = 0;
+    }
+    for (uint32_t index = 0; index < profiler.counter_count; index++) {
+        ProfilerCounter& counter = profiler.counters[index];
+        if (length < (int)sizeof(report)) {
+            length += snprintf(report + length, sizeof(report) - length, " | %s %.2f", counter.name, counter.total / profiler.frame_count);
+        }
+        if (overlay_length < (int)sizeof(profiler.overlay)) {
+            overlay_length += snprintf(profiler.overlay + overlay_length, sizeof(profiler.overlay) - overlay_length, "%-20s %9.2f\n", counter.name, counter.total / profiler.frame_count);
+        }
+        counter.total = 0.0;
+    }
+    log_info("%s", report);
+
+    profiler.frame_total = 0.0;
+    profiler.frame_count = 0;
+}
+
+void profiler_init() {
+    profiler.is_enabled = false;
+    profiler.counter_frequency = (double)SDL_GetPerformanceFrequency();
+    profiler.section_count = 0;
+    profiler.counter_count = 0;
+    profiler.frame_index = 0;
+    profiler.stack_size = 0;
+    profiler.overlay[0] = '\0';
+
+    for (uint32_t frame = 0; frame < PROFILER_FRAME_LATENCY; frame++) {
+        glGenQueries(PROFILER_MAX_SECTIONS * 2, &profiler.frames[frame].queries[0][0]);
+        for (uint32_t section = 0; section < PROFILER_MAX_SECTIONS; section++) {
+            profiler.frames[frame].is_section_used[section] = false;
+        }
+    }
+}
+
+void profiler_set_enabled(bool enabled) {
+    if (enabled && !profiler.is_enabled) {
+        for (uint32_t section = 0; section < profiler.section_count; section++) {
+            profiler.sections[section].cpu_total = 0.0;
+            profiler.sections[section].gpu_total = 0.0;
+            profiler.sections[section].cpu_samples = 0;
+            profiler.sections[section].gpu_samples = 0;
+        }
+        for (uint32_t counter = 0; counter < profiler.counter_count; counter++) {
+            profiler.counters[counter].total = 0.0;
+        }
+        profiler.frame_total = 0.0;
+        profiler.frame_count = 0;
+        profiler.report_start = SDL_GetPerformanceCounter();
+    }
+    profiler.is_enabled = enabled;
+}
+
+bool profiler_is_enabled() {
+    return profiler.is_enabled;
+}
+
+const char* profiler_get_overlay() {
+    return profiler.overlay;
+}
+
+void profiler_begin_frame() {
+    profiler.frame_start = SDL_GetPerformanceCounter();
+    profiler.stack_size = 0;
+}
+
+void profiler_end_frame() {
+    profiler.frame_total += profiler_seconds_since(profiler.frame_start);
+    profiler.frame_count++;
+
+    // The next slot was last used PROFILER_FRAME_LATENCY frames ago, so its queries are very likely done
+    profiler.frame_index = (profiler.frame_index + 1) % PROFILER_FRAME_LATENCY;
+    profiler_read_frame(profiler.frames[profiler.frame_index]);
+
+    if (profiler.is_enabled && profiler_seconds_since(profiler.report_start) >= PROFILER_REPORT_INTERVAL) {
+        profiler_report();
+        profiler.report_start = SDL_GetPerformanceCounter();
+    }
+}
+
+void profiler_begin(const char* name) {
+    if (!profiler.is_enabled) {
+        return;
+    }
+    if (profiler.stack_size == PROFILER_MAX_DEPTH) {
+        log_warn("Profiler section %s is nested too deep.", name);
+        return;
+    }
+
+    uint32_t section = profiler_find_section(name);
+    profiler.stack[profiler.stack_size] = section;
+    profiler.stack_start[profiler.stack_size] = SDL_GetPerformanceCounter();
+    profiler.stack_size++;
+
+    ProfilerFrame& frame = profiler.frames[profiler.frame_index];
+    if (section != PROFILER_MAX_SECTIONS && !frame.is_section_used[section]) {
+        glQueryCounter(frame.queries[section][0], GL_TIMESTAMP);
+    }
+}
+
+void profiler_end() {
+    if (!profiler.is_enabled || profiler.stack_size == 0) {
+        return;
+    }
+
+    profiler.stack_size--;
+    uint32_t section = profiler.stack[profiler.stack_size];
+    if (section == PROFILER_MAX_SECTIONS) {
+        return;
+    }
+
+    profiler.sections[section].cpu_total += profiler_seconds_since(profiler.stack_start[profiler.stack_size]);
+    profiler.sections[section].cpu_samples++;
+
+    ProfilerFrame& frame = profiler.frames[profiler.frame_index];
+    if (!frame.is_section_used[section]) {
+        glQueryCounter(frame.queries[section][1], GL_TIMESTAMP);
+        frame.is_section_used[section] = true;
+    }
+}
+
+void profiler_count(const char* name, double value) {
+    if (!profiler.is_enabled) {
+        return;
+    }
+
+    for (uint32_t counter = 0; counter < profiler.counter_count; counter++) {
+        if (profiler.counters[counter].name == name || strcmp(profiler.counters[counter].name, name) == 0) {
+            profiler.counters[counter].total += value;
+            return;
+        }
+    }
+    if (profiler.counter_count < PROFILER_MAX_COUNTERS) {
+        profiler.counters[profiler.counter_count++] = (ProfilerCounter) {
+            .name = name,
+            .total = value
+        };
+    }
+}
\ No newline at end of file
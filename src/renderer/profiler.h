@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Times named sections of each frame on the CPU and the GPU. GPU times come from timestamp queries that are
+// read back a few frames later, so profiling never waits on the GPU. Sections can nest, but each one should
+// only be entered once per frame. While enabled, averages are logged once per second
+void profiler_init();
+void profiler_set_enabled(bool enabled);
+bool profiler_is_enabled();
+// The averages of the last report as a table for drawing on screen, empty until the first report
+const char* profiler_get_overlay();
+
+void profiler_begin_frame();
+void profiler_end_frame();
+// Name must be a string literal or otherwise outlive the profiler
+void profiler_begin(const char* name);
+void profiler_end();
+// Adds to a per frame counter, reported as the average per frame
+void profiler_count(const char* name, double value);
\ No newline at end of file
@@ -1,46 +1,546 @@
 #include "renderer.h"
 
 #include "core/logger.h"
+#include "core/resource.h"
 #include "shader.h"
+#include "light_cluster.h"
+#include "profiler.h"
+#include "indirect.h"
+#include "occlusion.h"
+#include "font.h"
+#include "dynamic_resolution.h"
+#include "post.h"
+#include "capture.h"
+#include "core/job.h"
+#include "core/hash.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
+static const float RENDERER_NEAR_PLANE = 0.1f;
+static const float RENDERER_FAR_PLANE = 100.0f;
+// Lights are cut off where their inverse square falloff drops below this
+static const float RENDERER_LIGHT_THRESHOLD = 0.05f;
+// Texture units of the light buffers. The units below are left for material textures
+static const uint32_t RENDERER_LIGHT_DATA_UNIT = 5;
+static const uint32_t RENDERER_LIGHT_CLUSTERS_UNIT = 6;
+static const uint32_t RENDERER_LIGHT_INDICES_UNIT = 7;
+static const uint32_t RENDERER_SHADOW_MAP_UNIT = 8;
+static const uint32_t RENDERER_DRAW_MODELS_UNIT = 9;
+// Point light shadows are cube maps in one cube map array, one layer per shadowed light
+static const uint32_t RENDERER_MAX_SHADOW_LIGHTS = 16;
+static const uint32_t RENDERER_SHADOW_MAP_SIZE = 256;
+static const float RENDERER_SHADOW_NEAR_PLANE = 0.05f;
+// Shadow maps are only re-rendered when something inside the light's radius changed, and at most this many per frame.
+// Lights that miss out keep their old shadows until it is their turn
+static const uint32_t RENDERER_SHADOW_UPDATE_BUDGET = 2;
+// Scenes with more draws than this fall back to one draw call per surface
+static const uint32_t RENDERER_MAX_INDIRECT_DRAWS = 8192;
+static const uint32_t RENDERER_INDIRECT_BUILD_GRAIN = 256;
+static const uint32_t RENDERER_DRAW_INDEX_ATTRIBUTE = 3;
+// Shader variant feature of the surface shaders, reading the model matrix from draw_models instead of a uniform
+static const uint32_t RENDERER_SURFACE_INDIRECT = 1 << 0;
+// Surfaces share one vertex buffer so that a single indirect draw can mix them
+static const uint32_t RENDERER_QUAD3D_FIRST_VERTEX = 0;
+static const uint32_t RENDERER_QUAD3D_VERTEX_COUNT = 6;
+static const uint32_t RENDERER_CUBE_FIRST_VERTEX = 6;
+static const uint32_t RENDERER_CUBE_VERTEX_COUNT = 36;
+static const int RENDERER_FONT_SIZE = 14;
+// GPU time per frame the render scale aims for, leaving some headroom below the 60 Hz frame
+static const double RENDERER_TARGET_GPU_TIME = 0.0145;
+// How much the final blit sharpens when the scene was rendered below full size
+static const float RENDERER_UPSCALE_SHARPNESS = 0.4f;
+
+enum RendererGBufferTexture {
+    RENDERER_GBUFFER_ALBEDO,
+    RENDERER_GBUFFER_NORMAL,
+    RENDERER_GBUFFER_MATERIAL,
+    RENDERER_GBUFFER_DEPTH,
+    RENDERER_GBUFFER_COUNT
+};
+
+// Scene draws are recorded and submitted at the end of the scene so that shadows can be rendered from them first
+struct RendererSceneDraw {
+    mat4 model;
+    // Bounding sphere, to find the lights that can see the draw, and bounding box for occlusion culling
+    vec3 center;
+    float radius;
+    AABB bounds;
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    Texture texture;
+    // Set when the scene is built, from the frustum and the occlusion culler
+    bool is_visible;
+};
+
+struct RendererSceneBuild {
+    RendererSceneDraw* draws;
+    const uint32_t* order;
+    bool is_indirect;
+    bool is_occlusion_enabled;
+    const DepthRaster* occlusion_raster;
+    IndirectFrame frame;
+    std::atomic<uint32_t> culled_count;
+    std::atomic<uint32_t> occluded_count;
+};
+
+struct RendererShadow {
+    // Hash of the draws within the light's radius when the shadow map was rendered and as of this frame.
+    // The shadow map is out of date whenever they differ
+    uint64_t rendered_scene_hash;
+    uint64_t scene_hash;
+    uint32_t stale_frames;
+    bool is_rendered;
+};
+
+struct RendererTextureBuffer {
+    uint32_t buffer;
+    uint32_t texture;
+};
+
 struct RendererState {
     SDL_Window* window; // Pointer to the window, but it "belongs" in application
     SDL_GLContext context;
 
     ivec2 screen_size;
     ivec2 window_size;
+    // The part of the screen targets the scene is rendered into this frame, picked by dynamic resolution
+    ivec2 render_size;
 
+    // Linear, so that it comes out of the post chain as the color that was asked for
     vec3 clear_color;
+    mat4 projection;
+    // The projection with this frame's TAA jitter, which everything drawn from the camera uses
+    mat4 camera_projection;
+    mat4 view;
+    vec3 view_position;
+    vec4 frustum_planes[6];
 
     uint32_t quad_vao;
-    uint32_t glyph_vao;
-    uint32_t cube_vao;
-    uint32_t quad3d_vao;
+    uint32_t surface_vao;
+
+    // Text is queued over the frame and drawn in one call right before presenting
+    Font font;
+    uint32_t text_vao;
+    uint32_t text_vbo;
+    uint32_t text_buffer_capacity;
+    std::vector<TextVertex> text_vertices;
 
-    uint32_t screen_framebuffer;
-    uint32_t screen_texture;
-    uint32_t screen_intermediate_framebuffer;
-    uint32_t screen_intermediate_texture;
+    RendererLighting lighting;
+    bool is_in_scene;
+    uint32_t gbuffer_framebuffer;
+    uint32_t gbuffer_textures[RENDERER_GBUFFER_COUNT];
+    std::vector<RendererSceneDraw> scene_draws;
+    // Without multi-draw indirect, scene draws are submitted one by one instead
+    bool is_indirect_supported;
+    std::vector<uint32_t> scene_order;
+    // Occlusion culling against the level BVH, tested in the depth prepass
+    bool is_depth_prepass_enabled;
+    OcclusionCuller occlusion;
+    const DepthRaster* occlusion_raster;
+
+    uint32_t shadow_framebuffer;
+    uint32_t shadow_maps;
+    std::vector<RendererShadow> shadows;
+    std::vector<uint32_t> shadow_candidates;
 
     Shader screen_shader;
     Shader text_shader;
-    Shader model_shader;
+    // Features: SKINNED, NORMAL_MAP
+    ShaderVariants model_shaders;
     Shader geometry_shader;
     Shader light_shader;
     Shader editor_quad_shader;
+    // Features: INDIRECT
+    ShaderVariants lit_shaders;
+    ShaderVariants gbuffer_shaders;
+    ShaderVariants depth_shaders;
+    Shader deferred_shader;
+    Shader shadow_shader;
+
+    // Clustered lighting. Lights are binned on the CPU whenever the lights or the camera change
+    std::vector<LightClusterSphere> light_spheres;
+    std::vector<RendererLight> lights;
+    std::vector<vec4> light_data;
+    LightClusterGrid light_clusters;
+    RendererTextureBuffer light_data_buffer;
+    RendererTextureBuffer light_clusters_buffer;
+    RendererTextureBuffer light_indices_buffer;
 };
 
 static RendererState state;
 
-bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
+static RendererTextureBuffer renderer_create_texture_buffer(GLenum format, uint32_t texture_unit) {
+    RendererTextureBuffer result;
+    glGenBuffers(1, &result.buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, result.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 0, NULL, GL_STREAM_DRAW);
+
+    glGenTextures(1, &result.texture);
+    glActiveTexture(GL_TEXTURE0 + texture_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, result.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, result.buffer);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return result;
+}
+
+static void renderer_upload_texture_buffer(const RendererTextureBuffer& texture_buffer, const void* data, size_t size) {
+    glBindBuffer(GL_TEXTURE_BUFFER, texture_buffer.buffer);
+    // Reallocating every upload lets the driver hand out fresh storage instead of waiting on draws still using the old one
+    glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+static uint32_t renderer_create_gbuffer_texture(GLenum internal_format, GLenum format, GLenum type, GLenum attachment) {
+    uint32_t texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, state.screen_size.x, state.screen_size.y, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+static void renderer_set_light_uniforms(Shader shader) {
+    shader_set_uniform_vec2(shader, "render_size", vec2((float)state.render_size.x, (float)state.render_size.y));
+    shader_set_uniform_float(shader, "cluster_near", RENDERER_NEAR_PLANE);
+    shader_set_uniform_float(shader, "cluster_far", RENDERER_FAR_PLANE);
+    shader_set_uniform_int(shader, "light_data", RENDERER_LIGHT_DATA_UNIT);
+    shader_set_uniform_int(shader, "light_clusters", RENDERER_LIGHT_CLUSTERS_UNIT);
+    shader_set_uniform_int(shader, "light_indices", RENDERER_LIGHT_INDICES_UNIT);
+    shader_set_uniform_int(shader, "shadow_maps", RENDERER_SHADOW_MAP_UNIT);
+}
+
+// Sets every uniform that stays the same between frames, for any shader. GL ignores the ones a shader doesn't have.
+// Used for shader variants when they're compiled and for shaders that were rebuilt by a hot reload
+static void renderer_setup_shader(Shader shader) {
+    shader_set_uniform_mat4(shader, "projection", &state.camera_projection);
+    shader_set_uniform_mat4(shader, "view", &state.view);
+    shader_set_uniform_vec3(shader, "view_position", state.view_position);
+    shader_set_uniform_int(shader, "material_albedo", 0);
+    shader_set_uniform_int(shader, "material_metallic_roughness", 1);
+    shader_set_uniform_int(shader, "material_normal", 2);
+    shader_set_uniform_int(shader, "material_emissive", 3);
+    shader_set_uniform_int(shader, "material_occlusion", 4);
+    shader_set_uniform_int(shader, "draw_models", RENDERER_DRAW_MODELS_UNIT);
+    shader_set_uniform_int(shader, "screen_texture", 0);
+    shader_set_uniform_int(shader, "atlas_texture", 0);
+    shader_set_uniform_vec2(shader, "screen_size", vec2((float)state.screen_size.x, (float)state.screen_size.y));
+    shader_set_uniform_int(shader, "gbuffer_albedo", RENDERER_GBUFFER_ALBEDO);
+    shader_set_uniform_int(shader, "gbuffer_normal", RENDERER_GBUFFER_NORMAL);
+    shader_set_uniform_int(shader, "gbuffer_material", RENDERER_GBUFFER_MATERIAL);
+    shader_set_uniform_int(shader, "gbuffer_depth", RENDERER_GBUFFER_DEPTH);
+    renderer_set_light_uniforms(shader);
+}
+
+// Compiles the variant on first use. A variant that failed to compile comes back as 0, which draws nothing
+static Shader renderer_get_surface_shader(ShaderVariants* variants, bool is_indirect) {
+    Shader shader;
+    shader_variants_get(variants, is_indirect ? RENDERER_SURFACE_INDIRECT : 0, &shader);
+    return shader;
+}
+
+static void renderer_draw_surface(Shader shader, const mat4& model, uint32_t first_vertex, uint32_t vertex_count, Texture texture) {
+    shader_use(shader);
+    shader_set_uniform_mat4(shader, "model", (mat4*)&model);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_get_id(texture));
+
+    glBindVertexArray(state.surface_vao);
+    glDrawArrays(GL_TRIANGLES, first_vertex, vertex_count);
+    glBindVertexArray(0);
+}
+
+static void renderer_submit_surface(const Transform& transform, vec3 local_extents, uint32_t first_vertex, uint32_t vertex_count, Texture texture) {
+    mat4 model = transform.to_mat4();
+    if (!state.is_in_scene) {
+        renderer_draw_surface(state.editor_quad_shader, model, first_vertex, vertex_count, texture);
+        return;
+    }
+
+    // Quads and cubes both span -1 to 1, so the scale reaches the furthest corner
+    vec3 half_extents = vec3(
+        (fabsf(model[0].x) * local_extents.x) + (fabsf(model[1].x) * local_extents.y) + (fabsf(model[2].x) * local_extents.z),
+        (fabsf(model[0].y) * local_extents.x) + (fabsf(model[1].y) * local_extents.y) + (fabsf(model[2].y) * local_extents.z),
+        (fabsf(model[0].z) * local_extents.x) + (fabsf(model[1].z) * local_extents.y) + (fabsf(model[2].z) * local_extents.z));
+    state.scene_draws.push_back((RendererSceneDraw) {
+        .model = model,
+        .center = transform.origin,
+        .radius = transform.scale.length(),
+        .bounds = (AABB) {
+            .min = transform.origin - half_extents,
+            .max = transform.origin + half_extents
+        },
+        .first_vertex = first_vertex,
+        .vertex_count = vertex_count,
+        .texture = texture,
+        .is_visible = true
+    });
+}
+
+static bool renderer_is_draw_in_frustum(const RendererSceneDraw& draw) {
+    for (const vec4& plane : state.frustum_planes) {
+        if ((plane.x * draw.center.x) + (plane.y * draw.center.y) + (plane.z * draw.center.z) + plane.w < -draw.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Frustum planes of the view projection matrix, pointing inwards and normalized so that they give world distances
+static void renderer_update_frustum() {
+    mat4 view_projection = state.projection * state.view;
+    for (uint32_t plane_index = 0; plane_index < 6; plane_index++) {
+        uint32_t row = plane_index / 2;
+        float sign = plane_index % 2 == 0 ? 1.0f : -1.0f;
+        vec4 plane;
+        for (uint32_t column = 0; column < 4; column++) {
+            plane[column] = view_projection[column][3] + (sign * view_projection[column][row]);
+        }
+        float length = sqrtf((plane.x * plane.x) + (plane.y * plane.y) + (plane.z * plane.z));
+        state.frustum_planes[plane_index] = vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+    }
+}
+
+static bool renderer_is_draw_in_light(const RendererSceneDraw& draw, const LightClusterSphere& light) {
+    vec3 offset = draw.center - vec3(light.x, light.y, light.z);
+    float distance = draw.radius + light.w;
+    return vec3::dot(offset, offset) <= distance * distance;
+}
+
+static void renderer_render_shadow_map(uint32_t light_index) {
+    static const vec3 FACE_DIRECTIONS[6] = {
+        vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+        vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f)
+    };
+    static const vec3 FACE_UPS[6] = {
+        vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f),
+        vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)
+    };
+
+    const LightClusterSphere& light = state.light_spheres[light_index];
+    vec3 light_position = vec3(light.x, light.y, light.z);
+    mat4 projection = mat4::perspective(deg_to_rad(90.0f), 1.0f, RENDERER_SHADOW_NEAR_PLANE, light.w);
+
+    shader_use(state.shadow_shader);
+    shader_set_uniform_vec3(state.shadow_shader, "light_position", light_position);
+    shader_set_uniform_float(state.shadow_shader, "light_radius", light.w);
+    glBindVertexArray(state.surface_vao);
+    for (uint32_t face = 0; face < 6; face++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, state.shadow_maps, 0, (light_index * 6) + face);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        mat4 view_projection = projection * mat4::look_at(light_position, light_position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+        shader_set_uniform_mat4(state.shadow_shader, "view_projection", &view_projection);
+        for (const RendererSceneDraw& draw : state.scene_draws) {
+            if (!renderer_is_draw_in_light(draw, light)) {
+                continue;
+            }
+            shader_set_uniform_mat4(state.shadow_shader, "model", (mat4*)&draw.model);
+            glDrawArrays(GL_TRIANGLES, draw.first_vertex, draw.vertex_count);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+static void renderer_update_shadows() {
+    uint32_t shadow_count = std::min((uint32_t)state.light_spheres.size(), RENDERER_MAX_SHADOW_LIGHTS);
+
+    state.shadow_candidates.clear();
+    for (uint32_t light_index = 0; light_index < shadow_count; light_index++) {
+        uint64_t hash = HASH_FNV1A_BASIS;
+        for (const RendererSceneDraw& draw : state.scene_draws) {
+            if (renderer_is_draw_in_light(draw, state.light_spheres[light_index])) {
+                hash = hash_fnv1a(hash, &draw.model, sizeof(draw.model));
+                hash = hash_fnv1a(hash, &draw.first_vertex, sizeof(draw.first_vertex));
+            }
+        }
+        RendererShadow& shadow = state.shadows[light_index];
+        shadow.scene_hash = hash;
+        if (shadow.is_rendered && shadow.rendered_scene_hash == hash) {
+            shadow.stale_frames = 0;
+            continue;
+        }
+        shadow.stale_frames++;
+        state.shadow_candidates.push_back(light_index);
+    }
+
+    // Lights that never had a shadow go first, then the ones that have been out of date the longest, then the closest
+    std::sort(state.shadow_candidates.begin(), state.shadow_candidates.end(), [](uint32_t a, uint32_t b) {
+        const RendererShadow& shadow_a = state.shadows[a];
+        const RendererShadow& shadow_b = state.shadows[b];
+        if (shadow_a.is_rendered != shadow_b.is_rendered) {
+            return !shadow_a.is_rendered;
+        }
+        if (shadow_a.stale_frames != shadow_b.stale_frames) {
+            return shadow_a.stale_frames > shadow_b.stale_frames;
+        }
+        vec3 offset_a = vec3(state.light_spheres[a].x, state.light_spheres[a].y, state.light_spheres[a].z) - state.view_position;
+        vec3 offset_b = vec3(state.light_spheres[b].x, state.light_spheres[b].y, state.light_spheres[b].z) - state.view_position;
+        return vec3::dot(offset_a, offset_a) < vec3::dot(offset_b, offset_b);
+    });
+
+    uint32_t update_count = std::min((uint32_t)state.shadow_candidates.size(), RENDERER_SHADOW_UPDATE_BUDGET);
+    profiler_count("shadow updates", update_count);
+    if (update_count == 0) {
+        return;
+    }
+
+    profiler_begin("shadows");
+    glBindFramebuffer(GL_FRAMEBUFFER, state.shadow_framebuffer);
+    glViewport(0, 0, RENDERER_SHADOW_MAP_SIZE, RENDERER_SHADOW_MAP_SIZE);
+    for (uint32_t i = 0; i < update_count; i++) {
+        uint32_t light_index = state.shadow_candidates[i];
+        renderer_render_shadow_map(light_index);
+        RendererShadow& shadow = state.shadows[light_index];
+        shadow.rendered_scene_hash = shadow.scene_hash;
+        shadow.stale_frames = 0;
+        shadow.is_rendered = true;
+    }
+    glViewport(0, 0, state.render_size.x, state.render_size.y);
+    profiler_end();
+}
+
+// Culls the draws and, for indirect submission, writes their commands straight into the mapped indirect buffer.
+// Runs on the job system when drawing indirectly
+static void renderer_build_scene_commands(void* data, uint32_t begin, uint32_t end, uint32_t thread_index) {
+    RendererSceneBuild* build = (RendererSceneBuild*)data;
+    uint32_t culled_count = 0;
+    uint32_t occluded_count = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        RendererSceneDraw& draw = build->draws[build->order[i]];
+        draw.is_visible = renderer_is_draw_in_frustum(draw);
+        if (draw.is_visible && ((build->is_occlusion_enabled && occlusion_is_hidden(state.occlusion, draw.bounds)) ||
+                                (build->occlusion_raster != NULL && depth_raster_is_occluded(*build->occlusion_raster, draw.bounds)))) {
+            draw.is_visible = false;
+            occluded_count++;
+        }
+        culled_count += draw.is_visible ? 0 : 1;
+        if (!build->is_indirect) {
+            continue;
+        }
+
+        // Culled draws keep their command with no instances, so that ranges can be written without compacting them
+        build->frame.commands[i] = (IndirectDrawCommand) {
+            .vertex_count = draw.vertex_count,
+            .instance_count = draw.is_visible ? 1u : 0u,
+            .first_vertex = draw.first_vertex,
+            .base_instance = build->frame.base_draw + i
+        };
+        build->frame.models[i] = draw.model;
+    }
+    build->culled_count.fetch_add(culled_count);
+    build->occluded_count.fetch_add(occluded_count);
+}
+
+// Indirect draws are sorted by texture so that the whole scene goes out in one multi-draw per texture
+static void renderer_build_scene(RendererSceneBuild* build) {
+    uint32_t draw_count = (uint32_t)state.scene_draws.size();
+    state.scene_order.resize(draw_count);
+    for (uint32_t i = 0; i < draw_count; i++) {
+        state.scene_order[i] = i;
+    }
+
+    build->draws = state.scene_draws.data();
+    build->order = state.scene_order.data();
+    build->is_indirect = state.is_indirect_supported && draw_count != 0 && draw_count <= RENDERER_MAX_INDIRECT_DRAWS;
+    build->is_occlusion_enabled = state.is_depth_prepass_enabled;
+    build->occlusion_raster = state.occlusion_raster;
+    build->culled_count = 0;
+    build->occluded_count = 0;
+    if (!build->is_indirect) {
+        renderer_build_scene_commands(build, 0, draw_count, 0);
+        return;
+    }
+
+    std::stable_sort(state.scene_order.begin(), state.scene_order.end(), [](uint32_t a, uint32_t b) {
+        return state.scene_draws[a].texture < state.scene_draws[b].texture;
+    });
+    build->frame = indirect_begin_frame();
+    job_parallel_for(draw_count, RENDERER_INDIRECT_BUILD_GRAIN, renderer_build_scene_commands, build);
+}
+
+static void renderer_draw_scene(const RendererSceneBuild& build, Shader shader) {
+    uint32_t draw_count = (uint32_t)state.scene_draws.size();
+    if (!build.is_indirect) {
+        for (const RendererSceneDraw& draw : state.scene_draws) {
+            if (draw.is_visible) {
+                renderer_draw_surface(shader, draw.model, draw.first_vertex, draw.vertex_count, draw.texture);
+            }
+        }
+        profiler_count("draw calls", draw_count - build.culled_count.load());
+        return;
+    }
+
+    shader_use(shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(state.surface_vao);
+    uint32_t batch_count = 0;
+    uint32_t batch_start = 0;
+    for (uint32_t i = 1; i <= draw_count; i++) {
+        Texture texture = state.scene_draws[state.scene_order[batch_start]].texture;
+        if (i < draw_count && state.scene_draws[state.scene_order[i]].texture == texture) {
+            continue;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture_get_id(texture));
+        indirect_draw(build.frame, batch_start, i - batch_start);
+        batch_count++;
+        batch_start = i;
+    }
+    glBindVertexArray(0);
+    profiler_count("draw calls", batch_count);
+}
+
+static void renderer_draw_occlusion_box(const AABB& bounds) {
+    mat4 model = mat4::translate(bounds.center()) * mat4::scale((bounds.max - bounds.min) * 0.5f);
+    shader_set_uniform_mat4(state.light_shader, "model", &model);
+    glDrawArrays(GL_TRIANGLES, RENDERER_CUBE_FIRST_VERTEX, RENDERER_CUBE_VERTEX_COUNT);
+}
+
+// Draws the visible part of the scene into the depth buffer only, then tests the occlusion culler's boxes against it.
+// Their results decide what gets culled in the next frames
+static void renderer_render_depth_prepass(const RendererSceneBuild& build) {
+    profiler_begin("depth prepass");
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    renderer_draw_scene(build, renderer_get_surface_shader(&state.depth_shaders, build.is_indirect));
+
+    glDepthMask(GL_FALSE);
+    shader_use(state.light_shader);
+    glBindVertexArray(state.surface_vao);
+    occlusion_issue_queries(&state.occlusion, renderer_draw_occlusion_box);
+    glBindVertexArray(0);
+    profiler_count("occlusion queries", state.occlusion.query_nodes.size());
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    // The scene is drawn again at exactly the same depth
+    glDepthFunc(GL_LEQUAL);
+    profiler_end();
+}
+
+static void renderer_update_light_clusters() {
+    light_cluster_build(&state.light_clusters, state.view, state.light_spheres.data(), (uint32_t)state.light_spheres.size());
+    renderer_upload_texture_buffer(state.light_clusters_buffer, state.light_clusters.cluster_ranges.data(), state.light_clusters.cluster_ranges.size() * sizeof(uint32_t));
+    renderer_upload_texture_buffer(state.light_indices_buffer, state.light_clusters.light_indices.data(), state.light_clusters.light_indices.size() * sizeof(uint32_t));
+}
+
+bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size, PostAntiAliasing anti_aliasing) {
     state.window = window;
     state.screen_size = screen_size;
+    state.render_size = screen_size;
     state.window_size = window_size;
 
-    state.clear_color = vec3(0.2f, 0.2f, 0.2f);
+    renderer_set_clear_color(vec3(0.2f, 0.2f, 0.2f));
 
     // Set GL version
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
@@ -88,30 +588,23 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
 
 	glBindVertexArray(0);
 
-    // Setup glyph VAO
-    float glyph_vertices[] = {
-        0.0f, 0.0f,
-        1.0f, 0.0f,
-        0.0f, 1.0f,
+    // Setup text VAO. The buffer is sized on the first frame with text
+    glGenVertexArrays(1, &state.text_vao);
+    glGenBuffers(1, &state.text_vbo);
+    glBindVertexArray(state.text_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, state.text_vbo);
+    state.text_buffer_capacity = 0;
 
-        0.0f, 1.0f,
-        1.0f, 0.0f,
-        1.0f, 1.0f
-    };
-    uint32_t glyph_vbo;
-
-    glGenVertexArrays(1, &state.glyph_vao);
-    glGenBuffers(1, &glyph_vbo);
-    glBindVertexArray(state.glyph_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, glyph_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glyph_vertices), &glyph_vertices, GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, texture_coordinate));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*)offsetof(TextVertex, color));
 
-	glBindVertexArray(0);
+    glBindVertexArray(0);
 
-    // Setup cube VAO
+    // Cube vertices, uploaded with the surfaces below
 	float cube_vertices[] = {
 		// back face
 		-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
@@ -157,22 +650,7 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
 		 -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
 	};
 
-	uint32_t cube_vbo;
-    
-	glGenVertexArrays(1, &state.cube_vao);
-	glGenBuffers(1, &cube_vbo);
-	glBindVertexArray(state.cube_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-
-    // Setup quad3d VAO
+    // Setup surface VAO with the 3D quad followed by the cube
     float quad3d_vertices[] = {
         // positions         //normals          // texCoords
 		-1.0f, 1.0f, 0.0f,  0.0f, 0.0f, 1.0f,  0.0f, 1.0f,
@@ -184,12 +662,14 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
         1.0f,  1.0f, 0.0f,   0.0f, 0.0f, 1.0f,  1.0f, 1.0f
     };
 
-    uint32_t quad3d_vbo;
-    glGenVertexArrays(1, &state.quad3d_vao);
-    glGenBuffers(1, &quad3d_vbo);
-    glBindVertexArray(state.quad3d_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, quad3d_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quad3d_vertices), quad3d_vertices, GL_STATIC_DRAW);
+    uint32_t surface_vbo;
+    glGenVertexArrays(1, &state.surface_vao);
+    glGenBuffers(1, &surface_vbo);
+    glBindVertexArray(state.surface_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, surface_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad3d_vertices) + sizeof(cube_vertices), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, RENDERER_QUAD3D_FIRST_VERTEX * 8 * sizeof(float), sizeof(quad3d_vertices), quad3d_vertices);
+    glBufferSubData(GL_ARRAY_BUFFER, RENDERER_CUBE_FIRST_VERTEX * 8 * sizeof(float), sizeof(cube_vertices), cube_vertices);
 
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -198,43 +678,58 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 
+    state.is_indirect_supported = indirect_init(RENDERER_MAX_INDIRECT_DRAWS, RENDERER_DRAW_MODELS_UNIT);
+    if (state.is_indirect_supported) {
+        indirect_setup_draw_index(RENDERER_DRAW_INDEX_ATTRIBUTE);
+    }
+
     // Done with vao setup
 	glBindVertexArray(0);
 
-    // Setup framebuffer
-    glGenFramebuffers(1, &state.screen_framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, state.screen_framebuffer);
-
-    glActiveTexture(GL_TEXTURE0);
-    glGenTextures(1, &state.screen_texture);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, state.screen_texture);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, screen_size.x, screen_size.y, GL_TRUE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, state.screen_texture, 0);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-
-    uint32_t rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, screen_size.x, screen_size.y);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // The G-buffer is not multisampled, so the deferred path trades the MSAA of the forward path for cheaper lighting
+    glGenFramebuffers(1, &state.gbuffer_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, state.gbuffer_framebuffer);
+    state.gbuffer_textures[RENDERER_GBUFFER_ALBEDO] = renderer_create_gbuffer_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0);
+    state.gbuffer_textures[RENDERER_GBUFFER_NORMAL] = renderer_create_gbuffer_texture(GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT1);
+    state.gbuffer_textures[RENDERER_GBUFFER_MATERIAL] = renderer_create_gbuffer_texture(GL_RG8, GL_RG, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT2);
+    state.gbuffer_textures[RENDERER_GBUFFER_DEPTH] = renderer_create_gbuffer_texture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT);
+    GLenum gbuffer_attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, gbuffer_attachments);
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        log_error("Screen framebuffer not complete!");
+        log_error("G-buffer framebuffer not complete!");
         return false;
     }
+    state.lighting = RENDERER_LIGHTING_FORWARD;
+    state.is_in_scene = false;
+    state.is_depth_prepass_enabled = true;
+    occlusion_init(&state.occlusion);
+    state.occlusion_raster = NULL;
+    dynamic_resolution_init(screen_size, RENDERER_TARGET_GPU_TIME);
 
-    glGenFramebuffers(1, &state.screen_intermediate_framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, state.screen_intermediate_framebuffer);
-    glGenTextures(1, &state.screen_intermediate_texture);
-    glBindTexture(GL_TEXTURE_2D, state.screen_intermediate_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, screen_size.x, screen_size.y, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, state.screen_intermediate_texture, 0);
+    // Setup shadow maps
+    glGenFramebuffers(1, &state.shadow_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, state.shadow_framebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
 
+    glGenTextures(1, &state.shadow_maps);
+    glActiveTexture(GL_TEXTURE0 + RENDERER_SHADOW_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, state.shadow_maps);
+    glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT16, RENDERER_SHADOW_MAP_SIZE, RENDERER_SHADOW_MAP_SIZE, RENDERER_MAX_SHADOW_LIGHTS * 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    // Lookups compare against the stored depth in hardware, which also filters the result between texels
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glActiveTexture(GL_TEXTURE0);
+
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, state.shadow_maps, 0, 0);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        log_error("Screen intermediate framebuffer not complete!");
+        log_error("Shadow framebuffer not complete!");
         return false;
     }
 
@@ -242,30 +737,44 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
     // End setting up framebuffer
 
     // Load shaders
+    uint64_t shader_load_start = SDL_GetPerformanceCounter();
+    shader_cache_init((resource_base_path + "../shader_cache/").c_str());
+    shader_set_reload_callback(renderer_setup_shader);
     if (!shader_load(&state.screen_shader, "shader/screen.vert.glsl", "shader/screen.frag.glsl")) {
         return false;
     }
     shader_use(state.screen_shader);
     shader_set_uniform_uint(state.screen_shader, "screen_texture", 0);
+    shader_set_uniform_vec2(state.screen_shader, "screen_size", vec2((float)screen_size.x, (float)screen_size.y));
 
     if (!shader_load(&state.text_shader, "shader/text.vert.glsl", "shader/text.frag.glsl")) {
         return false;
     }
     shader_use(state.text_shader);
     shader_set_uniform_vec2(state.text_shader, "screen_size", vec2((float)screen_size.x, (float)screen_size.y));
-    shader_set_uniform_uint(state.text_shader, "atlas_texture", 0);
-
-    if (!shader_load(&state.model_shader, "shader/model.vert.glsl", "shader/model.frag.glsl")) {
+    shader_set_uniform_int(state.text_shader, "atlas_texture", 0);
+    if (!font_load(&state.font, "font/hack.ttf", RENDERER_FONT_SIZE)) {
+        return false;
+    }
+    if (!post_init(screen_size, state.quad_vao, anti_aliasing)) {
         return false;
     }
-    mat4 projection = mat4::perspective(deg_to_rad(45.0f), (float)screen_size.x / (float)screen_size.y, 0.1f, 100.0f);
-    shader_use(state.model_shader);
-    shader_set_uniform_mat4(state.model_shader, "projection", &projection);
-    shader_set_uniform_int(state.model_shader, "material_albedo", 0);
-    shader_set_uniform_int(state.model_shader, "material_metallic_roughness", 1);
-    shader_set_uniform_int(state.model_shader, "material_normal", 2);
-    shader_set_uniform_int(state.model_shader, "material_emissive", 3);
-    shader_set_uniform_int(state.model_shader, "material_occlusion", 4);
+    // Next to the resources rather than in them, where the file watcher would pick up every saved frame
+    capture_init((resource_base_path + "../capture/").c_str());
+
+    mat4 projection = mat4::perspective(deg_to_rad(45.0f), (float)screen_size.x / (float)screen_size.y, RENDERER_NEAR_PLANE, RENDERER_FAR_PLANE);
+    state.projection = projection;
+    state.camera_projection = projection;
+    state.view = mat4::look_at(vec3(0.0f, 0.0f, 1.0f), vec3(0.0f), VEC3_UP);
+    renderer_update_frustum();
+    // Nothing draws models yet, so none of their variants are compiled until something does
+    state.model_shaders = (ShaderVariants) {
+        .vertex_path = "shader/model.vert.glsl",
+        .fragment_path = "shader/model.frag.glsl",
+        .features = { "SKINNED", "NORMAL_MAP" },
+        .feature_count = 2,
+        .setup = renderer_setup_shader
+    };
 
     if (!shader_load(&state.geometry_shader, "shader/geometry.vert.glsl", "shader/geometry.frag.glsl")) {
         return false;
@@ -274,6 +783,61 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
     shader_set_uniform_mat4(state.geometry_shader, "projection", &projection);
     shader_set_uniform_int(state.geometry_shader, "material_albedo", 0);
 
+    // Setup clustered lighting
+    light_cluster_init(&state.light_clusters, projection, RENDERER_NEAR_PLANE, RENDERER_FAR_PLANE);
+    state.light_data_buffer = renderer_create_texture_buffer(GL_RGBA32F, RENDERER_LIGHT_DATA_UNIT);
+    state.light_clusters_buffer = renderer_create_texture_buffer(GL_RG32UI, RENDERER_LIGHT_CLUSTERS_UNIT);
+    state.light_indices_buffer = renderer_create_texture_buffer(GL_R32UI, RENDERER_LIGHT_INDICES_UNIT);
+    renderer_update_light_clusters();
+
+    state.lit_shaders = (ShaderVariants) {
+        .vertex_path = "shader/editor_quad.vert.glsl",
+        .fragment_path = "shader/lit.frag.glsl",
+        .features = { "INDIRECT" },
+        .feature_count = 1,
+        .setup = renderer_setup_shader
+    };
+    state.gbuffer_shaders = (ShaderVariants) {
+        .vertex_path = "shader/editor_quad.vert.glsl",
+        .fragment_path = "shader/gbuffer.frag.glsl",
+        .features = { "INDIRECT" },
+        .feature_count = 1,
+        .setup = renderer_setup_shader
+    };
+    state.depth_shaders = (ShaderVariants) {
+        .vertex_path = "shader/editor_quad.vert.glsl",
+        .fragment_path = "shader/depth.frag.glsl",
+        .features = { "INDIRECT" },
+        .feature_count = 1,
+        .setup = renderer_setup_shader
+    };
+    // The variants for how the scene is usually drawn are compiled up front. The rest are compiled if they are
+    // ever needed, the G-buffer ones on switching to deferred lighting and the others when indirect draws fall back
+    Shader surface_shader;
+    if (!shader_variants_get(&state.lit_shaders, state.is_indirect_supported ? RENDERER_SURFACE_INDIRECT : 0, &surface_shader) ||
+            !shader_variants_get(&state.depth_shaders, state.is_indirect_supported ? RENDERER_SURFACE_INDIRECT : 0, &surface_shader)) {
+        return false;
+    }
+
+    if (!shader_load(&state.deferred_shader, "shader/screen.vert.glsl", "shader/deferred.frag.glsl")) {
+        return false;
+    }
+    shader_use(state.deferred_shader);
+    shader_set_uniform_int(state.deferred_shader, "gbuffer_albedo", RENDERER_GBUFFER_ALBEDO);
+    shader_set_uniform_int(state.deferred_shader, "gbuffer_normal", RENDERER_GBUFFER_NORMAL);
+    shader_set_uniform_int(state.deferred_shader, "gbuffer_material", RENDERER_GBUFFER_MATERIAL);
+    shader_set_uniform_int(state.deferred_shader, "gbuffer_depth", RENDERER_GBUFFER_DEPTH);
+
+    if (!shader_load(&state.shadow_shader, "shader/shadow.vert.glsl", "shader/shadow.frag.glsl")) {
+        return false;
+    }
+
+    Shader lit_shaders[2] = { state.geometry_shader, state.deferred_shader };
+    for (Shader shader : lit_shaders) {
+        shader_use(shader);
+        renderer_set_light_uniforms(shader);
+    }
+
     if (!shader_load(&state.light_shader, "shader/light.vert.glsl", "shader/light.frag.glsl")) {
         return false;
     }
@@ -287,33 +851,122 @@ bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size) {
     shader_set_uniform_mat4(state.editor_quad_shader, "projection", &projection);
     shader_set_uniform_int(state.editor_quad_shader, "material_albedo", 0);
 
+    // Compare a launch with an empty shader cache against the next one to see what the cache saves
+    double shader_load_time = (double)(SDL_GetPerformanceCounter() - shader_load_start) / (double)SDL_GetPerformanceFrequency();
+    ShaderCacheStats shader_cache_stats = shader_cache_get_stats();
+    log_info("Loaded shaders in %.1fms. %u from the cache, %u compiled, %u cached binaries rejected.",
+             shader_load_time * 1000.0, shader_cache_stats.hits, shader_cache_stats.misses, shader_cache_stats.rejected);
+
+    profiler_init();
+
     log_info("Renderer subsystem initialized.");
     return true;
 }
 
 void renderer_quit() {
+    capture_quit();
     SDL_GL_DeleteContext(state.context);
 }
 
+// Undoes the gamma correction and tonemapping of the post chain
+static float renderer_get_linear_clear_channel(float value) {
+    float gamma_decoded = powf(std::min(std::max(value, 0.0f), 0.99f), 2.2f);
+    return gamma_decoded / (1.0f - gamma_decoded);
+}
+
 void renderer_set_clear_color(vec3 clear_color) {
-    state.clear_color = clear_color;
+    state.clear_color = vec3(renderer_get_linear_clear_channel(clear_color.x),
+                             renderer_get_linear_clear_channel(clear_color.y),
+                             renderer_get_linear_clear_channel(clear_color.z));
+}
+
+// Lit shaders find their light cluster from the pixel position, so they need the size the scene is rendered at
+static void renderer_update_render_size() {
+    ivec2 render_size = dynamic_resolution_get_size();
+    if (render_size.x == state.render_size.x && render_size.y == state.render_size.y) {
+        return;
+    }
+    state.render_size = render_size;
+
+    vec2 size = vec2((float)render_size.x, (float)render_size.y);
+    shader_use(state.geometry_shader);
+    shader_set_uniform_vec2(state.geometry_shader, "render_size", size);
+    shader_use(state.deferred_shader);
+    shader_set_uniform_vec2(state.deferred_shader, "render_size", size);
+    // Only the variants compiled so far, the others pick up the size when they're compiled
+    ShaderVariants* variant_shaders[2] = { &state.model_shaders, &state.lit_shaders };
+    for (ShaderVariants* variants : variant_shaders) {
+        for (const auto& program : variants->programs) {
+            if (program.second == 0) {
+                continue;
+            }
+            shader_use(program.second);
+            shader_set_uniform_vec2(program.second, "render_size", size);
+        }
+    }
+}
+
+// Clears only the part of the bound target the scene is rendered into
+static void renderer_clear_render_area(GLbitfield mask) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, state.render_size.x, state.render_size.y);
+    glClear(mask);
+    glDisable(GL_SCISSOR_TEST);
 }
 
 void renderer_prepare_frame() {
-    glBindFramebuffer(GL_FRAMEBUFFER, state.screen_framebuffer);
-    glViewport(0, 0, state.screen_size.x, state.screen_size.y);
+    if (state.is_depth_prepass_enabled) {
+        occlusion_read_results(&state.occlusion);
+    }
+    dynamic_resolution_begin_frame();
+    renderer_update_render_size();
+    profiler_count("render scale percent", dynamic_resolution_get_scale() * 100.0);
+    texture_begin_frame();
+    profiler_count("texture MB", (double)texture_get_stats().resident_bytes / (1024.0 * 1024.0));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, post_get_scene_framebuffer());
+    glViewport(0, 0, state.render_size.x, state.render_size.y);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ZERO);
     glClearColor(state.clear_color.x, state.clear_color.y, state.clear_color.z, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderer_clear_render_area(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Draws all the text of the frame with a single draw call. The buffer is orphaned every frame so that
+// writing this frame's text never waits on the GPU still drawing last frame's
+static void renderer_draw_text() {
+    if (state.text_vertices.empty()) {
+        return;
+    }
+
+    uint32_t vertex_count = (uint32_t)state.text_vertices.size();
+    glBindBuffer(GL_ARRAY_BUFFER, state.text_vbo);
+    if (vertex_count > state.text_buffer_capacity) {
+        state.text_buffer_capacity = std::max(vertex_count, state.text_buffer_capacity * 2);
+    }
+    glBufferData(GL_ARRAY_BUFFER, state.text_buffer_capacity * sizeof(TextVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(TextVertex), state.text_vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shader_use(state.text_shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, state.font.atlas);
+    glBindVertexArray(state.text_vao);
+    glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+    glBindVertexArray(0);
+    glBlendFunc(GL_ONE, GL_ZERO);
+    glEnable(GL_DEPTH_TEST);
+
+    state.text_vertices.clear();
 }
 
 void renderer_present_frame() {
-    // Blit multisample buffer to intermediate buffer
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, state.screen_framebuffer);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, state.screen_intermediate_framebuffer);
-    glBlitFramebuffer(0, 0, state.screen_size.x, state.screen_size.y, 0, 0, state.screen_size.x, state.screen_size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    profiler_begin("present");
+    uint32_t post_texture = post_run(state.render_size, state.projection * state.view);
+    capture_frame(post_texture, state.render_size);
 
     // Render framebuffer to screen
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -323,51 +976,230 @@ void renderer_present_frame() {
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    // The scene only covers the bottom left of the post texture when it was rendered below full size.
+    // It is stretched over the window with bilinear filtering and sharpened to win back some of the lost detail
+    float scale = (float)state.render_size.x / (float)state.screen_size.x;
     shader_use(state.screen_shader);
+    shader_set_uniform_vec2(state.screen_shader, "texture_scale", vec2(scale, (float)state.render_size.y / (float)state.screen_size.y));
+    shader_set_uniform_float(state.screen_shader, "sharpness", scale < 1.0f ? RENDERER_UPSCALE_SHARPNESS : 0.0f);
     glBindVertexArray(state.quad_vao);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, state.screen_intermediate_texture);
+    glBindTexture(GL_TEXTURE_2D, post_texture);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     glBindVertexArray(0);
 
+    // Text goes on after the upscale so that it stays sharp whatever the scene was rendered at
+    renderer_draw_text();
+    dynamic_resolution_end_frame();
+
     SDL_GL_SwapWindow(state.window);
+    profiler_end();
+}
+
+void renderer_render_text(const char* text, ivec2 position, vec3 color) {
+    font_layout(state.font, text, position, font_pack_color(color), &state.text_vertices);
+}
+
+void renderer_set_lighting(RendererLighting lighting) {
+    state.lighting = lighting;
+}
+
+RendererLighting renderer_get_lighting() {
+    return state.lighting;
+}
+
+void renderer_set_depth_prepass(bool is_enabled) {
+    state.is_depth_prepass_enabled = is_enabled;
+}
+
+bool renderer_is_depth_prepass_enabled() {
+    return state.is_depth_prepass_enabled;
+}
+
+void renderer_set_occluders(const Bvh* bvh) {
+    occlusion_set_bvh(&state.occlusion, bvh);
+}
+
+void renderer_set_occlusion_raster(const DepthRaster* raster) {
+    state.occlusion_raster = raster;
+}
+
+void renderer_begin_scene() {
+    state.is_in_scene = true;
+    state.scene_draws.clear();
+}
+
+void renderer_end_scene() {
+    renderer_update_shadows();
+
+    profiler_begin("scene");
+    bool is_deferred = state.lighting == RENDERER_LIGHTING_DEFERRED;
+    if (is_deferred) {
+        glBindFramebuffer(GL_FRAMEBUFFER, state.gbuffer_framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        renderer_clear_render_area(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, post_get_scene_framebuffer());
+    }
+    if (state.is_depth_prepass_enabled) {
+        occlusion_update(&state.occlusion, state.frustum_planes, state.view_position);
+    }
+
+    profiler_begin("scene build");
+    RendererSceneBuild build;
+    renderer_build_scene(&build);
+    profiler_end();
+    // The raster only holds for the frame it was given for
+    state.occlusion_raster = NULL;
+    uint32_t draw_count = (uint32_t)state.scene_draws.size();
+    uint32_t occluded_count = build.occluded_count.load();
+    profiler_count("culled draws", build.culled_count.load());
+    profiler_count("occluded draws", occluded_count);
+    profiler_count("occluded percent", draw_count == 0 ? 0.0 : (100.0 * occluded_count) / draw_count);
+
+    if (state.is_depth_prepass_enabled) {
+        renderer_render_depth_prepass(build);
+    }
+
+    profiler_begin("scene submit");
+    Shader shader = renderer_get_surface_shader(is_deferred ? &state.gbuffer_shaders : &state.lit_shaders, build.is_indirect);
+    renderer_draw_scene(build, shader);
+    if (build.is_indirect) {
+        indirect_end_frame(build.frame);
+    }
+    profiler_end();
+
+    if (state.is_depth_prepass_enabled) {
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+    state.is_in_scene = false;
+    profiler_end();
+    if (state.lighting != RENDERER_LIGHTING_DEFERRED) {
+        return;
+    }
+
+    profiler_begin("lighting");
+    glBindFramebuffer(GL_FRAMEBUFFER, post_get_scene_framebuffer());
+    // The lighting pass writes the G-buffer depth so that things drawn after the scene are still depth tested against it
+    glDepthFunc(GL_ALWAYS);
+
+    shader_use(state.deferred_shader);
+    for (uint32_t texture_index = 0; texture_index < RENDERER_GBUFFER_COUNT; texture_index++) {
+        glActiveTexture(GL_TEXTURE0 + texture_index);
+        glBindTexture(GL_TEXTURE_2D, state.gbuffer_textures[texture_index]);
+    }
+    glBindVertexArray(state.quad_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    for (uint32_t texture_index = 0; texture_index < RENDERER_GBUFFER_COUNT; texture_index++) {
+        glActiveTexture(GL_TEXTURE0 + texture_index);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glDepthFunc(GL_LESS);
+    profiler_end();
 }
 
 void renderer_set_lights(const RendererLight* lights, int light_count) {
-    if (light_count > 4) {
-        log_warn("Light count of %i is greater than supported max of 4.");
-        light_count = 4;
+    // Callers may set the same lights every frame, which shouldn't throw away the cached shadows
+    if (light_count == (int)state.lights.size() && (light_count == 0 || memcmp(lights, state.lights.data(), light_count * sizeof(RendererLight)) == 0)) {
+        return;
     }
+    state.lights.assign(lights, lights + light_count);
+    state.shadows.assign(std::min((uint32_t)light_count, RENDERER_MAX_SHADOW_LIGHTS), (RendererShadow) {
+        .rendered_scene_hash = 0,
+        .scene_hash = 0,
+        .stale_frames = 0,
+        .is_rendered = false
+    });
 
-    Shader shaders[2] = { state.geometry_shader, state.model_shader };
-    for (int shader_index = 0; shader_index < 2; shader_index++) {
-        Shader shader = shaders[shader_index];
-        shader_use(shader);
-        for (int i = 0; i < light_count; i++) {
-            char uniform_name[32];
-            sprintf(uniform_name, "light_positions[%i]", i);
-            shader_set_uniform_vec3(shader, uniform_name, lights[0].position);
-            sprintf(uniform_name, "light_colors[%i]", i);
-            shader_set_uniform_vec3(shader, uniform_name, lights[0].color);
-        }
-        shader_set_uniform_int(shader, "light_count", light_count);
+    state.light_spheres.clear();
+    state.light_data.clear();
+    for (int i = 0; i < light_count; i++) {
+        float brightest = fmaxf(lights[i].color.x, fmaxf(lights[i].color.y, lights[i].color.z));
+        float radius = sqrtf(brightest / RENDERER_LIGHT_THRESHOLD);
+        state.light_spheres.push_back(vec4(lights[i].position.x, lights[i].position.y, lights[i].position.z, radius));
+        state.light_data.push_back(state.light_spheres.back());
+        // The color's w is the light's layer in the shadow map array, or -1 for lights without a shadow
+        float shadow_layer = i < (int)RENDERER_MAX_SHADOW_LIGHTS ? (float)i : -1.0f;
+        state.light_data.push_back(vec4(lights[i].color.x, lights[i].color.y, lights[i].color.z, shadow_layer));
     }
+
+    renderer_upload_texture_buffer(state.light_data_buffer, state.light_data.data(), state.light_data.size() * sizeof(vec4));
+    renderer_update_light_clusters();
 }
 
 void renderer_set_camera(vec3 position, vec3 target) {
     mat4 view = mat4::look_at(position, target, VEC3_UP);
+    state.view = view;
+    state.view_position = position;
+    renderer_update_frustum();
+    renderer_update_light_clusters();
+
+    // Shifting the projection by the jitter moves the whole image by less than a pixel, so that TAA sees
+    // a slightly different sample of every pixel each frame
+    vec2 jitter = post_get_jitter(state.render_size);
+    mat4 projection = state.projection;
+    for (uint32_t column = 0; column < 4; column++) {
+        projection[column][0] += jitter.x * projection[column][3];
+        projection[column][1] += jitter.y * projection[column][3];
+    }
+    state.camera_projection = projection;
 
     shader_use(state.light_shader);
+    shader_set_uniform_mat4(state.light_shader, "projection", &projection);
     shader_set_uniform_mat4(state.light_shader, "view", &view);
     shader_use(state.geometry_shader);
+    shader_set_uniform_mat4(state.geometry_shader, "projection", &projection);
     shader_set_uniform_mat4(state.geometry_shader, "view", &view);
     shader_set_uniform_vec3(state.geometry_shader, "view_position", position);
-    shader_use(state.model_shader);
-    shader_set_uniform_mat4(state.model_shader, "view", &view);
-    shader_set_uniform_vec3(state.model_shader, "view_position", position);
     shader_use(state.editor_quad_shader);
+    shader_set_uniform_mat4(state.editor_quad_shader, "projection", &projection);
     shader_set_uniform_mat4(state.editor_quad_shader, "view", &view);
     shader_set_uniform_vec3(state.editor_quad_shader, "view_position", position);
+    // Only the variants compiled so far, the others pick up the camera when they're compiled
+    ShaderVariants* variant_shaders[4] = { &state.model_shaders, &state.lit_shaders, &state.gbuffer_shaders, &state.depth_shaders };
+    for (ShaderVariants* variants : variant_shaders) {
+        for (const auto& program : variants->programs) {
+            if (program.second == 0) {
+                continue;
+            }
+            shader_use(program.second);
+            shader_set_uniform_mat4(program.second, "projection", &projection);
+            shader_set_uniform_mat4(program.second, "view", &view);
+            shader_set_uniform_vec3(program.second, "view_position", position);
+        }
+    }
+
+    mat4 inverse_view_projection = (projection * view).inverse();
+    shader_use(state.deferred_shader);
+    shader_set_uniform_mat4(state.deferred_shader, "inverse_view_projection", &inverse_view_projection);
+    shader_set_uniform_vec3(state.deferred_shader, "view_position", position);
+}
+
+mat4 renderer_get_projection() {
+    return state.projection;
+}
+
+void renderer_get_mouse_ray(ivec2 mouse_position, vec3* origin, vec3* direction) {
+    // Mouse positions are in window pixels with y pointing down
+    float ndc_x = ((2.0f * mouse_position.x) / state.window_size.x) - 1.0f;
+    float ndc_y = 1.0f - ((2.0f * mouse_position.y) / state.window_size.y);
+
+    mat4 inverse_view_projection = (state.projection * state.view).inverse();
+    vec4 near_point = inverse_view_projection * vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    vec4 far_point = inverse_view_projection * vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+    vec3 near_position = vec3(near_point.x, near_point.y, near_point.z) / near_point.w;
+    vec3 far_position = vec3(far_point.x, far_point.y, far_point.z) / far_point.w;
+
+    *origin = near_position;
+    *direction = (far_position - near_position).normalized();
+}
+
+void renderer_clear_depth() {
+    renderer_clear_render_area(GL_DEPTH_BUFFER_BIT);
 }
 
 void renderer_render_light(vec3 position) {
@@ -376,21 +1208,15 @@ void renderer_render_light(vec3 position) {
     mat4 model = mat4::translate(position) * mat4::scale(vec3(0.1f));
     shader_set_uniform_mat4(state.light_shader, "model", &model);
 
-    glBindVertexArray(state.cube_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(state.surface_vao);
+    glDrawArrays(GL_TRIANGLES, RENDERER_CUBE_FIRST_VERTEX, RENDERER_CUBE_VERTEX_COUNT);
     glBindVertexArray(0);
 }
 
 void renderer_render_quad3d(const Transform& transform, Texture texture) {
-    shader_use(state.editor_quad_shader);
-
-    mat4 model = transform.to_mat4();
-    shader_set_uniform_mat4(state.editor_quad_shader, "model", &model);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    renderer_submit_surface(transform, vec3(1.0f, 1.0f, 0.0f), RENDERER_QUAD3D_FIRST_VERTEX, RENDERER_QUAD3D_VERTEX_COUNT, texture);
+}
 
-    glBindVertexArray(state.quad3d_vao);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+void renderer_render_cube(const Transform& transform, Texture texture) {
+    renderer_submit_surface(transform, vec3(1.0f), RENDERER_CUBE_FIRST_VERTEX, RENDERER_CUBE_VERTEX_COUNT, texture);
 }
\ No newline at end of file
@@ -2,21 +2,55 @@
 
 #include "math/math.h"
 #include "texture.h"
+#include "physics/bvh.h"
+#include "depth_raster.h"
+#include "post.h"
 #include <SDL2/SDL.h>
 
+enum RendererLighting {
+    RENDERER_LIGHTING_FORWARD,
+    RENDERER_LIGHTING_DEFERRED
+};
+
 struct RendererLight {
     vec3 position;
     vec3 color;
 };
 
-bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size);
+bool renderer_init(SDL_Window* window, ivec2 screen_size, ivec2 window_size, PostAntiAliasing anti_aliasing);
 void renderer_quit();
 void renderer_prepare_frame();
 void renderer_present_frame();
 
 void renderer_set_clear_color(vec3 color);
+void renderer_set_lighting(RendererLighting lighting);
+RendererLighting renderer_get_lighting();
+// The depth prepass lays down the scene's depth before shading it and tests the occluders against it.
+// Things hidden behind walls are skipped from the next frames on
+void renderer_set_depth_prepass(bool is_enabled);
+bool renderer_is_depth_prepass_enabled();
+// Scene draws inside hidden nodes of this BVH are culled. It must stay alive until it is replaced, or NULL
+void renderer_set_occluders(const Bvh* bvh);
+// Scene draws behind the occluders of this software depth buffer are culled too, without waiting on the GPU.
+// Set every frame before the scene, or NULL when there is no up to date one
+void renderer_set_occlusion_raster(const DepthRaster* raster);
 void renderer_set_lights(const RendererLight* lights, int light_count);
 void renderer_set_camera(vec3 position, vec3 target);
+mat4 renderer_get_projection();
+// World space ray through a mouse position, using the camera from the last renderer_set_camera()
+void renderer_get_mouse_ray(ivec2 mouse_position, vec3* origin, vec3* direction);
+// Anything rendered after this draws on top of what was rendered before, like editor gizmos
+void renderer_clear_depth();
+
+// Quads and cubes rendered between these are lit by the lights from renderer_set_lights(), either directly or
+// through the G-buffer depending on the lighting mode. Outside of a scene they are drawn unlit
+void renderer_begin_scene();
+void renderer_end_scene();
 
 void renderer_render_light(vec3 position);
-void renderer_render_quad3d(const Transform& transform, Texture texture);
\ No newline at end of file
+// Text is drawn over everything else when the frame is presented. The position is the top left of the first line,
+// in screen pixels
+void renderer_render_text(const char* text, ivec2 position, vec3 color);
+void renderer_render_quad3d(const Transform& transform, Texture texture);
+// The cube spans -1 to 1, so the transform scale is the half extents
+void renderer_render_cube(const Transform& transform, Texture texture);
\ No newline at end of file
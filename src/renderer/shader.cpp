@@ -2,31 +2,142 @@
 
 #include "core/resource.h"
 #include "core/logger.h"
+#include "core/hash.h"
+#include "core/vfs.h"
 #include <glad/glad.h>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <string>
+#include <vector>
 
-bool shader_compile(Shader* id, GLenum shader_type, const char* path) {
-    // determine full path
-    std::string full_path = resource_base_path + std::string(path);
+static const uint32_t SHADER_CACHE_MAGIC = 0x42435350; // "PSCB"
+static const uint32_t SHADER_CACHE_VERSION = 1;
 
-    // read the shader file
-    std::string shader_source;
-    std::ifstream shader_file;
-    std::string line;
+struct ShaderCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
 
-    shader_file.open(full_path);
-    if (!shader_file.is_open()) {
-        log_error("Error opening shader file at path %s\n", full_path.c_str());
+struct ShaderCache {
+    bool is_enabled;
+    std::string directory;
+    // Driver strings, so that a driver update makes every old binary miss instead of being rejected one by one
+    std::string driver;
+    ShaderCacheStats stats;
+};
+
+static ShaderCache cache;
+
+struct ShaderSources {
+    std::string vertex;
+    std::string fragment;
+    std::vector<std::string> vertex_files;
+    std::vector<std::string> fragment_files;
+    uint64_t key;
+};
+
+// Every loaded program and where it came from, so that it can be rebuilt when one of its files changes
+struct ShaderProgram {
+    Shader id;
+    std::string vertex_path;
+    std::string fragment_path;
+    std::string defines;
+    std::vector<std::string> files;
+};
+
+static std::vector<ShaderProgram> shader_programs;
+static ShaderReloadCallback shader_reload_callback = NULL;
+
+static uint64_t shader_hash_string(uint64_t hash, const std::string& value) {
+    // The terminator is hashed too so that moving text from one string into the next changes the key
+    return hash_fnv1a(hash, value.c_str(), value.size() + 1);
+}
+
+static bool shader_read_file(std::string* source, const std::string& path) {
+    VfsFile file;
+    if (!vfs_open(&file, path.c_str())) {
+        log_error("Error opening shader file at path %s", path.c_str());
+        return false;
+    }
+    source->assign((const char*)file.data, file.size);
+    vfs_close(&file);
+
+    // The preprocessor goes line by line, so the last line needs its newline too
+    if (!source->empty() && source->back() != '\n') {
+        *source += "\n";
+    }
+    return true;
+}
+
+// Reads a shader and everything it includes into one source string. Includes are relative to the including file and
+// are only pulled in once, like #pragma once in C++. #line directives carry each file's index in files, so the
+// "index:line" in compile errors points at the right file. The defines are inserted right after the #version line
+static bool shader_preprocess(std::string* source, const std::string& path, const char* defines, std::vector<std::string>* files) {
+    uint32_t file_index = (uint32_t)files->size();
+    files->push_back(path);
+    std::string file_source;
+    if (!shader_read_file(&file_source, path)) {
         return false;
     }
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+
+    uint32_t line_number = 0;
+    size_t line_start = 0;
+    while (line_start < file_source.size()) {
+        size_t line_end = file_source.find('\n', line_start);
+        std::string line = file_source.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        line_number++;
 
-    while (std::getline(shader_file, line)) {
-        shader_source += line + "\n";
+        size_t directive_start = line.find_first_not_of(" \t");
+        if (directive_start != std::string::npos && line.compare(directive_start, 8, "#include") == 0) {
+            size_t name_start = line.find('"', directive_start);
+            size_t name_end = name_start == std::string::npos ? std::string::npos : line.find('"', name_start + 1);
+            if (name_end == std::string::npos) {
+                log_error("Malformed #include in %s line %u", path.c_str(), line_number);
+                return false;
+            }
+            std::string include_path = directory + line.substr(name_start + 1, name_end - name_start - 1);
+            bool is_included = false;
+            for (const std::string& file : *files) {
+                is_included = is_included || file == include_path;
+            }
+            if (!is_included) {
+                *source += "#line 1 " + std::to_string(files->size()) + "\n";
+                if (!shader_preprocess(source, include_path, NULL, files)) {
+                    return false;
+                }
+            }
+            *source += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n";
+            continue;
+        }
+
+        *source += line + "\n";
+        if (defines != NULL && directive_start != std::string::npos && line.compare(directive_start, 8, "#version") == 0) {
+            size_t define_start = 0;
+            std::string define_lines = defines;
+            while (define_start < define_lines.size()) {
+                size_t define_end = define_lines.find('\n', define_start);
+                if (define_end == std::string::npos) {
+                    define_end = define_lines.size();
+                }
+                if (define_end != define_start) {
+                    *source += "#define " + define_lines.substr(define_start, define_end - define_start) + "\n";
+                }
+                define_start = define_end + 1;
+            }
+            *source += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n";
+        }
     }
 
-    shader_file.close();
-    
+    return true;
+}
+
+bool shader_compile(Shader* id, GLenum shader_type, const std::vector<std::string>& files, const std::string& shader_source) {
     // compile the shader
     const char* shader_source_cstr = shader_source.c_str();
     int success;
@@ -37,42 +148,305 @@ bool shader_compile(Shader* id, GLenum shader_type, const char* path) {
     if (!success) {
         char info_log[512];
         glGetShaderInfoLog(*id, 512, NULL, info_log);
-        log_error("Shader %s failed to compile: %s", path, info_log);
+        std::string file_list;
+        for (uint32_t file_index = 1; file_index < files.size(); file_index++) {
+            file_list += " " + std::to_string(file_index) + ": " + files[file_index];
+        }
+        log_error("Shader %s failed to compile: %s%s%s", files[0].c_str(), info_log, file_list.empty() ? "" : "Included files:", file_list.c_str());
         return false;
     }
 
     return true;
 }
 
-bool shader_load(Shader* id, const char* vertex_path, const char* fragment_path) {
-    // Compile shaders
-    GLuint vertex_shader;
-    if (!shader_compile(&vertex_shader, GL_VERTEX_SHADER, vertex_path)) {
-        return false;
+void shader_cache_init(const char* directory) {
+    cache.stats = (ShaderCacheStats) {
+        .hits = 0,
+        .misses = 0,
+        .rejected = 0
+    };
+
+    // Some drivers support glProgramBinary() but don't offer any format to save in
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    cache.is_enabled = format_count > 0;
+    if (!cache.is_enabled) {
+        log_info("Shader program binaries are not supported by the driver, shaders will be compiled every launch.");
+        return;
     }
 
-    GLuint fragment_shader;
-    if (!shader_compile(&fragment_shader, GL_FRAGMENT_SHADER, fragment_path)) {
+    cache.directory = directory;
+    std::error_code error;
+    std::filesystem::create_directories(cache.directory, error);
+    if (error) {
+        log_warn("Error creating shader cache directory %s: %s", cache.directory.c_str(), error.message().c_str());
+        cache.is_enabled = false;
+        return;
+    }
+
+    cache.driver = std::string((const char*)glGetString(GL_VENDOR)) + "\n" +
+                   std::string((const char*)glGetString(GL_RENDERER)) + "\n" +
+                   std::string((const char*)glGetString(GL_VERSION));
+}
+
+ShaderCacheStats shader_cache_get_stats() {
+    return cache.stats;
+}
+
+static std::string shader_cache_path(uint64_t key) {
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016llx.bin", (unsigned long long)key);
+    return cache.directory + filename;
+}
+
+static bool shader_cache_load(Shader* id, uint64_t key) {
+    std::ifstream file(shader_cache_path(key), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    ShaderCacheHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || header.magic != SHADER_CACHE_MAGIC ||
+            header.version != SHADER_CACHE_VERSION || header.key != key) {
+        return false;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), header.length)) {
         return false;
     }
 
-    // Link program
     int success;
     *id = glCreateProgram();
-    glAttachShader(*id, vertex_shader);
-    glAttachShader(*id, fragment_shader);
-    glLinkProgram(*id);
+    glProgramBinary(*id, header.format, binary.data(), header.length);
     glGetProgramiv(*id, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Drivers may reject binaries they saved themselves, for example after an update that kept the version string
+        log_info("Cached shader program %016llx was rejected by the driver, compiling it again.", (unsigned long long)key);
+        cache.stats.rejected++;
+        glDeleteProgram(*id);
+        return false;
+    }
+    return true;
+}
+
+static void shader_cache_save(Shader id, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(id, length, &length, &format, binary.data());
+    ShaderCacheHeader header = (ShaderCacheHeader) {
+        .magic = SHADER_CACHE_MAGIC,
+        .version = SHADER_CACHE_VERSION,
+        .key = key,
+        .format = format,
+        .length = (uint32_t)length
+    };
+
+    // Written next to the real file and moved over it, so a crash mid write can't leave a truncated binary behind
+    std::string path = shader_cache_path(key);
+    std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        log_warn("Error opening shader cache file %s", temp_path.c_str());
+        return;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write(binary.data(), length);
+    file.close();
+    if (!file || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        log_warn("Error writing shader cache file %s", path.c_str());
+        std::remove(temp_path.c_str());
+    }
+}
+
+// Reads both stages and hashes them, with everything they include and their defines, into the cache key
+static bool shader_read_sources(ShaderSources* sources, const char* vertex_path, const char* fragment_path, const char* defines) {
+    sources->vertex.clear();
+    sources->fragment.clear();
+    sources->vertex_files.clear();
+    sources->fragment_files.clear();
+    if (!shader_preprocess(&sources->vertex, vertex_path, defines, &sources->vertex_files) ||
+            !shader_preprocess(&sources->fragment, fragment_path, defines, &sources->fragment_files)) {
+        return false;
+    }
+
+    // Cached binaries are keyed by everything that goes into them, so edited sources and new variants simply miss
+    sources->key = HASH_FNV1A_BASIS;
+    sources->key = shader_hash_string(sources->key, sources->vertex);
+    sources->key = shader_hash_string(sources->key, sources->fragment);
+    sources->key = shader_hash_string(sources->key, cache.driver);
+    return true;
+}
+
+// Links the compiled stages into program, replacing whatever program had before if it was linked already
+static bool shader_link(GLuint program, GLuint vertex_shader, GLuint fragment_shader, const char* vertex_path, const char* fragment_path) {
+    GLuint attached_shaders[2];
+    GLsizei attached_count = 0;
+    glGetAttachedShaders(program, 2, &attached_count, attached_shaders);
+    for (GLsizei i = 0; i < attached_count; i++) {
+        glDetachShader(program, attached_shaders[i]);
+    }
+
+    int success;
+    if (cache.is_enabled) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glDetachShader(program, vertex_shader);
+    glDetachShader(program, fragment_shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
         char info_log[512];
-        glGetProgramInfoLog(*id, 512, NULL, info_log);
+        glGetProgramInfoLog(program, 512, NULL, info_log);
         log_error("Failed linking shader program. Vertex: %s Fragment %s Error: %s", vertex_path, fragment_path, info_log);
         return false;
     }
 
+    return true;
+}
+
+static bool shader_compile_stages(GLuint* vertex_shader, GLuint* fragment_shader, const ShaderSources& sources) {
+    if (!shader_compile(vertex_shader, GL_VERTEX_SHADER, sources.vertex_files, sources.vertex)) {
+        glDeleteShader(*vertex_shader);
+        return false;
+    }
+    if (!shader_compile(fragment_shader, GL_FRAGMENT_SHADER, sources.fragment_files, sources.fragment)) {
+        glDeleteShader(*vertex_shader);
+        glDeleteShader(*fragment_shader);
+        return false;
+    }
+    return true;
+}
+
+static void shader_register(Shader id, const char* vertex_path, const char* fragment_path, const char* defines, const ShaderSources& sources) {
+    ShaderProgram program = (ShaderProgram) {
+        .id = id,
+        .vertex_path = vertex_path,
+        .fragment_path = fragment_path,
+        .defines = defines != NULL ? defines : "",
+        .files = sources.vertex_files
+    };
+    program.files.insert(program.files.end(), sources.fragment_files.begin(), sources.fragment_files.end());
+    shader_programs.push_back(program);
+}
+
+bool shader_load(Shader* id, const char* vertex_path, const char* fragment_path, const char* defines) {
+    ShaderSources sources;
+    if (!shader_read_sources(&sources, vertex_path, fragment_path, defines)) {
+        return false;
+    }
+
+    if (cache.is_enabled && shader_cache_load(id, sources.key)) {
+        cache.stats.hits++;
+        shader_register(*id, vertex_path, fragment_path, defines, sources);
+        return true;
+    }
+    cache.stats.misses++;
+
+    // Compile shaders
+    GLuint vertex_shader;
+    GLuint fragment_shader;
+    if (!shader_compile_stages(&vertex_shader, &fragment_shader, sources)) {
+        return false;
+    }
+
+    // Link program
+    *id = glCreateProgram();
+    bool is_linked = shader_link(*id, vertex_shader, fragment_shader, vertex_path, fragment_path);
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    if (!is_linked) {
+        return false;
+    }
+
+    if (cache.is_enabled) {
+        shader_cache_save(*id, sources.key);
+    }
+    shader_register(*id, vertex_path, fragment_path, defines, sources);
+
+    return true;
+}
 
+void shader_set_reload_callback(ShaderReloadCallback callback) {
+    shader_reload_callback = callback;
+}
+
+uint32_t shader_reload(const char* path) {
+    uint32_t reload_count = 0;
+    for (ShaderProgram& program : shader_programs) {
+        bool is_affected = false;
+        for (const std::string& file : program.files) {
+            is_affected = is_affected || file == path;
+        }
+        if (!is_affected) {
+            continue;
+        }
+
+        // Any error leaves the program as it was, so a typo doesn't take the shader down with it
+        ShaderSources sources;
+        GLuint vertex_shader;
+        GLuint fragment_shader;
+        const char* defines = program.defines.empty() ? NULL : program.defines.c_str();
+        if (!shader_read_sources(&sources, program.vertex_path.c_str(), program.fragment_path.c_str(), defines) ||
+                !shader_compile_stages(&vertex_shader, &fragment_shader, sources)) {
+            continue;
+        }
+        // A failed link would leave the program unusable, so the stages are tried on a scratch program first.
+        // Linking the real one again keeps its id, which the renderer holds on to everywhere
+        GLuint test_program = glCreateProgram();
+        bool is_linked = shader_link(test_program, vertex_shader, fragment_shader, program.vertex_path.c_str(), program.fragment_path.c_str()) &&
+                         shader_link(program.id, vertex_shader, fragment_shader, program.vertex_path.c_str(), program.fragment_path.c_str());
+        glDeleteProgram(test_program);
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        if (!is_linked) {
+            continue;
+        }
+
+        if (cache.is_enabled) {
+            shader_cache_save(program.id, sources.key);
+        }
+        program.files = sources.vertex_files;
+        program.files.insert(program.files.end(), sources.fragment_files.begin(), sources.fragment_files.end());
+        // Linking resets the uniforms
+        if (shader_reload_callback != NULL) {
+            shader_use(program.id);
+            shader_reload_callback(program.id);
+        }
+        reload_count++;
+    }
+    return reload_count;
+}
+
+bool shader_variants_get(ShaderVariants* variants, uint32_t key, Shader* id) {
+    auto it = variants->programs.find(key);
+    if (it != variants->programs.end()) {
+        *id = it->second;
+        return *id != 0;
+    }
+
+    std::string defines;
+    for (uint32_t feature = 0; feature < variants->feature_count; feature++) {
+        if (key & (1 << feature)) {
+            defines += std::string(variants->features[feature]) + "\n";
+        }
+    }
+    if (!shader_load(id, variants->vertex_path, variants->fragment_path, defines.c_str())) {
+        log_error("Failed to load variant %u of shader %s %s", key, variants->vertex_path, variants->fragment_path);
+        *id = 0;
+        variants->programs[key] = 0;
+        return false;
+    }
+    variants->programs[key] = *id;
+    if (variants->setup != NULL) {
+        shader_use(*id);
+        variants->setup(*id);
+    }
     return true;
 }
 
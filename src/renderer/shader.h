@@ -3,10 +3,51 @@
 #include "math/vector2.h"
 #include "math/vector3.h"
 #include "math/matrix.h"
+#include <cstdint>
+#include <unordered_map>
 
 typedef uint32_t Shader;
 
-bool shader_load(Shader* id, const char* vertex_path, const char* fragment_path);
+static const uint32_t SHADER_MAX_FEATURES = 8;
+
+// Called once for each variant right after it's compiled, to set up its uniforms
+typedef void (*ShaderVariantSetup)(Shader id);
+
+// Variants of one program that only differ in which of its features are defined. A variant's key has bit i set
+// when features[i] is defined. Variants are compiled the first time they are asked for, so a feature costs
+// nothing until something uses it, and the shader never has to branch on it
+struct ShaderVariants {
+    const char* vertex_path;
+    const char* fragment_path;
+    const char* features[SHADER_MAX_FEATURES];
+    uint32_t feature_count;
+    ShaderVariantSetup setup;
+    // Variants that failed to compile are kept as 0 so that they aren't tried again every frame
+    std::unordered_map<uint32_t, Shader> programs;
+};
+
+struct ShaderCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    // Binaries that were found but that the driver refused to load. These are counted as misses too
+    uint32_t rejected;
+};
+
+// Linked programs are saved to the shader cache directory and loaded from there on later launches. The directory
+// should be outside the resource path, where writing to it doesn't wake the file watcher. Call after the GL
+// context is created and before loading any shaders
+void shader_cache_init(const char* directory);
+ShaderCacheStats shader_cache_get_stats();
+// Shaders can #include "path" relative to themselves. Defines are "NAME" or "NAME VALUE", one per line,
+// and are defined right after the #version line of both stages
+bool shader_load(Shader* id, const char* vertex_path, const char* fragment_path, const char* defines = NULL);
+bool shader_variants_get(ShaderVariants* variants, uint32_t key, Shader* id);
+// Called for each program that was rebuilt by shader_reload(). Its uniforms are reset and need setting again
+typedef void (*ShaderReloadCallback)(Shader id);
+void shader_set_reload_callback(ShaderReloadCallback callback);
+// Rebuilds every program made from path, directly or through an #include, keeping its id. Paths are relative to the
+// resource directory. Programs that fail to build keep their old version. Returns how many programs were rebuilt
+uint32_t shader_reload(const char* path);
 void shader_use(Shader id);
 void shader_set_uniform_int(Shader id, const char* name, int value);
 void shader_set_uniform_int_array(Shader id, const char* name, int* value, int count);
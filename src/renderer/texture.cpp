@@ -1,105 +1,381 @@
 #include "texture.h"
 
 #include "core/logger.h"
-#include "core/resource.h"
+#include "core/vfs.h"
 #include <glad/glad.h>
 #include <stb_image.h>
+#include <algorithm>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
-Texture texture_load(const char* path);
+static const uint32_t TEXTURE_INDEX_MASK = TEXTURE_MAX_COUNT - 1;
+static const uint32_t TEXTURE_GENERATION_MASK = (1 << (32 - TEXTURE_INDEX_BITS)) - 1;
+// Referenced textures drawn this recently are kept even over budget, evicting them would only mean loading them again
+static const uint32_t TEXTURE_EVICTION_MIN_AGE = 4;
 
-Texture texture_acquire(const char* path) {
-    static std::unordered_map<std::string, Texture> textures;
+struct TextureSlot {
+    // GL name, 0 while the texture is evicted
+    uint32_t id;
+    uint32_t generation;
+    uint32_t reference_count;
+    size_t size;
+    uint32_t last_used_frame;
 
-    std::string full_path = resource_base_path + std::string(path);
-    log_trace("Loading texture %s...", full_path.c_str());
+    // What the texture was made from, so it can be made again after being evicted. Solid colors have no path
+    std::string path;
+    uint32_t color;
 
-    auto it = textures.find(full_path);
-    if (it != textures.end()) {
-        log_trace("Texture already loaded, returning copy.");
-        return it->second;
-    }
+    // Resident textures are linked from least to most recently used. Slot 0 is never used, so 0 ends the list
+    uint32_t lru_previous;
+    uint32_t lru_next;
+};
 
-    Texture texture = texture_load(full_path.c_str());
+struct TextureState {
+    std::vector<TextureSlot> slots;
+    std::vector<uint32_t> free_slots;
+    // Only looked at when acquiring. Paths are relative to the resource directory, which is also how reloaded files are reported
+    std::unordered_map<std::string, uint32_t> path_slots;
+    std::unordered_map<uint32_t, uint32_t> color_slots;
 
-    if (texture != 0) {
-        textures[full_path] = texture;
-        log_trace("Texture loaded successfully.");
-    }
+    uint32_t lru_first;
+    uint32_t lru_last;
+    uint32_t frame;
 
-    return texture;
-}
+    uint32_t resident_count;
+    size_t resident_bytes;
+    size_t budget_bytes;
+    uint32_t eviction_count;
+    uint32_t reload_count;
+};
+
+static TextureState state;
 
-Texture texture_load(const char* path) {
-    int width;
-    int height;
-    int number_of_components;
-    stbi_uc* data = stbi_load(path, &width, &height, &number_of_components, 0);
-    if (!data) {
+bool texture_decode(TextureImage* image, const char* path) {
+    VfsFile file;
+    if (!vfs_open(&file, path)) {
+        return false;
+    }
+    image->data = stbi_load_from_memory(file.data, (int)file.size, &image->width, &image->height, &image->components, 0);
+    vfs_close(&file);
+    if (!image->data) {
         log_error("Could not load texture %s", path);
-        return 0;
+        return false;
+    }
+    if (image->components != 1 && image->components != 3 && image->components != 4) {
+        log_error("Texture format of texture %s not recognized.", path);
+        texture_free_image(image);
+        return false;
     }
+    return true;
+}
+
+void texture_free_image(TextureImage* image) {
+    stbi_image_free(image->data);
+    image->data = NULL;
+}
 
+// Drivers store RGB textures with a padding byte
+static size_t texture_get_image_size(const TextureImage& image) {
+    size_t texel_size = image.components == 1 ? 1 : 4;
+    return (size_t)image.width * (size_t)image.height * texel_size;
+}
+
+static void texture_upload(uint32_t id, const TextureImage& image) {
     GLenum texture_format;
-    if (number_of_components == 1) {
+    if (image.components == 1) {
         texture_format = GL_RED;
-    } else if (number_of_components == 3) {
+    } else if (image.components == 3) {
         texture_format = GL_RGB;
-    } else if (number_of_components == 4) {
-        texture_format = GL_RGBA;
     } else {
-        log_error("Texture format of texture %s not recognized.", path);
-        return 0;
+        texture_format = GL_RGBA;
     }
 
-    uint32_t texture;
-    glGenTextures(1, &texture);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, texture_format, width, height, GL_FALSE, texture_format, GL_UNSIGNED_BYTE, data);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, texture_format, image.width, image.height, GL_FALSE, texture_format, GL_UNSIGNED_BYTE, image.data);
     // glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+static void texture_lru_unlink(uint32_t index) {
+    TextureSlot& slot = state.slots[index];
+    if (slot.lru_previous == 0) {
+        state.lru_first = slot.lru_next;
+    } else {
+        state.slots[slot.lru_previous].lru_next = slot.lru_next;
+    }
+    if (slot.lru_next == 0) {
+        state.lru_last = slot.lru_previous;
+    } else {
+        state.slots[slot.lru_next].lru_previous = slot.lru_previous;
+    }
+    slot.lru_previous = 0;
+    slot.lru_next = 0;
+}
+
+static void texture_lru_push_back(uint32_t index) {
+    TextureSlot& slot = state.slots[index];
+    slot.lru_previous = state.lru_last;
+    slot.lru_next = 0;
+    if (state.lru_last == 0) {
+        state.lru_first = index;
+    } else {
+        state.slots[state.lru_last].lru_next = index;
+    }
+    state.lru_last = index;
+}
+
+// Creates the GL texture of a slot from its path or color
+static bool texture_make_resident(uint32_t index) {
+    TextureSlot& slot = state.slots[index];
+    TextureImage image;
+    if (slot.path.empty()) {
+        image = (TextureImage) {
+            .width = 1,
+            .height = 1,
+            .components = 4,
+            .data = (uint8_t*)&slot.color
+        };
+    } else if (!texture_decode(&image, slot.path.c_str())) {
+        return false;
+    }
+
+    glGenTextures(1, &slot.id);
+    texture_upload(slot.id, image);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    stbi_image_free(data);
+    slot.size = texture_get_image_size(image);
+    if (!slot.path.empty()) {
+        texture_free_image(&image);
+    }
 
-    return texture;
+    slot.last_used_frame = state.frame;
+    texture_lru_push_back(index);
+    state.resident_count++;
+    state.resident_bytes += slot.size;
+    return true;
 }
 
-Texture texture_acquire_solidcolor(float r, float g, float b, float a) {
-    static std::unordered_map<uint32_t, Texture> solidcolor_textures;
+static void texture_evict(uint32_t index) {
+    TextureSlot& slot = state.slots[index];
+    glDeleteTextures(1, &slot.id);
+    slot.id = 0;
+    texture_lru_unlink(index);
+    state.resident_count--;
+    state.resident_bytes -= slot.size;
+    state.eviction_count++;
+}
+
+static uint32_t texture_allocate_slot() {
+    if (state.slots.empty()) {
+        state.slots.push_back((TextureSlot) {});
+    }
+
+    uint32_t index;
+    if (!state.free_slots.empty()) {
+        index = state.free_slots.back();
+        state.free_slots.pop_back();
+    } else {
+        index = (uint32_t)state.slots.size();
+        if (index == TEXTURE_MAX_COUNT) {
+            log_error("Out of texture slots, the limit is %u.", TEXTURE_MAX_COUNT - 1);
+            return 0;
+        }
+        state.slots.push_back((TextureSlot) { .generation = 1 });
+    }
+
+    TextureSlot& slot = state.slots[index];
+    slot.id = 0;
+    slot.reference_count = 0;
+    slot.size = 0;
+    slot.path.clear();
+    slot.color = 0;
+    return index;
+}
+
+// Unreferenced slots already moved to a new generation when they were released
+static void texture_free_slot(uint32_t index) {
+    TextureSlot& slot = state.slots[index];
+    if (slot.id != 0) {
+        texture_evict(index);
+    }
+    if (slot.path.empty()) {
+        state.color_slots.erase(slot.color);
+    } else {
+        state.path_slots.erase(slot.path);
+    }
+    slot.path.clear();
+    state.free_slots.push_back(index);
+}
+
+static Texture texture_add_reference(uint32_t index) {
+    TextureSlot& slot = state.slots[index];
+    slot.reference_count++;
+    return (slot.generation << TEXTURE_INDEX_BITS) | index;
+}
 
+static TextureSlot* texture_get_slot(Texture texture) {
+    uint32_t index = texture & TEXTURE_INDEX_MASK;
+    if (index == 0 || index >= state.slots.size()) {
+        return NULL;
+    }
+    TextureSlot& slot = state.slots[index];
+    if (slot.generation != texture >> TEXTURE_INDEX_BITS || slot.reference_count == 0) {
+        return NULL;
+    }
+    return &slot;
+}
+
+Texture texture_acquire(const char* path) {
+    log_trace("Loading texture %s...", path);
+
+    auto it = state.path_slots.find(path);
+    if (it != state.path_slots.end()) {
+        log_trace("Texture already loaded, returning copy.");
+        return texture_add_reference(it->second);
+    }
+
+    uint32_t index = texture_allocate_slot();
+    if (index == 0) {
+        return 0;
+    }
+    state.slots[index].path = path;
+    if (!texture_make_resident(index)) {
+        state.slots[index].path.clear();
+        state.free_slots.push_back(index);
+        return 0;
+    }
+    state.path_slots[path] = index;
+    log_trace("Texture loaded successfully.");
+
+    return texture_add_reference(index);
+}
+
+Texture texture_acquire_solidcolor(float r, float g, float b, float a) {
     // pack the color values into one byte
     uint32_t color = (uint32_t(a * 255.0f) << 24) | (uint32_t(b * 255.0f) << 16) | (uint32_t(g * 255.0f) << 8) | uint32_t(r * 255.0f);
 
     // Check if solid color texture of this color already exists
-    auto it = solidcolor_textures.find(color);
-    if (it != solidcolor_textures.end()) {
-        return it->second;
+    auto it = state.color_slots.find(color);
+    if (it != state.color_slots.end()) {
+        return texture_add_reference(it->second);
     }
 
     // If it doesn't, create it
-    Texture texture;
-    glGenTextures(1, &texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, GL_FALSE, GL_RGBA, GL_UNSIGNED_BYTE, &color);
+    uint32_t index = texture_allocate_slot();
+    if (index == 0) {
+        return 0;
+    }
+    state.slots[index].color = color;
+    texture_make_resident(index);
+    state.color_slots[color] = index;
 
-    // Since these are 1x1 textures there's no reason to use GL_LINEAR
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    return texture_add_reference(index);
+}
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+void texture_release(Texture texture) {
+    TextureSlot* slot = texture_get_slot(texture);
+    if (slot == NULL) {
+        log_warn("Released texture handle %x is stale.", texture);
+        return;
+    }
+    slot->reference_count--;
+    // The texture stays loaded in case it's acquired again, but the handles given out so far go stale
+    if (slot->reference_count == 0) {
+        slot->generation = std::max((slot->generation + 1) & TEXTURE_GENERATION_MASK, 1u);
+    }
+}
+
+bool texture_is_valid(Texture texture) {
+    return texture_get_slot(texture) != NULL;
+}
+
+uint32_t texture_get_id(Texture texture) {
+    TextureSlot* slot = texture_get_slot(texture);
+    if (slot == NULL) {
+        return 0;
+    }
+    uint32_t index = texture & TEXTURE_INDEX_MASK;
+    if (slot->id == 0) {
+        if (!texture_make_resident(index)) {
+            return 0;
+        }
+        state.reload_count++;
+    }
+    if (slot->last_used_frame != state.frame) {
+        slot->last_used_frame = state.frame;
+        texture_lru_unlink(index);
+        texture_lru_push_back(index);
+    }
+    return slot->id;
+}
+
+void texture_set_budget(size_t budget_bytes) {
+    state.budget_bytes = budget_bytes;
+    log_info("Texture budget set to %.1f MB.", (double)budget_bytes / (1024.0 * 1024.0));
+}
 
-    solidcolor_textures[color] = texture;
-    return texture;
+void texture_begin_frame() {
+    state.frame++;
+    if (state.budget_bytes == 0) {
+        return;
+    }
+
+    // Released textures go first, they're only kept around in case they're acquired again
+    uint32_t index = state.lru_first;
+    while (index != 0 && state.resident_bytes > state.budget_bytes) {
+        uint32_t next = state.slots[index].lru_next;
+        if (state.slots[index].reference_count == 0) {
+            texture_free_slot(index);
+        }
+        index = next;
+    }
+
+    // The list is ordered by last use, so the first texture that's too recent ends the search
+    index = state.lru_first;
+    while (index != 0 && state.resident_bytes > state.budget_bytes) {
+        uint32_t next = state.slots[index].lru_next;
+        if (state.frame - state.slots[index].last_used_frame <= TEXTURE_EVICTION_MIN_AGE) {
+            break;
+        }
+        texture_evict(index);
+        index = next;
+    }
+}
+
+TextureStats texture_get_stats() {
+    uint32_t slot_count = state.slots.empty() ? 0 : (uint32_t)state.slots.size() - 1;
+    return (TextureStats) {
+        .texture_count = slot_count - (uint32_t)state.free_slots.size(),
+        .resident_count = state.resident_count,
+        .resident_bytes = state.resident_bytes,
+        .budget_bytes = state.budget_bytes,
+        .eviction_count = state.eviction_count,
+        .reload_count = state.reload_count
+    };
+}
+
+bool texture_reload(const char* path, TextureImage* image) {
+    auto it = state.path_slots.find(path);
+    if (it == state.path_slots.end()) {
+        return false;
+    }
+    // Evicted textures will pick up the new file when they're next drawn
+    TextureSlot& slot = state.slots[it->second];
+    if (slot.id == 0) {
+        return true;
+    }
+    // Uploaded into the same texture so that everything holding it sees the new image
+    texture_upload(slot.id, *image);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    state.resident_bytes -= slot.size;
+    slot.size = texture_get_image_size(*image);
+    state.resident_bytes += slot.size;
+    return true;
 }
\ No newline at end of file
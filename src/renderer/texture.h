@@ -1,8 +1,51 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
+// Handle to a texture slot. The low bits index the slot and the high bits hold the generation the slot had when
+// the handle was made, so a handle to a released texture is caught instead of reaching whatever took its slot.
+// 0 is never a valid handle
 typedef uint32_t Texture;
 
+static const uint32_t TEXTURE_INDEX_BITS = 16;
+static const uint32_t TEXTURE_MAX_COUNT = 1 << TEXTURE_INDEX_BITS;
+
+// Decoded pixels, kept separate from the upload so that decoding can happen on another thread
+struct TextureImage {
+    int width;
+    int height;
+    int components;
+    uint8_t* data;
+};
+
+struct TextureStats {
+    uint32_t texture_count;
+    uint32_t resident_count;
+    size_t resident_bytes;
+    size_t budget_bytes;
+    // Totals since startup
+    uint32_t eviction_count;
+    uint32_t reload_count;
+};
+
+// Every acquire adds a reference, to be given back with texture_release(). Acquiring an already loaded texture
+// looks up the path or color once, after that the handle is all that's needed
 Texture texture_acquire(const char* path);
-Texture texture_acquire_solidcolor(float r, float g, float b, float a);
\ No newline at end of file
+Texture texture_acquire_solidcolor(float r, float g, float b, float a);
+void texture_release(Texture texture);
+bool texture_is_valid(Texture texture);
+// The GL name to bind for the texture, marking it as used this frame. Evicted textures are loaded again first.
+// Returns 0 for stale handles
+uint32_t texture_get_id(Texture texture);
+
+// Once resident textures go over the budget, the least recently used ones are evicted at the start of a frame.
+// Released textures go first, then referenced ones that haven't been drawn for a few frames
+void texture_set_budget(size_t budget_bytes);
+void texture_begin_frame();
+TextureStats texture_get_stats();
+
+bool texture_decode(TextureImage* image, const char* path);
+void texture_free_image(TextureImage* image);
+// Replaces the image of the texture acquired from path, returning false if it was never acquired
+bool texture_reload(const char* path, TextureImage* image);
\ No newline at end of file
@@ -11,7 +11,8 @@ static const std::unordered_map<int, AppState> app_states = {
         .on_init = &level_init,
         .on_switch = &level_on_switch,
         .update = &level_update,
-        .render = &level_render
+        .render = &level_render,
+        .fixed_update = &level_fixed_update
     }},
     { STATE_EDITOR, (AppState) {
         .on_init = &editor_init,
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core/ecs.h"
+#include "math/math.h"
+
+enum GameComponent {
+    COMPONENT_TRANSFORM,
+    COMPONENT_WALL,
+    // Index of the entity's body in the level's PhysicsWorld, whose pose is copied to the transform every step
+    COMPONENT_RIGID_BODY,
+    COMPONENT_COUNT
+};
+
+struct WallComponent {
+    bool portalable;
+};
+
+struct RigidBodyComponent {
+    uint32_t body;
+};
+
+inline void components_register(EcsWorld* world) {
+    ecs_register_component(world, COMPONENT_TRANSFORM, sizeof(Transform), alignof(Transform));
+    ecs_register_component(world, COMPONENT_WALL, sizeof(WallComponent), alignof(WallComponent));
+    ecs_register_component(world, COMPONENT_RIGID_BODY, sizeof(RigidBodyComponent), alignof(RigidBodyComponent));
+}
\ No newline at end of file
@@ -6,21 +6,49 @@
 #include "core/input.h"
 #include "core/logger.h"
 #include "states/states.h"
+#include "states/wall.h"
 #include "renderer/texture.h"
+#include "physics/collision.h"
+#include "physics/raycast.h"
 #include <vector>
 
-struct Wall {
-    Transform transform;
-    bool portalable;
+static const uint32_t EDITOR_NO_SELECTION = UINT32_MAX;
+static const uint32_t EDITOR_NO_AXIS = UINT32_MAX;
+static const float EDITOR_PICK_DISTANCE = 100.0f;
+static const float EDITOR_GRID_SIZE = 0.25f;
+static const float EDITOR_ROTATION_STEP_DEGREES = 15.0f;
+// Gizmo sizes scale with the camera distance so the gizmo keeps the same size on screen
+static const float EDITOR_GIZMO_SIZE = 0.25f;
+static const float EDITOR_GIZMO_HANDLE_WIDTH = 0.02f;
+static const float EDITOR_GIZMO_PICK_WIDTH = 0.08f;
+static const uint32_t EDITOR_GIZMO_RING_SEGMENTS = 48;
+static const vec3 EDITOR_AXES[3] = { vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f) };
+
+enum EditorGizmoMode {
+    EDITOR_GIZMO_TRANSLATE,
+    EDITOR_GIZMO_ROTATE
 };
 
 struct EditorState {
     Texture texture_portalwall;
     Texture texture_noportalwall;
+    Texture texture_selected;
+    Texture texture_axes[3];
+    Texture texture_axis_active;
 
     std::vector<Wall> walls;
     std::vector<RendererLight> lights;
 
+    // Walls as collision faces with the same indices, so picking is a raycast against the BVH instead of a GPU readback
+    CollisionWorld picking;
+    uint32_t selected_wall;
+    EditorGizmoMode gizmo_mode;
+    uint32_t drag_axis;
+    Transform drag_start_transform;
+    // Where the mouse grabbed the gizmo: the distance along the axis when translating, the direction from the center when rotating
+    float drag_start_offset;
+    vec3 drag_start_direction;
+
     vec3 camera_position;
     float camera_yaw;
     float camera_pitch;
@@ -34,6 +62,11 @@ bool editor_init() {
     state.texture_portalwall = texture_acquire_solidcolor(0.78f, 0.78f, 0.78f, 1.0f);
     state.texture_noportalwall = texture_acquire_solidcolor(0.45f, 0.47f, 0.47f, 1.0f);
     state.texture_noportalwall = texture_acquire("texture/tile/diorama_tile1_05.png");
+    state.texture_selected = texture_acquire_solidcolor(0.45f, 0.65f, 0.95f, 1.0f);
+    state.texture_axes[0] = texture_acquire_solidcolor(0.9f, 0.2f, 0.2f, 1.0f);
+    state.texture_axes[1] = texture_acquire_solidcolor(0.2f, 0.85f, 0.2f, 1.0f);
+    state.texture_axes[2] = texture_acquire_solidcolor(0.2f, 0.35f, 0.95f, 1.0f);
+    state.texture_axis_active = texture_acquire_solidcolor(0.95f, 0.85f, 0.1f, 1.0f);
 
     state.walls.push_back((Wall) {
         .transform = (Transform) {
@@ -95,6 +128,14 @@ bool editor_init() {
     state.camera_distance = 3.0f;
     state.camera_target = vec3(0.0f);
 
+    state.selected_wall = EDITOR_NO_SELECTION;
+    state.gizmo_mode = EDITOR_GIZMO_TRANSLATE;
+    state.drag_axis = EDITOR_NO_AXIS;
+    for (const Wall& wall : state.walls) {
+        state.picking.faces.push_back(collision_face_from_transform(wall.transform, wall.portalable));
+    }
+    collision_world_build(&state.picking);
+
     return true;
 }
 
@@ -103,6 +144,145 @@ void editor_on_switch(void* switch_params) {
     application_set_mouse_mode(APP_MOUSE_MODE_VISIBLE);
 }
 
+static float editor_snap(float value, float step) {
+    return roundf(value / step) * step;
+}
+
+static float editor_gizmo_size() {
+    return state.camera_distance * EDITOR_GIZMO_SIZE;
+}
+
+// Faces are one sided just like the editor wall shader, so walls seen from behind can be clicked through
+static uint32_t editor_pick_wall(vec3 ray_origin, vec3 ray_direction) {
+    Ray ray = (Ray) {
+        .origin = ray_origin,
+        .direction = ray_direction,
+        .max_distance = EDITOR_PICK_DISTANCE
+    };
+    RaycastHit hit;
+    if (!raycast_nearest(state.picking, ray, RAYCAST_FILTER_ALL, &hit)) {
+        return EDITOR_NO_SELECTION;
+    }
+    return hit.face_index;
+}
+
+// Finds the closest points between the mouse ray and the line through the gizmo center along axis
+static bool editor_ray_axis_closest(vec3 ray_origin, vec3 ray_direction, vec3 axis_origin, vec3 axis, float* ray_t, float* axis_t) {
+    vec3 offset = ray_origin - axis_origin;
+    float b = vec3::dot(ray_direction, axis);
+    float d = vec3::dot(ray_direction, offset);
+    float e = vec3::dot(axis, offset);
+    float denominator = 1.0f - (b * b);
+    if (denominator < 0.0001f) {
+        return false;
+    }
+
+    *ray_t = ((b * e) - d) / denominator;
+    *axis_t = (e - (b * d)) / denominator;
+    return true;
+}
+
+static bool editor_ray_plane(vec3 ray_origin, vec3 ray_direction, vec3 plane_point, vec3 plane_normal, vec3* point) {
+    float denominator = vec3::dot(ray_direction, plane_normal);
+    if (fabs(denominator) < 0.0001f) {
+        return false;
+    }
+
+    float t = vec3::dot(plane_point - ray_origin, plane_normal) / denominator;
+    if (t < 0.0f) {
+        return false;
+    }
+    *point = ray_origin + (ray_direction * t);
+    return true;
+}
+
+// Returns the gizmo handle under the mouse ray, taking the nearest one when they overlap
+static uint32_t editor_pick_gizmo_axis(vec3 ray_origin, vec3 ray_direction) {
+    vec3 center = state.walls[state.selected_wall].transform.origin;
+    float size = editor_gizmo_size();
+    float pick_width = size * EDITOR_GIZMO_PICK_WIDTH;
+
+    uint32_t best_axis = EDITOR_NO_AXIS;
+    float best_distance = INFINITY;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        float ray_distance;
+        float handle_distance;
+        if (state.gizmo_mode == EDITOR_GIZMO_TRANSLATE) {
+            float axis_t;
+            if (!editor_ray_axis_closest(ray_origin, ray_direction, center, EDITOR_AXES[axis], &ray_distance, &axis_t) ||
+                ray_distance < 0.0f || axis_t < 0.0f || axis_t > size) {
+                continue;
+            }
+            handle_distance = (ray_origin + (ray_direction * ray_distance)).distance_to(center + (EDITOR_AXES[axis] * axis_t));
+        } else {
+            vec3 point;
+            if (!editor_ray_plane(ray_origin, ray_direction, center, EDITOR_AXES[axis], &point)) {
+                continue;
+            }
+            ray_distance = ray_origin.distance_to(point);
+            handle_distance = fabs(point.distance_to(center) - size);
+        }
+
+        if (handle_distance <= pick_width && ray_distance < best_distance) {
+            best_axis = axis;
+            best_distance = ray_distance;
+        }
+    }
+
+    return best_axis;
+}
+
+static void editor_begin_drag(uint32_t axis, vec3 ray_origin, vec3 ray_direction) {
+    const Transform& transform = state.walls[state.selected_wall].transform;
+    state.drag_axis = axis;
+    state.drag_start_transform = transform;
+
+    if (state.gizmo_mode == EDITOR_GIZMO_TRANSLATE) {
+        float ray_t;
+        editor_ray_axis_closest(ray_origin, ray_direction, transform.origin, EDITOR_AXES[axis], &ray_t, &state.drag_start_offset);
+    } else {
+        vec3 point;
+        editor_ray_plane(ray_origin, ray_direction, transform.origin, EDITOR_AXES[axis], &point);
+        state.drag_start_direction = (point - transform.origin).normalized();
+    }
+}
+
+static void editor_update_drag(vec3 ray_origin, vec3 ray_direction) {
+    const Transform& start = state.drag_start_transform;
+    Transform& transform = state.walls[state.selected_wall].transform;
+    vec3 axis = EDITOR_AXES[state.drag_axis];
+
+    if (state.gizmo_mode == EDITOR_GIZMO_TRANSLATE) {
+        float ray_t;
+        float axis_t;
+        if (!editor_ray_axis_closest(ray_origin, ray_direction, start.origin, axis, &ray_t, &axis_t)) {
+            return;
+        }
+
+        // Snap the coordinate along the axis to the grid rather than the distance moved
+        float start_coordinate = vec3::dot(start.origin, axis);
+        float coordinate = editor_snap(start_coordinate + axis_t - state.drag_start_offset, EDITOR_GRID_SIZE);
+        transform.origin = start.origin + (axis * (coordinate - start_coordinate));
+    } else {
+        vec3 point;
+        if (!editor_ray_plane(ray_origin, ray_direction, start.origin, axis, &point)) {
+            return;
+        }
+
+        vec3 direction = (point - start.origin).normalized();
+        float angle = atan2f(vec3::dot(vec3::cross(state.drag_start_direction, direction), axis), vec3::dot(state.drag_start_direction, direction));
+        angle = editor_snap(angle, deg_to_rad(EDITOR_ROTATION_STEP_DEGREES));
+        transform.rotation = quat::from_axis_angle(axis, angle, true) * start.rotation;
+    }
+}
+
+static void editor_end_drag() {
+    const Wall& wall = state.walls[state.selected_wall];
+    state.picking.faces[state.selected_wall] = collision_face_from_transform(wall.transform, wall.portalable);
+    collision_world_refit(&state.picking);
+    state.drag_axis = EDITOR_NO_AXIS;
+}
+
 void editor_update(float delta) {
     if (input_is_action_just_pressed(INPUT_TILDE)) {
         application_set_state(STATE_LEVEL, nullptr);
@@ -114,13 +294,78 @@ void editor_update(float delta) {
         state.camera_pitch = clampf(state.camera_pitch + (mouse_rel.y * delta), deg_to_rad(-89.0f), deg_to_rad(89.0f));
     }
     state.camera_distance = clampf(state.camera_distance - input_get_mouse_wheel_motion(), 3.0f, 25.0f);
+
+    if (state.drag_axis == EDITOR_NO_AXIS) {
+        if (input_is_action_just_pressed(INPUT_GIZMO_TRANSLATE)) {
+            state.gizmo_mode = EDITOR_GIZMO_TRANSLATE;
+        } else if (input_is_action_just_pressed(INPUT_GIZMO_ROTATE)) {
+            state.gizmo_mode = EDITOR_GIZMO_ROTATE;
+        }
+    }
+
+    vec3 ray_origin;
+    vec3 ray_direction;
+    renderer_get_mouse_ray(input_get_mouse_position(), &ray_origin, &ray_direction);
+    if (input_is_action_just_pressed(INPUT_PORTAL_LEFT)) {
+        // The gizmo is drawn on top of the walls, so it gets the click first
+        uint32_t axis = state.selected_wall != EDITOR_NO_SELECTION ? editor_pick_gizmo_axis(ray_origin, ray_direction) : EDITOR_NO_AXIS;
+        if (axis != EDITOR_NO_AXIS) {
+            editor_begin_drag(axis, ray_origin, ray_direction);
+        } else {
+            state.selected_wall = editor_pick_wall(ray_origin, ray_direction);
+        }
+    } else if (state.drag_axis != EDITOR_NO_AXIS) {
+        if (input_is_action_pressed(INPUT_PORTAL_LEFT)) {
+            editor_update_drag(ray_origin, ray_direction);
+        } else {
+            editor_end_drag();
+        }
+    }
+}
+
+static void editor_render_gizmo() {
+    vec3 center = state.walls[state.selected_wall].transform.origin;
+    float size = editor_gizmo_size();
+    float handle_width = size * EDITOR_GIZMO_HANDLE_WIDTH;
+
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        Texture texture = axis == state.drag_axis ? state.texture_axis_active : state.texture_axes[axis];
+        if (state.gizmo_mode == EDITOR_GIZMO_TRANSLATE) {
+            renderer_render_cube((Transform) {
+                .origin = center + (EDITOR_AXES[axis] * (size * 0.5f)),
+                .rotation = quat(),
+                .scale = vec3(handle_width) + (EDITOR_AXES[axis] * ((size * 0.5f) - handle_width))
+            }, texture);
+            renderer_render_cube((Transform) {
+                .origin = center + (EDITOR_AXES[axis] * size),
+                .rotation = quat(),
+                .scale = vec3(handle_width * 3.0f)
+            }, texture);
+        } else {
+            vec3 ring_u = EDITOR_AXES[(axis + 1) % 3];
+            vec3 ring_v = EDITOR_AXES[(axis + 2) % 3];
+            for (uint32_t segment = 0; segment < EDITOR_GIZMO_RING_SEGMENTS; segment++) {
+                float angle = (2.0f * MATH_PI * segment) / EDITOR_GIZMO_RING_SEGMENTS;
+                renderer_render_cube((Transform) {
+                    .origin = center + (((ring_u * cosf(angle)) + (ring_v * sinf(angle))) * size),
+                    .rotation = quat(),
+                    .scale = vec3(handle_width * 1.5f)
+                }, texture);
+            }
+        }
+    }
 }
 
 void editor_render() {
     renderer_set_lights(&state.lights[0], state.lights.size());
     state.camera_position = vec3(sin(state.camera_yaw) * cos(state.camera_pitch), sin(state.camera_pitch), cos(state.camera_yaw) * cos(state.camera_pitch)) * state.camera_distance;
     renderer_set_camera(state.camera_position, state.camera_target);
-    for (Wall& wall : state.walls) {
-        renderer_render_quad3d(wall.transform, state.texture_noportalwall);
+    for (uint32_t wall_index = 0; wall_index < state.walls.size(); wall_index++) {
+        renderer_render_quad3d(state.walls[wall_index].transform, wall_index == state.selected_wall ? state.texture_selected : state.texture_noportalwall);
+    }
+
+    if (state.selected_wall != EDITOR_NO_SELECTION) {
+        renderer_clear_depth();
+        editor_render_gizmo();
     }
 }
\ No newline at end of file
@@ -3,48 +3,312 @@
 #include "core/logger.h"
 #include "core/application.h"
 #include "core/input.h"
+#include "core/job.h"
 #include "renderer/renderer.h"
+#include "renderer/texture.h"
+#include "renderer/profiler.h"
+#include "renderer/depth_raster.h"
+#include "renderer/dynamic_resolution.h"
+#include "renderer/post.h"
+#include "renderer/capture.h"
+#include "physics/collision.h"
+#include "physics/character.h"
+#include "physics/portal.h"
+#include "physics/physics.h"
+#include "physics/raycast.h"
 #include "states/states.h"
+#include "states/components.h"
+#include <vector>
+
+static const float PLAYER_RADIUS = 0.3f;
+static const float PLAYER_HEIGHT = 1.8f;
+static const float PLAYER_STEP_HEIGHT = 0.35f;
+static const float PLAYER_EYE_OFFSET = 0.7f;
+static const float PLAYER_SPEED = 5.0f;
+static const float PLAYER_JUMP_SPEED = 6.0f;
+static const float GRAVITY = 20.0f;
+static const float CAMERA_PITCH_LIMIT = deg_to_rad(89.0f);
+static const float CUBE_HALF_EXTENT = 0.25f;
+static const float CUBE_MASS = 1.0f;
+static const float PORTAL_HALF_WIDTH = 0.6f;
+static const float PORTAL_HALF_HEIGHT = 1.0f;
+static const float PORTAL_RANGE = 100.0f;
+static const int LIGHT_GRID_SIZE = 4;
+static const uint32_t DEPTH_RASTER_WIDTH = 256;
+static const uint32_t DEPTH_RASTER_HEIGHT = 144;
+static const float DEPTH_RASTER_NEAR_PLANE = 0.05f;
 
 struct LevelState {
+    Texture texture_portalwall;
+    Texture texture_noportalwall;
+    Texture texture_cube;
+    Texture texture_portals[2];
+
+    // Walls and cubes are entities, so updates and rendering walk their components in packed arrays
+    EcsWorld world;
+
+    // Geometry
+    CollisionWorld collision;
+    Portal portals[2];
+    PhysicsWorld physics;
+
     // Player
-    vec3 player_position;
+    Character player;
     vec3 player_direction;
     float player_camera_yaw;
     float player_camera_pitch;
 
     // Lights
-    vec3 light_position;
+    std::vector<RendererLight> lights;
+
+    // CPU occlusion culling. Walls are rasterized on the job system while the level updates
+    bool is_cpu_occlusion_enabled;
+    bool is_depth_raster_pending;
+    DepthRaster depth_raster;
+    std::vector<DepthRasterQuad> occluders;
+    JobBatch depth_raster_batch;
 };
 
 static LevelState state;
 
+static vec3 level_camera_direction() {
+    return vec3(cos(state.player_camera_yaw) * cos(state.player_camera_pitch),
+                sin(state.player_camera_pitch),
+                sin(state.player_camera_yaw) * cos(state.player_camera_pitch));
+}
+
+static void level_add_wall(vec3 origin, quat rotation, vec3 scale, bool portalable) {
+    Entity entity = ecs_create(&state.world, ecs_mask(COMPONENT_TRANSFORM) | ecs_mask(COMPONENT_WALL));
+    *ecs_get<Transform>(state.world, entity, COMPONENT_TRANSFORM) = (Transform) {
+        .origin = origin,
+        .rotation = rotation,
+        .scale = scale
+    };
+    ecs_get<WallComponent>(state.world, entity, COMPONENT_WALL)->portalable = portalable;
+}
+
+static void level_add_cube(vec3 position, quat rotation) {
+    Entity entity = ecs_create(&state.world, ecs_mask(COMPONENT_TRANSFORM) | ecs_mask(COMPONENT_RIGID_BODY));
+    *ecs_get<Transform>(state.world, entity, COMPONENT_TRANSFORM) = (Transform) {
+        .origin = position,
+        .rotation = rotation,
+        .scale = vec3(CUBE_HALF_EXTENT)
+    };
+    ecs_get<RigidBodyComponent>(state.world, entity, COMPONENT_RIGID_BODY)->body = physics_add_box(&state.physics, position, rotation, vec3(CUBE_HALF_EXTENT), CUBE_MASS);
+}
+
 bool level_init() {
+    state.texture_portalwall = texture_acquire_solidcolor(0.78f, 0.78f, 0.78f, 1.0f);
+    state.texture_noportalwall = texture_acquire("texture/tile/diorama_tile1_05.png");
+    state.texture_cube = texture_acquire("model/cube/metal_box_skin00.png");
+    state.texture_portals[0] = texture_acquire_solidcolor(0.1f, 0.5f, 1.0f, 1.0f);
+    state.texture_portals[1] = texture_acquire_solidcolor(1.0f, 0.5f, 0.1f, 1.0f);
+
+    ecs_world_init(&state.world);
+    components_register(&state.world);
+
+    // Test chamber with a small ledge to step onto
+    const quat facing_up = quat::from_axis_angle(VEC3_RIGHT, deg_to_rad(90.0f), true);
+    const quat facing_down = quat::from_axis_angle(VEC3_RIGHT, deg_to_rad(-90.0f), true);
+    const quat facing_back = quat();
+    const quat facing_forward = quat::from_axis_angle(VEC3_UP, deg_to_rad(180.0f), true);
+    const quat facing_right = quat::from_axis_angle(VEC3_UP, deg_to_rad(-90.0f), true);
+    const quat facing_left = quat::from_axis_angle(VEC3_UP, deg_to_rad(90.0f), true);
+
+    level_add_wall(vec3(0.0f, 0.0f, 0.0f), facing_up, vec3(6.0f, 6.0f, 1.0f), true);
+    level_add_wall(vec3(0.0f, -5.0f, 0.0f), facing_down, vec3(6.0f, 6.0f, 1.0f), true);
+    level_add_wall(vec3(0.0f, -2.5f, -6.0f), facing_back, vec3(6.0f, 2.5f, 1.0f), true);
+    level_add_wall(vec3(0.0f, -2.5f, 6.0f), facing_forward, vec3(6.0f, 2.5f, 1.0f), true);
+    level_add_wall(vec3(-6.0f, -2.5f, 0.0f), facing_right, vec3(6.0f, 2.5f, 1.0f), true);
+    level_add_wall(vec3(6.0f, -2.5f, 0.0f), facing_left, vec3(6.0f, 2.5f, 1.0f), true);
+
+    level_add_wall(vec3(2.0f, -0.3f, -1.0f), facing_up, vec3(1.0f, 1.0f, 1.0f), false);
+    level_add_wall(vec3(2.0f, -0.15f, 0.0f), facing_back, vec3(1.0f, 0.15f, 1.0f), false);
+    level_add_wall(vec3(2.0f, -0.15f, -2.0f), facing_forward, vec3(1.0f, 0.15f, 1.0f), false);
+    level_add_wall(vec3(1.0f, -0.15f, -1.0f), facing_left, vec3(1.0f, 0.15f, 1.0f), false);
+    level_add_wall(vec3(3.0f, -0.15f, -1.0f), facing_right, vec3(1.0f, 0.15f, 1.0f), false);
+
+    state.collision.faces.clear();
+    EcsQuery wall_query = ecs_query(state.world, ecs_mask(COMPONENT_TRANSFORM) | ecs_mask(COMPONENT_WALL));
+    EcsChunkView view;
+    while (ecs_query_next(&wall_query, &view)) {
+        const Transform* transforms = ecs_view_get<Transform>(view, COMPONENT_TRANSFORM);
+        const WallComponent* walls = ecs_view_get<WallComponent>(view, COMPONENT_WALL);
+        for (uint32_t index = 0; index < view.count; index++) {
+            state.collision.faces.push_back(collision_face_from_transform(transforms[index], walls[index].portalable));
+        }
+    }
+    collision_world_build(&state.collision);
+
+    state.occluders.clear();
+    for (const CollisionFace& face : state.collision.faces) {
+        vec3 u = face.axis_u * face.extent_u;
+        vec3 v = face.axis_v * face.extent_v;
+        state.occluders.push_back((DepthRasterQuad) {
+            .corners = { face.center - u - v, face.center + u - v, face.center + u + v, face.center - u + v },
+            .normal = face.normal
+        });
+    }
+    depth_raster_init(&state.depth_raster, DEPTH_RASTER_WIDTH, DEPTH_RASTER_HEIGHT, DEPTH_RASTER_NEAR_PLANE);
+    state.is_cpu_occlusion_enabled = true;
+    state.is_depth_raster_pending = false;
+
+    state.portals[0].is_open = false;
+    state.portals[1].is_open = false;
+
+    // A few stacks of cubes in the corner
+    physics_world_init(&state.physics, &state.collision);
+    for (int stack = 0; stack < 3; stack++) {
+        for (int level = 0; level < 4 - stack; level++) {
+            vec3 position = vec3(-4.0f + (stack * 1.0f), -CUBE_HALF_EXTENT - (level * CUBE_HALF_EXTENT * 2.0f), -4.0f);
+            quat rotation = quat::from_axis_angle(VEC3_UP, deg_to_rad(level * 10.0f), true);
+            level_add_cube(position, rotation);
+        }
+    }
+    physics_set_portals(&state.physics, state.portals, 2);
+
     // Initialize player
-    state.player_position = vec3(0.0f);
+    state.player = character_create(vec3(0.0f, -(PLAYER_HEIGHT * 0.5f) - 0.05f, 2.0f), PLAYER_RADIUS, PLAYER_HEIGHT, PLAYER_STEP_HEIGHT);
     state.player_camera_yaw = deg_to_rad(-90.0f);
     state.player_camera_pitch = 0.0f;
+    state.player_direction = level_camera_direction();
 
-    state.light_position = vec3(0.0f, 0.75f, -5.0f);
+    // Grid of lights under the ceiling
+    state.lights.clear();
+    for (int x = 0; x < LIGHT_GRID_SIZE; x++) {
+        for (int z = 0; z < LIGHT_GRID_SIZE; z++) {
+            state.lights.push_back((RendererLight) {
+                .position = vec3(-4.5f + (x * 3.0f), -4.5f, -4.5f + (z * 3.0f)),
+                .color = vec3(4.0f)
+            });
+        }
+    }
+    renderer_set_lights(&state.lights[0], (int)state.lights.size());
+    renderer_set_occluders(&state.collision.bvh);
 
     return true;
 }
 
 void level_on_switch(void* switch_params) {
     renderer_set_clear_color(vec3(0.2f, 0.2f, 0.2f));
+    renderer_set_lights(&state.lights[0], (int)state.lights.size());
+    renderer_set_occluders(&state.collision.bvh);
+}
+
+static void level_render_depth_raster_bands(void* data, uint32_t begin, uint32_t end, uint32_t thread_index) {
+    for (uint32_t band = begin; band < end; band++) {
+        depth_raster_render_band(&state.depth_raster, state.occluders.data(), (uint32_t)state.occluders.size(), band);
+    }
+}
+
+static void level_finish_depth_raster() {
+    if (!state.is_depth_raster_pending) {
+        return;
+    }
+    job_wait(&state.depth_raster_batch);
+    depth_raster_build_hiz(&state.depth_raster);
+    state.is_depth_raster_pending = false;
+}
+
+// Rasterizes the walls from the camera the frame is rendered with, so nothing is culled against a view that has
+// since moved. The raster is built while the level's draws are gathered
+static void level_begin_depth_raster(vec3 camera_position, vec3 camera_target) {
+    level_finish_depth_raster();
+    if (!state.is_cpu_occlusion_enabled) {
+        return;
+    }
+
+    mat4 view = mat4::look_at(camera_position, camera_target, VEC3_UP);
+    depth_raster_set_camera(&state.depth_raster, renderer_get_projection() * view, camera_position);
+    job_submit(&state.depth_raster_batch, depth_raster_get_band_count(state.depth_raster), 1, level_render_depth_raster_bands, NULL);
+    state.is_depth_raster_pending = true;
+}
+
+// Copies each body's pose to its entity after the physics step
+static void level_sync_rigid_bodies(void* data, const EcsChunkView& view, uint32_t thread_index) {
+    Transform* transforms = ecs_view_get<Transform>(view, COMPONENT_TRANSFORM);
+    const RigidBodyComponent* rigid_bodies = ecs_view_get<RigidBodyComponent>(view, COMPONENT_RIGID_BODY);
+    for (uint32_t index = 0; index < view.count; index++) {
+        const RigidBody& body = state.physics.bodies[rigid_bodies[index].body];
+        transforms[index].origin = body.position;
+        transforms[index].rotation = body.orientation;
+    }
+}
+
+static void level_shoot_portal(uint32_t portal_index) {
+    Ray ray = (Ray) {
+        .origin = state.player.position + (VEC3_UP * PLAYER_EYE_OFFSET),
+        .direction = state.player_direction,
+        .max_distance = PORTAL_RANGE
+    };
+    RaycastHit hit;
+    if (!raycast_nearest(state.collision, ray, RAYCAST_FILTER_ALL, &hit) || !state.collision.faces[hit.face_index].portalable) {
+        return;
+    }
+
+    // Portals on walls stand upright, portals on floors and ceilings point away from the player
+    vec3 up = fabs(vec3::dot(hit.normal, VEC3_UP)) > 0.99f ? state.player_direction : VEC3_UP;
+    Portal portal;
+    if (!portal_place(&portal, state.collision, hit.face_index, hit.point, up, PORTAL_HALF_WIDTH, PORTAL_HALF_HEIGHT)) {
+        return;
+    }
+    const Portal& other = state.portals[portal_index ^ 1];
+    if (other.is_open && other.wall_index == portal.wall_index && portal_overlaps(portal, other)) {
+        return;
+    }
+
+    portal.is_open = true;
+    state.portals[portal_index] = portal;
+    physics_set_portals(&state.physics, state.portals, 2);
 }
 
 void level_update(float delta) {
-    static const float CAMERA_PITCH_LIMIT = deg_to_rad(89.0f);
     static const float CAMERA_SPEED = 0.1f;
-    static const float PLAYER_SPEED = 5.0f;
+    static const uint32_t FRAME_DUMP_INTERVAL = 2;
 
     if (input_is_action_just_pressed(INPUT_TILDE)) {
         application_set_state(STATE_EDITOR, nullptr);
     }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_LIGHTING)) {
+        bool is_deferred = renderer_get_lighting() == RENDERER_LIGHTING_FORWARD;
+        renderer_set_lighting(is_deferred ? RENDERER_LIGHTING_DEFERRED : RENDERER_LIGHTING_FORWARD);
+        log_info("Switched to %s lighting.", is_deferred ? "deferred" : "forward");
+    }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_PROFILER)) {
+        profiler_set_enabled(!profiler_is_enabled());
+    }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_OCCLUSION)) {
+        bool is_enabled = !renderer_is_depth_prepass_enabled();
+        renderer_set_depth_prepass(is_enabled);
+        log_info("Depth prepass and occlusion culling %s.", is_enabled ? "enabled" : "disabled");
+    }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_CPU_OCCLUSION)) {
+        state.is_cpu_occlusion_enabled = !state.is_cpu_occlusion_enabled;
+        log_info("CPU occlusion culling %s.", state.is_cpu_occlusion_enabled ? "enabled" : "disabled");
+    }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_DYNAMIC_RESOLUTION)) {
+        bool is_enabled = !dynamic_resolution_is_enabled();
+        dynamic_resolution_set_enabled(is_enabled);
+        log_info("Dynamic resolution %s.", is_enabled ? "enabled" : "disabled");
+    }
+    // Cycling through the modes with the profiler on compares their GPU time and post bandwidth
+    if (input_is_action_just_pressed(INPUT_CYCLE_ANTI_ALIASING)) {
+        post_set_anti_aliasing((PostAntiAliasing)((post_get_anti_aliasing() + 1) % POST_ANTI_ALIASING_COUNT));
+    }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_BLOOM)) {
+        post_set_bloom(!post_is_bloom_enabled());
+    }
+    if (input_is_action_just_pressed(INPUT_SCREENSHOT)) {
+        capture_screenshot();
+    }
+    if (input_is_action_just_pressed(INPUT_TOGGLE_FRAME_DUMP)) {
+        bool is_enabled = capture_get_dump_interval() == 0;
+        capture_set_dump_interval(is_enabled ? FRAME_DUMP_INTERVAL : 0);
+        log_info("Frame dump %s.", is_enabled ? "started" : "stopped");
+    }
 
-    // Player input
-    ivec2 player_move_input = ivec2(0, 0);
+    // Player input. Movement happens in the fixed steps, looking and shooting happen here
+    bool can_shoot = false;
     if (application_get_mouse_mode() == APP_MOUSE_MODE_VISIBLE) {
         if (input_is_action_just_pressed(INPUT_PORTAL_LEFT)) {
             application_set_mouse_mode(APP_MOUSE_MODE_RELATIVE);
@@ -58,34 +322,107 @@ void level_update(float delta) {
         ivec2 mouse_motion = input_get_mouse_relative_position();
         state.player_camera_yaw += deg_to_rad(mouse_motion.x * -CAMERA_SPEED);
         state.player_camera_pitch = clampf(state.player_camera_pitch + deg_to_rad(mouse_motion.y * CAMERA_SPEED), -CAMERA_PITCH_LIMIT, CAMERA_PITCH_LIMIT);
+        can_shoot = true;
+    }
+    state.player_direction = level_camera_direction();
 
-        // Movement 
-        if (input_is_action_pressed(INPUT_FORWARD)) {
-            player_move_input.y -= 1;
-        }
-        if (input_is_action_pressed(INPUT_BACK)) {
-            player_move_input.y += 1;
-        }
-        if (input_is_action_pressed(INPUT_LEFT)) {
-            player_move_input.x -= 1;
-        }
-        if (input_is_action_pressed(INPUT_RIGHT)) {
-            player_move_input.x += 1;
+    if (can_shoot && input_is_action_just_pressed(INPUT_PORTAL_LEFT)) {
+        level_shoot_portal(0);
+    }
+    if (can_shoot && input_is_action_just_pressed(INPUT_PORTAL_RIGHT)) {
+        level_shoot_portal(1);
+    }
+}
+
+void level_fixed_update(float delta) {
+    // Movement is scaled by how much of the step each key was held for, so a key let go early in a step only
+    // moves the player that far
+    vec2 player_move_input = vec2(0.0f, 0.0f);
+    if (application_get_mouse_mode() == APP_MOUSE_MODE_RELATIVE) {
+        player_move_input.x = input_get_action_held_fraction(INPUT_RIGHT) - input_get_action_held_fraction(INPUT_LEFT);
+        player_move_input.y = input_get_action_held_fraction(INPUT_BACK) - input_get_action_held_fraction(INPUT_FORWARD);
+        if (input_is_action_just_pressed(INPUT_JUMP) && state.player.is_grounded) {
+            state.player.velocity += VEC3_UP * PLAYER_JUMP_SPEED;
         }
     }
 
-    // Player update
-    state.player_direction = vec3(cos(state.player_camera_yaw) * cos(state.player_camera_pitch),
-                                  sin(state.player_camera_pitch),
-                                  sin(state.player_camera_yaw) * cos(state.player_camera_pitch));
     vec3 player_move_forward_direction = vec3(state.player_direction.x, 0.0f, state.player_direction.z).normalized();
     vec3 player_move_right_direction = vec3::cross(player_move_forward_direction, VEC3_UP).normalized();
-    vec3 player_velocity = ((player_move_forward_direction * -player_move_input.y) + 
-                           (player_move_right_direction * player_move_input.x)).normalized() * PLAYER_SPEED;
-    state.player_position += player_velocity * delta;
+    vec3 player_move_velocity = (player_move_forward_direction * -player_move_input.y) + (player_move_right_direction * player_move_input.x);
+    // Diagonals are no faster than straight lines
+    float player_move_length = player_move_velocity.length();
+    if (player_move_length > 1.0f) {
+        player_move_velocity = player_move_velocity / player_move_length;
+    }
+    player_move_velocity = player_move_velocity * PLAYER_SPEED;
+
+    // Walking sets the horizontal velocity directly, gravity accumulates on the vertical part
+    float player_vertical_speed = vec3::dot(state.player.velocity, VEC3_UP);
+    if (!state.player.is_grounded) {
+        player_vertical_speed -= GRAVITY * delta;
+    }
+    state.player.velocity = player_move_velocity + (VEC3_UP * player_vertical_speed);
+
+    mat4 teleport_matrix;
+    if (character_move(&state.player, state.collision, state.portals, 2, delta, &teleport_matrix) != -1) {
+        vec3 direction = teleport_matrix.transform_direction(state.player_direction).normalized();
+        state.player_camera_pitch = clampf(asinf(direction.y), -CAMERA_PITCH_LIMIT, CAMERA_PITCH_LIMIT);
+        state.player_camera_yaw = atan2f(direction.z, direction.x);
+        state.player_direction = level_camera_direction();
+    }
+
+    physics_step(&state.physics, delta);
+    ecs_parallel_for_each_chunk(state.world, ecs_mask(COMPONENT_TRANSFORM) | ecs_mask(COMPONENT_RIGID_BODY), level_sync_rigid_bodies, NULL);
 }
 
 void level_render() {
-    renderer_set_camera(state.player_position, state.player_position + state.player_direction);
-    renderer_render_light(state.light_position);
+    vec3 camera_position = state.player.position + (VEC3_UP * PLAYER_EYE_OFFSET);
+    vec3 camera_target = camera_position + state.player_direction;
+    renderer_set_camera(camera_position, camera_target);
+    level_begin_depth_raster(camera_position, camera_target);
+
+    renderer_begin_scene();
+    EcsQuery wall_query = ecs_query(state.world, ecs_mask(COMPONENT_TRANSFORM) | ecs_mask(COMPONENT_WALL));
+    EcsChunkView view;
+    while (ecs_query_next(&wall_query, &view)) {
+        const Transform* transforms = ecs_view_get<Transform>(view, COMPONENT_TRANSFORM);
+        const WallComponent* walls = ecs_view_get<WallComponent>(view, COMPONENT_WALL);
+        for (uint32_t index = 0; index < view.count; index++) {
+            renderer_render_quad3d(transforms[index], walls[index].portalable ? state.texture_portalwall : state.texture_noportalwall);
+        }
+    }
+    EcsQuery cube_query = ecs_query(state.world, ecs_mask(COMPONENT_TRANSFORM) | ecs_mask(COMPONENT_RIGID_BODY));
+    while (ecs_query_next(&cube_query, &view)) {
+        const Transform* transforms = ecs_view_get<Transform>(view, COMPONENT_TRANSFORM);
+        for (uint32_t index = 0; index < view.count; index++) {
+            renderer_render_cube(transforms[index], state.texture_cube);
+        }
+    }
+    // Cubes going through a portal are drawn coming out of the other side as well
+    for (const PhysicsGhost& ghost : state.physics.ghosts) {
+        renderer_render_cube((Transform) {
+            .origin = ghost.position,
+            .rotation = ghost.orientation,
+            .scale = state.physics.bodies[ghost.body].half_extents
+        }, state.texture_cube);
+    }
+    level_finish_depth_raster();
+    renderer_set_occlusion_raster(state.is_cpu_occlusion_enabled ? &state.depth_raster : NULL);
+    renderer_end_scene();
+
+    for (uint32_t portal_index = 0; portal_index < 2; portal_index++) {
+        const Portal& portal = state.portals[portal_index];
+        if (!portal.is_open) {
+            continue;
+        }
+        // Nudged off the wall so it doesn't z-fight with it
+        renderer_render_quad3d((Transform) {
+            .origin = portal.face.center + (portal.face.normal * 0.005f),
+            .rotation = quat::from_mat4(portal_frame(portal)),
+            .scale = vec3(portal.face.extent_u, portal.face.extent_v, 1.0f)
+        }, state.texture_portals[portal_index]);
+    }
+    for (const RendererLight& light : state.lights) {
+        renderer_render_light(light.position);
+    }
 }
\ No newline at end of file
@@ -3,4 +3,5 @@
 bool level_init();
 void level_on_switch(void* switch_params);
 void level_update(float delta);
+void level_fixed_update(float delta);
 void level_render();
\ No newline at end of file
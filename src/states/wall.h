@@ -0,0 +1,8 @@
+#pragma once
+
+#include "math/math.h"
+
+struct Wall {
+    Transform transform;
+    bool portalable;
+};
\ No newline at end of file
@@ -0,0 +1,290 @@
+// Benchmarks for the engine's hot paths: bench [--suite <name>]... [--warmup <count>] [--repeats <count>]
+// [--resources <directory>] [--out <json file>]. Results are printed and written as JSON, so CI can compare them
+// between commits
+
+#include "bench.h"
+
+#include "core/logger.h"
+#include "core/memory.h"
+#include "core/job.h"
+#include "core/vfs.h"
+#include "core/resource.h"
+#include <SDL2/SDL.h>
+#include <json.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static const uint32_t BENCH_DEFAULT_WARMUP_COUNT = 3;
+static const uint32_t BENCH_DEFAULT_REPEAT_COUNT = 20;
+static const size_t BENCH_FRAME_ARENA_CAPACITY = 4 * 1024 * 1024;
+
+struct BenchSuite {
+    const char* name;
+    void (*run)();
+};
+
+static const BenchSuite BENCH_SUITES[] = {
+    { "math", bench_suite_math },
+    { "loading", bench_suite_loading },
+    { "physics", bench_suite_physics },
+    { "renderer", bench_suite_renderer },
+    { "ecs", bench_suite_ecs },
+    { "frames", bench_suite_frames }
+};
+
+struct BenchMetric {
+    std::string name;
+    double value;
+};
+
+struct BenchResult {
+    std::string suite;
+    std::string name;
+    uint64_t item_count;
+    // Milliseconds, sorted
+    std::vector<double> samples;
+    double mean;
+    std::vector<BenchMetric> metrics;
+    std::vector<std::string> failures;
+};
+
+struct BenchState {
+    BenchConfig config;
+    const char* suite;
+    std::vector<BenchResult> results;
+};
+
+static BenchState state;
+
+// Nearest rank, so the value is always one that was measured
+static double bench_percentile(const std::vector<double>& sorted_samples, double percentile) {
+    size_t rank = (size_t)ceil((percentile / 100.0) * (double)sorted_samples.size());
+    return sorted_samples[std::min(std::max(rank, (size_t)1), sorted_samples.size()) - 1];
+}
+
+double bench_run(const char* name, uint64_t item_count, const std::function<void()>& function) {
+    return bench_run(name, item_count, []() {}, function);
+}
+
+double bench_run(const char* name, uint64_t item_count, const std::function<void()>& setup, const std::function<void()>& function) {
+    for (uint32_t run = 0; run < state.config.warmup_count; run++) {
+        setup();
+        memory_begin_frame();
+        function();
+    }
+
+    BenchResult result;
+    result.suite = state.suite;
+    result.name = name;
+    result.item_count = item_count;
+    result.mean = 0.0;
+    // Reserved up front, so that the harness doesn't allocate between the runs it measures
+    result.samples.reserve(state.config.repeat_count);
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    for (uint32_t run = 0; run < state.config.repeat_count; run++) {
+        setup();
+        memory_begin_frame();
+        uint64_t start = SDL_GetPerformanceCounter();
+        function();
+        double sample = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+        result.samples.push_back(sample);
+        result.mean += sample / state.config.repeat_count;
+    }
+    std::sort(result.samples.begin(), result.samples.end());
+
+    double median = bench_percentile(result.samples, 50.0);
+    printf("%-10s %-40s median %10.4f ms  p99 %10.4f ms  %14.0f items/s\n", state.suite, name, median,
+           bench_percentile(result.samples, 99.0), median > 0.0 ? (double)item_count * 1000.0 / median : 0.0);
+    state.results.push_back(result);
+    return median;
+}
+
+void bench_set_metric(const char* name, double value) {
+    state.results.back().metrics.push_back((BenchMetric) { .name = name, .value = value });
+    printf("%-10s %-40s %s %.4f\n", state.suite, state.results.back().name.c_str(), name, value);
+}
+
+void bench_fail(const char* reason) {
+    state.results.back().failures.push_back(reason);
+    printf("%-10s %-40s FAILED: %s\n", state.suite, state.results.back().name.c_str(), reason);
+}
+
+const BenchConfig& bench_get_config() {
+    return state.config;
+}
+
+float bench_random(uint32_t* seed) {
+    uint32_t value = *seed;
+    value ^= value << 13;
+    value ^= value >> 17;
+    value ^= value << 5;
+    *seed = value;
+    return (float)(value >> 8) / (float)(1 << 24);
+}
+
+vec3 bench_get_room_center(uint32_t x, uint32_t z) {
+    return vec3(((float)x + 0.5f) * BENCH_ROOM_SIZE, -BENCH_ROOM_HEIGHT * 0.5f, ((float)z + 0.5f) * BENCH_ROOM_SIZE);
+}
+
+static void bench_add_face(CollisionWorld* world, vec3 origin, quat rotation, vec3 scale, bool portalable) {
+    world->faces.push_back(collision_face_from_transform((Transform) {
+        .origin = origin,
+        .rotation = rotation,
+        .scale = scale
+    }, portalable));
+}
+
+void bench_build_level(CollisionWorld* world, uint32_t room_count) {
+    const quat facing_up = quat::from_axis_angle(VEC3_RIGHT, deg_to_rad(90.0f), true);
+    const quat facing_down = quat::from_axis_angle(VEC3_RIGHT, deg_to_rad(-90.0f), true);
+    const quat facing_back = quat();
+    const quat facing_forward = quat::from_axis_angle(VEC3_UP, deg_to_rad(180.0f), true);
+    const quat facing_right = quat::from_axis_angle(VEC3_UP, deg_to_rad(-90.0f), true);
+    const quat facing_left = quat::from_axis_angle(VEC3_UP, deg_to_rad(90.0f), true);
+    const float half_size = BENCH_ROOM_SIZE * 0.5f;
+    const vec3 floor_scale = vec3(half_size, half_size, 1.0f);
+    const vec3 wall_scale = vec3(half_size, BENCH_ROOM_HEIGHT * 0.5f, 1.0f);
+    const float end = room_count * BENCH_ROOM_SIZE;
+
+    world->faces.clear();
+    for (uint32_t x = 0; x < room_count; x++) {
+        for (uint32_t z = 0; z < room_count; z++) {
+            vec3 center = bench_get_room_center(x, z);
+            bench_add_face(world, vec3(center.x, 0.0f, center.z), facing_up, floor_scale, true);
+            bench_add_face(world, vec3(center.x, -BENCH_ROOM_HEIGHT, center.z), facing_down, floor_scale, true);
+
+            // Two out of three inner walls are there, so rooms open into each other here and there
+            uint32_t hash = (x * 73856093u) ^ (z * 19349663u);
+            if (x + 1 < room_count && hash % 3 != 0) {
+                vec3 origin = vec3((x + 1) * BENCH_ROOM_SIZE, center.y, center.z);
+                bench_add_face(world, origin, facing_right, wall_scale, true);
+                bench_add_face(world, origin, facing_left, wall_scale, true);
+            }
+            if (z + 1 < room_count && (hash / 3) % 3 != 0) {
+                vec3 origin = vec3(center.x, center.y, (z + 1) * BENCH_ROOM_SIZE);
+                bench_add_face(world, origin, facing_back, wall_scale, true);
+                bench_add_face(world, origin, facing_forward, wall_scale, true);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < room_count; i++) {
+        vec3 center = bench_get_room_center(i, i);
+        bench_add_face(world, vec3(0.0f, center.y, center.z), facing_right, wall_scale, false);
+        bench_add_face(world, vec3(end, center.y, center.z), facing_left, wall_scale, false);
+        bench_add_face(world, vec3(center.x, center.y, 0.0f), facing_back, wall_scale, false);
+        bench_add_face(world, vec3(center.x, center.y, end), facing_forward, wall_scale, false);
+    }
+    collision_world_build(world);
+}
+
+static bool bench_is_suite_selected(const std::vector<const char*>& selected_suites, const char* name) {
+    if (selected_suites.empty()) {
+        return true;
+    }
+    for (const char* selected_suite : selected_suites) {
+        if (strcmp(selected_suite, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool bench_write_json(const char* path) {
+    nlohmann::json results = nlohmann::json::array();
+    for (const BenchResult& result : state.results) {
+        double median = bench_percentile(result.samples, 50.0);
+        nlohmann::json metrics = nlohmann::json::object();
+        for (const BenchMetric& metric : result.metrics) {
+            metrics[metric.name] = metric.value;
+        }
+        results.push_back({
+            { "suite", result.suite },
+            { "name", result.name },
+            { "items", result.item_count },
+            { "median_ms", median },
+            { "p99_ms", bench_percentile(result.samples, 99.0) },
+            { "mean_ms", result.mean },
+            { "min_ms", result.samples.front() },
+            { "max_ms", result.samples.back() },
+            { "items_per_second", median > 0.0 ? (double)result.item_count * 1000.0 / median : 0.0 },
+            { "metrics", metrics },
+            { "failures", result.failures }
+        });
+    }
+    nlohmann::json document = {
+        { "warmup", state.config.warmup_count },
+        { "repeats", state.config.repeat_count },
+        { "hardware_threads", SDL_GetCPUCount() },
+        { "results", results }
+    };
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return false;
+    }
+    file << document.dump(4) << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    state.config = (BenchConfig) {
+        .warmup_count = BENCH_DEFAULT_WARMUP_COUNT,
+        .repeat_count = BENCH_DEFAULT_REPEAT_COUNT,
+        .resource_path = "res/"
+    };
+    const char* out_path = "bench.json";
+    std::vector<const char*> selected_suites;
+    for (int arg = 1; arg < argc; arg++) {
+        bool has_value = arg + 1 < argc;
+        if (strcmp(argv[arg], "--suite") == 0 && has_value) {
+            selected_suites.push_back(argv[++arg]);
+        } else if (strcmp(argv[arg], "--warmup") == 0 && has_value) {
+            state.config.warmup_count = (uint32_t)atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "--repeats") == 0 && has_value) {
+            state.config.repeat_count = std::max(atoi(argv[++arg]), 1);
+        } else if (strcmp(argv[arg], "--resources") == 0 && has_value) {
+            state.config.resource_path = argv[++arg];
+        } else if (strcmp(argv[arg], "--out") == 0 && has_value) {
+            out_path = argv[++arg];
+        } else {
+            fprintf(stderr, "Usage: %s [--suite <name>]... [--warmup <count>] [--repeats <count>] [--resources <directory>] [--out <json file>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    logger_init();
+    memory_init(BENCH_FRAME_ARENA_CAPACITY);
+    job_system_init(0);
+    resource_base_path = std::string(state.config.resource_path);
+    vfs_init(state.config.resource_path);
+
+    for (const BenchSuite& suite : BENCH_SUITES) {
+        if (!bench_is_suite_selected(selected_suites, suite.name)) {
+            continue;
+        }
+        state.suite = suite.name;
+        suite.run();
+    }
+
+    vfs_quit();
+    job_system_quit();
+    memory_quit();
+    logger_quit();
+
+    if (!bench_write_json(out_path)) {
+        return 1;
+    }
+    printf("Wrote %zu results to %s\n", state.results.size(), out_path);
+    for (const BenchResult& result : state.results) {
+        if (!result.failures.empty()) {
+            return 1;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
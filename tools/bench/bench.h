@@ -0,0 +1,49 @@
+#pragma once
+
+#include "math/math.h"
+#include "physics/collision.h"
+#include <cstdint>
+#include <functional>
+
+// Rooms of the generated level are this wide and this high
+static const float BENCH_ROOM_SIZE = 4.0f;
+static const float BENCH_ROOM_HEIGHT = 3.0f;
+
+struct BenchConfig {
+    uint32_t warmup_count;
+    uint32_t repeat_count;
+    const char* resource_path;
+};
+
+// Runs function warmup_count times without timing it, then repeat_count timed times. Frame memory is reset before
+// every run, as the game does before every frame. Items are whatever one run processes, bodies stepped or rays
+// cast, and give the throughput. Returns the median time in milliseconds
+double bench_run(const char* name, uint64_t item_count, const std::function<void()>& function);
+// Also runs setup before every run, untimed, for work that changes the data it runs on, like a physics step
+double bench_run(const char* name, uint64_t item_count, const std::function<void()>& setup, const std::function<void()>& function);
+// Attaches a number that isn't a time to the last result, such as how much of the hidden geometry got culled
+void bench_set_metric(const char* name, double value);
+// Fails the last result, for checks that are hard rules rather than numbers to compare. The results are still
+// written, but bench exits with an error
+void bench_fail(const char* reason);
+const BenchConfig& bench_get_config();
+
+// Keeps the compiler from optimizing away work whose results are never used
+template <typename T>
+inline void bench_keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// xorshift, so every run of every build sees the same numbers. Returns a float in [0, 1)
+float bench_random(uint32_t* seed);
+// A grid of rooms with a floor and ceiling each, and two sided walls between some of them. The outside walls are
+// always there, facing in. Room (x, z) is centered on bench_get_room_center(x, z)
+void bench_build_level(CollisionWorld* world, uint32_t room_count);
+vec3 bench_get_room_center(uint32_t x, uint32_t z);
+
+void bench_suite_math();
+void bench_suite_loading();
+void bench_suite_physics();
+void bench_suite_renderer();
+void bench_suite_ecs();
+void bench_suite_frames();
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "bench.h"
+
+#include "core/ecs.h"
+#include "renderer/texture.h"
+#include <vector>
+
+static const float BENCH_DELTA = 1.0f / 60.0f;
+static const uint32_t BENCH_ENTITY_COUNT = 100000;
+// One in this many entities also spins, so the queries span two archetypes
+static const uint32_t BENCH_SPINNER_INTERVAL = 4;
+static const uint32_t BENCH_CHURN_COUNT = 10000;
+
+enum BenchComponent {
+    BENCH_COMPONENT_TRANSFORM,
+    BENCH_COMPONENT_VELOCITY,
+    BENCH_COMPONENT_SPIN
+};
+
+// What a level object looks like without components: everything about it in one struct, most of which the
+// update never reads
+struct BenchObject {
+    Transform transform;
+    vec3 velocity;
+    float spin;
+    bool is_spinner;
+    bool portalable;
+    Texture texture;
+    uint32_t flags;
+    char name[32];
+};
+
+static void bench_integrate_chunk(void* data, const EcsChunkView& view, uint32_t thread_index) {
+    Transform* transforms = ecs_view_get<Transform>(view, BENCH_COMPONENT_TRANSFORM);
+    const vec3* velocities = ecs_view_get<vec3>(view, BENCH_COMPONENT_VELOCITY);
+    for (uint32_t index = 0; index < view.count; index++) {
+        transforms[index].origin += velocities[index] * BENCH_DELTA;
+    }
+}
+
+static void bench_spin_chunk(void* data, const EcsChunkView& view, uint32_t thread_index) {
+    Transform* transforms = ecs_view_get<Transform>(view, BENCH_COMPONENT_TRANSFORM);
+    const float* spins = ecs_view_get<float>(view, BENCH_COMPONENT_SPIN);
+    for (uint32_t index = 0; index < view.count; index++) {
+        transforms[index].rotation = transforms[index].rotation * quat::from_axis_angle(VEC3_UP, spins[index] * BENCH_DELTA, true);
+    }
+}
+
+static void bench_update_chunk(void* data, const EcsChunkView& view, uint32_t thread_index) {
+    bench_integrate_chunk(data, view, thread_index);
+    if ((view.archetype->mask & ecs_mask(BENCH_COMPONENT_SPIN)) != 0) {
+        bench_spin_chunk(data, view, thread_index);
+    }
+}
+
+static EcsMask bench_get_entity_mask(uint32_t index) {
+    EcsMask mask = ecs_mask(BENCH_COMPONENT_TRANSFORM) | ecs_mask(BENCH_COMPONENT_VELOCITY);
+    return index % BENCH_SPINNER_INTERVAL == 0 ? mask | ecs_mask(BENCH_COMPONENT_SPIN) : mask;
+}
+
+static Entity bench_create_entity(EcsWorld* world, uint32_t index, uint32_t* seed) {
+    Entity entity = ecs_create(world, bench_get_entity_mask(index));
+    *ecs_get<Transform>(*world, entity, BENCH_COMPONENT_TRANSFORM) = (Transform) {
+        .origin = vec3(bench_random(seed), -bench_random(seed), bench_random(seed)) * 100.0f,
+        .rotation = quat(),
+        .scale = vec3(1.0f)
+    };
+    *ecs_get<vec3>(*world, entity, BENCH_COMPONENT_VELOCITY) = vec3(bench_random(seed) - 0.5f, bench_random(seed) - 0.5f, bench_random(seed) - 0.5f) * 4.0f;
+    float* spin = ecs_get<float>(*world, entity, BENCH_COMPONENT_SPIN);
+    if (spin != NULL) {
+        *spin = bench_random(seed) * 6.28f;
+    }
+    return entity;
+}
+
+// The same update over the same entities, first AoS as the level used to store its objects, then from the
+// archetypes' chunks on one thread and on the job system
+void bench_suite_ecs() {
+    uint32_t seed = 13;
+    std::vector<BenchObject> objects(BENCH_ENTITY_COUNT);
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; i++) {
+        BenchObject& object = objects[i];
+        object.transform = (Transform) {
+            .origin = vec3(bench_random(&seed), -bench_random(&seed), bench_random(&seed)) * 100.0f,
+            .rotation = quat(),
+            .scale = vec3(1.0f)
+        };
+        object.velocity = vec3(bench_random(&seed) - 0.5f, bench_random(&seed) - 0.5f, bench_random(&seed) - 0.5f) * 4.0f;
+        object.is_spinner = i % BENCH_SPINNER_INTERVAL == 0;
+        object.spin = object.is_spinner ? bench_random(&seed) * 6.28f : 0.0f;
+    }
+    bench_run("aos update 100k objects", BENCH_ENTITY_COUNT, [&]() {
+        for (BenchObject& object : objects) {
+            object.transform.origin += object.velocity * BENCH_DELTA;
+            if (object.is_spinner) {
+                object.transform.rotation = object.transform.rotation * quat::from_axis_angle(VEC3_UP, object.spin * BENCH_DELTA, true);
+            }
+        }
+        bench_keep(objects[0].transform);
+    });
+
+    EcsWorld world;
+    ecs_world_init(&world);
+    ecs_register_component(&world, BENCH_COMPONENT_TRANSFORM, sizeof(Transform), alignof(Transform));
+    ecs_register_component(&world, BENCH_COMPONENT_VELOCITY, sizeof(vec3), alignof(vec3));
+    ecs_register_component(&world, BENCH_COMPONENT_SPIN, sizeof(float), alignof(float));
+    seed = 13;
+    std::vector<Entity> entities(BENCH_ENTITY_COUNT);
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; i++) {
+        entities[i] = bench_create_entity(&world, i, &seed);
+    }
+    uint32_t chunk_count = 0;
+    for (const EcsArchetype& archetype : world.archetypes) {
+        chunk_count += (uint32_t)archetype.chunks.size();
+    }
+
+    EcsMask update_mask = ecs_mask(BENCH_COMPONENT_TRANSFORM) | ecs_mask(BENCH_COMPONENT_VELOCITY);
+    double single_thread_time = bench_run("ecs update 100k entities", BENCH_ENTITY_COUNT, [&]() {
+        ecs_for_each_chunk(world, update_mask, bench_update_chunk, NULL);
+    });
+    bench_set_metric("chunks", chunk_count);
+    bench_set_metric("archetypes", world.archetypes.size());
+    double time = bench_run("ecs update 100k entities on jobs", BENCH_ENTITY_COUNT, [&]() {
+        ecs_parallel_for_each_chunk(world, update_mask, bench_update_chunk, NULL);
+    });
+    bench_set_metric("speedup", time > 0.0 ? single_thread_time / time : 0.0);
+
+    // Destroying entities all over the world and making new ones, which is what swap-remove and the free list are for
+    bench_run("ecs destroy and create 10k entities", BENCH_CHURN_COUNT * 2, [&]() {
+        for (uint32_t i = 0; i < BENCH_CHURN_COUNT; i++) {
+            uint32_t index = (uint32_t)(bench_random(&seed) * BENCH_ENTITY_COUNT);
+            ecs_destroy(&world, entities[index]);
+            entities[index] = bench_create_entity(&world, index, &seed);
+        }
+        bench_keep(entities[0]);
+    });
+    bench_set_metric("entities", world.entity_count);
+
+    ecs_world_free(&world);
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "bench.h"
+
+#include "core/application.h"
+#include "core/input.h"
+#include "core/memory.h"
+#include "renderer/renderer.h"
+#include "renderer/dynamic_resolution.h"
+#include "states/level/level.h"
+#include "states/editor/editor.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstdio>
+
+static const int BENCH_SCREEN_WIDTH = 1280;
+static const int BENCH_SCREEN_HEIGHT = 720;
+// Input is stamped with a made up clock that advances by one frame per run
+static const uint64_t BENCH_FRAME_TIME = 16;
+static const uint32_t BENCH_CLICK_INTERVAL = 45;
+
+struct BenchFrames {
+    uint64_t time;
+    uint32_t frame;
+
+    // Of the scenario being run
+    uint32_t run;
+    uint32_t heap_allocation_mark;
+    uint32_t heap_allocation_peak;
+};
+
+static BenchFrames frames;
+
+static void bench_begin_scenario() {
+    frames.run = 0;
+    frames.heap_allocation_peak = 0;
+}
+
+static void bench_begin_frame() {
+    frames.run++;
+    frames.heap_allocation_mark = memory_get_heap_allocation_total();
+    frames.time += BENCH_FRAME_TIME;
+    frames.frame++;
+    input_update();
+}
+
+// Once warmed up, a frame should not touch the heap at all
+static void bench_end_frame() {
+    if (frames.run > bench_get_config().warmup_count) {
+        frames.heap_allocation_peak = std::max(frames.heap_allocation_peak, memory_get_heap_allocation_total() - frames.heap_allocation_mark);
+    }
+}
+
+static void bench_check_heap_allocations() {
+    bench_set_metric("heap_allocs_per_frame", frames.heap_allocation_peak);
+    if (frames.heap_allocation_peak != 0) {
+        bench_fail("the steady state frame allocated from the heap");
+    }
+}
+
+static void bench_click(uint8_t button) {
+    input_process_mouse_button(button, true, frames.time);
+    input_process_mouse_button(button, false, frames.time);
+}
+
+// Walking forward while turning, shooting a portal now and then. The level's own update, fixed step and render
+// all run, with one fixed step per frame
+static void bench_level_frames() {
+    level_init();
+    level_on_switch(NULL);
+    application_set_mouse_mode(APP_MOUSE_MODE_RELATIVE);
+    input_restart_steps(frames.time);
+    input_process_key(SDL_SCANCODE_W, true, frames.time);
+
+    bench_begin_scenario();
+    bench_run("level frame", 1, []() {
+        bench_begin_frame();
+        input_process_mouse_motion(ivec2(BENCH_SCREEN_WIDTH / 2, BENCH_SCREEN_HEIGHT / 2), ivec2(4, 0), frames.time);
+        if (frames.frame % BENCH_CLICK_INTERVAL == 0) {
+            bench_click((frames.frame / BENCH_CLICK_INTERVAL) % 2 == 0 ? SDL_BUTTON_LEFT : SDL_BUTTON_RIGHT);
+        }
+        level_update(APPLICATION_FIXED_DELTA);
+        input_begin_fixed_step(frames.time);
+        level_fixed_update(APPLICATION_FIXED_DELTA);
+        input_end_fixed_steps();
+        renderer_prepare_frame();
+        level_render();
+        renderer_present_frame();
+        bench_end_frame();
+    });
+    bench_check_heap_allocations();
+
+    input_process_key(SDL_SCANCODE_W, false, frames.time);
+    application_set_mouse_mode(APP_MOUSE_MODE_VISIBLE);
+}
+
+// Orbiting the camera with the right button held, picking walls under the cursor now and then
+static void bench_editor_frames() {
+    editor_init();
+    editor_on_switch(NULL);
+    input_process_mouse_button(SDL_BUTTON_RIGHT, true, frames.time);
+
+    bench_begin_scenario();
+    bench_run("editor frame", 1, []() {
+        bench_begin_frame();
+        input_process_mouse_motion(ivec2(BENCH_SCREEN_WIDTH / 2, BENCH_SCREEN_HEIGHT / 2), ivec2(3, 1), frames.time);
+        if (frames.frame % BENCH_CLICK_INTERVAL == 0) {
+            bench_click(SDL_BUTTON_LEFT);
+        }
+        editor_update(APPLICATION_FIXED_DELTA);
+        input_flush_events(frames.time);
+        renderer_prepare_frame();
+        editor_render();
+        renderer_present_frame();
+        bench_end_frame();
+    });
+    bench_check_heap_allocations();
+
+    input_process_mouse_button(SDL_BUTTON_RIGHT, false, frames.time);
+}
+
+// Needs a GL context. Like golden runs, run with SDL_VIDEODRIVER=offscreen to go without a window, and with
+// LIBGL_ALWAYS_SOFTWARE=1 when there is no GPU
+void bench_suite_frames() {
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("Skipping frames, SDL failed to initialize: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_Window* window = SDL_CreateWindow("bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    ivec2 screen_size = ivec2(BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT);
+    if (window == NULL || !renderer_init(window, screen_size, screen_size, POST_ANTI_ALIASING_FXAA)) {
+        printf("Skipping frames, no GL context: %s\n", SDL_GetError());
+        if (window != NULL) {
+            SDL_DestroyWindow(window);
+        }
+        SDL_Quit();
+        return;
+    }
+    // A steady render size, so frame times only change when the code does
+    dynamic_resolution_set_enabled(false);
+    SDL_GL_SetSwapInterval(0);
+    input_init();
+    frames.time = SDL_GetTicks();
+    frames.frame = 0;
+
+    bench_level_frames();
+    bench_editor_frames();
+
+    renderer_quit();
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "bench.h"
+
+#include "core/vfs.h"
+#include "renderer/texture.h"
+#include <cstdio>
+
+static const char* BENCH_TEXTURE_PATHS[] = {
+    "texture/tile/diorama_tile1_05.png",
+    "texture/tile/aperture_concretewall001a.png",
+    "model/cube/metal_box_skin00.png"
+};
+static const char* BENCH_MODEL_PATH = "model/cube/Metal_box.obj";
+static const uint32_t BENCH_LEVEL_ROOM_COUNT = 32;
+
+static bool bench_has_textures() {
+    for (const char* path : BENCH_TEXTURE_PATHS) {
+        TextureImage image;
+        if (!texture_decode(&image, path)) {
+            printf("Skipping texture decode, %s is missing from %s\n", path, bench_get_config().resource_path);
+            return false;
+        }
+        texture_free_image(&image);
+    }
+    return true;
+}
+
+void bench_suite_loading() {
+    // Decoding through the VFS, as texture_acquire() does, includes reading the file from the pak or disk
+    if (bench_has_textures()) {
+        char name[64];
+        for (const char* path : BENCH_TEXTURE_PATHS) {
+            TextureImage image;
+            texture_decode(&image, path);
+            snprintf(name, sizeof(name), "texture decode %dx%d", image.width, image.height);
+            texture_free_image(&image);
+            bench_run(name, 1, [path]() {
+                TextureImage image;
+                texture_decode(&image, path);
+                texture_free_image(&image);
+            });
+        }
+    }
+
+    // There is no model loader yet, so models only measure getting their bytes out of the VFS
+    VfsFile model;
+    if (vfs_open(&model, BENCH_MODEL_PATH)) {
+        size_t model_size = model.size;
+        vfs_close(&model);
+        bench_run("vfs read model", model_size, []() {
+            VfsFile file;
+            vfs_open(&file, BENCH_MODEL_PATH);
+            uint64_t checksum = 0;
+            for (size_t i = 0; i < file.size; i++) {
+                checksum += file.data[i];
+            }
+            bench_keep(checksum);
+            vfs_close(&file);
+        });
+    }
+
+    // Building the collision faces and BVH of a level, which is what loading a level does besides textures
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_LEVEL_ROOM_COUNT);
+    bench_run("level build 32x32 rooms", level.faces.size(), [&]() {
+        bench_build_level(&level, BENCH_LEVEL_ROOM_COUNT);
+    });
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "bench.h"
+
+#include <vector>
+
+static const uint32_t BENCH_MATRIX_COUNT = 4096;
+static const uint32_t BENCH_POINT_COUNT = 65536;
+
+void bench_suite_math() {
+    uint32_t seed = 1;
+    std::vector<Transform> transforms(BENCH_MATRIX_COUNT);
+    std::vector<mat4> matrices(BENCH_MATRIX_COUNT);
+    std::vector<mat4> results(BENCH_MATRIX_COUNT);
+    for (uint32_t i = 0; i < BENCH_MATRIX_COUNT; i++) {
+        vec3 axis = vec3(bench_random(&seed) - 0.5f, bench_random(&seed) - 0.5f, bench_random(&seed) - 0.5f).normalized();
+        transforms[i] = (Transform) {
+            .origin = vec3(bench_random(&seed), bench_random(&seed), bench_random(&seed)) * 10.0f,
+            .rotation = quat::from_axis_angle(axis, bench_random(&seed) * 6.28f, true),
+            .scale = vec3(0.5f + bench_random(&seed))
+        };
+        matrices[i] = transforms[i].to_mat4();
+    }
+    std::vector<vec3> points(BENCH_POINT_COUNT);
+    std::vector<vec3> transformed_points(BENCH_POINT_COUNT);
+    std::vector<quat> rotations(BENCH_POINT_COUNT);
+    for (uint32_t i = 0; i < BENCH_POINT_COUNT; i++) {
+        points[i] = vec3(bench_random(&seed), bench_random(&seed), bench_random(&seed));
+        rotations[i] = transforms[i % BENCH_MATRIX_COUNT].rotation;
+    }
+
+    bench_run("transform to_mat4", BENCH_MATRIX_COUNT, [&]() {
+        for (uint32_t i = 0; i < BENCH_MATRIX_COUNT; i++) {
+            results[i] = transforms[i].to_mat4();
+        }
+        bench_keep(results[0]);
+    });
+    bench_run("mat4 multiply", BENCH_MATRIX_COUNT, [&]() {
+        for (uint32_t i = 0; i < BENCH_MATRIX_COUNT; i++) {
+            results[i] = matrices[i] * matrices[(i + 1) % BENCH_MATRIX_COUNT];
+        }
+        bench_keep(results[0]);
+    });
+    bench_run("mat4 inverse", BENCH_MATRIX_COUNT, [&]() {
+        for (uint32_t i = 0; i < BENCH_MATRIX_COUNT; i++) {
+            results[i] = matrices[i].inverse();
+        }
+        bench_keep(results[0]);
+    });
+    bench_run("mat4 transform_point", BENCH_POINT_COUNT, [&]() {
+        const mat4& matrix = matrices[0];
+        for (uint32_t i = 0; i < BENCH_POINT_COUNT; i++) {
+            transformed_points[i] = matrix.transform_point(points[i]);
+        }
+        bench_keep(transformed_points[0]);
+    });
+    bench_run("quat slerp", BENCH_POINT_COUNT, [&]() {
+        quat sum = quat();
+        for (uint32_t i = 0; i + 1 < BENCH_POINT_COUNT; i++) {
+            sum = sum + quat::slerp(rotations[i], rotations[i + 1], 0.3f);
+        }
+        bench_keep(sum);
+    });
+    bench_run("vec3 normalize and cross", BENCH_POINT_COUNT, [&]() {
+        for (uint32_t i = 0; i + 1 < BENCH_POINT_COUNT; i++) {
+            transformed_points[i] = vec3::cross(points[i].normalized(), points[i + 1]);
+        }
+        bench_keep(transformed_points[0]);
+    });
+}
\ No newline at end of file
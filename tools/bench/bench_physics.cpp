@@ -0,0 +1,281 @@
+#include "bench.h"
+
+#include "core/job.h"
+#include "physics/character.h"
+#include "physics/physics.h"
+#include "physics/raycast.h"
+#include "physics/portal.h"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const float BENCH_DELTA = 1.0f / 60.0f;
+static const uint32_t BENCH_CHARACTER_ROOM_COUNT = 64;
+static const float BENCH_CHARACTER_SPEED = 5.0f;
+static const float BENCH_GRAVITY = 20.0f;
+static const uint32_t BENCH_CUBE_COUNT = 2000;
+static const uint32_t BENCH_CUBE_ROOM_COUNT = 8;
+static const float BENCH_CUBE_HALF_EXTENT = 0.25f;
+// Steps taken before the state every sample starts from, so the cubes are falling into each other rather than
+// placed, and there are contacts to warm start from
+static const uint32_t BENCH_CUBE_START_STEP_COUNT = 5;
+static const uint32_t BENCH_STATIC_ROOM_COUNT = 8;
+static const float BENCH_SLAB_HEIGHT = 0.5f;
+static const uint32_t BENCH_RAYCAST_ROOM_COUNT = 32;
+static const uint32_t BENCH_RAY_COUNT = 65536;
+static const float BENCH_RAY_DISTANCE = 100.0f;
+// About 100k faces, as many as the editor's picking is meant to handle
+static const uint32_t BENCH_PICK_ROOM_COUNT = 148;
+static const uint32_t BENCH_PICK_GRID_SIZE = 64;
+static const float BENCH_PICK_DISTANCE = 100.0f;
+
+// One character per room, each walking in a circle of its own size so they keep running into walls and each other's rooms
+static void bench_characters() {
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_CHARACTER_ROOM_COUNT);
+    Portal portals[2];
+    portals[0].is_open = false;
+    portals[1].is_open = false;
+
+    uint32_t seed = 7;
+    std::vector<Character> characters;
+    std::vector<float> headings;
+    std::vector<float> turn_rates;
+    for (uint32_t x = 0; x < BENCH_CHARACTER_ROOM_COUNT; x++) {
+        for (uint32_t z = 0; z < BENCH_CHARACTER_ROOM_COUNT; z++) {
+            vec3 center = bench_get_room_center(x, z);
+            characters.push_back(character_create(vec3(center.x, -0.95f, center.z), 0.3f, 1.8f, 0.35f));
+            headings.push_back(bench_random(&seed) * 6.28f);
+            turn_rates.push_back((bench_random(&seed) - 0.5f) * 4.0f);
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "character move %zu agents", characters.size());
+    bench_run(name, characters.size(), [&]() {
+        mat4 teleport_matrix;
+        for (uint32_t i = 0; i < characters.size(); i++) {
+            Character& character = characters[i];
+            headings[i] += turn_rates[i] * BENCH_DELTA;
+            float vertical_speed = vec3::dot(character.velocity, VEC3_UP);
+            if (!character.is_grounded) {
+                vertical_speed -= BENCH_GRAVITY * BENCH_DELTA;
+            }
+            character.velocity = (vec3(cosf(headings[i]), 0.0f, sinf(headings[i])) * BENCH_CHARACTER_SPEED) + (VEC3_UP * vertical_speed);
+            character_move(&character, level, portals, 2, BENCH_DELTA, &teleport_matrix);
+        }
+    });
+}
+
+// Columns of cubes in every room, dropped a little above the floor so they settle into stacks during the runs
+static void bench_create_cubes(PhysicsWorld* world, const CollisionWorld* level) {
+    const uint32_t rooms = BENCH_CUBE_ROOM_COUNT * BENCH_CUBE_ROOM_COUNT;
+    const float spacing = BENCH_CUBE_HALF_EXTENT * 3.0f;
+    physics_world_init(world, level);
+    for (uint32_t i = 0; i < BENCH_CUBE_COUNT; i++) {
+        uint32_t room = i % rooms;
+        uint32_t slot = i / rooms;
+        uint32_t column = slot % 9;
+        uint32_t layer = slot / 9;
+        vec3 center = bench_get_room_center(room % BENCH_CUBE_ROOM_COUNT, room / BENCH_CUBE_ROOM_COUNT);
+        vec3 position = vec3(center.x + ((float)(column % 3) - 1.0f) * spacing,
+                             -BENCH_CUBE_HALF_EXTENT - 0.01f - (layer * (BENCH_CUBE_HALF_EXTENT * 2.0f + 0.02f)),
+                             center.z + ((float)(column / 3) - 1.0f) * spacing);
+        quat rotation = quat::from_axis_angle(VEC3_UP, deg_to_rad(layer * 10.0f), true);
+        physics_add_box(world, position, rotation, vec3(BENCH_CUBE_HALF_EXTENT), 1.0f);
+    }
+    physics_set_portals(world, NULL, 0);
+}
+
+// The same scene with 1, 2, 4... threads up to the core count. Every sample steps from the same state, since the
+// cubes would otherwise settle and fall asleep partway through the runs
+static void bench_physics() {
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_CUBE_ROOM_COUNT);
+
+    uint32_t hardware_thread_count = (uint32_t)SDL_GetCPUCount();
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t thread_count = 1; thread_count < hardware_thread_count; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    thread_counts.push_back(hardware_thread_count);
+
+    double single_thread_time = 0.0;
+    char name[64];
+    for (uint32_t thread_count : thread_counts) {
+        job_system_quit();
+        job_system_init(thread_count);
+
+        PhysicsWorld start_world;
+        bench_create_cubes(&start_world, &level);
+        for (uint32_t step = 0; step < BENCH_CUBE_START_STEP_COUNT; step++) {
+            physics_step(&start_world, BENCH_DELTA);
+        }
+        PhysicsWorld world;
+        snprintf(name, sizeof(name), "physics step 2000 cubes %u threads", thread_count);
+        double time = bench_run(name, BENCH_CUBE_COUNT, [&]() {
+            world = start_world;
+        }, [&]() {
+            physics_step(&world, BENCH_DELTA);
+        });
+        if (thread_count == 1) {
+            single_thread_time = time;
+        }
+        bench_set_metric("speedup", time > 0.0 ? single_thread_time / time : 0.0);
+        bench_set_metric("awake_bodies", world.stats.awake_body_count);
+        bench_set_metric("contacts", world.stats.contact_count);
+    }
+
+    job_system_quit();
+    job_system_init(0);
+}
+
+// A static slab in every room with cubes dropped onto it. The slabs are added first, so they are body_a of their
+// pairs, and neighbouring rooms' islands are solved in parallel while touching nothing but their own slab
+static void bench_static_boxes() {
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_STATIC_ROOM_COUNT);
+    const uint32_t rooms = BENCH_STATIC_ROOM_COUNT * BENCH_STATIC_ROOM_COUNT;
+    const float spacing = BENCH_CUBE_HALF_EXTENT * 3.0f;
+
+    PhysicsWorld world;
+    physics_world_init(&world, &level);
+    for (uint32_t room = 0; room < rooms; room++) {
+        vec3 center = bench_get_room_center(room % BENCH_STATIC_ROOM_COUNT, room / BENCH_STATIC_ROOM_COUNT);
+        physics_add_box(&world, vec3(center.x, -BENCH_SLAB_HEIGHT * 0.5f, center.z), quat(), vec3(1.0f, BENCH_SLAB_HEIGHT * 0.5f, 1.0f), 0.0f);
+    }
+    for (uint32_t room = 0; room < rooms; room++) {
+        vec3 center = bench_get_room_center(room % BENCH_STATIC_ROOM_COUNT, room / BENCH_STATIC_ROOM_COUNT);
+        for (uint32_t column = 0; column < 9; column++) {
+            vec3 position = vec3(center.x + ((float)(column % 3) - 1.0f) * spacing, -BENCH_SLAB_HEIGHT - BENCH_CUBE_HALF_EXTENT - 0.05f,
+                                 center.z + ((float)(column / 3) - 1.0f) * spacing);
+            physics_add_box(&world, position, quat(), vec3(BENCH_CUBE_HALF_EXTENT), 1.0f);
+        }
+    }
+    physics_set_portals(&world, NULL, 0);
+    std::vector<vec3> slab_positions;
+    for (uint32_t room = 0; room < rooms; room++) {
+        slab_positions.push_back(world.bodies[room].position);
+    }
+
+    uint32_t peak_contact_count = 0;
+    bench_run("physics step cubes on static boxes", world.bodies.size(), [&]() {
+        physics_step(&world, BENCH_DELTA);
+        peak_contact_count = std::max(peak_contact_count, world.stats.contact_count);
+    });
+    // The slabs must not have moved, and every cube should still be resting on its slab rather than the floor
+    uint32_t moved_slab_count = 0;
+    for (uint32_t room = 0; room < rooms; room++) {
+        moved_slab_count += world.bodies[room].position == slab_positions[room] ? 0 : 1;
+    }
+    uint32_t fallen_cube_count = 0;
+    for (uint32_t i = rooms; i < world.bodies.size(); i++) {
+        fallen_cube_count += world.bodies[i].position.y > -BENCH_SLAB_HEIGHT ? 1 : 0;
+    }
+    bench_set_metric("moved_static_bodies", moved_slab_count);
+    bench_set_metric("fallen_cubes", fallen_cube_count);
+    bench_set_metric("islands", world.stats.island_count);
+    bench_set_metric("peak_contacts", peak_contact_count);
+}
+
+static void bench_raycast() {
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_RAYCAST_ROOM_COUNT);
+
+    // Incoherent rays from random rooms in random directions, and packets of rays fanning out from one point
+    uint32_t seed = 11;
+    std::vector<Ray> rays(BENCH_RAY_COUNT);
+    std::vector<Ray> packet_rays(BENCH_RAY_COUNT);
+    for (uint32_t i = 0; i < BENCH_RAY_COUNT; i++) {
+        vec3 center = bench_get_room_center((uint32_t)(bench_random(&seed) * BENCH_RAYCAST_ROOM_COUNT), (uint32_t)(bench_random(&seed) * BENCH_RAYCAST_ROOM_COUNT));
+        vec3 direction = vec3(bench_random(&seed) - 0.5f, (bench_random(&seed) - 0.5f) * 0.2f, bench_random(&seed) - 0.5f).normalized();
+        rays[i] = (Ray) {
+            .origin = center,
+            .direction = direction,
+            .max_distance = BENCH_RAY_DISTANCE
+        };
+    }
+    for (uint32_t i = 0; i < BENCH_RAY_COUNT; i++) {
+        const Ray& packet_ray = rays[i - (i % RAYCAST_PACKET_SIZE)];
+        vec3 spread = vec3(bench_random(&seed) - 0.5f, bench_random(&seed) - 0.5f, bench_random(&seed) - 0.5f) * 0.05f;
+        packet_rays[i] = (Ray) {
+            .origin = packet_ray.origin,
+            .direction = (packet_ray.direction + spread).normalized(),
+            .max_distance = BENCH_RAY_DISTANCE
+        };
+    }
+
+    std::vector<RaycastHit> hits(BENCH_RAY_COUNT);
+    double time = bench_run("raycast nearest", BENCH_RAY_COUNT, [&]() {
+        for (uint32_t i = 0; i < BENCH_RAY_COUNT; i++) {
+            raycast_nearest(level, rays[i], RAYCAST_FILTER_ALL, &hits[i]);
+        }
+        bench_keep(hits[0]);
+    });
+    bench_set_metric("mrays_per_second", BENCH_RAY_COUNT / (time * 1000.0));
+    time = bench_run("raycast any", BENCH_RAY_COUNT, [&]() {
+        uint32_t hit_count = 0;
+        for (uint32_t i = 0; i < BENCH_RAY_COUNT; i++) {
+            hit_count += raycast_any(level, rays[i], RAYCAST_FILTER_ALL) ? 1 : 0;
+        }
+        bench_keep(hit_count);
+    });
+    bench_set_metric("mrays_per_second", BENCH_RAY_COUNT / (time * 1000.0));
+    time = bench_run("raycast nearest packets of 8", BENCH_RAY_COUNT, [&]() {
+        for (uint32_t i = 0; i < BENCH_RAY_COUNT; i += RAYCAST_PACKET_SIZE) {
+            raycast_nearest_packet(level, &packet_rays[i], RAYCAST_PACKET_SIZE, RAYCAST_FILTER_ALL, &hits[i]);
+        }
+        bench_keep(hits[0]);
+    });
+    bench_set_metric("mrays_per_second", BENCH_RAY_COUNT / (time * 1000.0));
+}
+
+// Mouse rays cast as far as the editor casts them, through the inverse view-projection of a camera above the level
+// looking down across it. Ceilings are one sided and face into their rooms, so most rays go through a few of them first
+static void bench_picking() {
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_PICK_ROOM_COUNT);
+
+    vec3 target = bench_get_room_center(BENCH_PICK_ROOM_COUNT / 2, BENCH_PICK_ROOM_COUNT / 2);
+    vec3 eye = target + vec3(-15.0f, 0.0f, -15.0f) + (VEC3_UP * 20.0f);
+    mat4 view_projection = mat4::perspective(deg_to_rad(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) * mat4::look_at(eye, target, VEC3_UP);
+    mat4 inverse_view_projection = view_projection.inverse();
+    std::vector<Ray> rays;
+    for (uint32_t y = 0; y < BENCH_PICK_GRID_SIZE; y++) {
+        for (uint32_t x = 0; x < BENCH_PICK_GRID_SIZE; x++) {
+            float ndc_x = ((((float)x + 0.5f) / BENCH_PICK_GRID_SIZE) * 2.0f) - 1.0f;
+            float ndc_y = ((((float)y + 0.5f) / BENCH_PICK_GRID_SIZE) * 2.0f) - 1.0f;
+            vec4 near_point = inverse_view_projection * vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+            vec4 far_point = inverse_view_projection * vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+            vec3 near_position = vec3(near_point.x, near_point.y, near_point.z) / near_point.w;
+            vec3 far_position = vec3(far_point.x, far_point.y, far_point.z) / far_point.w;
+            rays.push_back((Ray) {
+                .origin = near_position,
+                .direction = (far_position - near_position).normalized(),
+                .max_distance = BENCH_PICK_DISTANCE
+            });
+        }
+    }
+
+    std::vector<RaycastHit> hits(rays.size());
+    uint32_t hit_count = 0;
+    double time = bench_run("editor pick 100k faces", rays.size(), [&]() {
+        hit_count = 0;
+        for (uint32_t i = 0; i < rays.size(); i++) {
+            hit_count += raycast_nearest(level, rays[i], RAYCAST_FILTER_ALL, &hits[i]) ? 1 : 0;
+        }
+        bench_keep(hits[0]);
+    });
+    bench_set_metric("faces", level.faces.size());
+    bench_set_metric("ms_per_pick", time / rays.size());
+    bench_set_metric("hit_percent", (hit_count * 100.0) / rays.size());
+}
+
+void bench_suite_physics() {
+    bench_characters();
+    bench_physics();
+    bench_static_boxes();
+    bench_raycast();
+    bench_picking();
+}
\ No newline at end of file
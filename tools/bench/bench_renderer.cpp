@@ -0,0 +1,290 @@
+#include "bench.h"
+
+#include "core/job.h"
+#include "physics/raycast.h"
+#include "renderer/depth_raster.h"
+#include "renderer/font.h"
+#include "renderer/light_cluster.h"
+#include <string>
+#include <vector>
+
+// The renderer's projection
+static const float BENCH_FOV = deg_to_rad(45.0f);
+static const float BENCH_ASPECT = 16.0f / 9.0f;
+static const float BENCH_NEAR_PLANE = 0.1f;
+static const float BENCH_FAR_PLANE = 100.0f;
+static const uint32_t BENCH_ROOM_COUNT = 16;
+static const float BENCH_EYE_HEIGHT = 1.6f;
+// The level's CPU occlusion buffer
+static const uint32_t BENCH_RASTER_WIDTH = 256;
+static const uint32_t BENCH_RASTER_HEIGHT = 144;
+static const float BENCH_RASTER_NEAR_PLANE = 0.05f;
+static const uint32_t BENCH_BOX_COUNT = 4096;
+// Visibility samples per box face, along each axis
+static const uint32_t BENCH_VISIBILITY_SAMPLES = 3;
+// Camera positions along each axis in front of the head-on wall
+static const uint32_t BENCH_HEAD_ON_SAMPLES = 26;
+static const uint32_t BENCH_GLYPH_COUNT = 10000;
+static const uint32_t BENCH_GLYPHS_PER_LINE = 100;
+
+struct BenchView {
+    vec3 position;
+    mat4 view;
+    mat4 projection;
+};
+
+// Standing in a corner room and looking diagonally across the level, so a few rooms are in view and most are
+// behind walls
+static BenchView bench_get_view() {
+    BenchView view;
+    view.position = bench_get_room_center(1, 1) + (VEC3_UP * (BENCH_EYE_HEIGHT - (BENCH_ROOM_HEIGHT * 0.5f)));
+    vec3 target = bench_get_room_center(10, 12) + (VEC3_UP * (BENCH_EYE_HEIGHT - (BENCH_ROOM_HEIGHT * 0.5f)));
+    view.view = mat4::look_at(view.position, target, VEC3_UP);
+    view.projection = mat4::perspective(BENCH_FOV, BENCH_ASPECT, BENCH_NEAR_PLANE, BENCH_FAR_PLANE);
+    return view;
+}
+
+static void bench_light_clusters(const BenchView& view) {
+    const uint32_t light_counts[] = { 256, 1024 };
+    uint32_t seed = 5;
+    float level_size = BENCH_ROOM_COUNT * BENCH_ROOM_SIZE;
+    LightClusterGrid grid;
+    light_cluster_init(&grid, view.projection, BENCH_NEAR_PLANE, BENCH_FAR_PLANE);
+
+    char name[64];
+    for (uint32_t light_count : light_counts) {
+        std::vector<LightClusterSphere> spheres;
+        for (uint32_t i = 0; i < light_count; i++) {
+            spheres.push_back(LightClusterSphere(bench_random(&seed) * level_size, -bench_random(&seed) * BENCH_ROOM_HEIGHT,
+                                                 bench_random(&seed) * level_size, 3.0f + (bench_random(&seed) * 3.0f)));
+        }
+        snprintf(name, sizeof(name), "light cluster build %u lights", light_count);
+        bench_run(name, light_count, [&]() {
+            light_cluster_build(&grid, view.view, spheres.data(), light_count);
+        });
+        bench_set_metric("light_references", grid.light_indices.size());
+    }
+}
+
+struct BenchDepthRasterJob {
+    DepthRaster* raster;
+    const std::vector<DepthRasterQuad>* occluders;
+};
+
+static void bench_render_depth_raster_bands(void* data, uint32_t begin, uint32_t end, uint32_t thread_index) {
+    BenchDepthRasterJob* job = (BenchDepthRasterJob*)data;
+    for (uint32_t band = begin; band < end; band++) {
+        depth_raster_render_band(job->raster, job->occluders->data(), (uint32_t)job->occluders->size(), band);
+    }
+}
+
+// Ray traced against the level from the camera to a grid of points on every face of the box. Not exact either,
+// a box can peek through a gap between its samples, but it's independent of the rasterizer
+static bool bench_is_box_visible(const CollisionWorld& level, const BenchView& view, const AABB& box, bool* is_in_frustum) {
+    mat4 view_projection = view.projection * view.view;
+    vec3 center = box.center();
+    vec3 half_size = (box.max - box.min) * 0.5f * 0.98f;
+    *is_in_frustum = false;
+    for (uint32_t face = 0; face < 6; face++) {
+        uint32_t axis = face / 2;
+        float side = face % 2 == 0 ? -1.0f : 1.0f;
+        for (uint32_t u = 0; u < BENCH_VISIBILITY_SAMPLES; u++) {
+            for (uint32_t v = 0; v < BENCH_VISIBILITY_SAMPLES; v++) {
+                float a = (((float)u / (BENCH_VISIBILITY_SAMPLES - 1)) * 2.0f) - 1.0f;
+                float b = (((float)v / (BENCH_VISIBILITY_SAMPLES - 1)) * 2.0f) - 1.0f;
+                vec3 offset = axis == 0 ? vec3(side, a, b) : (axis == 1 ? vec3(a, side, b) : vec3(a, b, side));
+                vec3 point = center + vec3(offset.x * half_size.x, offset.y * half_size.y, offset.z * half_size.z);
+
+                vec4 clip = view_projection * vec4(point.x, point.y, point.z, 1.0f);
+                if (clip.w <= BENCH_NEAR_PLANE || fabsf(clip.x) > clip.w || fabsf(clip.y) > clip.w || fabsf(clip.z) > clip.w) {
+                    continue;
+                }
+                *is_in_frustum = true;
+                vec3 to_point = point - view.position;
+                float distance = to_point.length();
+                Ray ray = (Ray) {
+                    .origin = view.position,
+                    .direction = to_point / distance,
+                    .max_distance = distance - 0.01f
+                };
+                if (!raycast_any(level, ray, RAYCAST_FILTER_ALL)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static void bench_depth_raster(const BenchView& view) {
+    CollisionWorld level;
+    bench_build_level(&level, BENCH_ROOM_COUNT);
+    std::vector<DepthRasterQuad> occluders;
+    for (const CollisionFace& face : level.faces) {
+        vec3 u = face.axis_u * face.extent_u;
+        vec3 v = face.axis_v * face.extent_v;
+        occluders.push_back((DepthRasterQuad) {
+            .corners = { face.center - u - v, face.center + u - v, face.center + u + v, face.center - u + v },
+            .normal = face.normal
+        });
+    }
+
+    DepthRaster raster;
+    depth_raster_init(&raster, BENCH_RASTER_WIDTH, BENCH_RASTER_HEIGHT, BENCH_RASTER_NEAR_PLANE);
+    depth_raster_set_camera(&raster, view.projection * view.view, view.position);
+    bench_run("depth raster render", occluders.size(), [&]() {
+        depth_raster_render(&raster, occluders.data(), (uint32_t)occluders.size());
+    });
+    BenchDepthRasterJob job = (BenchDepthRasterJob) {
+        .raster = &raster,
+        .occluders = &occluders
+    };
+    bench_run("depth raster render on jobs", occluders.size(), [&]() {
+        job_parallel_for(depth_raster_get_band_count(raster), 1, bench_render_depth_raster_bands, &job);
+        depth_raster_build_hiz(&raster);
+    });
+
+    // Boxes the size of cubes up to crates, anywhere between the floor and ceiling of any room
+    uint32_t seed = 3;
+    float level_size = BENCH_ROOM_COUNT * BENCH_ROOM_SIZE;
+    std::vector<AABB> boxes;
+    for (uint32_t i = 0; i < BENCH_BOX_COUNT; i++) {
+        float half_size = 0.25f + (bench_random(&seed) * 0.35f);
+        vec3 center = vec3(bench_random(&seed) * level_size, -half_size - (bench_random(&seed) * (BENCH_ROOM_HEIGHT - (half_size * 2.0f))), bench_random(&seed) * level_size);
+        boxes.push_back((AABB) {
+            .min = center - vec3(half_size),
+            .max = center + vec3(half_size)
+        });
+    }
+    std::vector<uint8_t> is_occluded(BENCH_BOX_COUNT);
+    bench_run("depth raster cull 4096 boxes", BENCH_BOX_COUNT, [&]() {
+        for (uint32_t i = 0; i < BENCH_BOX_COUNT; i++) {
+            is_occluded[i] = depth_raster_is_occluded(raster, boxes[i]) ? 1 : 0;
+        }
+        bench_keep(is_occluded[0]);
+    });
+
+    // Accuracy against ray traced visibility, counting only the boxes in the frustum, since frustum culling is
+    // left to the caller. Culling a visible box is a bug that makes things pop, missing a hidden one only costs time
+    uint32_t in_frustum_count = 0;
+    uint32_t hidden_count = 0;
+    uint32_t culled_count = 0;
+    uint32_t culled_hidden_count = 0;
+    uint32_t culled_visible_count = 0;
+    for (uint32_t i = 0; i < BENCH_BOX_COUNT; i++) {
+        bool is_in_frustum;
+        bool is_visible = bench_is_box_visible(level, view, boxes[i], &is_in_frustum);
+        if (!is_in_frustum) {
+            continue;
+        }
+        in_frustum_count++;
+        hidden_count += is_visible ? 0 : 1;
+        culled_count += is_occluded[i];
+        culled_hidden_count += !is_visible && is_occluded[i] ? 1 : 0;
+        culled_visible_count += is_visible && is_occluded[i] ? 1 : 0;
+    }
+    bench_set_metric("boxes_in_frustum", in_frustum_count);
+    bench_set_metric("hidden_percent", in_frustum_count == 0 ? 0.0 : (hidden_count * 100.0) / in_frustum_count);
+    bench_set_metric("culled_percent", in_frustum_count == 0 ? 0.0 : (culled_count * 100.0) / in_frustum_count);
+    bench_set_metric("hidden_culled_percent", hidden_count == 0 ? 0.0 : (culled_hidden_count * 100.0) / hidden_count);
+    bench_set_metric("visible_culled", culled_visible_count);
+
+    // Every wall's own flat box, which is what the renderer tests its wall draws with. A wall lies exactly on its
+    // occluder, so these are the boxes a missing depth bias culls
+    uint32_t wall_count = 0;
+    uint32_t culled_visible_wall_count = 0;
+    for (const DepthRasterQuad& occluder : occluders) {
+        AABB bounds = AABB::empty();
+        for (uint32_t corner = 0; corner < 4; corner++) {
+            bounds.expand(occluder.corners[corner]);
+        }
+        bool is_in_frustum;
+        bool is_visible = bench_is_box_visible(level, view, bounds, &is_in_frustum);
+        if (!is_in_frustum) {
+            continue;
+        }
+        wall_count++;
+        culled_visible_wall_count += is_visible && depth_raster_is_occluded(raster, bounds) ? 1 : 0;
+    }
+    bench_set_metric("walls_in_frustum", wall_count);
+    bench_set_metric("visible_walls_culled", culled_visible_wall_count);
+    if (culled_visible_count + culled_visible_wall_count > 0) {
+        bench_fail("a visible box was culled");
+    }
+}
+
+// A wall straight ahead of the camera, seen from a grid of positions in front of it. The 1 / w interpolated
+// across the wall can round to just in front of the nearest corner of the wall's own box, which would cull
+// the wall against itself
+static void bench_depth_raster_head_on(const BenchView& view) {
+    DepthRasterQuad wall = (DepthRasterQuad) {
+        .corners = { vec3(-2.0f, -1.5f, 0.0f), vec3(2.0f, -1.5f, 0.0f), vec3(2.0f, 1.5f, 0.0f), vec3(-2.0f, 1.5f, 0.0f) },
+        .normal = vec3(0.0f, 0.0f, 1.0f)
+    };
+    AABB bounds = (AABB) {
+        .min = vec3(-2.0f, -1.5f, 0.0f),
+        .max = vec3(2.0f, 1.5f, 0.0f)
+    };
+    DepthRaster raster;
+    depth_raster_init(&raster, BENCH_RASTER_WIDTH, BENCH_RASTER_HEIGHT, BENCH_RASTER_NEAR_PLANE);
+
+    uint32_t self_culled_count = 0;
+    bench_run("depth raster head-on wall", BENCH_HEAD_ON_SAMPLES * BENCH_HEAD_ON_SAMPLES, [&]() {
+        self_culled_count = 0;
+        for (uint32_t x = 0; x < BENCH_HEAD_ON_SAMPLES; x++) {
+            for (uint32_t z = 0; z < BENCH_HEAD_ON_SAMPLES; z++) {
+                vec3 position = vec3(-1.0f + ((2.0f * x) / (BENCH_HEAD_ON_SAMPLES - 1)), 0.0f, 1.0f + ((7.0f * z) / (BENCH_HEAD_ON_SAMPLES - 1)));
+                mat4 camera_view = mat4::look_at(position, position - vec3(0.0f, 0.0f, 1.0f), VEC3_UP);
+                depth_raster_set_camera(&raster, view.projection * camera_view, position);
+                depth_raster_render(&raster, &wall, 1);
+                self_culled_count += depth_raster_is_occluded(raster, bounds) ? 1 : 0;
+            }
+        }
+    });
+    bench_set_metric("self_culled", self_culled_count);
+    if (self_culled_count > 0) {
+        bench_fail("the wall was culled by itself");
+    }
+}
+
+// font_layout() only needs the glyph metrics, so a made up monospaced font stands in for a loaded one and no
+// GL context is needed
+static void bench_glyphs() {
+    Font font;
+    font.atlas = 0;
+    font.atlas_size = ivec2(512, 512);
+    font.line_height = 16;
+    for (uint32_t i = 0; i < FONT_CHARACTER_COUNT; i++) {
+        bool is_space = i + FONT_FIRST_CHARACTER == ' ';
+        font.glyphs[i] = (FontGlyph) {
+            .atlas_position = ivec2((i % 32) * 16, (i / 32) * 16),
+            .size = is_space ? ivec2(0, 0) : ivec2(8, 14),
+            .offset = ivec2(0, 2),
+            .advance = 9
+        };
+    }
+
+    std::string text;
+    for (uint32_t i = 0; i < BENCH_GLYPH_COUNT; i++) {
+        text.push_back((char)('!' + (i % (FONT_CHARACTER_COUNT - 1))));
+        if (i % BENCH_GLYPHS_PER_LINE == BENCH_GLYPHS_PER_LINE - 1) {
+            text.push_back('\n');
+        }
+    }
+    std::vector<TextVertex> vertices;
+    vertices.reserve(BENCH_GLYPH_COUNT * 6);
+    uint32_t color = font_pack_color(vec3(1.0f, 1.0f, 1.0f));
+    bench_run("font layout 10k glyphs", BENCH_GLYPH_COUNT, [&]() {
+        vertices.clear();
+        font_layout(font, text.c_str(), ivec2(8, 8), color, &vertices);
+        bench_keep(vertices[0]);
+    });
+}
+
+void bench_suite_renderer() {
+    BenchView view = bench_get_view();
+    bench_light_clusters(view);
+    bench_depth_raster(view);
+    bench_depth_raster_head_on(view);
+    bench_glyphs();
+}
\ No newline at end of file
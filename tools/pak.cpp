@@ -0,0 +1,139 @@
+// Packs a resource directory into a pak for the game's VFS: pak <resource directory> <output pak>
+
+#include "core/pak.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct PakFile {
+    std::string path;
+    std::vector<uint8_t> data;
+    PakEntry entry;
+};
+
+static bool pak_read_file(const std::filesystem::path& path, std::vector<uint8_t>* data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static uint64_t pak_align(uint64_t offset) {
+    return (offset + PAK_ALIGNMENT - 1) & ~(uint64_t)(PAK_ALIGNMENT - 1);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <resource directory> <output pak>\n", argv[0]);
+        return 1;
+    }
+    std::filesystem::path resource_directory = argv[1];
+
+    std::vector<PakFile> files;
+    size_t loose_size = 0;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(resource_directory, error); it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (error) {
+            fprintf(stderr, "Could not read %s: %s\n", resource_directory.string().c_str(), error.message().c_str());
+            return 1;
+        }
+        if (!it->is_regular_file()) {
+            continue;
+        }
+
+        PakFile file;
+        file.path = std::filesystem::relative(it->path(), resource_directory).generic_string();
+        if (!pak_read_file(it->path(), &file.data)) {
+            fprintf(stderr, "Could not read %s\n", it->path().string().c_str());
+            return 1;
+        }
+        loose_size += file.data.size();
+        file.entry = (PakEntry) {
+            .hash = pak_hash_path(file.path.c_str(), file.path.size()),
+            .size = file.data.size(),
+            .stored_size = file.data.size(),
+            .name_length = (uint32_t)file.path.size()
+        };
+
+        std::vector<uint8_t> compressed(pak_get_compress_bound(file.data.size()));
+        size_t compressed_size = pak_compress(file.data.data(), file.data.size(), compressed.data(), compressed.size());
+        if (compressed_size != 0 && (float)compressed_size <= (float)file.data.size() * (1.0f - PAK_MIN_COMPRESSION_SAVING)) {
+            compressed.resize(compressed_size);
+            file.data.swap(compressed);
+            file.entry.stored_size = compressed_size;
+            file.entry.flags = PAK_ENTRY_COMPRESSED;
+        }
+        files.push_back(file);
+    }
+
+    std::sort(files.begin(), files.end(), [](const PakFile& a, const PakFile& b) {
+        return a.entry.hash < b.entry.hash;
+    });
+    for (size_t i = 1; i < files.size(); i++) {
+        if (files[i].entry.hash == files[i - 1].entry.hash) {
+            fprintf(stderr, "%s and %s have the same hash, rename one of them.\n", files[i - 1].path.c_str(), files[i].path.c_str());
+            return 1;
+        }
+    }
+
+    // About one entry per bucket
+    uint32_t bucket_bits = 1;
+    while ((1ull << bucket_bits) < files.size()) {
+        bucket_bits++;
+    }
+    uint32_t bucket_count = 1 << bucket_bits;
+    std::vector<uint32_t> buckets(bucket_count + 1);
+    uint32_t entry_index = 0;
+    for (uint32_t bucket = 0; bucket <= bucket_count; bucket++) {
+        while (entry_index < files.size() && pak_get_bucket(files[entry_index].entry.hash, bucket_bits) < bucket) {
+            entry_index++;
+        }
+        buckets[bucket] = entry_index;
+    }
+
+    std::string names;
+    for (PakFile& file : files) {
+        file.entry.name_offset = (uint32_t)names.size();
+        names += file.path;
+    }
+
+    PakHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PAK_MAGIC, sizeof(PAK_MAGIC));
+    header.version = PAK_VERSION;
+    header.entry_count = (uint32_t)files.size();
+    header.bucket_bits = bucket_bits;
+    header.buckets_offset = sizeof(PakHeader);
+    header.entries_offset = pak_align(header.buckets_offset + (buckets.size() * sizeof(uint32_t)));
+    header.names_offset = header.entries_offset + (files.size() * sizeof(PakEntry));
+    uint64_t offset = pak_align(header.names_offset + names.size());
+    for (PakFile& file : files) {
+        file.entry.offset = offset;
+        offset = pak_align(offset + file.entry.stored_size);
+    }
+    header.file_size = offset;
+
+    std::vector<uint8_t> pak(header.file_size, 0);
+    memcpy(pak.data(), &header, sizeof(header));
+    memcpy(pak.data() + header.buckets_offset, buckets.data(), buckets.size() * sizeof(uint32_t));
+    memcpy(pak.data() + header.names_offset, names.data(), names.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        memcpy(pak.data() + header.entries_offset + (i * sizeof(PakEntry)), &files[i].entry, sizeof(PakEntry));
+        memcpy(pak.data() + files[i].entry.offset, files[i].data.data(), files[i].data.size());
+    }
+
+    std::ofstream output(argv[2], std::ios::binary);
+    output.write((const char*)pak.data(), pak.size());
+    if (!output.good()) {
+        fprintf(stderr, "Could not write %s\n", argv[2]);
+        return 1;
+    }
+    printf("Packed %zu files, %.2f MB of loose files into %.2f MB.\n", files.size(), (double)loose_size / (1024.0 * 1024.0), (double)pak.size() / (1024.0 * 1024.0));
+    return 0;
+}
\ No newline at end of file